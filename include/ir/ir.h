@@ -0,0 +1,217 @@
+#pragma once
+
+#include <stddef.h>
+#include <stdint.h>
+
+#include "utils/arena.h"
+
+#define IR_NONE UINT32_MAX
+
+typedef uint32_t IrValueId;
+typedef uint32_t IrBlockId;
+
+enum {
+  IR_OPF_PURE = 1 << 0,
+  IR_OPF_BINARY = 1 << 1,
+  IR_OPF_UNARY = 1 << 2,
+  IR_OPF_COMMUTATIVE = 1 << 3,
+  IR_OPF_COMPARE = 1 << 4,
+  IR_OPF_TERMINATOR = 1 << 5,
+  IR_OPF_SIDE_EFFECT = 1 << 6,
+  IR_OPF_READS_MEMORY = 1 << 7
+};
+
+typedef enum {
+#define IR_OP(name, text, flags) IR_OP_##name,
+#include "ir/ir_ops.def"
+  IR_OP_COUNT
+} IrOp;
+
+typedef enum {
+  IR_TYPE_VOID,
+  IR_TYPE_I32,
+  IR_TYPE_PTR
+} IrType;
+
+enum {
+  IR_INST_TAIL = 1 << 0
+};
+
+typedef struct {
+  uint8_t op;
+  uint8_t type;
+  uint8_t width;
+  uint8_t flags;
+  IrBlockId block;
+  uint32_t ops[3];
+  int32_t imm;
+  uint32_t list;
+  uint32_t list_count;
+} IrInst;
+
+typedef struct {
+  uint32_t *items;
+  uint32_t count;
+  uint32_t capacity;
+} IrIdVector;
+
+enum {
+  IR_BLOCK_DEAD = 1 << 0
+};
+
+typedef struct {
+  IrIdVector insts;
+  IrIdVector preds;
+  uint32_t flags;
+} IrBlock;
+
+enum {
+  IR_FRAME_SCALAR = 1 << 0,
+  IR_FRAME_DEAD = 1 << 1
+};
+
+typedef struct {
+  const char *name;
+  int32_t size;
+  int32_t align;
+  uint8_t elem_width;
+  uint8_t flags;
+} IrFrameObject;
+
+enum {
+  IR_FUNCTION_READONLY = 1 << 0,
+  IR_FUNCTION_PURE = 1 << 1
+};
+
+typedef struct IrModule IrModule;
+
+typedef struct IrFunction {
+  IrModule *module;
+  const char *name;
+  size_t length;
+  int32_t index;
+  int32_t param_count;
+  uint32_t attrs;
+  IrInst *insts;
+  uint32_t inst_count;
+  uint32_t inst_capacity;
+  IrBlock *blocks;
+  uint32_t block_count;
+  uint32_t block_capacity;
+  uint32_t *operands;
+  uint32_t operand_count;
+  uint32_t operand_capacity;
+  IrFrameObject *frame;
+  uint32_t frame_count;
+  uint32_t frame_capacity;
+} IrFunction;
+
+typedef struct {
+  const int32_t *words;
+  uint32_t word_count;
+} IrData;
+
+typedef struct {
+  uint32_t value_count;
+  uint32_t *start;
+  uint32_t *users;
+} IrUses;
+
+struct IrModule {
+  Arena arena;
+  IrFunction **functions;
+  uint32_t function_count;
+  uint32_t function_capacity;
+  IrData *data;
+  uint32_t data_count;
+  uint32_t data_capacity;
+};
+
+void ir_module_init(IrModule *module);
+
+void ir_module_destroy(IrModule *module);
+
+IrFunction *ir_function_create(IrModule *module, const char *name, size_t length, int32_t param_count);
+
+uint32_t ir_data_create(IrModule *module, const int32_t *words, uint32_t word_count);
+
+const char *ir_op_name(IrOp op);
+
+uint32_t ir_op_flags(IrOp op);
+
+static inline IrInst *ir_inst(const IrFunction *fn, const IrValueId id) {
+  return &fn->insts[id];
+}
+
+static inline IrBlock *ir_block(const IrFunction *fn, const IrBlockId id) {
+  return &fn->blocks[id];
+}
+
+void ir_id_vector_push(IrFunction *fn, IrIdVector *vec, uint32_t id);
+
+IrBlockId ir_block_create(IrFunction *fn);
+
+int32_t ir_frame_object_create(IrFunction *fn, const char *name, int32_t size, int32_t align, uint8_t elem_width,
+                               uint8_t flags);
+
+IrValueId ir_inst_create(IrFunction *fn, IrOp op, IrType type);
+
+void ir_block_append(IrFunction *fn, IrBlockId block, IrValueId inst);
+
+void ir_block_insert(IrFunction *fn, IrBlockId block, uint32_t position, IrValueId inst);
+
+void ir_block_insert_before_terminator(IrFunction *fn, IrBlockId block, IrValueId inst);
+
+IrValueId ir_emit(IrFunction *fn, IrBlockId block, IrOp op, IrType type, uint32_t a, uint32_t b);
+
+IrValueId ir_emit_const(IrFunction *fn, IrBlockId block, int32_t value);
+
+void ir_inst_set_list(IrFunction *fn, IrValueId inst, const uint32_t *items, uint32_t count);
+
+void ir_phi_add_incoming(IrFunction *fn, IrValueId phi, IrBlockId block, IrValueId value);
+
+IrValueId ir_phi_incoming_for(const IrFunction *fn, IrValueId phi, IrBlockId block);
+
+void ir_phi_remove_incoming(IrFunction *fn, IrValueId phi, IrBlockId block);
+
+IrValueId ir_block_terminator(const IrFunction *fn, IrBlockId block);
+
+uint32_t ir_block_succs(const IrFunction *fn, IrBlockId block, IrBlockId out[2]);
+
+void ir_compute_preds(IrFunction *fn);
+
+uint32_t ir_operand_count(const IrFunction *fn, const IrInst *inst);
+
+uint32_t *ir_operand_slot(const IrFunction *fn, const IrInst *inst, uint32_t index);
+
+int32_t ir_value_const(const IrFunction *fn, IrValueId value, int32_t *out);
+
+void ir_inst_kill(IrFunction *fn, IrValueId inst);
+
+void ir_inst_make_const(IrFunction *fn, IrValueId inst, int32_t value);
+
+void ir_replace_all_uses(IrFunction *fn, IrValueId from, IrValueId to);
+
+void ir_rewrite_operands(IrFunction *fn, IrValueId *map);
+
+void ir_replace_successor(IrFunction *fn, IrBlockId block, IrBlockId from, IrBlockId to);
+
+void ir_phis_rename_pred(IrFunction *fn, IrBlockId block, IrBlockId from, IrBlockId to);
+
+IrBlockId ir_split_edge(IrFunction *fn, IrBlockId from, IrBlockId to);
+
+void ir_block_kill(IrFunction *fn, IrBlockId block);
+
+void ir_sweep(IrFunction *fn);
+
+void ir_compact_blocks(IrFunction *fn);
+
+uint32_t ir_live_inst_count(const IrFunction *fn);
+
+IrValueId ir_address_base(const IrFunction *fn, IrValueId value);
+
+int32_t ir_address_constant_offset(const IrFunction *fn, IrValueId value, int32_t *offset);
+
+void ir_uses_compute(IrUses *uses, const IrFunction *fn);
+
+void ir_uses_destroy(IrUses *uses);
@@ -0,0 +1,7 @@
+#pragma once
+
+#include "ir/ir.h"
+#include "parser/ast.h"
+#include "sema/sema.h"
+
+void ir_build_module(IrModule *module, const AstModule *ast, const Sema *sema);
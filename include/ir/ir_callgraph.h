@@ -0,0 +1,22 @@
+#pragma once
+
+#include <stdint.h>
+
+#include "ir/ir.h"
+
+typedef struct {
+  uint32_t function_count;
+  uint32_t *edge_start;
+  uint32_t *edges;
+  uint32_t *call_sites;
+  uint32_t *scc;
+  uint32_t scc_count;
+  uint32_t *bottom_up;
+  uint8_t *recursive;
+} IrCallGraph;
+
+void ir_callgraph_compute(IrCallGraph *graph, const IrModule *module);
+
+void ir_callgraph_infer_attrs(const IrCallGraph *graph, IrModule *module);
+
+void ir_callgraph_destroy(IrCallGraph *graph);
@@ -0,0 +1,29 @@
+#pragma once
+
+#include <stdint.h>
+
+#include "ir/ir.h"
+
+typedef struct {
+  uint32_t block_count;
+  uint32_t *idom;
+  uint32_t *rpo;
+  uint32_t rpo_count;
+  uint32_t *rpo_index;
+  uint32_t *child_start;
+  uint32_t *children;
+  uint32_t *pre;
+  uint32_t *post;
+  uint32_t *df_start;
+  uint32_t *df;
+} IrDomTree;
+
+void ir_dom_compute(IrDomTree *dom, const IrFunction *fn);
+
+void ir_dom_compute_frontiers(IrDomTree *dom, const IrFunction *fn);
+
+int32_t ir_dom_dominates(const IrDomTree *dom, IrBlockId a, IrBlockId b);
+
+int32_t ir_dom_reachable(const IrDomTree *dom, IrBlockId block);
+
+void ir_dom_destroy(IrDomTree *dom);
@@ -0,0 +1,9 @@
+#pragma once
+
+#include <stdint.h>
+
+#include "ir/ir.h"
+
+int32_t ir_fold_binary(IrOp op, int32_t a, int32_t b, int32_t *out);
+
+int32_t ir_fold_unary(IrOp op, int32_t a, int32_t *out);
@@ -0,0 +1,42 @@
+#pragma once
+
+#include <stdint.h>
+
+#include "ir/ir.h"
+
+typedef enum {
+  IR_INTERP_OK,
+  IR_INTERP_MEMORY_FAULT,
+  IR_INTERP_STACK_OVERFLOW,
+  IR_INTERP_STEP_LIMIT,
+  IR_INTERP_INVALID
+} IrInterpStatus;
+
+typedef struct {
+  IrInterpStatus status;
+  int32_t value;
+  uint64_t steps;
+} IrInterpResult;
+
+typedef struct {
+  uint64_t *blocks;
+  uint64_t *taken;
+  uint32_t block_count;
+} IrFunctionProfile;
+
+typedef struct {
+  IrFunctionProfile *functions;
+  uint32_t function_count;
+} IrProfile;
+
+IrInterpResult ir_interp_run(const IrModule *module, int32_t function, const int32_t *args, uint32_t arg_count,
+                             uint64_t step_limit);
+
+IrInterpResult ir_interp_profile(const IrModule *module, int32_t function, const int32_t *args, uint32_t arg_count,
+                                 uint64_t step_limit, IrProfile *profile);
+
+void ir_profile_init(IrProfile *profile, const IrModule *module);
+
+void ir_profile_destroy(IrProfile *profile);
+
+const char *ir_interp_status_name(IrInterpStatus status);
@@ -0,0 +1,33 @@
+#pragma once
+
+#include <stdint.h>
+
+#include "ir/ir.h"
+#include "ir/ir_dom.h"
+
+typedef struct {
+  IrBlockId header;
+  uint32_t parent;
+  uint32_t depth;
+  uint32_t block_start;
+  uint32_t block_count;
+} IrLoop;
+
+typedef struct {
+  IrLoop *loops;
+  uint32_t loop_count;
+  uint32_t *blocks;
+  uint32_t *block_loop;
+  uint32_t *block_depth;
+  uint32_t block_count;
+} IrLoopInfo;
+
+void ir_loops_compute(IrLoopInfo *info, const IrFunction *fn, const IrDomTree *dom);
+
+int32_t ir_loop_contains(const IrLoopInfo *info, uint32_t loop, IrBlockId block);
+
+IrBlockId ir_loop_preheader(const IrFunction *fn, const IrLoopInfo *info, uint32_t loop);
+
+IrBlockId ir_loop_ensure_preheader(IrFunction *fn, const IrLoopInfo *info, uint32_t loop);
+
+void ir_loops_destroy(IrLoopInfo *info);
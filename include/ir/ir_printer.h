@@ -0,0 +1,7 @@
+#pragma once
+
+#include "ir/ir.h"
+
+void ir_print_function(const IrFunction *fn);
+
+void ir_print_module(const IrModule *module);
@@ -0,0 +1,21 @@
+#pragma once
+
+#include <stdint.h>
+
+#include "ir/ir.h"
+#include "ir/ir_dom.h"
+#include "ir/ir_interp.h"
+#include "ir/ir_loop.h"
+
+typedef struct {
+  float *taken;
+  float *frequency;
+  uint32_t block_count;
+} IrBlockProbs;
+
+void ir_probs_compute(IrBlockProbs *probs, const IrFunction *fn, const IrDomTree *dom, const IrLoopInfo *loops,
+                      const IrFunctionProfile *profile);
+
+float ir_probs_edge(const IrBlockProbs *probs, const IrFunction *fn, IrBlockId from, IrBlockId to);
+
+void ir_probs_destroy(IrBlockProbs *probs);
@@ -0,0 +1,7 @@
+#pragma once
+
+#include <stdint.h>
+
+#include "ir/ir.h"
+
+uint32_t ir_promote_slots(IrFunction *fn);
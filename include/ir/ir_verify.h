@@ -0,0 +1,9 @@
+#pragma once
+
+#include <stdint.h>
+
+#include "ir/ir.h"
+
+int32_t ir_verify_function(const IrFunction *fn);
+
+int32_t ir_verify_module(const IrModule *module);
@@ -0,0 +1,44 @@
+#pragma once
+
+#include <stdint.h>
+
+#include "ir/ir.h"
+#include "ir/ir_dom.h"
+#include "ir/ir_loop.h"
+#include "opt/optimize.h"
+
+enum {
+  OPT_ANALYSIS_DOM = 1 << 0,
+  OPT_ANALYSIS_LOOPS = 1 << 1,
+  OPT_ANALYSIS_USES = 1 << 2
+};
+
+enum {
+  OPT_PRESERVE_NONE = 0,
+  OPT_PRESERVE_CFG = OPT_ANALYSIS_DOM | OPT_ANALYSIS_LOOPS,
+  OPT_PRESERVE_ALL = OPT_ANALYSIS_DOM | OPT_ANALYSIS_LOOPS | OPT_ANALYSIS_USES
+};
+
+typedef struct {
+  IrFunction *fn;
+  const OptOptions *options;
+  uint32_t valid;
+  IrDomTree dom;
+  IrLoopInfo loops;
+  IrUses uses;
+  double seconds;
+} OptAnalyses;
+
+void opt_analyses_init(OptAnalyses *analyses, IrFunction *fn, const OptOptions *options);
+
+const IrDomTree *opt_analyses_dom(OptAnalyses *analyses);
+
+const IrLoopInfo *opt_analyses_loops(OptAnalyses *analyses);
+
+const IrUses *opt_analyses_uses(OptAnalyses *analyses);
+
+const IrLoopInfo *opt_analyses_loops_with_preheaders(OptAnalyses *analyses);
+
+void opt_analyses_invalidate(OptAnalyses *analyses, uint32_t preserved);
+
+void opt_analyses_destroy(OptAnalyses *analyses);
@@ -0,0 +1,9 @@
+#pragma once
+
+#include <stdint.h>
+
+#include "ir/ir.h"
+
+uint32_t opt_dead_stores(IrFunction *fn);
+
+uint32_t opt_dce(IrFunction *fn);
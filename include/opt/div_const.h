@@ -0,0 +1,10 @@
+#pragma once
+
+#include <stdint.h>
+
+#include "ir/ir.h"
+#include "opt/analysis.h"
+
+uint32_t opt_div_const(IrFunction *fn, int32_t has_mul);
+
+uint32_t opt_div_const_pass(IrFunction *fn, OptAnalyses *analyses);
@@ -0,0 +1,9 @@
+#pragma once
+
+#include <stdint.h>
+
+#include "ir/ir.h"
+
+#define OPT_INLINE_DEFAULT_LIMIT 40
+
+uint32_t opt_inline_module(IrModule *module, int32_t limit);
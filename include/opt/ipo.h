@@ -0,0 +1,12 @@
+#pragma once
+
+#include <stdint.h>
+
+#include "ir/ir.h"
+
+#define OPT_IPO_EVAL_STEP_LIMIT 100000
+#define OPT_IPO_EVAL_BUDGET 2000000
+
+uint32_t opt_fold_pure_calls(IrModule *module, int32_t whole_program);
+
+uint32_t opt_global_dce(IrModule *module, int32_t whole_program);
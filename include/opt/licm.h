@@ -0,0 +1,8 @@
+#pragma once
+
+#include <stdint.h>
+
+#include "ir/ir.h"
+#include "opt/analysis.h"
+
+uint32_t opt_licm(IrFunction *fn, OptAnalyses *analyses);
@@ -0,0 +1,20 @@
+#pragma once
+
+#include <stdint.h>
+
+#include "ir/ir.h"
+#include "target/target.h"
+
+typedef struct {
+  int32_t level;
+  int32_t inline_limit;
+  int32_t whole_program;
+  TargetInfo target;
+  const char *pipeline;
+} OptOptions;
+
+void opt_options_init(OptOptions *options, int32_t level);
+
+const char *opt_default_pipeline(int32_t level);
+
+void opt_optimize_module(IrModule *module, const OptOptions *options);
@@ -0,0 +1,10 @@
+#pragma once
+
+#include <stdint.h>
+
+#include "ir/ir.h"
+#include "opt/optimize.h"
+
+int32_t opt_pipeline_validate(const char *pipeline);
+
+void opt_pipeline_run(IrModule *module, const char *pipeline, const OptOptions *options);
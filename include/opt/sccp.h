@@ -0,0 +1,8 @@
+#pragma once
+
+#include <stdint.h>
+
+#include "ir/ir.h"
+#include "opt/analysis.h"
+
+uint32_t opt_sccp(IrFunction *fn, OptAnalyses *analyses);
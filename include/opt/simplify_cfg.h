@@ -0,0 +1,7 @@
+#pragma once
+
+#include <stdint.h>
+
+#include "ir/ir.h"
+
+uint32_t opt_simplify_cfg(IrFunction *fn);
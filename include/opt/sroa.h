@@ -0,0 +1,10 @@
+#pragma once
+
+#include <stdint.h>
+
+#include "ir/ir.h"
+#include "opt/analysis.h"
+
+#define OPT_SROA_MAX_ELEMENTS 16
+
+uint32_t opt_sroa(IrFunction *fn, OptAnalyses *analyses);
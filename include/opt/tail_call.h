@@ -0,0 +1,11 @@
+#pragma once
+
+#include <stdint.h>
+
+#include "ir/ir.h"
+
+#define OPT_TAIL_CALL_MAX_ARGS 8
+
+uint32_t opt_tail_recursion(IrFunction *fn);
+
+uint32_t opt_mark_tail_calls(IrFunction *fn);
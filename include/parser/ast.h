@@ -5,6 +5,8 @@
 
 #include "lexer/token.h"
 
+#define AST_NO_SYMBOL (-1)
+
 typedef enum {
   AST_TYPE_INT,
   AST_TYPE_CHAR,
@@ -47,6 +49,9 @@ typedef struct {
   AstType type;
   char *name;
   size_t length;
+  int32_t line;
+  int32_t column;
+  int32_t symbol;
 } AstParam;
 
 typedef struct {
@@ -61,6 +66,9 @@ typedef struct {
   AstType return_type;
   AstNode *body;
   AstParamVector params;
+  int32_t line;
+  int32_t column;
+  int32_t symbol;
 } AstFunction;
 
 typedef struct {
@@ -96,6 +104,7 @@ struct AstNode {
       char *name;
       size_t length;
       AstNode *initializer;
+      int32_t symbol;
     } var_decl;
 
     struct {
@@ -131,6 +140,7 @@ struct AstNode {
     struct {
       char *name;
       size_t length;
+      int32_t symbol;
     } identifier;
 
     struct {
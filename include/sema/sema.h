@@ -0,0 +1,76 @@
+#pragma once
+
+#include <stddef.h>
+#include <stdint.h>
+
+#include "parser/ast.h"
+
+typedef enum {
+  SEMA_SYMBOL_FUNCTION,
+  SEMA_SYMBOL_PARAM,
+  SEMA_SYMBOL_LOCAL
+} SemaSymbolKind;
+
+typedef struct {
+  SemaSymbolKind kind;
+  AstType type;
+  const char *name;
+  size_t length;
+  int32_t line;
+  int32_t column;
+  int32_t function;
+  int32_t slot;
+} SemaSymbol;
+
+typedef struct {
+  SemaSymbol *items;
+  size_t count;
+  size_t capacity;
+} SemaSymbolVector;
+
+typedef struct {
+  int32_t symbol;
+  int32_t first_local;
+  int32_t local_count;
+  int32_t param_count;
+} SemaFunctionInfo;
+
+typedef struct {
+  uint32_t hash;
+  int32_t symbol;
+} SemaScopeEntry;
+
+typedef struct {
+  SemaScopeEntry *entries;
+  uint32_t capacity;
+  uint32_t count;
+} SemaScope;
+
+typedef struct Sema {
+  AstModule *module;
+  const char *filename;
+  const char *source_begin;
+  int32_t had_error;
+  SemaSymbolVector symbols;
+  SemaFunctionInfo *functions;
+  SemaScope *scopes;
+  int32_t scope_depth;
+  int32_t scope_capacity;
+  int32_t current_function;
+  int32_t loop_depth;
+} Sema;
+
+typedef struct {
+  const Sema *sema;
+  int32_t had_error;
+} SemaResult;
+
+void sema_init(Sema *sema, AstModule *module, const char *source, const char *filename);
+
+SemaResult sema_analyze(Sema *sema);
+
+const SemaSymbol *sema_symbol(const Sema *sema, int32_t symbol);
+
+const SemaFunctionInfo *sema_function_info(const Sema *sema, int32_t function);
+
+void sema_destroy(Sema *sema);
@@ -0,0 +1,73 @@
+#pragma once
+
+#include <stddef.h>
+#include <stdint.h>
+#include <stdio.h>
+
+#include "sim/sim_decode.h"
+#include "target/sched.h"
+#include "utils/arena.h"
+
+#define SIM_BLOCK_BUCKETS 4096
+#define SIM_RETURN_STACK 16
+
+typedef enum {
+  SIM_OK,
+  SIM_MEMORY_FAULT,
+  SIM_FETCH_FAULT,
+  SIM_ILLEGAL_INSTRUCTION,
+  SIM_BREAKPOINT,
+  SIM_STEP_LIMIT
+} SimStatus;
+
+typedef struct {
+  uint64_t instructions;
+  uint64_t loads;
+  uint64_t stores;
+  uint64_t branches;
+  uint64_t taken_branches;
+  uint64_t mispredicts;
+  uint64_t jumps;
+  uint64_t vector_insts;
+  uint64_t cycles;
+  uint64_t blocks;
+} SimStats;
+
+typedef struct {
+  SimStatus status;
+  int64_t value;
+  uint64_t pc;
+} SimResult;
+
+typedef struct SimBlock SimBlock;
+
+typedef struct {
+  int32_t xlen;
+  uint8_t *memory;
+  uint64_t memory_size;
+  uint64_t entry;
+  uint64_t regs[SIM_REG_COUNT];
+  uint64_t vl;
+  uint64_t vtype;
+  uint32_t vsew;
+  uint8_t vregs[SIM_VREG_COUNT * SIM_VLENB];
+  const MachineModel *model;
+  SimStats stats;
+  Arena arena;
+  SimBlock *buckets[SIM_BLOCK_BUCKETS];
+  void *const *handlers;
+  uint64_t returns[SIM_RETURN_STACK];
+  uint32_t return_top;
+} SimMachine;
+
+void sim_init(SimMachine *sim, uint64_t memory_size, const MachineModel *model);
+
+int32_t sim_load_elf(SimMachine *sim, const uint8_t *image, size_t size);
+
+SimResult sim_run(SimMachine *sim, uint64_t step_limit);
+
+void sim_print_stats(const SimStats *stats, double seconds, FILE *out);
+
+void sim_destroy(SimMachine *sim);
+
+const char *sim_status_name(SimStatus status);
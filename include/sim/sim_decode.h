@@ -0,0 +1,54 @@
+#pragma once
+
+#include <stddef.h>
+#include <stdint.h>
+
+#define SIM_REG_SINK 32
+#define SIM_REG_COUNT 33
+
+#define SIM_VLEN 128
+#define SIM_VLENB (SIM_VLEN / 8)
+#define SIM_VREG_COUNT 32
+
+enum {
+  SIM_OPF_RV64 = 1 << 0,
+  SIM_OPF_VECTOR = 1 << 1,
+  SIM_OPF_VMASK = 1 << 2
+};
+
+typedef enum {
+  SIM_UNIT_NONE,
+  SIM_UNIT_ALU,
+  SIM_UNIT_MUL,
+  SIM_UNIT_DIV,
+  SIM_UNIT_LOAD,
+  SIM_UNIT_STORE,
+  SIM_UNIT_BRANCH,
+  SIM_UNIT_JUMP,
+  SIM_UNIT_SYSTEM
+} SimUnit;
+
+typedef enum {
+#define SIM_OP(name, unit, format, opcode, funct3, funct7, flags) SIM_OP_##name,
+#include "sim/sim_ops.def"
+#define SIM_VOP(name, unit, format, opcode, funct3, funct6, vs1, flags) SIM_OP_##name,
+#include "sim/sim_rvv.def"
+  SIM_OP_COUNT
+} SimOp;
+
+typedef struct {
+  SimOp op;
+  uint8_t rd;
+  uint8_t rs1;
+  uint8_t rs2;
+  uint8_t size;
+  int64_t imm;
+} SimDecoded;
+
+SimUnit sim_op_unit(SimOp op);
+
+uint32_t sim_op_flags(SimOp op);
+
+const char *sim_op_name(SimOp op);
+
+uint32_t sim_decode(const uint8_t *code, size_t available, uint64_t pc, int32_t xlen, SimDecoded *out);
@@ -0,0 +1,7 @@
+#pragma once
+
+#include <stdio.h>
+
+#include "target/mir.h"
+
+void asm_print_module(const MirModule *module, FILE *out);
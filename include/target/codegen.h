@@ -0,0 +1,32 @@
+#pragma once
+
+#include <stdint.h>
+#include <stdio.h>
+
+#include "ir/ir.h"
+#include "ir/ir_interp.h"
+#include "target/regalloc.h"
+#include "target/sched.h"
+#include "target/target.h"
+
+typedef struct {
+  TargetInfo target;
+  int32_t opt_level;
+  RegallocKind regalloc;
+  int32_t regalloc_report;
+  const MachineModel *tune;
+  int32_t schedule;
+  int32_t peephole;
+  int32_t emit_object;
+  int32_t compress_report;
+  int32_t vectorize;
+  int32_t layout;
+  int32_t shrink_wrap;
+  const IrProfile *profile;
+} CodegenOptions;
+
+void codegen_options_init(CodegenOptions *options, const TargetInfo *target, int32_t opt_level);
+
+int32_t codegen_parse_regalloc(CodegenOptions *options, const char *name);
+
+int32_t codegen_module(IrModule *module, const CodegenOptions *options, FILE *out);
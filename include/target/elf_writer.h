@@ -0,0 +1,111 @@
+#pragma once
+
+#include <stddef.h>
+#include <stdint.h>
+#include <stdio.h>
+
+#define ELF_EM_RISCV 243
+#define ELF_EF_RISCV_RVC 0x1u
+#define ELF_NO_SYMBOL UINT32_MAX
+
+typedef enum {
+  ELF_SECTION_TEXT,
+  ELF_SECTION_DATA,
+  ELF_SECTION_RODATA,
+  ELF_SECTION_BSS,
+  ELF_SECTION_COUNT
+} ElfSectionId;
+
+typedef enum {
+  ELF_SYM_NOTYPE = 0,
+  ELF_SYM_OBJECT = 1,
+  ELF_SYM_FUNC = 2,
+  ELF_SYM_SECTION = 3
+} ElfSymbolType;
+
+typedef enum {
+  ELF_BIND_LOCAL = 0,
+  ELF_BIND_GLOBAL = 1
+} ElfSymbolBind;
+
+typedef enum {
+  R_RISCV_32 = 1,
+  R_RISCV_64 = 2,
+  R_RISCV_BRANCH = 16,
+  R_RISCV_JAL = 17,
+  R_RISCV_CALL = 18,
+  R_RISCV_CALL_PLT = 19,
+  R_RISCV_PCREL_HI20 = 23,
+  R_RISCV_PCREL_LO12_I = 24,
+  R_RISCV_PCREL_LO12_S = 25,
+  R_RISCV_HI20 = 26,
+  R_RISCV_LO12_I = 27,
+  R_RISCV_LO12_S = 28,
+  R_RISCV_RVC_BRANCH = 44,
+  R_RISCV_RVC_JUMP = 45,
+  R_RISCV_ALIGN = 43,
+  R_RISCV_RELAX = 51
+} ElfRelocType;
+
+typedef struct {
+  uint8_t *data;
+  size_t size;
+  size_t capacity;
+} ElfBuffer;
+
+typedef struct {
+  uint64_t offset;
+  uint32_t symbol;
+  uint32_t type;
+  int64_t addend;
+} ElfReloc;
+
+typedef struct {
+  uint32_t name;
+  uint64_t value;
+  uint64_t size;
+  ElfSectionId section;
+  ElfSymbolType type;
+  ElfSymbolBind bind;
+} ElfSymbol;
+
+typedef struct {
+  ElfBuffer data;
+  uint64_t bss_size;
+  uint32_t align;
+  ElfReloc *relocs;
+  uint32_t reloc_count;
+  uint32_t reloc_capacity;
+} ElfSection;
+
+typedef struct {
+  int32_t is64;
+  uint32_t flags;
+  ElfSection sections[ELF_SECTION_COUNT];
+  ElfSymbol *symbols;
+  uint32_t symbol_count;
+  uint32_t symbol_capacity;
+  ElfBuffer strtab;
+} ElfObject;
+
+void elf_buffer_append(ElfBuffer *buffer, const void *data, size_t size);
+
+void elf_buffer_append_u16(ElfBuffer *buffer, uint16_t value);
+
+void elf_buffer_append_u32(ElfBuffer *buffer, uint32_t value);
+
+void elf_buffer_patch_u32(ElfBuffer *buffer, size_t offset, uint32_t value);
+
+void elf_buffer_align(ElfBuffer *buffer, size_t align);
+
+void elf_object_init(ElfObject *object, int32_t xlen, uint32_t flags);
+
+void elf_object_destroy(ElfObject *object);
+
+uint32_t elf_add_symbol(ElfObject *object, const char *name, ElfSectionId section, uint64_t value, uint64_t size,
+                        ElfSymbolType type, ElfSymbolBind bind);
+
+void elf_add_reloc(ElfObject *object, ElfSectionId section, uint64_t offset, uint32_t symbol, ElfRelocType type,
+                   int64_t addend);
+
+int32_t elf_object_write(const ElfObject *object, FILE *out);
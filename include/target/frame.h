@@ -0,0 +1,7 @@
+#pragma once
+
+#include <stdint.h>
+
+#include "target/mir.h"
+
+void frame_lower_function(MirFunction *fn, int32_t shrink_wrap);
@@ -0,0 +1,9 @@
+#pragma once
+
+#include <stdint.h>
+
+#include "ir/ir.h"
+#include "ir/ir_interp.h"
+#include "target/mir.h"
+
+void isel_select_module(MirModule *out, IrModule *module, int32_t vectorize, const IrProfile *profile);
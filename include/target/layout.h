@@ -0,0 +1,10 @@
+#pragma once
+
+#include <stdint.h>
+
+#include "target/mir.h"
+#include "target/sched.h"
+
+#define LAYOUT_ALIGN_FREQUENCY 2.0f
+
+void layout_function(MirFunction *fn, const MachineModel *model);
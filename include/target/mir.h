@@ -0,0 +1,234 @@
+#pragma once
+
+#include <stdint.h>
+
+#include "target/target.h"
+#include "utils/arena.h"
+
+#define MIR_NONE UINT32_MAX
+#define MIR_VREG_BASE 64
+#define MIR_MAX_USES (RV_ARG_REGS + 2)
+
+typedef uint32_t MirReg;
+
+enum {
+  RV_IF_LOAD = 1 << 0,
+  RV_IF_STORE = 1 << 1,
+  RV_IF_BRANCH = 1 << 2,
+  RV_IF_JUMP = 1 << 3,
+  RV_IF_CALL = 1 << 4,
+  RV_IF_RETURN = 1 << 5,
+  RV_IF_RV64 = 1 << 6,
+  RV_IF_MULDIV = 1 << 7,
+  RV_IF_VECTOR = 1 << 8,
+  RV_IF_VMASK = 1 << 9
+};
+
+typedef enum {
+  RV_FMT_R,
+  RV_FMT_I,
+  RV_FMT_S,
+  RV_FMT_B,
+  RV_FMT_U,
+  RV_FMT_J,
+  RV_FMT_SHIFT,
+  RV_FMT_PSEUDO,
+  RV_FMT_VSETVLI,
+  RV_FMT_VLOAD,
+  RV_FMT_VSTORE,
+  RV_FMT_VV,
+  RV_FMT_VX,
+  RV_FMT_VI,
+  RV_FMT_VSPLAT,
+  RV_FMT_VUNARY,
+  RV_FMT_VINDEX,
+  RV_FMT_VTOX
+} RvFormat;
+
+typedef enum {
+#define RV_INST(name, text, format, opcode, funct3, funct7, flags) RV_##name,
+#include "target/riscv.def"
+#define RVV_INST(name, text, format, opcode, funct3, funct6, vs1, flags) RV_##name,
+#include "target/rvv.def"
+  RV_OPCODE_COUNT
+} RvOpcode;
+
+typedef struct {
+  const char *name;
+  RvFormat format;
+  uint8_t opcode;
+  uint8_t funct3;
+  uint8_t funct7;
+  uint8_t vs1;
+  uint32_t flags;
+} RvInstInfo;
+
+enum {
+  RV_ZERO = 0,
+  RV_RA = 1,
+  RV_SP = 2,
+  RV_GP = 3,
+  RV_TP = 4,
+  RV_T0 = 5,
+  RV_T1 = 6,
+  RV_T2 = 7,
+  RV_S0 = 8,
+  RV_S1 = 9,
+  RV_A0 = 10,
+  RV_A1 = 11,
+  RV_A7 = 17,
+  RV_S2 = 18,
+  RV_S11 = 27,
+  RV_T3 = 28,
+  RV_T6 = 31,
+  RV_REG_COUNT = 32
+};
+
+enum {
+  RV_VSEW_8 = 0,
+  RV_VSEW_16 = 1,
+  RV_VSEW_32 = 2
+};
+
+enum {
+  RV_VLMUL_1 = 0,
+  RV_VLMUL_F4 = 6,
+  RV_VLMUL_F2 = 7
+};
+
+#define RV_VTYPE(sew, lmul) (0xc0 | ((sew) << 3) | (lmul))
+
+#define RV_ARG_REGS 8
+#define RV_SCRATCH RV_T6
+
+enum {
+  MIR_INST_FRAME = 1 << 0,
+  MIR_INST_DATA = 1 << 1
+};
+
+typedef struct {
+  uint16_t op;
+  uint8_t flags;
+  MirReg rd;
+  MirReg rs1;
+  MirReg rs2;
+  int32_t imm;
+  uint32_t target;
+} MirInst;
+
+typedef struct {
+  MirInst *insts;
+  uint32_t count;
+  uint32_t capacity;
+  uint32_t loop_depth;
+  uint32_t align;
+  float frequency;
+  float taken;
+} MirBlock;
+
+typedef enum {
+  MIR_FRAME_LOCAL,
+  MIR_FRAME_SPILL,
+  MIR_FRAME_INCOMING
+} MirFrameKind;
+
+typedef struct {
+  int32_t size;
+  int32_t align;
+  int32_t offset;
+  MirFrameKind kind;
+} MirFrameObject;
+
+typedef struct MirModule MirModule;
+
+typedef struct {
+  MirModule *module;
+  const char *name;
+  int32_t index;
+  int32_t global;
+  MirBlock *blocks;
+  uint32_t block_count;
+  uint32_t block_capacity;
+  uint32_t vreg_count;
+  MirFrameObject *frame;
+  uint32_t frame_count;
+  uint32_t frame_capacity;
+  int32_t outgoing_size;
+  int32_t frame_size;
+  uint32_t saved_regs;
+  int32_t has_calls;
+} MirFunction;
+
+typedef struct {
+  const int32_t *words;
+  uint32_t word_count;
+} MirData;
+
+struct MirModule {
+  Arena arena;
+  TargetInfo target;
+  MirFunction **functions;
+  uint32_t function_count;
+  uint32_t function_capacity;
+  MirData *data;
+  uint32_t data_count;
+  uint32_t data_capacity;
+};
+
+const RvInstInfo *rv_inst_info(RvOpcode op);
+
+const char *rv_reg_name(MirReg reg);
+
+uint32_t rv_caller_saved_mask(void);
+
+uint32_t rv_callee_saved_mask(void);
+
+static inline int32_t mir_is_vreg(const MirReg reg) {
+  return reg != MIR_NONE && reg >= MIR_VREG_BASE;
+}
+
+static inline int32_t rv_fits_imm12(const int64_t value) {
+  return value >= -2048 && value <= 2047;
+}
+
+void mir_module_init(MirModule *module, const TargetInfo *target);
+
+void mir_module_destroy(MirModule *module);
+
+MirFunction *mir_function_create(MirModule *module, const char *name, int32_t global);
+
+uint32_t mir_data_create(MirModule *module, const int32_t *words, uint32_t word_count);
+
+uint32_t mir_block_create(MirFunction *fn);
+
+MirReg mir_vreg_create(MirFunction *fn);
+
+uint32_t mir_frame_object_create(MirFunction *fn, int32_t size, int32_t align, MirFrameKind kind);
+
+MirInst *mir_emit(MirFunction *fn, uint32_t block, RvOpcode op, MirReg rd, MirReg rs1, MirReg rs2, int32_t imm);
+
+MirInst *mir_insert(MirFunction *fn, uint32_t block, uint32_t position, const MirInst *inst);
+
+void mir_remove(MirFunction *fn, uint32_t block, uint32_t position);
+
+MirInst mir_make(RvOpcode op, MirReg rd, MirReg rs1, MirReg rs2, int32_t imm);
+
+MirReg mir_inst_def(const MirInst *inst);
+
+uint32_t mir_inst_uses(const MirInst *inst, MirReg uses[MIR_MAX_USES]);
+
+MirReg *mir_inst_use_slot(MirInst *inst, uint32_t index);
+
+uint32_t mir_inst_clobbers(const MirInst *inst);
+
+int32_t mir_inst_is_move(const MirInst *inst);
+
+uint32_t mir_block_terminator_start(const MirFunction *fn, uint32_t block);
+
+uint32_t mir_block_succs(const MirFunction *fn, uint32_t block, uint32_t out[2]);
+
+RvOpcode rv_invert_branch(RvOpcode op);
+
+void mir_remove_fallthrough_jumps(MirFunction *fn);
+
+uint32_t mir_inst_count(const MirFunction *fn);
@@ -0,0 +1,44 @@
+#pragma once
+
+#include <stdint.h>
+
+#include "target/mir.h"
+
+typedef struct {
+  MirReg *items;
+  uint32_t count;
+  uint32_t capacity;
+} MirRegSet;
+
+typedef struct {
+  uint32_t reg_count;
+  uint32_t block_count;
+  MirRegSet *live_in;
+  MirRegSet *live_out;
+} MirLiveness;
+
+void mir_liveness_compute(MirLiveness *live, const MirFunction *fn);
+
+void mir_liveness_destroy(MirLiveness *live);
+
+int32_t mir_reg_set_contains(const MirRegSet *set, MirReg reg);
+
+static inline int32_t mir_bit_test(const uint64_t *set, const uint32_t index) {
+  return (int32_t) ((set[index >> 6] >> (index & 63)) & 1u);
+}
+
+static inline void mir_bit_set(uint64_t *set, const uint32_t index) {
+  set[index >> 6] |= 1ull << (index & 63);
+}
+
+static inline void mir_bit_clear(uint64_t *set, const uint32_t index) {
+  set[index >> 6] &= ~(1ull << (index & 63));
+}
+
+static inline const MirRegSet *mir_live_in(const MirLiveness *live, const uint32_t block) {
+  return &live->live_in[block];
+}
+
+static inline const MirRegSet *mir_live_out(const MirLiveness *live, const uint32_t block) {
+  return &live->live_out[block];
+}
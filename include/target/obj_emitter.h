@@ -0,0 +1,11 @@
+#pragma once
+
+#include <stdint.h>
+#include <stdio.h>
+
+#include "target/mir.h"
+#include "target/rvc.h"
+
+int32_t obj_emit_module(const MirModule *module, FILE *out);
+
+void obj_measure_function(const MirFunction *fn, RvcReport *report);
@@ -0,0 +1,9 @@
+#pragma once
+
+#include <stdint.h>
+
+#include "target/mir.h"
+
+#define PEEPHOLE_WINDOW 4
+
+void peephole_function(MirFunction *fn);
@@ -0,0 +1,54 @@
+#pragma once
+
+#include <stdint.h>
+#include <stdio.h>
+
+#include "target/mir.h"
+#include "target/mir_liveness.h"
+
+#define REGALLOC_MAX_ROUNDS 64
+#define REGALLOC_INFINITE_WEIGHT 1e30f
+#define REGALLOC_HOT_WEIGHT 10.0f
+
+typedef enum {
+  REGALLOC_LINEAR_SCAN,
+  REGALLOC_GRAPH_COLORING
+} RegallocKind;
+
+typedef struct {
+  const char *function;
+  RegallocKind kind;
+  uint32_t rounds;
+  uint32_t spills;
+  uint32_t reloads;
+  uint32_t splits;
+  uint32_t coalesced;
+} RegallocReport;
+
+typedef struct {
+  MirFunction *fn;
+  MirLiveness live;
+  uint32_t *block_start;
+  uint32_t *block_end;
+  float *weight;
+  const uint8_t *temp;
+  MirReg *assign;
+  uint32_t *split;
+  int32_t leaf;
+  int32_t compress;
+  RegallocReport *report;
+} RegallocState;
+
+uint32_t regalloc_order(int32_t leaf, MirReg order[RV_REG_COUNT]);
+
+int32_t regalloc_prefers(const RegallocState *state, MirReg vreg, MirReg reg);
+
+int32_t regalloc_linear_scan(RegallocState *state);
+
+int32_t regalloc_graph_color(RegallocState *state);
+
+void regalloc_function(MirFunction *fn, RegallocKind kind, RegallocReport *report);
+
+const char *regalloc_kind_name(RegallocKind kind);
+
+void regalloc_print_reports(const RegallocReport *reports, uint32_t count, FILE *out);
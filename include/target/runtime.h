@@ -0,0 +1,15 @@
+#pragma once
+
+#include <stdint.h>
+
+#include "ir/ir.h"
+#include "target/target.h"
+
+typedef enum {
+  RV_RUNTIME_MUL,
+  RV_RUNTIME_DIV,
+  RV_RUNTIME_REM,
+  RV_RUNTIME_COUNT
+} RvRuntimeHelper;
+
+void rv_runtime_add_helpers(IrModule *module, const TargetInfo *target, int32_t helpers[RV_RUNTIME_COUNT]);
@@ -0,0 +1,58 @@
+#pragma once
+
+#include <stdint.h>
+#include <stdio.h>
+
+#include "target/mir.h"
+
+#define RVC_BRANCH_RANGE 256
+#define RVC_JUMP_RANGE 2048
+
+typedef enum {
+  RVC_FMT_CR,
+  RVC_FMT_CI,
+  RVC_FMT_CI_ADDI16SP,
+  RVC_FMT_CI_LWSP,
+  RVC_FMT_CI_LDSP,
+  RVC_FMT_CSS_SWSP,
+  RVC_FMT_CSS_SDSP,
+  RVC_FMT_CIW,
+  RVC_FMT_CL_W,
+  RVC_FMT_CL_D,
+  RVC_FMT_CA,
+  RVC_FMT_CB_ALU,
+  RVC_FMT_CB_BRANCH,
+  RVC_FMT_CJ
+} RvcFormat;
+
+typedef enum {
+#define RVC_INST(name, text, format, match) RVC_##name,
+#include "target/rvc.def"
+  RVC_OPCODE_COUNT
+} RvcOpcode;
+
+typedef struct {
+  RvcOpcode op;
+  MirReg high;
+  MirReg low;
+  int32_t imm;
+} RvcInst;
+
+typedef struct {
+  const char *function;
+  uint32_t insts;
+  uint32_t compressed;
+  uint32_t bytes;
+} RvcReport;
+
+int32_t rvc_is_compact_reg(MirReg reg);
+
+int32_t rvc_select(const MirInst *inst, int32_t xlen, RvcInst *out);
+
+int32_t rvc_select_branch(const MirInst *inst, int32_t xlen, int64_t displacement, RvcInst *out);
+
+uint16_t rvc_encode(const RvcInst *inst);
+
+void rvc_print(const RvcInst *inst, FILE *out);
+
+void rvc_print_reports(const RvcReport *reports, uint32_t count, FILE *out);
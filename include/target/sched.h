@@ -0,0 +1,29 @@
+#pragma once
+
+#include <stdint.h>
+
+#include "target/mir.h"
+
+typedef enum {
+  SCHED_UNIT_ALU,
+  SCHED_UNIT_MUL,
+  SCHED_UNIT_MEM,
+  SCHED_UNIT_COUNT
+} SchedUnit;
+
+typedef struct {
+  const char *name;
+  uint32_t issue_width;
+  uint32_t units[SCHED_UNIT_COUNT];
+  uint32_t alu_latency;
+  uint32_t mul_latency;
+  uint32_t div_latency;
+  uint32_t load_latency;
+  uint32_t loop_align;
+} MachineModel;
+
+const MachineModel *machine_model_default(void);
+
+const MachineModel *machine_model_find(const char *name);
+
+void sched_function(MirFunction *fn, const MachineModel *model, int32_t post_ra);
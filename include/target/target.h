@@ -0,0 +1,14 @@
+#pragma once
+
+#include <stdint.h>
+
+typedef struct {
+  int32_t xlen;
+  int32_t ext_m;
+  int32_t ext_c;
+  int32_t ext_v;
+} TargetInfo;
+
+void target_init(TargetInfo *target);
+
+int32_t target_parse_march(TargetInfo *target, const char *march);
@@ -0,0 +1,94 @@
+#pragma once
+
+#include <stdint.h>
+
+#include "ir/ir.h"
+#include "ir/ir_loop.h"
+#include "target/mir.h"
+
+#define VEC_FIRST_REG 1
+#define VEC_LAST_REG 28
+#define VEC_MASK_REG 0
+#define VEC_TEMP0 29
+#define VEC_TEMP1 30
+#define VEC_TEMP2 31
+
+typedef enum {
+  VEC_OK,
+  VEC_REJECTED_SHAPE,
+  VEC_REJECTED_INDUCTION,
+  VEC_REJECTED_STRIDE,
+  VEC_REJECTED_OPERATION,
+  VEC_REJECTED_DEPENDENCE,
+  VEC_REJECTED_REGISTERS
+} VecStatus;
+
+typedef enum {
+  VEC_LANE_NONE,
+  VEC_LANE_VEC,
+  VEC_LANE_UNI
+} VecLane;
+
+typedef enum {
+  VEC_ACTION_VV,
+  VEC_ACTION_VV_SWAP,
+  VEC_ACTION_VX,
+  VEC_ACTION_VX_NOT,
+  VEC_ACTION_XV,
+  VEC_ACTION_SPLAT,
+  VEC_ACTION_NEG,
+  VEC_ACTION_NOT,
+  VEC_ACTION_SEXT8,
+  VEC_ACTION_COPY
+} VecAction;
+
+typedef struct {
+  IrOp op;
+  VecLane left;
+  VecLane right;
+  RvOpcode rv;
+  VecAction action;
+} VecPattern;
+
+typedef enum {
+  VEC_UNIFORM,
+  VEC_VECTOR,
+  VEC_ADDRESS,
+  VEC_INDUCTION,
+  VEC_REDUCTION,
+  VEC_ACCUMULATE,
+  VEC_STORE
+} VecValueKind;
+
+typedef struct {
+  uint8_t kind;
+  uint8_t live;
+  uint8_t reg;
+  uint8_t swapped;
+  uint16_t pattern;
+  IrValueId base;
+  int32_t offset;
+} VecValue;
+
+typedef struct {
+  IrBlockId header;
+  IrBlockId body;
+  IrBlockId exit;
+  IrBlockId preheader;
+  IrValueId control;
+  IrValueId bound;
+  IrOp compare;
+  VecValue *values;
+  uint32_t registers;
+} VecLoop;
+
+const VecPattern *vec_pattern(uint32_t index);
+
+RvOpcode vec_reduction(uint32_t index);
+
+const char *vec_status_name(VecStatus status);
+
+VecStatus vec_analyze_loop(VecLoop *out, const IrFunction *fn, const IrUses *uses, const IrLoopInfo *loops,
+                           uint32_t loop);
+
+void vec_loop_destroy(VecLoop *loop);
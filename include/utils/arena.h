@@ -0,0 +1,21 @@
+#pragma once
+
+#include <stddef.h>
+#include <stdint.h>
+
+typedef struct ArenaChunk ArenaChunk;
+
+typedef struct {
+  ArenaChunk *head;
+  size_t total_allocated;
+} Arena;
+
+void arena_init(Arena *arena);
+
+void *arena_alloc(Arena *arena, size_t size);
+
+void *arena_grow(Arena *arena, void *ptr, size_t old_size, size_t new_size);
+
+char *arena_strndup(Arena *arena, const char *str, size_t length);
+
+void arena_destroy(Arena *arena);
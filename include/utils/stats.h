@@ -0,0 +1,12 @@
+#pragma once
+
+#include <stdint.h>
+#include <stdio.h>
+
+void stats_add(const char *name, uint64_t amount);
+
+uint64_t stats_get(const char *name);
+
+void stats_reset(void);
+
+void stats_print(FILE *out);
@@ -0,0 +1,14 @@
+#pragma once
+
+#include <stdint.h>
+#include <stdio.h>
+
+double timing_now(void);
+
+void timing_add(const char *name, double seconds);
+
+double timing_get(const char *name);
+
+void timing_reset(void);
+
+void timing_print(FILE *out);
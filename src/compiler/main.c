@@ -1,16 +1,331 @@
 #include <stdio.h>
 #include <stdlib.h>
+#include <string.h>
 #include "lexer/lexer.h"
 #include "utils/diagnostic.h"
 #include "parser/parser.h"
+#include "parser/ast_printer.h"
+#include "sema/sema.h"
+#include "ir/ir.h"
+#include "ir/ir_builder.h"
+#include "ir/ir_interp.h"
+#include "ir/ir_printer.h"
+#include "ir/ir_verify.h"
+#include "opt/optimize.h"
+#include "opt/inline.h"
+#include "opt/pass_manager.h"
+#include "target/codegen.h"
+#include "utils/stats.h"
+#include "utils/timing.h"
 
-int main(int argc, char **argv) {
-  (void) argc;
-  (void) argv;
+#define PROFILE_STEP_LIMIT 100000000u
+
+typedef struct {
+  const char *input;
+  int32_t dump_tokens;
+  int32_t dump_ast;
+  int32_t dump_ir;
+  OptOptions opt;
+  int32_t print_stats;
+  int32_t time_report;
+  int32_t emit_asm;
+  int32_t emit_object;
+  const char *output;
+  const char *regalloc;
+  int32_t regalloc_report;
+  int32_t compress_report;
+  int32_t no_vectorize;
+  int32_t profile_interp;
+  const MachineModel *tune;
+} CompilerOptions;
+
+static void print_usage(const char *argv0) {
+  fprintf(stderr,
+          "usage: %s [options] <file.c>\n"
+          "  -O0, -O1, -O2   optimization level (default -O0)\n"
+          "  -finline-limit=N  inline callees up to N instructions (default %d, 0 disables)\n"
+          "  -fwhole-program  treat main as the only entry point: fold pure calls and drop unreachable functions\n"
+          "  -S              emit RISC-V assembly (default output <file>.s)\n"
+          "  -c              emit an ELF relocatable object (default output <file>.o)\n"
+          "  -o FILE         write output to FILE ('-' for stdout)\n"
+          "  -mtune=CPU      schedule for a core model: generic, rocket, sifive-7 (default generic)\n"
+          "  -fregalloc=KIND register allocator: linear or graph (default linear below -O2)\n"
+          "  -fregalloc-report  print per-function spill and reload counts\n"
+          "  -fcompress-report  print the share of compressed (RVC) instructions per function\n"
+          "  -fno-vectorize  keep loops scalar when the target has the V extension\n"
+          "  -fprofile-interp  lay out blocks by branch counts from running main in the IR interpreter\n"
+          "  -march=ISA      target ISA: rv32i, rv32im, rv64i, rv64im, optionally with c and v (default rv32im)\n"
+          "  --dump-tokens   print the token stream\n"
+          "  --dump-ast      print the syntax tree\n"
+          "  --dump-ir       print the SSA intermediate representation\n"
+          "  -fpasses=LIST   run a comma-separated pass list instead of the -O pipeline\n"
+          "  -fstats         print optimization statistics\n"
+          "  -ftime-report   print time spent in each compiler phase and pass\n",
+          argv0, OPT_INLINE_DEFAULT_LIMIT);
+}
+
+static int32_t parse_options(CompilerOptions *options, const int argc, char **argv) {
+  memset(options, 0, sizeof(*options));
+  opt_options_init(&options->opt, 0);
+  for (int i = 1; i < argc; i++) {
+    const char *arg = argv[i];
+    if (arg[0] == '-' && arg[1] == 'O' && arg[2] >= '0' && arg[2] <= '2' && arg[3] == '\0') {
+      options->opt.level = arg[2] - '0';
+    } else if (strncmp(arg, "-finline-limit=", 15) == 0) {
+      char *end;
+      long limit = strtol(arg + 15, &end, 10);
+      if (*end != '\0' || end == arg + 15 || limit < 0 || limit > 100000) {
+        fprintf(stderr, "invalid inline limit '%s'\n", arg + 15);
+        return 0;
+      }
+      options->opt.inline_limit = (int32_t) limit;
+    } else if (strcmp(arg, "-fwhole-program") == 0) {
+      options->opt.whole_program = 1;
+    } else if (strncmp(arg, "-march=", 7) == 0) {
+      if (!target_parse_march(&options->opt.target, arg + 7)) {
+        fprintf(stderr, "unsupported target ISA '%s'\n", arg + 7);
+        return 0;
+      }
+    } else if (strncmp(arg, "-mtune=", 7) == 0) {
+      options->tune = machine_model_find(arg + 7);
+      if (!options->tune) {
+        fprintf(stderr, "unknown tuning model '%s'\n", arg + 7);
+        return 0;
+      }
+    } else if (strncmp(arg, "-fpasses=", 9) == 0) {
+      if (!opt_pipeline_validate(arg + 9)) {
+        return 0;
+      }
+      options->opt.pipeline = arg + 9;
+    } else if (strncmp(arg, "-fregalloc=", 11) == 0) {
+      CodegenOptions scratch;
+      if (!codegen_parse_regalloc(&scratch, arg + 11)) {
+        fprintf(stderr, "unknown register allocator '%s'\n", arg + 11);
+        return 0;
+      }
+      options->regalloc = arg + 11;
+    } else if (strcmp(arg, "-fregalloc-report") == 0) {
+      options->regalloc_report = 1;
+    } else if (strcmp(arg, "-fcompress-report") == 0) {
+      options->compress_report = 1;
+    } else if (strcmp(arg, "-fno-vectorize") == 0) {
+      options->no_vectorize = 1;
+    } else if (strcmp(arg, "-fprofile-interp") == 0) {
+      options->profile_interp = 1;
+    } else if (strcmp(arg, "-S") == 0) {
+      options->emit_asm = 1;
+    } else if (strcmp(arg, "-c") == 0) {
+      options->emit_object = 1;
+    } else if (strcmp(arg, "-o") == 0) {
+      if (i + 1 >= argc) {
+        fprintf(stderr, "missing file name after '-o'\n");
+        return 0;
+      }
+      options->output = argv[++i];
+    } else if (strcmp(arg, "-ftime-report") == 0) {
+      options->time_report = 1;
+    } else if (strcmp(arg, "--dump-tokens") == 0) {
+      options->dump_tokens = 1;
+    } else if (strcmp(arg, "--dump-ast") == 0) {
+      options->dump_ast = 1;
+    } else if (strcmp(arg, "--dump-ir") == 0) {
+      options->dump_ir = 1;
+    } else if (strcmp(arg, "-fstats") == 0 || strcmp(arg, "-fmem-report") == 0) {
+      options->print_stats = 1;
+    } else if (arg[0] == '-') {
+      fprintf(stderr, "unknown option '%s'\n", arg);
+      return 0;
+    } else if (options->input) {
+      fprintf(stderr, "multiple input files are not supported\n");
+      return 0;
+    } else {
+      options->input = arg;
+    }
+  }
+  if (!options->input) {
+    return 0;
+  }
+  return 1;
+}
+
+static char *read_file(const char *path) {
+  FILE *f = fopen(path, "rb");
+  if (!f) return NULL;
+  if (fseek(f, 0, SEEK_END) != 0) {
+    fclose(f);
+    return NULL;
+  }
+  long size = ftell(f);
+  if (size < 0) {
+    fclose(f);
+    return NULL;
+  }
+  rewind(f);
+  char *buffer = malloc((size_t) size + 1);
+  if (!buffer) {
+    fclose(f);
+    return NULL;
+  }
+  size_t read = fread(buffer, 1, (size_t) size, f);
+  buffer[read] = '\0';
+  fclose(f);
+  return buffer;
+}
+
+static char *output_path(const char *input, const char *suffix) {
+  const char *base = strrchr(input, '/');
+  base = base ? base + 1 : input;
+  const char *dot = strrchr(base, '.');
+  size_t length = dot ? (size_t) (dot - base) : strlen(base);
+  char *path = malloc(length + strlen(suffix) + 1);
+  if (!path) {
+    LOG(FATAL, "out of memory");
+  }
+  memcpy(path, base, length);
+  strcpy(path + length, suffix);
+  return path;
+}
+
+static void collect_profile(const IrModule *module, IrProfile *profile) {
+  ir_profile_init(profile, module);
+  for (uint32_t f = 0; f < module->function_count; f++) {
+    const IrFunction *fn = module->functions[f];
+    if (strcmp(fn->name, "main") != 0 || fn->param_count != 0) {
+      continue;
+    }
+    double start = timing_now();
+    IrInterpResult result = ir_interp_profile(module, (int32_t) f, NULL, 0, PROFILE_STEP_LIMIT, profile);
+    timing_add("codegen: profiling run", timing_now() - start);
+    if (result.status != IR_INTERP_OK) {
+      fprintf(stderr, "warning: profiling run of main stopped early: %s\n", ir_interp_status_name(result.status));
+    }
+  }
+}
+
+static int32_t write_code(const CompilerOptions *options, IrModule *module, const CodegenOptions *codegen) {
+  if (options->output && strcmp(options->output, "-") == 0) {
+    return codegen_module(module, codegen, stdout);
+  }
+  char *path = options->output ? NULL : output_path(options->input, options->emit_object ? ".o" : ".s");
+  const char *target = options->output ? options->output : path;
+  FILE *out = fopen(target, options->emit_object ? "wb" : "w");
+  if (!out) {
+    fprintf(stderr, "cannot open '%s' for writing\n", target);
+    free(path);
+    return 1;
+  }
+  int32_t status = codegen_module(module, codegen, out);
+  if (fclose(out) != 0) {
+    status = 1;
+  }
+  free(path);
+  return status;
+}
+
+static int32_t emit_code(const CompilerOptions *options, IrModule *module) {
+  CodegenOptions codegen;
+  codegen_options_init(&codegen, &options->opt.target, options->opt.level);
+  if (options->regalloc) {
+    codegen_parse_regalloc(&codegen, options->regalloc);
+  }
+  codegen.regalloc_report = options->regalloc_report;
+  if (options->tune) {
+    codegen.tune = options->tune;
+  }
+  codegen.emit_object = options->emit_object;
+  codegen.compress_report = options->compress_report;
+  if (options->no_vectorize) {
+    codegen.vectorize = 0;
+  }
+  IrProfile profile;
+  memset(&profile, 0, sizeof(profile));
+  if (options->profile_interp) {
+    collect_profile(module, &profile);
+    codegen.profile = &profile;
+  }
+  int32_t status = write_code(options, module, &codegen);
+  ir_profile_destroy(&profile);
+  return status;
+}
+
+static int32_t compile(const CompilerOptions *options, const char *source) {
+  int32_t status = 1;
+  Lexer lexer;
+  lexer_init(&lexer, source, options->input);
+  double start = timing_now();
+  lexer_tokenize(&lexer);
+  timing_add("frontend: lex", timing_now() - start);
+  if (options->dump_tokens) {
+    lexer_print_tokens(&lexer);
+  }
+  if (lexer_had_error(&lexer)) {
+    lexer_destroy(&lexer);
+    return status;
+  }
 
+  Parser parser;
+  parser_init(&parser, lexer_get_tokens(&lexer), source, options->input);
+  start = timing_now();
+  ParseResult pr = parser_parse(&parser);
+  timing_add("frontend: parse", timing_now() - start);
+  if (!pr.had_error && options->dump_ast) {
+    ast_print_module(pr.module);
+  }
+
+  Sema sema;
+  sema_init(&sema, pr.module, source, options->input);
+  start = timing_now();
+  int32_t sema_ok = !pr.had_error && !sema_analyze(&sema).had_error;
+  timing_add("frontend: sema", timing_now() - start);
+  if (sema_ok) {
+    IrModule module;
+    ir_module_init(&module);
+    start = timing_now();
+    ir_build_module(&module, pr.module, &sema);
+    timing_add("irgen", timing_now() - start);
+    status = ir_verify_module(&module) == 0 ? 0 : 1;
+    if (status == 0) {
+      opt_optimize_module(&module, &options->opt);
+      status = ir_verify_module(&module) == 0 ? 0 : 1;
+    }
+    if (options->dump_ir) {
+      ir_print_module(&module);
+    }
+    if (status == 0 && (options->emit_asm || options->emit_object)) {
+      status = emit_code(options, &module);
+    }
+    if (options->print_stats) {
+      stats_print(stderr);
+    }
+    if (options->time_report) {
+      timing_print(stderr);
+    }
+    ir_module_destroy(&module);
+  }
+
+  sema_destroy(&sema);
+  parser_destroy(&parser);
+  lexer_destroy(&lexer);
+  return status;
+}
+
+int main(int argc, char **argv) {
 #if defined(DEBUG)
   LOG(INFO, "DEBUG MODE");
 #endif
 
-  return 0;
+  CompilerOptions options;
+  if (!parse_options(&options, argc, argv)) {
+    print_usage(argv[0]);
+    return 2;
+  }
+  char *source = read_file(options.input);
+  if (!source) {
+    fprintf(stderr, "cannot read '%s'\n", options.input);
+    return 1;
+  }
+  diagnostic_init(options.input);
+  int32_t status = compile(&options, source);
+  free(source);
+  return status;
 }
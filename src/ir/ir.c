@@ -0,0 +1,615 @@
+#include "ir/ir.h"
+#include "utils/diagnostic.h"
+#include "utils/attributes.h"
+#include <stdlib.h>
+#include <string.h>
+
+typedef struct {
+  const char *name;
+  uint32_t flags;
+} IrOpInfo;
+
+static const IrOpInfo ir_op_table[] = {
+#define IR_OP(name, text, flags) {text, flags},
+#include "ir/ir_ops.def"
+};
+
+#define IR_GROW(fn, ptr, count, capacity, initial)                                                        \
+  do {                                                                                                     \
+    if ((count) == (capacity)) {                                                                           \
+      uint32_t new_cap_ = (capacity) ? (capacity) * 2 : (initial);                                         \
+      (ptr) = arena_grow(&(fn)->module->arena, (ptr), (size_t) (capacity) * sizeof(*(ptr)),                 \
+                         (size_t) new_cap_ * sizeof(*(ptr)));                                              \
+      (capacity) = new_cap_;                                                                               \
+    }                                                                                                      \
+  } while (0)
+
+void ir_module_init(IrModule *module) {
+  arena_init(&module->arena);
+  module->functions = NULL;
+  module->function_count = 0;
+  module->function_capacity = 0;
+  module->data = NULL;
+  module->data_count = 0;
+  module->data_capacity = 0;
+}
+
+void ir_module_destroy(IrModule *module) {
+  arena_destroy(&module->arena);
+  module->functions = NULL;
+  module->function_count = 0;
+  module->function_capacity = 0;
+  module->data = NULL;
+  module->data_count = 0;
+  module->data_capacity = 0;
+}
+
+IrFunction *ir_function_create(IrModule *module, const char *name, const size_t length, const int32_t param_count) {
+  IrFunction *fn = arena_alloc(&module->arena, sizeof(IrFunction));
+  fn->module = module;
+  fn->name = arena_strndup(&module->arena, name, length);
+  fn->length = length;
+  fn->index = (int32_t) module->function_count;
+  fn->param_count = param_count;
+  if (module->function_count == module->function_capacity) {
+    uint32_t new_cap = module->function_capacity ? module->function_capacity * 2 : 8;
+    module->functions = arena_grow(&module->arena, module->functions,
+                                   module->function_capacity * sizeof(IrFunction *), new_cap * sizeof(IrFunction *));
+    module->function_capacity = new_cap;
+  }
+  module->functions[module->function_count++] = fn;
+  return fn;
+}
+
+uint32_t ir_data_create(IrModule *module, const int32_t *words, const uint32_t word_count) {
+  for (uint32_t d = 0; d < module->data_count; d++) {
+    const IrData *data = &module->data[d];
+    if (data->word_count == word_count && memcmp(data->words, words, word_count * sizeof(int32_t)) == 0) {
+      return d;
+    }
+  }
+  if (module->data_count == module->data_capacity) {
+    uint32_t new_cap = module->data_capacity ? module->data_capacity * 2 : 8;
+    module->data = arena_grow(&module->arena, module->data, module->data_capacity * sizeof(IrData),
+                              new_cap * sizeof(IrData));
+    module->data_capacity = new_cap;
+  }
+  int32_t *copy = arena_alloc(&module->arena, word_count * sizeof(int32_t));
+  memcpy(copy, words, word_count * sizeof(int32_t));
+  module->data[module->data_count] = (IrData) {copy, word_count};
+  return module->data_count++;
+}
+
+INLINE const char *ir_op_name(const IrOp op) {
+  if (op < IR_OP_COUNT) {
+    return ir_op_table[op].name;
+  }
+  return "?";
+}
+
+INLINE uint32_t ir_op_flags(const IrOp op) {
+  if (op < IR_OP_COUNT) {
+    return ir_op_table[op].flags;
+  }
+  return 0;
+}
+
+void ir_id_vector_push(IrFunction *fn, IrIdVector *vec, const uint32_t id) {
+  IR_GROW(fn, vec->items, vec->count, vec->capacity, 4);
+  vec->items[vec->count++] = id;
+}
+
+IrBlockId ir_block_create(IrFunction *fn) {
+  IR_GROW(fn, fn->blocks, fn->block_count, fn->block_capacity, 16);
+  IrBlock *block = &fn->blocks[fn->block_count];
+  memset(block, 0, sizeof(*block));
+  return fn->block_count++;
+}
+
+int32_t ir_frame_object_create(IrFunction *fn, const char *name, const int32_t size, const int32_t align,
+                               const uint8_t elem_width, const uint8_t flags) {
+  IR_GROW(fn, fn->frame, fn->frame_count, fn->frame_capacity, 8);
+  IrFrameObject *object = &fn->frame[fn->frame_count];
+  object->name = name;
+  object->size = size;
+  object->align = align;
+  object->elem_width = elem_width;
+  object->flags = flags;
+  return (int32_t) fn->frame_count++;
+}
+
+IrValueId ir_inst_create(IrFunction *fn, const IrOp op, const IrType type) {
+  IR_GROW(fn, fn->insts, fn->inst_count, fn->inst_capacity, 64);
+  IrInst *inst = &fn->insts[fn->inst_count];
+  memset(inst, 0, sizeof(*inst));
+  inst->op = (uint8_t) op;
+  inst->type = (uint8_t) type;
+  inst->block = IR_NONE;
+  inst->ops[0] = IR_NONE;
+  inst->ops[1] = IR_NONE;
+  inst->ops[2] = IR_NONE;
+  return fn->inst_count++;
+}
+
+void ir_block_append(IrFunction *fn, const IrBlockId block, const IrValueId inst) {
+  fn->insts[inst].block = block;
+  ir_id_vector_push(fn, &fn->blocks[block].insts, inst);
+}
+
+void ir_block_insert(IrFunction *fn, const IrBlockId block, const uint32_t position, const IrValueId inst) {
+  IrIdVector *vec = &fn->blocks[block].insts;
+  ir_id_vector_push(fn, vec, inst);
+  memmove(vec->items + position + 1, vec->items + position, (vec->count - 1 - position) * sizeof(uint32_t));
+  vec->items[position] = inst;
+  fn->insts[inst].block = block;
+}
+
+void ir_block_insert_before_terminator(IrFunction *fn, const IrBlockId block, const IrValueId inst) {
+  IrIdVector *vec = &fn->blocks[block].insts;
+  uint32_t position = vec->count;
+  while (position > 0 && fn->insts[vec->items[position - 1]].op == IR_OP_NOP) {
+    position--;
+  }
+  if (position > 0 && (ir_op_flags(fn->insts[vec->items[position - 1]].op) & IR_OPF_TERMINATOR)) {
+    position--;
+  }
+  ir_block_insert(fn, block, position, inst);
+}
+
+IrValueId ir_emit(IrFunction *fn, const IrBlockId block, const IrOp op, const IrType type, const uint32_t a,
+                  const uint32_t b) {
+  IrValueId id = ir_inst_create(fn, op, type);
+  fn->insts[id].ops[0] = a;
+  fn->insts[id].ops[1] = b;
+  ir_block_append(fn, block, id);
+  return id;
+}
+
+IrValueId ir_emit_const(IrFunction *fn, const IrBlockId block, const int32_t value) {
+  IrValueId id = ir_inst_create(fn, IR_OP_CONST, IR_TYPE_I32);
+  fn->insts[id].imm = value;
+  ir_block_append(fn, block, id);
+  return id;
+}
+
+static uint32_t ir_operand_reserve(IrFunction *fn, const uint32_t count) {
+  while (fn->operand_count + count > fn->operand_capacity) {
+    uint32_t new_cap = fn->operand_capacity ? fn->operand_capacity * 2 : 64;
+    fn->operands = arena_grow(&fn->module->arena, fn->operands, fn->operand_capacity * sizeof(uint32_t),
+                              new_cap * sizeof(uint32_t));
+    fn->operand_capacity = new_cap;
+  }
+  uint32_t start = fn->operand_count;
+  fn->operand_count += count;
+  return start;
+}
+
+void ir_inst_set_list(IrFunction *fn, const IrValueId inst, const uint32_t *items, const uint32_t count) {
+  uint32_t start = ir_operand_reserve(fn, count);
+  if (count) {
+    memcpy(fn->operands + start, items, count * sizeof(uint32_t));
+  }
+  fn->insts[inst].list = start;
+  fn->insts[inst].list_count = count;
+}
+
+void ir_phi_add_incoming(IrFunction *fn, const IrValueId phi, const IrBlockId block, const IrValueId value) {
+  IrInst *inst = &fn->insts[phi];
+  uint32_t used = inst->list_count * 2;
+  if (inst->list_count == 0 || inst->list + used != fn->operand_count) {
+    uint32_t start = ir_operand_reserve(fn, used + 2);
+    if (used) {
+      memmove(fn->operands + start, fn->operands + inst->list, used * sizeof(uint32_t));
+    }
+    inst = &fn->insts[phi];
+    inst->list = start;
+  } else {
+    ir_operand_reserve(fn, 2);
+  }
+  fn->operands[inst->list + used] = block;
+  fn->operands[inst->list + used + 1] = value;
+  inst->list_count++;
+}
+
+IrValueId ir_phi_incoming_for(const IrFunction *fn, const IrValueId phi, const IrBlockId block) {
+  const IrInst *inst = &fn->insts[phi];
+  for (uint32_t i = 0; i < inst->list_count; i++) {
+    if (fn->operands[inst->list + 2 * i] == block) {
+      return fn->operands[inst->list + 2 * i + 1];
+    }
+  }
+  return IR_NONE;
+}
+
+void ir_phi_remove_incoming(IrFunction *fn, const IrValueId phi, const IrBlockId block) {
+  IrInst *inst = &fn->insts[phi];
+  uint32_t *pairs = fn->operands + inst->list;
+  uint32_t out = 0;
+  for (uint32_t i = 0; i < inst->list_count; i++) {
+    if (pairs[2 * i] == block) {
+      continue;
+    }
+    pairs[2 * out] = pairs[2 * i];
+    pairs[2 * out + 1] = pairs[2 * i + 1];
+    out++;
+  }
+  inst->list_count = out;
+}
+
+IrValueId ir_block_terminator(const IrFunction *fn, const IrBlockId block) {
+  const IrIdVector *vec = &fn->blocks[block].insts;
+  for (uint32_t i = vec->count; i > 0; i--) {
+    const IrInst *inst = &fn->insts[vec->items[i - 1]];
+    if (inst->op == IR_OP_NOP) {
+      continue;
+    }
+    return (ir_op_flags(inst->op) & IR_OPF_TERMINATOR) ? vec->items[i - 1] : IR_NONE;
+  }
+  return IR_NONE;
+}
+
+uint32_t ir_block_succs(const IrFunction *fn, const IrBlockId block, IrBlockId out[2]) {
+  IrValueId term = ir_block_terminator(fn, block);
+  if (term == IR_NONE) {
+    return 0;
+  }
+  const IrInst *inst = &fn->insts[term];
+  switch (inst->op) {
+    case IR_OP_JUMP:
+      out[0] = inst->ops[0];
+      return 1;
+    case IR_OP_BRANCH:
+      out[0] = inst->ops[1];
+      if (inst->ops[2] == inst->ops[1]) {
+        return 1;
+      }
+      out[1] = inst->ops[2];
+      return 2;
+    default:
+      return 0;
+  }
+}
+
+void ir_compute_preds(IrFunction *fn) {
+  for (uint32_t b = 0; b < fn->block_count; b++) {
+    fn->blocks[b].preds.count = 0;
+  }
+  for (uint32_t b = 0; b < fn->block_count; b++) {
+    if (fn->blocks[b].flags & IR_BLOCK_DEAD) {
+      continue;
+    }
+    IrBlockId succs[2];
+    uint32_t count = ir_block_succs(fn, b, succs);
+    for (uint32_t i = 0; i < count; i++) {
+      ir_id_vector_push(fn, &fn->blocks[succs[i]].preds, b);
+    }
+  }
+}
+
+uint32_t ir_operand_count(const IrFunction *fn, const IrInst *inst) {
+  (void) fn;
+  uint32_t flags = ir_op_flags(inst->op);
+  if (flags & IR_OPF_BINARY) {
+    return 2;
+  }
+  if (flags & IR_OPF_UNARY) {
+    return 1;
+  }
+  switch (inst->op) {
+    case IR_OP_LOAD:
+    case IR_OP_BRANCH:
+      return 1;
+    case IR_OP_STORE:
+      return 2;
+    case IR_OP_RET:
+      return inst->ops[0] != IR_NONE ? 1 : 0;
+    case IR_OP_PHI:
+    case IR_OP_CALL:
+      return inst->list_count;
+    default:
+      return 0;
+  }
+}
+
+uint32_t *ir_operand_slot(const IrFunction *fn, const IrInst *inst, const uint32_t index) {
+  switch (inst->op) {
+    case IR_OP_PHI:
+      return &fn->operands[inst->list + 2 * index + 1];
+    case IR_OP_CALL:
+      return &fn->operands[inst->list + index];
+    default:
+      return (uint32_t *) &inst->ops[index];
+  }
+}
+
+INLINE int32_t ir_value_const(const IrFunction *fn, const IrValueId value, int32_t *out) {
+  if (value == IR_NONE || fn->insts[value].op != IR_OP_CONST) {
+    return 0;
+  }
+  *out = fn->insts[value].imm;
+  return 1;
+}
+
+void ir_inst_kill(IrFunction *fn, const IrValueId inst) {
+  IrInst *data = &fn->insts[inst];
+  data->op = IR_OP_NOP;
+  data->type = IR_TYPE_VOID;
+  data->flags = 0;
+  data->ops[0] = IR_NONE;
+  data->ops[1] = IR_NONE;
+  data->ops[2] = IR_NONE;
+  data->list_count = 0;
+}
+
+void ir_inst_make_const(IrFunction *fn, const IrValueId inst, const int32_t value) {
+  ir_inst_kill(fn, inst);
+  fn->insts[inst].op = IR_OP_CONST;
+  fn->insts[inst].type = IR_TYPE_I32;
+  fn->insts[inst].width = 0;
+  fn->insts[inst].imm = value;
+}
+
+void ir_replace_all_uses(IrFunction *fn, const IrValueId from, const IrValueId to) {
+  for (uint32_t i = 0; i < fn->inst_count; i++) {
+    IrInst *inst = &fn->insts[i];
+    uint32_t count = ir_operand_count(fn, inst);
+    for (uint32_t k = 0; k < count; k++) {
+      uint32_t *slot = ir_operand_slot(fn, inst, k);
+      if (*slot == from) {
+        *slot = to;
+      }
+    }
+  }
+}
+
+void ir_rewrite_operands(IrFunction *fn, IrValueId *map) {
+  for (uint32_t i = 0; i < fn->inst_count; i++) {
+    IrInst *inst = &fn->insts[i];
+    if (inst->op == IR_OP_NOP) {
+      continue;
+    }
+    uint32_t count = ir_operand_count(fn, inst);
+    for (uint32_t k = 0; k < count; k++) {
+      uint32_t *slot = ir_operand_slot(fn, inst, k);
+      uint32_t value = *slot;
+      if (value == IR_NONE) {
+        continue;
+      }
+      while (map[value] != IR_NONE && map[value] != value) {
+        value = map[value];
+      }
+      *slot = value;
+    }
+  }
+}
+
+void ir_replace_successor(IrFunction *fn, const IrBlockId block, const IrBlockId from, const IrBlockId to) {
+  IrValueId term = ir_block_terminator(fn, block);
+  if (term == IR_NONE) {
+    return;
+  }
+  IrInst *inst = &fn->insts[term];
+  if (inst->op == IR_OP_JUMP && inst->ops[0] == from) {
+    inst->ops[0] = to;
+  } else if (inst->op == IR_OP_BRANCH) {
+    if (inst->ops[1] == from) {
+      inst->ops[1] = to;
+    }
+    if (inst->ops[2] == from) {
+      inst->ops[2] = to;
+    }
+  }
+}
+
+void ir_phis_rename_pred(IrFunction *fn, const IrBlockId block, const IrBlockId from, const IrBlockId to) {
+  IrIdVector *insts = &fn->blocks[block].insts;
+  for (uint32_t i = 0; i < insts->count; i++) {
+    IrInst *inst = &fn->insts[insts->items[i]];
+    if (inst->op == IR_OP_NOP) {
+      continue;
+    }
+    if (inst->op != IR_OP_PHI) {
+      break;
+    }
+    for (uint32_t k = 0; k < inst->list_count; k++) {
+      if (fn->operands[inst->list + 2 * k] == from) {
+        fn->operands[inst->list + 2 * k] = to;
+      }
+    }
+  }
+}
+
+IrBlockId ir_split_edge(IrFunction *fn, const IrBlockId from, const IrBlockId to) {
+  IrBlockId middle = ir_block_create(fn);
+  IrValueId jump = ir_inst_create(fn, IR_OP_JUMP, IR_TYPE_VOID);
+  fn->insts[jump].ops[0] = to;
+  ir_block_append(fn, middle, jump);
+  ir_replace_successor(fn, from, to, middle);
+  ir_phis_rename_pred(fn, to, from, middle);
+  ir_compute_preds(fn);
+  return middle;
+}
+
+void ir_block_kill(IrFunction *fn, const IrBlockId block) {
+  IrBlock *data = &fn->blocks[block];
+  if (data->flags & IR_BLOCK_DEAD) {
+    return;
+  }
+  IrBlockId succs[2];
+  uint32_t count = ir_block_succs(fn, block, succs);
+  for (uint32_t s = 0; s < count; s++) {
+    IrIdVector *insts = &fn->blocks[succs[s]].insts;
+    for (uint32_t i = 0; i < insts->count; i++) {
+      IrInst *inst = &fn->insts[insts->items[i]];
+      if (inst->op == IR_OP_PHI) {
+        ir_phi_remove_incoming(fn, insts->items[i], block);
+      } else if (inst->op != IR_OP_NOP) {
+        break;
+      }
+    }
+  }
+  for (uint32_t i = 0; i < data->insts.count; i++) {
+    ir_inst_kill(fn, data->insts.items[i]);
+    fn->insts[data->insts.items[i]].block = IR_NONE;
+  }
+  data->insts.count = 0;
+  data->preds.count = 0;
+  data->flags |= IR_BLOCK_DEAD;
+}
+
+void ir_sweep(IrFunction *fn) {
+  for (uint32_t b = 0; b < fn->block_count; b++) {
+    IrIdVector *insts = &fn->blocks[b].insts;
+    uint32_t out = 0;
+    for (uint32_t i = 0; i < insts->count; i++) {
+      if (fn->insts[insts->items[i]].op != IR_OP_NOP) {
+        insts->items[out++] = insts->items[i];
+      } else {
+        fn->insts[insts->items[i]].block = IR_NONE;
+      }
+    }
+    insts->count = out;
+  }
+}
+
+void ir_compact_blocks(IrFunction *fn) {
+  uint32_t *remap = malloc((fn->block_count ? fn->block_count : 1) * sizeof(uint32_t));
+  if (!remap) {
+    LOG(FATAL, "out of memory");
+  }
+  uint32_t live = 0;
+  for (uint32_t b = 0; b < fn->block_count; b++) {
+    remap[b] = (fn->blocks[b].flags & IR_BLOCK_DEAD) ? IR_NONE : live++;
+  }
+  for (uint32_t i = 0; i < fn->inst_count; i++) {
+    IrInst *inst = &fn->insts[i];
+    if (inst->op == IR_OP_NOP || inst->block == IR_NONE) {
+      continue;
+    }
+    inst->block = remap[inst->block];
+    if (inst->op == IR_OP_JUMP) {
+      inst->ops[0] = remap[inst->ops[0]];
+    } else if (inst->op == IR_OP_BRANCH) {
+      inst->ops[1] = remap[inst->ops[1]];
+      inst->ops[2] = remap[inst->ops[2]];
+    } else if (inst->op == IR_OP_PHI) {
+      uint32_t *pairs = fn->operands + inst->list;
+      uint32_t out = 0;
+      for (uint32_t k = 0; k < inst->list_count; k++) {
+        if (remap[pairs[2 * k]] == IR_NONE) {
+          continue;
+        }
+        pairs[2 * out] = remap[pairs[2 * k]];
+        pairs[2 * out + 1] = pairs[2 * k + 1];
+        out++;
+      }
+      inst->list_count = out;
+    }
+  }
+  for (uint32_t b = 0; b < fn->block_count; b++) {
+    if (remap[b] != IR_NONE && remap[b] != b) {
+      fn->blocks[remap[b]] = fn->blocks[b];
+    }
+  }
+  fn->block_count = live;
+  free(remap);
+  ir_compute_preds(fn);
+}
+
+uint32_t ir_live_inst_count(const IrFunction *fn) {
+  uint32_t count = 0;
+  for (uint32_t b = 0; b < fn->block_count; b++) {
+    const IrIdVector *insts = &fn->blocks[b].insts;
+    for (uint32_t i = 0; i < insts->count; i++) {
+      if (fn->insts[insts->items[i]].op != IR_OP_NOP) {
+        count++;
+      }
+    }
+  }
+  return count;
+}
+
+IrValueId ir_address_base(const IrFunction *fn, IrValueId value) {
+  while (value != IR_NONE) {
+    const IrInst *inst = &fn->insts[value];
+    if (inst->op == IR_OP_ALLOCA) {
+      return value;
+    }
+    if (inst->op != IR_OP_ADD || inst->type != IR_TYPE_PTR) {
+      return IR_NONE;
+    }
+    value = fn->insts[inst->ops[0]].type == IR_TYPE_PTR ? inst->ops[0] : inst->ops[1];
+  }
+  return IR_NONE;
+}
+
+int32_t ir_address_constant_offset(const IrFunction *fn, IrValueId value, int32_t *offset) {
+  *offset = 0;
+  while (value != IR_NONE && fn->insts[value].op != IR_OP_ALLOCA) {
+    const IrInst *inst = &fn->insts[value];
+    if (inst->op != IR_OP_ADD || inst->type != IR_TYPE_PTR) {
+      return 0;
+    }
+    uint32_t ptr = fn->insts[inst->ops[0]].type == IR_TYPE_PTR ? 0 : 1;
+    int32_t step;
+    if (!ir_value_const(fn, inst->ops[1 - ptr], &step)) {
+      return 0;
+    }
+    *offset += step;
+    value = inst->ops[ptr];
+  }
+  return value != IR_NONE;
+}
+
+void ir_uses_compute(IrUses *uses, const IrFunction *fn) {
+  uint32_t n = fn->inst_count;
+  uses->value_count = n;
+  uses->start = calloc((size_t) n + 1, sizeof(uint32_t));
+  if (!uses->start) {
+    LOG(FATAL, "out of memory");
+  }
+  for (uint32_t i = 0; i < n; i++) {
+    const IrInst *inst = &fn->insts[i];
+    if (inst->op == IR_OP_NOP || inst->block == IR_NONE) {
+      continue;
+    }
+    uint32_t count = ir_operand_count(fn, inst);
+    for (uint32_t k = 0; k < count; k++) {
+      uint32_t value = *ir_operand_slot(fn, inst, k);
+      if (value != IR_NONE) {
+        uses->start[value + 1]++;
+      }
+    }
+  }
+  for (uint32_t i = 0; i < n; i++) {
+    uses->start[i + 1] += uses->start[i];
+  }
+  uses->users = malloc((uses->start[n] ? uses->start[n] : 1) * sizeof(uint32_t));
+  uint32_t *fill = malloc(((size_t) n + 1) * sizeof(uint32_t));
+  if (!uses->users || !fill) {
+    LOG(FATAL, "out of memory");
+  }
+  memcpy(fill, uses->start, ((size_t) n + 1) * sizeof(uint32_t));
+  for (uint32_t i = 0; i < n; i++) {
+    const IrInst *inst = &fn->insts[i];
+    if (inst->op == IR_OP_NOP || inst->block == IR_NONE) {
+      continue;
+    }
+    uint32_t count = ir_operand_count(fn, inst);
+    for (uint32_t k = 0; k < count; k++) {
+      uint32_t value = *ir_operand_slot(fn, inst, k);
+      if (value != IR_NONE) {
+        uses->users[fill[value]++] = i;
+      }
+    }
+  }
+  free(fill);
+}
+
+void ir_uses_destroy(IrUses *uses) {
+  free(uses->start);
+  free(uses->users);
+  uses->start = NULL;
+  uses->users = NULL;
+  uses->value_count = 0;
+}
@@ -0,0 +1,686 @@
+#include "ir/ir_builder.h"
+#include "ir/ir_ssa.h"
+#include "utils/diagnostic.h"
+#include <stdlib.h>
+
+#define INIT_BLOCK_MIN_BYTES 64
+#define INIT_TEMPLATE_MIN 8
+#define INIT_LOOP_MIN_WORDS 32
+#define INIT_LOOP_UNROLL_SHIFT 2
+
+typedef struct {
+  IrFunction *fn;
+  const Sema *sema;
+  const SemaFunctionInfo *info;
+  IrValueId *slots;
+  IrBlockId current;
+  IrBlockId break_target;
+  IrValueId counter;
+  uint8_t *written;
+  int32_t return_char;
+} IrBuilder;
+
+static IrValueId build_expr(IrBuilder *builder, const AstNode *node);
+
+static void build_statement(IrBuilder *builder, const AstNode *node);
+
+static void build_condition(IrBuilder *builder, const AstNode *node, IrBlockId then_bb, IrBlockId else_bb);
+
+static int32_t builder_is_terminated(const IrBuilder *builder) {
+  return ir_block_terminator(builder->fn, builder->current) != IR_NONE;
+}
+
+static void builder_ensure_open(IrBuilder *builder) {
+  if (builder_is_terminated(builder)) {
+    builder->current = ir_block_create(builder->fn);
+  }
+}
+
+static void builder_jump(IrBuilder *builder, const IrBlockId target) {
+  if (builder_is_terminated(builder)) {
+    return;
+  }
+  ir_emit(builder->fn, builder->current, IR_OP_JUMP, IR_TYPE_VOID, target, IR_NONE);
+}
+
+static void builder_branch(IrBuilder *builder, const IrValueId cond, const IrBlockId then_bb,
+                           const IrBlockId else_bb) {
+  IrValueId id = ir_emit(builder->fn, builder->current, IR_OP_BRANCH, IR_TYPE_VOID, cond, then_bb);
+  builder->fn->insts[id].ops[2] = else_bb;
+}
+
+static IrValueId builder_emit(IrBuilder *builder, const IrOp op, const IrType type, const IrValueId a,
+                              const IrValueId b) {
+  return ir_emit(builder->fn, builder->current, op, type, a, b);
+}
+
+static const SemaSymbol *builder_symbol(const IrBuilder *builder, const int32_t symbol) {
+  return sema_symbol(builder->sema, symbol);
+}
+
+static IrValueId builder_slot(const IrBuilder *builder, const int32_t symbol) {
+  return builder->slots[builder_symbol(builder, symbol)->slot];
+}
+
+static IrValueId builder_hidden_slot(IrBuilder *builder, const char *name) {
+  IrFunction *fn = builder->fn;
+  int32_t object = ir_frame_object_create(fn, name, 4, 4, 4, IR_FRAME_SCALAR);
+  IrValueId alloca = ir_inst_create(fn, IR_OP_ALLOCA, IR_TYPE_PTR);
+  fn->insts[alloca].imm = object;
+  ir_block_insert(fn, 0, 0, alloca);
+  return alloca;
+}
+
+static uint8_t type_width(const AstTypeKind kind) {
+  return kind == AST_TYPE_CHAR ? 1 : 4;
+}
+
+static IrValueId build_load(IrBuilder *builder, const IrValueId addr, const uint8_t width) {
+  IrValueId id = builder_emit(builder, IR_OP_LOAD, IR_TYPE_I32, addr, IR_NONE);
+  builder->fn->insts[id].width = width;
+  return id;
+}
+
+static void build_store(IrBuilder *builder, const IrValueId addr, const IrValueId value, const uint8_t width) {
+  IrValueId id = builder_emit(builder, IR_OP_STORE, IR_TYPE_VOID, addr, value);
+  builder->fn->insts[id].width = width;
+}
+
+static IrValueId build_element_address(IrBuilder *builder, const AstNode *node, uint8_t *width) {
+  const AstNode *base = node->data.subscript.base;
+  const SemaSymbol *sym = builder_symbol(builder, base->data.identifier.symbol);
+  IrValueId array = builder_slot(builder, base->data.identifier.symbol);
+  IrValueId index = build_expr(builder, node->data.subscript.index);
+  *width = type_width(sym->type.element_kind);
+  IrValueId offset = index;
+  if (*width == 4) {
+    IrValueId shift = ir_emit_const(builder->fn, builder->current, 2);
+    offset = builder_emit(builder, IR_OP_SHL, IR_TYPE_I32, index, shift);
+  }
+  return builder_emit(builder, IR_OP_ADD, IR_TYPE_PTR, array, offset);
+}
+
+static IrValueId build_assignment(IrBuilder *builder, const AstNode *node) {
+  const AstNode *target = node->data.binary.left;
+  if (target->kind == AST_NODE_SUBSCRIPT_EXPR) {
+    uint8_t width;
+    IrValueId addr = build_element_address(builder, target, &width);
+    IrValueId value = build_expr(builder, node->data.binary.right);
+    build_store(builder, addr, value, width);
+    if (width == 1) {
+      return builder_emit(builder, IR_OP_SEXT8, IR_TYPE_I32, value, IR_NONE);
+    }
+    return value;
+  }
+  const SemaSymbol *sym = builder_symbol(builder, target->data.identifier.symbol);
+  IrValueId value = build_expr(builder, node->data.binary.right);
+  uint8_t width = type_width(sym->type.kind);
+  build_store(builder, builder_slot(builder, target->data.identifier.symbol), value, width);
+  if (width == 1) {
+    return builder_emit(builder, IR_OP_SEXT8, IR_TYPE_I32, value, IR_NONE);
+  }
+  return value;
+}
+
+static IrOp binary_op_for(const TokenKind op) {
+  switch (op) {
+    case TOKEN_PLUS: return IR_OP_ADD;
+    case TOKEN_MINUS: return IR_OP_SUB;
+    case TOKEN_STAR: return IR_OP_MUL;
+    case TOKEN_DIV: return IR_OP_DIV;
+    case TOKEN_MOD: return IR_OP_REM;
+    case TOKEN_AMPERSAND: return IR_OP_AND;
+    case TOKEN_PIPE: return IR_OP_OR;
+    case TOKEN_CARET: return IR_OP_XOR;
+    case TOKEN_LSHIFT: return IR_OP_SHL;
+    case TOKEN_RSHIFT: return IR_OP_SHR;
+    case TOKEN_EQUAL: return IR_OP_EQ;
+    case TOKEN_NOT_EQUAL: return IR_OP_NE;
+    case TOKEN_LESS: return IR_OP_LT;
+    case TOKEN_LESS_EQUAL: return IR_OP_LE;
+    case TOKEN_GREATER: return IR_OP_GT;
+    case TOKEN_GREATER_EQUAL: return IR_OP_GE;
+    default: return IR_OP_NOP;
+  }
+}
+
+static IrValueId build_call(IrBuilder *builder, const AstNode *node) {
+  const AstNodeVector *args = &node->data.call.args;
+  uint32_t *values = malloc((args->count ? args->count : 1) * sizeof(uint32_t));
+  if (!values) {
+    LOG(FATAL, "out of memory");
+  }
+  for (size_t i = 0; i < args->count; i++) {
+    values[i] = build_expr(builder, args->items[i]);
+  }
+  const SemaSymbol *callee = builder_symbol(builder, node->data.call.callee->data.identifier.symbol);
+  IrValueId call = builder_emit(builder, IR_OP_CALL, IR_TYPE_I32, IR_NONE, IR_NONE);
+  builder->fn->insts[call].imm = callee->function;
+  ir_inst_set_list(builder->fn, call, values, (uint32_t) args->count);
+  free(values);
+  return call;
+}
+
+static int32_t builder_is_logical(const TokenKind op) {
+  return op == TOKEN_LOGICAL_AND || op == TOKEN_LOGICAL_OR;
+}
+
+static int32_t builder_can_speculate(const AstNode *node) {
+  switch (node->kind) {
+    case AST_NODE_INT_LITERAL:
+    case AST_NODE_IDENTIFIER:
+      return 1;
+    case AST_NODE_UNARY_EXPR:
+      return builder_can_speculate(node->data.unary.operand);
+    case AST_NODE_BINARY_EXPR: {
+      TokenKind op = node->data.binary.op;
+      return op != TOKEN_ASSIGN && op != TOKEN_DIV && op != TOKEN_MOD &&
+             builder_can_speculate(node->data.binary.left) && builder_can_speculate(node->data.binary.right);
+    }
+    default:
+      return 0;
+  }
+}
+
+static int32_t builder_is_bool(const IrFunction *fn, const IrValueId value) {
+  const IrInst *inst = &fn->insts[value];
+  int32_t constant;
+  if (ir_value_const(fn, value, &constant)) {
+    return constant == 0 || constant == 1;
+  }
+  if (inst->op == IR_OP_AND || inst->op == IR_OP_OR) {
+    return builder_is_bool(fn, inst->ops[0]) && builder_is_bool(fn, inst->ops[1]);
+  }
+  return (ir_op_flags((IrOp) inst->op) & IR_OPF_COMPARE) != 0;
+}
+
+static IrValueId build_bool(IrBuilder *builder, const IrValueId value) {
+  if (builder_is_bool(builder->fn, value)) {
+    return value;
+  }
+  IrValueId zero = ir_emit_const(builder->fn, builder->current, 0);
+  return builder_emit(builder, IR_OP_NE, IR_TYPE_I32, value, zero);
+}
+
+static IrValueId build_logical(IrBuilder *builder, const AstNode *node) {
+  IrFunction *fn = builder->fn;
+  if (builder_can_speculate(node->data.binary.right)) {
+    IrValueId left = build_expr(builder, node->data.binary.left);
+    IrValueId right = build_expr(builder, node->data.binary.right);
+    if (node->data.binary.op == TOKEN_LOGICAL_OR) {
+      return build_bool(builder, builder_emit(builder, IR_OP_OR, IR_TYPE_I32, left, right));
+    }
+    left = build_bool(builder, left);
+    return builder_emit(builder, IR_OP_AND, IR_TYPE_I32, left, build_bool(builder, right));
+  }
+  IrValueId slot = builder_hidden_slot(builder, "logical.value");
+  IrBlockId true_bb = ir_block_create(fn);
+  IrBlockId false_bb = ir_block_create(fn);
+  IrBlockId join = ir_block_create(fn);
+  build_condition(builder, node, true_bb, false_bb);
+  builder->current = true_bb;
+  build_store(builder, slot, ir_emit_const(fn, true_bb, 1), 4);
+  builder_jump(builder, join);
+  builder->current = false_bb;
+  build_store(builder, slot, ir_emit_const(fn, false_bb, 0), 4);
+  builder_jump(builder, join);
+  builder->current = join;
+  return build_load(builder, slot, 4);
+}
+
+static IrValueId build_expr(IrBuilder *builder, const AstNode *node) {
+  switch (node->kind) {
+    case AST_NODE_INT_LITERAL:
+      return ir_emit_const(builder->fn, builder->current, node->data.int_literal.value);
+    case AST_NODE_IDENTIFIER: {
+      const SemaSymbol *sym = builder_symbol(builder, node->data.identifier.symbol);
+      return build_load(builder, builder_slot(builder, node->data.identifier.symbol), type_width(sym->type.kind));
+    }
+    case AST_NODE_SUBSCRIPT_EXPR: {
+      uint8_t width;
+      IrValueId addr = build_element_address(builder, node, &width);
+      return build_load(builder, addr, width);
+    }
+    case AST_NODE_CALL_EXPR:
+      return build_call(builder, node);
+    case AST_NODE_UNARY_EXPR: {
+      IrValueId operand = build_expr(builder, node->data.unary.operand);
+      switch (node->data.unary.op) {
+        case TOKEN_MINUS: {
+          int32_t value;
+          if (ir_value_const(builder->fn, operand, &value)) {
+            builder->fn->insts[operand].imm = (int32_t) (0u - (uint32_t) value);
+            return operand;
+          }
+          return builder_emit(builder, IR_OP_NEG, IR_TYPE_I32, operand, IR_NONE);
+        }
+        case TOKEN_TILDE:
+          return builder_emit(builder, IR_OP_NOT, IR_TYPE_I32, operand, IR_NONE);
+        case TOKEN_EXCLAIM: {
+          IrValueId zero = ir_emit_const(builder->fn, builder->current, 0);
+          return builder_emit(builder, IR_OP_EQ, IR_TYPE_I32, operand, zero);
+        }
+        default:
+          return operand;
+      }
+    }
+    case AST_NODE_BINARY_EXPR: {
+      if (node->data.binary.op == TOKEN_ASSIGN) {
+        return build_assignment(builder, node);
+      }
+      if (builder_is_logical(node->data.binary.op)) {
+        return build_logical(builder, node);
+      }
+      IrValueId left = build_expr(builder, node->data.binary.left);
+      IrValueId right = build_expr(builder, node->data.binary.right);
+      return builder_emit(builder, binary_op_for(node->data.binary.op), IR_TYPE_I32, left, right);
+    }
+    default:
+      LOG(ERROR, "ir builder: unexpected expression node %d", node->kind);
+      return ir_emit_const(builder->fn, builder->current, 0);
+  }
+}
+
+static void build_condition(IrBuilder *builder, const AstNode *node, const IrBlockId then_bb,
+                            const IrBlockId else_bb) {
+  if (node->kind == AST_NODE_UNARY_EXPR && node->data.unary.op == TOKEN_EXCLAIM) {
+    build_condition(builder, node->data.unary.operand, else_bb, then_bb);
+    return;
+  }
+  if (node->kind == AST_NODE_BINARY_EXPR && builder_is_logical(node->data.binary.op)) {
+    IrBlockId next = ir_block_create(builder->fn);
+    if (node->data.binary.op == TOKEN_LOGICAL_AND) {
+      build_condition(builder, node->data.binary.left, next, else_bb);
+    } else {
+      build_condition(builder, node->data.binary.left, then_bb, next);
+    }
+    builder->current = next;
+    build_condition(builder, node->data.binary.right, then_bb, else_bb);
+    return;
+  }
+  IrValueId cond = build_expr(builder, node);
+  builder_branch(builder, cond, then_bb, else_bb);
+}
+
+static IrValueId builder_counter(IrBuilder *builder) {
+  if (builder->counter == IR_NONE) {
+    builder->counter = builder_hidden_slot(builder, "init.index");
+  }
+  return builder->counter;
+}
+
+static IrValueId build_offset(IrBuilder *builder, const IrValueId base, const int32_t offset) {
+  if (offset == 0) {
+    return base;
+  }
+  IrValueId step = ir_emit_const(builder->fn, builder->current, offset);
+  return builder_emit(builder, IR_OP_ADD, IR_TYPE_PTR, base, step);
+}
+
+static void build_store_const(IrBuilder *builder, const IrValueId base, const int32_t offset, const int32_t value,
+                              const uint8_t width) {
+  IrValueId constant = ir_emit_const(builder->fn, builder->current, value);
+  build_store(builder, build_offset(builder, base, offset), constant, width);
+}
+
+static IrValueId build_word_address(IrBuilder *builder, const IrValueId base, const IrValueId position,
+                                    const int32_t offset) {
+  IrValueId index = position;
+  if (offset != 0) {
+    IrValueId constant = ir_emit_const(builder->fn, builder->current, offset);
+    index = builder_emit(builder, IR_OP_ADD, IR_TYPE_I32, position, constant);
+  }
+  return builder_emit(builder, IR_OP_ADD, IR_TYPE_PTR, base, index);
+}
+
+static void build_word_store(IrBuilder *builder, const IrValueId dst, const IrValueId src, const int32_t offset,
+                             const int32_t index) {
+  IrValueId value = src == IR_NONE ? ir_emit_const(builder->fn, builder->current, 0)
+                                   : build_load(builder, build_offset(builder, src, index * 4), 4);
+  build_store(builder, build_offset(builder, dst, offset + index * 4), value, 4);
+}
+
+static void build_word_loop(IrBuilder *builder, const IrValueId dst, const IrValueId src, const int32_t offset,
+                            const int32_t words) {
+  IrFunction *fn = builder->fn;
+  IrValueId counter = builder_counter(builder);
+  IrBlockId header = ir_block_create(fn);
+  IrBlockId body = ir_block_create(fn);
+  IrBlockId exit = ir_block_create(fn);
+  build_store(builder, counter, ir_emit_const(fn, builder->current, 0), 4);
+  builder_jump(builder, header);
+  builder->current = header;
+  IrValueId position = build_load(builder, counter, 4);
+  IrValueId limit = ir_emit_const(fn, header, words * 4);
+  builder_branch(builder, builder_emit(builder, IR_OP_LT, IR_TYPE_I32, position, limit), body, exit);
+  builder->current = body;
+  position = build_load(builder, counter, 4);
+  for (int32_t k = 0; k < 1 << INIT_LOOP_UNROLL_SHIFT; k++) {
+    IrValueId value = src == IR_NONE ? ir_emit_const(fn, body, 0)
+                                     : build_load(builder, build_word_address(builder, src, position, k * 4), 4);
+    build_store(builder, build_word_address(builder, dst, position, offset + k * 4), value, 4);
+  }
+  IrValueId step = ir_emit_const(fn, body, 4 << INIT_LOOP_UNROLL_SHIFT);
+  build_store(builder, counter, builder_emit(builder, IR_OP_ADD, IR_TYPE_I32, position, step), 4);
+  builder_jump(builder, header);
+  builder->current = exit;
+}
+
+static void build_word_copy(IrBuilder *builder, const IrValueId dst, const IrValueId src, const int32_t offset,
+                            const int32_t words) {
+  int32_t looped = words >= INIT_LOOP_MIN_WORDS ? words >> INIT_LOOP_UNROLL_SHIFT << INIT_LOOP_UNROLL_SHIFT : 0;
+  if (looped > 0) {
+    build_word_loop(builder, dst, src, offset, looped);
+  }
+  for (int32_t w = looped; w < words; w++) {
+    build_word_store(builder, dst, src, offset, w);
+  }
+}
+
+static void build_zero_fill(IrBuilder *builder, const IrValueId slot, int32_t from, const int32_t to) {
+  for (; from < to && (from & 3); from++) {
+    build_store_const(builder, slot, from, 0, 1);
+  }
+  int32_t words = (to - from) / 4;
+  build_word_copy(builder, slot, IR_NONE, from, words);
+  from += words * 4;
+  for (; from < to; from++) {
+    build_store_const(builder, slot, from, 0, 1);
+  }
+}
+
+static IrValueId build_template(IrBuilder *builder, const int32_t *bytes, const int32_t size) {
+  IrFunction *fn = builder->fn;
+  int32_t words = (size + 3) / 4;
+  int32_t *template = calloc((size_t) words, sizeof(int32_t));
+  if (!template) {
+    LOG(FATAL, "out of memory");
+  }
+  for (int32_t w = 0; w < words; w++) {
+    uint32_t word = 0;
+    for (int32_t k = 3; k >= 0; k--) {
+      word = (word << 8) | (w * 4 + k < size ? (uint8_t) bytes[w * 4 + k] : 0u);
+    }
+    template[w] = (int32_t) word;
+  }
+  IrValueId data = builder_emit(builder, IR_OP_DATA, IR_TYPE_PTR, IR_NONE, IR_NONE);
+  fn->insts[data].imm = (int32_t) ir_data_create(fn->module, template, (uint32_t) words);
+  free(template);
+  return data;
+}
+
+static IrValueId build_block_init(IrBuilder *builder, const IrValueId slot, const AstType *type,
+                                  const AstNodeVector *elements, const int32_t read_only) {
+  IrFunction *fn = builder->fn;
+  uint8_t width = type_width(type->element_kind);
+  int32_t size = type->array_size * width;
+  int32_t count = (int32_t) elements->count;
+  IrValueId *values = malloc((size_t) (count ? count : 1) * sizeof(IrValueId));
+  int32_t *bytes = calloc((size_t) size, sizeof(int32_t));
+  if (!values || !bytes) {
+    LOG(FATAL, "out of memory");
+  }
+  int32_t constants = 0;
+  int32_t dynamic = 0;
+  int32_t template_end = 0;
+  int32_t stored_end = 0;
+  for (int32_t i = 0; i < count; i++) {
+    values[i] = build_expr(builder, elements->items[i]);
+    int32_t value;
+    if (!ir_value_const(fn, values[i], &value)) {
+      dynamic++;
+      stored_end = i + 1;
+      continue;
+    }
+    for (int32_t k = 0; k < width; k++) {
+      bytes[i * width + k] = (int32_t) (((uint32_t) value >> (8 * k)) & 0xffu);
+    }
+    if (value != 0) {
+      constants++;
+      template_end = i + 1;
+      stored_end = i + 1;
+    }
+  }
+  if (read_only && dynamic == 0) {
+    fn->frame[fn->insts[slot].imm].flags |= IR_FRAME_DEAD;
+    IrValueId data = build_template(builder, bytes, size);
+    free(values);
+    free(bytes);
+    return data;
+  }
+  fn->frame[fn->insts[slot].imm].align = 4;
+  int32_t covered = stored_end * width;
+  int32_t templated = constants >= INIT_TEMPLATE_MIN;
+  if (templated) {
+    int32_t end = template_end * width;
+    int32_t words = (end + 3) / 4 < size / 4 ? (end + 3) / 4 : size / 4;
+    build_word_copy(builder, slot, build_template(builder, bytes, words * 4), 0, words);
+    for (int32_t b = words * 4; b < end; b++) {
+      build_store_const(builder, slot, b, bytes[b], 1);
+    }
+    covered = words * 4 > end ? words * 4 : end;
+    build_zero_fill(builder, slot, covered, size);
+    covered = size;
+  }
+  for (int32_t i = 0; i < stored_end; i++) {
+    int32_t value;
+    if (templated && ir_value_const(fn, values[i], &value)) {
+      continue;
+    }
+    build_store(builder, build_offset(builder, slot, i * width), values[i], width);
+  }
+  if (covered < size) {
+    build_zero_fill(builder, slot, covered, size);
+  }
+  free(values);
+  free(bytes);
+  return slot;
+}
+
+static void build_var_decl(IrBuilder *builder, const AstNode *node) {
+  const AstNode *init = node->data.var_decl.initializer;
+  const AstType *type = &node->data.var_decl.type;
+  IrValueId slot = builder_slot(builder, node->data.var_decl.symbol);
+  if (type->kind != AST_TYPE_ARRAY) {
+    if (init) {
+      build_store(builder, slot, build_expr(builder, init), type_width(type->kind));
+    }
+    return;
+  }
+  if (!init) {
+    return;
+  }
+  uint8_t width = type_width(type->element_kind);
+  const AstNodeVector *elements = &init->data.init_list.elements;
+  if (type->array_size * width >= INIT_BLOCK_MIN_BYTES) {
+    int32_t local = builder_symbol(builder, node->data.var_decl.symbol)->slot;
+    builder->slots[local] = build_block_init(builder, slot, type, elements, !builder->written[local]);
+    return;
+  }
+  IrValueId zero = IR_NONE;
+  for (int32_t i = 0; i < type->array_size; i++) {
+    IrValueId value;
+    if ((size_t) i < elements->count) {
+      value = build_expr(builder, elements->items[i]);
+    } else {
+      if (zero == IR_NONE) {
+        zero = ir_emit_const(builder->fn, builder->current, 0);
+      }
+      value = zero;
+    }
+    IrValueId offset = ir_emit_const(builder->fn, builder->current, i * width);
+    IrValueId addr = builder_emit(builder, IR_OP_ADD, IR_TYPE_PTR, slot, offset);
+    build_store(builder, addr, value, width);
+  }
+}
+
+static void build_if(IrBuilder *builder, const AstNode *node) {
+  IrBlockId then_bb = ir_block_create(builder->fn);
+  IrBlockId merge_bb = ir_block_create(builder->fn);
+  IrBlockId else_bb = node->data.if_stmt.else_branch ? ir_block_create(builder->fn) : merge_bb;
+  build_condition(builder, node->data.if_stmt.condition, then_bb, else_bb);
+  builder->current = then_bb;
+  build_statement(builder, node->data.if_stmt.then_branch);
+  builder_jump(builder, merge_bb);
+  if (node->data.if_stmt.else_branch) {
+    builder->current = else_bb;
+    build_statement(builder, node->data.if_stmt.else_branch);
+    builder_jump(builder, merge_bb);
+  }
+  builder->current = merge_bb;
+}
+
+static void build_while(IrBuilder *builder, const AstNode *node) {
+  IrBlockId header = ir_block_create(builder->fn);
+  IrBlockId body = ir_block_create(builder->fn);
+  IrBlockId exit = ir_block_create(builder->fn);
+  builder_jump(builder, header);
+  builder->current = header;
+  build_condition(builder, node->data.while_stmt.condition, body, exit);
+  IrBlockId saved_break = builder->break_target;
+  builder->break_target = exit;
+  builder->current = body;
+  build_statement(builder, node->data.while_stmt.body);
+  builder_jump(builder, header);
+  builder->break_target = saved_break;
+  builder->current = exit;
+}
+
+static void build_return(IrBuilder *builder, const AstNode *node) {
+  IrValueId value = build_expr(builder, node->data.return_stmt.expr);
+  if (builder->return_char) {
+    value = builder_emit(builder, IR_OP_SEXT8, IR_TYPE_I32, value, IR_NONE);
+  }
+  builder_emit(builder, IR_OP_RET, IR_TYPE_VOID, value, IR_NONE);
+}
+
+static void build_statement(IrBuilder *builder, const AstNode *node) {
+  if (!node) {
+    return;
+  }
+  builder_ensure_open(builder);
+  switch (node->kind) {
+    case AST_NODE_BLOCK:
+      for (size_t i = 0; i < node->data.block.statements.count; i++) {
+        build_statement(builder, node->data.block.statements.items[i]);
+      }
+      break;
+    case AST_NODE_VAR_DECL:
+      build_var_decl(builder, node);
+      break;
+    case AST_NODE_EXPR_STMT:
+      build_expr(builder, node->data.expr_stmt.expr);
+      break;
+    case AST_NODE_RETURN_STMT:
+      build_return(builder, node);
+      break;
+    case AST_NODE_IF_STMT:
+      build_if(builder, node);
+      break;
+    case AST_NODE_WHILE_STMT:
+      build_while(builder, node);
+      break;
+    case AST_NODE_BREAK_STMT:
+      builder_jump(builder, builder->break_target);
+      break;
+    default:
+      LOG(ERROR, "ir builder: unexpected statement node %d", node->kind);
+      break;
+  }
+}
+
+static void builder_mark_written(IrBuilder *builder, const AstNode *node) {
+  if (!node) {
+    return;
+  }
+  const AstNodeVector *children = NULL;
+  switch (node->kind) {
+    case AST_NODE_BLOCK: children = &node->data.block.statements; break;
+    case AST_NODE_INIT_LIST: children = &node->data.init_list.elements; break;
+    case AST_NODE_CALL_EXPR: children = &node->data.call.args; break;
+    case AST_NODE_RETURN_STMT: builder_mark_written(builder, node->data.return_stmt.expr); break;
+    case AST_NODE_EXPR_STMT: builder_mark_written(builder, node->data.expr_stmt.expr); break;
+    case AST_NODE_VAR_DECL: builder_mark_written(builder, node->data.var_decl.initializer); break;
+    case AST_NODE_UNARY_EXPR: builder_mark_written(builder, node->data.unary.operand); break;
+    case AST_NODE_IF_STMT:
+      builder_mark_written(builder, node->data.if_stmt.condition);
+      builder_mark_written(builder, node->data.if_stmt.then_branch);
+      builder_mark_written(builder, node->data.if_stmt.else_branch);
+      break;
+    case AST_NODE_WHILE_STMT:
+      builder_mark_written(builder, node->data.while_stmt.condition);
+      builder_mark_written(builder, node->data.while_stmt.body);
+      break;
+    case AST_NODE_SUBSCRIPT_EXPR:
+      builder_mark_written(builder, node->data.subscript.index);
+      break;
+    case AST_NODE_BINARY_EXPR: {
+      const AstNode *left = node->data.binary.left;
+      if (node->data.binary.op == TOKEN_ASSIGN && left->kind == AST_NODE_SUBSCRIPT_EXPR) {
+        builder->written[builder_symbol(builder, left->data.subscript.base->data.identifier.symbol)->slot] = 1;
+      }
+      builder_mark_written(builder, left);
+      builder_mark_written(builder, node->data.binary.right);
+      break;
+    }
+    default: break;
+  }
+  for (size_t i = 0; children && i < children->count; i++) {
+    builder_mark_written(builder, children->items[i]);
+  }
+}
+
+static void build_function(IrModule *module, const AstFunction *ast_fn, const Sema *sema, const int32_t index) {
+  const SemaFunctionInfo *info = sema_function_info(sema, index);
+  IrFunction *fn = ir_function_create(module, ast_fn->name, ast_fn->length, (int32_t) ast_fn->params.count);
+  IrBuilder builder = {
+    .fn = fn,
+    .sema = sema,
+    .info = info,
+    .slots = malloc((info->local_count ? info->local_count : 1) * sizeof(IrValueId)),
+    .current = ir_block_create(fn),
+    .break_target = IR_NONE,
+    .counter = IR_NONE,
+    .written = calloc(info->local_count ? (size_t) info->local_count : 1, 1),
+    .return_char = ast_fn->return_type.kind == AST_TYPE_CHAR
+  };
+  if (!builder.slots || !builder.written) {
+    LOG(FATAL, "out of memory");
+  }
+  for (int32_t i = 0; i < info->local_count; i++) {
+    const SemaSymbol *sym = sema_symbol(sema, info->first_local + i);
+    int32_t object;
+    if (sym->type.kind == AST_TYPE_ARRAY) {
+      uint8_t width = type_width(sym->type.element_kind);
+      object = ir_frame_object_create(fn, sym->name, sym->type.array_size * width, width, width, 0);
+    } else {
+      uint8_t width = type_width(sym->type.kind);
+      object = ir_frame_object_create(fn, sym->name, width, width, width, IR_FRAME_SCALAR);
+    }
+    IrValueId alloca = builder_emit(&builder, IR_OP_ALLOCA, IR_TYPE_PTR, IR_NONE, IR_NONE);
+    fn->insts[alloca].imm = object;
+    builder.slots[sym->slot] = alloca;
+  }
+  for (size_t i = 0; i < ast_fn->params.count; i++) {
+    const AstParam *param = &ast_fn->params.items[i];
+    IrValueId value = builder_emit(&builder, IR_OP_PARAM, IR_TYPE_I32, IR_NONE, IR_NONE);
+    fn->insts[value].imm = (int32_t) i;
+    build_store(&builder, builder_slot(&builder, param->symbol), value, type_width(param->type.kind));
+  }
+  builder_mark_written(&builder, ast_fn->body);
+  build_statement(&builder, ast_fn->body);
+  if (!builder_is_terminated(&builder)) {
+    IrValueId zero = ir_emit_const(fn, builder.current, 0);
+    builder_emit(&builder, IR_OP_RET, IR_TYPE_VOID, zero, IR_NONE);
+  }
+  free(builder.slots);
+  free(builder.written);
+  ir_compute_preds(fn);
+  ir_promote_slots(fn);
+}
+
+void ir_build_module(IrModule *module, const AstModule *ast, const Sema *sema) {
+  for (size_t i = 0; i < ast->functions.count; i++) {
+    build_function(module, ast->functions.items[i], sema, (int32_t) i);
+  }
+}
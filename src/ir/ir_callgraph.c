@@ -0,0 +1,281 @@
+#include "ir/ir_callgraph.h"
+#include "utils/diagnostic.h"
+#include <stdlib.h>
+#include <string.h>
+
+typedef struct {
+  IrCallGraph *graph;
+  uint32_t *index;
+  uint32_t *lowlink;
+  uint8_t *on_stack;
+  uint32_t *stack;
+  uint32_t stack_count;
+  uint32_t *frames;
+  uint32_t *next_edge;
+  uint32_t counter;
+  uint32_t order_count;
+} CallGraphTarjan;
+
+enum {
+  CALLGRAPH_READS = 1 << 0,
+  CALLGRAPH_WRITES = 1 << 1
+};
+
+static uint32_t *callgraph_alloc(const uint32_t count) {
+  uint32_t *ptr = calloc(count ? count : 1, sizeof(uint32_t));
+  if (!ptr) {
+    LOG(FATAL, "out of memory");
+  }
+  return ptr;
+}
+
+static void callgraph_collect_edges(IrCallGraph *graph, const IrModule *module) {
+  uint32_t n = module->function_count;
+  uint8_t *seen = calloc(n ? n : 1, 1);
+  if (!seen) {
+    LOG(FATAL, "out of memory");
+  }
+  for (int32_t pass = 0; pass < 2; pass++) {
+    uint32_t fill = 0;
+    for (uint32_t f = 0; f < n; f++) {
+      const IrFunction *fn = module->functions[f];
+      memset(seen, 0, n);
+      if (pass == 1) {
+        fill = graph->edge_start[f];
+      }
+      for (uint32_t i = 0; i < fn->inst_count; i++) {
+        const IrInst *inst = &fn->insts[i];
+        if (inst->op != IR_OP_CALL || inst->block == IR_NONE) {
+          continue;
+        }
+        uint32_t callee = (uint32_t) inst->imm;
+        if (pass == 0) {
+          graph->call_sites[callee]++;
+        }
+        if (seen[callee]) {
+          continue;
+        }
+        seen[callee] = 1;
+        if (pass == 0) {
+          graph->edge_start[f + 1]++;
+        } else {
+          graph->edges[fill++] = callee;
+        }
+      }
+    }
+    if (pass == 0) {
+      for (uint32_t f = 0; f < n; f++) {
+        graph->edge_start[f + 1] += graph->edge_start[f];
+      }
+      graph->edges = callgraph_alloc(graph->edge_start[n]);
+    }
+  }
+  free(seen);
+}
+
+static void callgraph_strongconnect(CallGraphTarjan *t, const uint32_t root) {
+  IrCallGraph *graph = t->graph;
+  uint32_t depth = 0;
+  t->frames[depth++] = root;
+  t->index[root] = t->lowlink[root] = t->counter++;
+  t->stack[t->stack_count++] = root;
+  t->on_stack[root] = 1;
+  t->next_edge[root] = graph->edge_start[root];
+  while (depth > 0) {
+    uint32_t v = t->frames[depth - 1];
+    if (t->next_edge[v] < graph->edge_start[v + 1]) {
+      uint32_t w = graph->edges[t->next_edge[v]++];
+      if (t->index[w] == IR_NONE) {
+        t->index[w] = t->lowlink[w] = t->counter++;
+        t->stack[t->stack_count++] = w;
+        t->on_stack[w] = 1;
+        t->next_edge[w] = graph->edge_start[w];
+        t->frames[depth++] = w;
+      } else if (t->on_stack[w] && t->index[w] < t->lowlink[v]) {
+        t->lowlink[v] = t->index[w];
+      }
+      continue;
+    }
+    depth--;
+    if (depth > 0) {
+      uint32_t parent = t->frames[depth - 1];
+      if (t->lowlink[v] < t->lowlink[parent]) {
+        t->lowlink[parent] = t->lowlink[v];
+      }
+    }
+    if (t->lowlink[v] != t->index[v]) {
+      continue;
+    }
+    uint32_t scc = graph->scc_count++;
+    uint32_t size = 0;
+    uint32_t w;
+    do {
+      w = t->stack[--t->stack_count];
+      t->on_stack[w] = 0;
+      graph->scc[w] = scc;
+      graph->bottom_up[t->order_count++] = w;
+      size++;
+    } while (w != v);
+    if (size > 1) {
+      for (uint32_t i = t->order_count - size; i < t->order_count; i++) {
+        graph->recursive[graph->bottom_up[i]] = 1;
+      }
+    }
+  }
+}
+
+void ir_callgraph_compute(IrCallGraph *graph, const IrModule *module) {
+  uint32_t n = module->function_count;
+  memset(graph, 0, sizeof(*graph));
+  graph->function_count = n;
+  graph->edge_start = callgraph_alloc(n + 1);
+  graph->call_sites = callgraph_alloc(n);
+  graph->scc = callgraph_alloc(n);
+  graph->bottom_up = callgraph_alloc(n);
+  graph->recursive = calloc(n ? n : 1, 1);
+  if (!graph->recursive) {
+    LOG(FATAL, "out of memory");
+  }
+  callgraph_collect_edges(graph, module);
+  for (uint32_t f = 0; f < n; f++) {
+    for (uint32_t e = graph->edge_start[f]; e < graph->edge_start[f + 1]; e++) {
+      if (graph->edges[e] == f) {
+        graph->recursive[f] = 1;
+      }
+    }
+  }
+  CallGraphTarjan t;
+  memset(&t, 0, sizeof(t));
+  t.graph = graph;
+  t.index = callgraph_alloc(n);
+  t.lowlink = callgraph_alloc(n);
+  t.stack = callgraph_alloc(n);
+  t.frames = callgraph_alloc(n);
+  t.next_edge = callgraph_alloc(n);
+  t.on_stack = calloc(n ? n : 1, 1);
+  if (!t.on_stack) {
+    LOG(FATAL, "out of memory");
+  }
+  for (uint32_t f = 0; f < n; f++) {
+    t.index[f] = IR_NONE;
+  }
+  for (uint32_t f = 0; f < n; f++) {
+    if (t.index[f] == IR_NONE) {
+      callgraph_strongconnect(&t, f);
+    }
+  }
+  free(t.index);
+  free(t.lowlink);
+  free(t.stack);
+  free(t.frames);
+  free(t.next_edge);
+  free(t.on_stack);
+}
+
+static int32_t callgraph_local_address(const IrFunction *fn, const IrValueId addr, uint32_t *mark, const uint32_t stamp,
+                                       uint32_t *stack) {
+  uint32_t count = 0;
+  stack[count++] = addr;
+  while (count > 0) {
+    IrValueId value = stack[--count];
+    if (value == IR_NONE) {
+      return 0;
+    }
+    if (mark[value] == stamp) {
+      continue;
+    }
+    mark[value] = stamp;
+    const IrInst *inst = &fn->insts[value];
+    switch (inst->op) {
+      case IR_OP_ALLOCA:
+      case IR_OP_DATA:
+        break;
+      case IR_OP_COPY:
+        stack[count++] = inst->ops[0];
+        break;
+      case IR_OP_ADD:
+        if (inst->type != IR_TYPE_PTR) {
+          return 0;
+        }
+        stack[count++] = fn->insts[inst->ops[0]].type == IR_TYPE_PTR ? inst->ops[0] : inst->ops[1];
+        break;
+      case IR_OP_PHI:
+        for (uint32_t k = 0; k < inst->list_count; k++) {
+          stack[count++] = fn->operands[inst->list + 2 * k + 1];
+        }
+        break;
+      default:
+        return 0;
+    }
+  }
+  return 1;
+}
+
+static uint8_t callgraph_local_effects(const IrFunction *fn) {
+  if (fn->block_count == 0) {
+    return CALLGRAPH_READS | CALLGRAPH_WRITES;
+  }
+  uint32_t *mark = callgraph_alloc(fn->inst_count);
+  uint32_t *stack = callgraph_alloc(fn->inst_count + fn->operand_count);
+  uint32_t stamp = 0;
+  uint8_t effects = 0;
+  for (uint32_t i = 0; i < fn->inst_count; i++) {
+    const IrInst *inst = &fn->insts[i];
+    if ((inst->op != IR_OP_LOAD && inst->op != IR_OP_STORE) || inst->block == IR_NONE) {
+      continue;
+    }
+    if (!callgraph_local_address(fn, inst->ops[0], mark, ++stamp, stack)) {
+      effects |= inst->op == IR_OP_LOAD ? CALLGRAPH_READS : CALLGRAPH_WRITES;
+    }
+  }
+  free(mark);
+  free(stack);
+  return effects;
+}
+
+void ir_callgraph_infer_attrs(const IrCallGraph *graph, IrModule *module) {
+  uint32_t n = graph->function_count;
+  uint8_t *effects = calloc(n ? n : 1, 1);
+  if (!effects) {
+    LOG(FATAL, "out of memory");
+  }
+  uint32_t first = 0;
+  while (first < n) {
+    uint32_t scc = graph->scc[graph->bottom_up[first]];
+    uint32_t last = first;
+    uint8_t scc_effects = 0;
+    while (last < n && graph->scc[graph->bottom_up[last]] == scc) {
+      uint32_t f = graph->bottom_up[last++];
+      scc_effects |= callgraph_local_effects(module->functions[f]);
+      for (uint32_t e = graph->edge_start[f]; e < graph->edge_start[f + 1]; e++) {
+        if (graph->scc[graph->edges[e]] != scc) {
+          scc_effects |= effects[graph->edges[e]];
+        }
+      }
+    }
+    for (uint32_t i = first; i < last; i++) {
+      uint32_t f = graph->bottom_up[i];
+      effects[f] = scc_effects;
+      uint32_t attrs = 0;
+      if (!(scc_effects & CALLGRAPH_WRITES)) {
+        attrs |= IR_FUNCTION_READONLY;
+        if (!(scc_effects & CALLGRAPH_READS)) {
+          attrs |= IR_FUNCTION_PURE;
+        }
+      }
+      module->functions[f]->attrs = attrs;
+    }
+    first = last;
+  }
+  free(effects);
+}
+
+void ir_callgraph_destroy(IrCallGraph *graph) {
+  free(graph->edge_start);
+  free(graph->edges);
+  free(graph->call_sites);
+  free(graph->scc);
+  free(graph->bottom_up);
+  free(graph->recursive);
+  memset(graph, 0, sizeof(*graph));
+}
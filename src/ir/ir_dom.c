@@ -0,0 +1,235 @@
+#include "ir/ir_dom.h"
+#include "utils/diagnostic.h"
+#include "utils/attributes.h"
+#include <stdlib.h>
+#include <string.h>
+
+static uint32_t *dom_alloc(const uint32_t count) {
+  uint32_t *ptr = malloc((count ? count : 1) * sizeof(uint32_t));
+  if (!ptr) {
+    LOG(FATAL, "out of memory");
+  }
+  return ptr;
+}
+
+static void dom_compute_rpo(IrDomTree *dom, const IrFunction *fn) {
+  uint32_t n = fn->block_count;
+  uint32_t *stack = dom_alloc(n);
+  uint32_t *next_succ = dom_alloc(n);
+  uint32_t *post = dom_alloc(n);
+  uint8_t *visited = calloc(n ? n : 1, 1);
+  if (!visited) {
+    LOG(FATAL, "out of memory");
+  }
+  uint32_t post_count = 0;
+  uint32_t sp = 0;
+  if (n > 0) {
+    stack[sp++] = 0;
+    next_succ[0] = 0;
+    visited[0] = 1;
+  }
+  while (sp > 0) {
+    uint32_t b = stack[sp - 1];
+    IrBlockId succs[2];
+    uint32_t count = ir_block_succs(fn, b, succs);
+    if (next_succ[b] < count) {
+      uint32_t s = succs[next_succ[b]++];
+      if (!visited[s]) {
+        visited[s] = 1;
+        next_succ[s] = 0;
+        stack[sp++] = s;
+      }
+      continue;
+    }
+    post[post_count++] = b;
+    sp--;
+  }
+  for (uint32_t i = 0; i < n; i++) {
+    dom->rpo_index[i] = IR_NONE;
+  }
+  for (uint32_t i = 0; i < post_count; i++) {
+    dom->rpo[i] = post[post_count - 1 - i];
+    dom->rpo_index[dom->rpo[i]] = i;
+  }
+  dom->rpo_count = post_count;
+  free(stack);
+  free(next_succ);
+  free(post);
+  free(visited);
+}
+
+static uint32_t dom_intersect(const IrDomTree *dom, uint32_t a, uint32_t b) {
+  while (a != b) {
+    while (dom->rpo_index[a] > dom->rpo_index[b]) {
+      a = dom->idom[a];
+    }
+    while (dom->rpo_index[b] > dom->rpo_index[a]) {
+      b = dom->idom[b];
+    }
+  }
+  return a;
+}
+
+static void dom_number_tree(IrDomTree *dom) {
+  uint32_t n = dom->block_count;
+  uint32_t *stack = dom_alloc(n);
+  uint32_t *next_child = dom_alloc(n);
+  uint32_t counter = 0;
+  uint32_t sp = 0;
+  for (uint32_t i = 0; i < n; i++) {
+    dom->pre[i] = IR_NONE;
+    dom->post[i] = IR_NONE;
+  }
+  if (dom->rpo_count > 0) {
+    stack[sp++] = dom->rpo[0];
+    next_child[dom->rpo[0]] = dom->child_start[dom->rpo[0]];
+    dom->pre[dom->rpo[0]] = counter++;
+  }
+  while (sp > 0) {
+    uint32_t b = stack[sp - 1];
+    if (next_child[b] < dom->child_start[b + 1]) {
+      uint32_t c = dom->children[next_child[b]++];
+      dom->pre[c] = counter++;
+      next_child[c] = dom->child_start[c];
+      stack[sp++] = c;
+      continue;
+    }
+    dom->post[b] = counter++;
+    sp--;
+  }
+  free(stack);
+  free(next_child);
+}
+
+void ir_dom_compute(IrDomTree *dom, const IrFunction *fn) {
+  uint32_t n = fn->block_count;
+  memset(dom, 0, sizeof(*dom));
+  dom->block_count = n;
+  dom->idom = dom_alloc(n);
+  dom->rpo = dom_alloc(n);
+  dom->rpo_index = dom_alloc(n);
+  dom->child_start = dom_alloc(n + 1);
+  dom->children = dom_alloc(n);
+  dom->pre = dom_alloc(n);
+  dom->post = dom_alloc(n);
+  dom_compute_rpo(dom, fn);
+  for (uint32_t i = 0; i < n; i++) {
+    dom->idom[i] = IR_NONE;
+  }
+  if (dom->rpo_count == 0) {
+    memset(dom->child_start, 0, (n + 1) * sizeof(uint32_t));
+    dom_number_tree(dom);
+    return;
+  }
+  uint32_t entry = dom->rpo[0];
+  dom->idom[entry] = entry;
+  int32_t changed = 1;
+  while (changed) {
+    changed = 0;
+    for (uint32_t i = 1; i < dom->rpo_count; i++) {
+      uint32_t b = dom->rpo[i];
+      const IrIdVector *preds = &fn->blocks[b].preds;
+      uint32_t new_idom = IR_NONE;
+      for (uint32_t k = 0; k < preds->count; k++) {
+        uint32_t p = preds->items[k];
+        if (dom->rpo_index[p] == IR_NONE || dom->idom[p] == IR_NONE) {
+          continue;
+        }
+        new_idom = new_idom == IR_NONE ? p : dom_intersect(dom, p, new_idom);
+      }
+      if (new_idom != IR_NONE && dom->idom[b] != new_idom) {
+        dom->idom[b] = new_idom;
+        changed = 1;
+      }
+    }
+  }
+  memset(dom->child_start, 0, (n + 1) * sizeof(uint32_t));
+  for (uint32_t i = 1; i < dom->rpo_count; i++) {
+    dom->child_start[dom->idom[dom->rpo[i]] + 1]++;
+  }
+  for (uint32_t i = 0; i < n; i++) {
+    dom->child_start[i + 1] += dom->child_start[i];
+  }
+  uint32_t *fill = dom_alloc(n);
+  memcpy(fill, dom->child_start, n * sizeof(uint32_t));
+  for (uint32_t i = 1; i < dom->rpo_count; i++) {
+    uint32_t b = dom->rpo[i];
+    dom->children[fill[dom->idom[b]]++] = b;
+  }
+  free(fill);
+  dom->idom[entry] = IR_NONE;
+  dom_number_tree(dom);
+}
+
+void ir_dom_compute_frontiers(IrDomTree *dom, const IrFunction *fn) {
+  uint32_t n = dom->block_count;
+  free(dom->df_start);
+  free(dom->df);
+  dom->df_start = dom_alloc(n + 1);
+  uint32_t *last = dom_alloc(n);
+  memset(dom->df_start, 0, (n + 1) * sizeof(uint32_t));
+  for (int32_t pass = 0; pass < 2; pass++) {
+    uint32_t *fill = NULL;
+    if (pass == 1) {
+      for (uint32_t i = 0; i < n; i++) {
+        dom->df_start[i + 1] += dom->df_start[i];
+      }
+      dom->df = dom_alloc(dom->df_start[n]);
+      fill = dom_alloc(n);
+      memcpy(fill, dom->df_start, n * sizeof(uint32_t));
+    }
+    for (uint32_t i = 0; i < n; i++) {
+      last[i] = IR_NONE;
+    }
+    for (uint32_t i = 0; i < dom->rpo_count; i++) {
+      uint32_t b = dom->rpo[i];
+      const IrIdVector *preds = &fn->blocks[b].preds;
+      if (preds->count < 2) {
+        continue;
+      }
+      for (uint32_t k = 0; k < preds->count; k++) {
+        uint32_t runner = preds->items[k];
+        if (dom->rpo_index[runner] == IR_NONE) {
+          continue;
+        }
+        while (runner != IR_NONE && runner != dom->idom[b]) {
+          if (last[runner] != b) {
+            last[runner] = b;
+            if (pass == 0) {
+              dom->df_start[runner + 1]++;
+            } else {
+              dom->df[fill[runner]++] = b;
+            }
+          }
+          runner = dom->idom[runner];
+        }
+      }
+    }
+    free(fill);
+  }
+  free(last);
+}
+
+INLINE int32_t ir_dom_dominates(const IrDomTree *dom, const IrBlockId a, const IrBlockId b) {
+  if (dom->pre[a] == IR_NONE || dom->pre[b] == IR_NONE) {
+    return 0;
+  }
+  return dom->pre[a] <= dom->pre[b] && dom->post[b] <= dom->post[a];
+}
+
+INLINE int32_t ir_dom_reachable(const IrDomTree *dom, const IrBlockId block) {
+  return dom->rpo_index[block] != IR_NONE;
+}
+
+void ir_dom_destroy(IrDomTree *dom) {
+  free(dom->idom);
+  free(dom->rpo);
+  free(dom->rpo_index);
+  free(dom->child_start);
+  free(dom->children);
+  free(dom->pre);
+  free(dom->post);
+  free(dom->df_start);
+  free(dom->df);
+  memset(dom, 0, sizeof(*dom));
+}
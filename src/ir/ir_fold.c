@@ -0,0 +1,44 @@
+#include "ir/ir_fold.h"
+
+int32_t ir_fold_binary(const IrOp op, const int32_t a, const int32_t b, int32_t *out) {
+  uint32_t ua = (uint32_t) a;
+  uint32_t ub = (uint32_t) b;
+  switch (op) {
+    case IR_OP_ADD: *out = (int32_t) (ua + ub); return 1;
+    case IR_OP_SUB: *out = (int32_t) (ua - ub); return 1;
+    case IR_OP_MUL: *out = (int32_t) (ua * ub); return 1;
+    case IR_OP_MULH: *out = (int32_t) (((int64_t) a * b) >> 32); return 1;
+    case IR_OP_MULHU: *out = (int32_t) (((uint64_t) ua * ub) >> 32); return 1;
+    case IR_OP_DIV:
+      if (b == 0) return 0;
+      *out = (a == INT32_MIN && b == -1) ? INT32_MIN : a / b;
+      return 1;
+    case IR_OP_REM:
+      if (b == 0) return 0;
+      *out = (a == INT32_MIN && b == -1) ? 0 : a % b;
+      return 1;
+    case IR_OP_AND: *out = a & b; return 1;
+    case IR_OP_OR: *out = a | b; return 1;
+    case IR_OP_XOR: *out = a ^ b; return 1;
+    case IR_OP_SHL: *out = (int32_t) (ua << (ub & 31)); return 1;
+    case IR_OP_SHR: *out = a >> (ub & 31); return 1;
+    case IR_OP_SHRU: *out = (int32_t) (ua >> (ub & 31)); return 1;
+    case IR_OP_EQ: *out = a == b; return 1;
+    case IR_OP_NE: *out = a != b; return 1;
+    case IR_OP_LT: *out = a < b; return 1;
+    case IR_OP_LE: *out = a <= b; return 1;
+    case IR_OP_GT: *out = a > b; return 1;
+    case IR_OP_GE: *out = a >= b; return 1;
+    default: return 0;
+  }
+}
+
+int32_t ir_fold_unary(const IrOp op, const int32_t a, int32_t *out) {
+  switch (op) {
+    case IR_OP_NEG: *out = (int32_t) (0u - (uint32_t) a); return 1;
+    case IR_OP_NOT: *out = ~a; return 1;
+    case IR_OP_SEXT8: *out = (int8_t) a; return 1;
+    case IR_OP_COPY: *out = a; return 1;
+    default: return 0;
+  }
+}
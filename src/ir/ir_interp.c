@@ -0,0 +1,387 @@
+#include "ir/ir_interp.h"
+#include "ir/ir_fold.h"
+#include "utils/diagnostic.h"
+#include <stdlib.h>
+#include <string.h>
+
+#define INTERP_MEMORY_SIZE (1u << 20)
+#define INTERP_MEMORY_BASE 0x10000u
+#define INTERP_MAX_DEPTH 10000
+
+typedef struct {
+  const IrModule *module;
+  uint8_t *memory;
+  int64_t *data_addr;
+  uint32_t sp;
+  uint64_t steps;
+  uint64_t step_limit;
+  int32_t depth;
+  int32_t tail_function;
+  int64_t *tail_args;
+  IrProfile *profile;
+  IrInterpStatus status;
+} IrInterp;
+
+static int32_t interp_check(IrInterp *interp, const int64_t addr, const uint32_t width, uint32_t *offset) {
+  int64_t off = addr - INTERP_MEMORY_BASE;
+  if (off < 0 || (uint64_t) off + width > INTERP_MEMORY_SIZE) {
+    interp->status = IR_INTERP_MEMORY_FAULT;
+    return 0;
+  }
+  *offset = (uint32_t) off;
+  return 1;
+}
+
+static int64_t interp_load(IrInterp *interp, const int64_t addr, const uint32_t width) {
+  uint32_t off;
+  if (!interp_check(interp, addr, width, &off)) {
+    return 0;
+  }
+  if (width == 1) {
+    return (int8_t) interp->memory[off];
+  }
+  int32_t value;
+  memcpy(&value, interp->memory + off, sizeof(value));
+  return value;
+}
+
+static void interp_store(IrInterp *interp, const int64_t addr, const uint32_t width, const int64_t value) {
+  uint32_t off;
+  if (!interp_check(interp, addr, width, &off)) {
+    return;
+  }
+  if (width == 1) {
+    interp->memory[off] = (uint8_t) value;
+    return;
+  }
+  int32_t v = (int32_t) value;
+  memcpy(interp->memory + off, &v, sizeof(v));
+}
+
+static int32_t interp_binary(const IrOp op, const int32_t a, const int32_t b) {
+  int32_t result;
+  if (ir_fold_binary(op, a, b, &result)) {
+    return result;
+  }
+  if (op == IR_OP_DIV) {
+    return -1;
+  }
+  if (op == IR_OP_REM) {
+    return a;
+  }
+  return 0;
+}
+
+static int32_t interp_compare_ptr(const IrOp op, const int64_t a, const int64_t b) {
+  switch (op) {
+    case IR_OP_EQ: return a == b;
+    case IR_OP_NE: return a != b;
+    case IR_OP_LT: return a < b;
+    case IR_OP_LE: return a <= b;
+    case IR_OP_GT: return a > b;
+    case IR_OP_GE: return a >= b;
+    default: return 0;
+  }
+}
+
+static int32_t interp_call(IrInterp *interp, int32_t function, const int64_t *args, uint32_t arg_count);
+
+static IrFunctionProfile *interp_profile_for(const IrInterp *interp, const IrFunction *fn, const IrBlockId block) {
+  if (!interp->profile || fn->index < 0 || (uint32_t) fn->index >= interp->profile->function_count) {
+    return NULL;
+  }
+  IrFunctionProfile *profile = &interp->profile->functions[fn->index];
+  return block < profile->block_count ? profile : NULL;
+}
+
+static void interp_enter_block(const IrFunction *fn, int64_t *values, int64_t *scratch, const IrBlockId from,
+                               const IrBlockId to) {
+  const IrIdVector *insts = &fn->blocks[to].insts;
+  uint32_t count = 0;
+  for (uint32_t i = 0; i < insts->count; i++) {
+    const IrInst *inst = &fn->insts[insts->items[i]];
+    if (inst->op == IR_OP_NOP) {
+      continue;
+    }
+    if (inst->op != IR_OP_PHI) {
+      break;
+    }
+    IrValueId incoming = ir_phi_incoming_for(fn, insts->items[i], from);
+    scratch[count++] = incoming == IR_NONE ? 0 : values[incoming];
+  }
+  count = 0;
+  for (uint32_t i = 0; i < insts->count; i++) {
+    const IrInst *inst = &fn->insts[insts->items[i]];
+    if (inst->op == IR_OP_NOP) {
+      continue;
+    }
+    if (inst->op != IR_OP_PHI) {
+      break;
+    }
+    values[insts->items[i]] = scratch[count++];
+  }
+}
+
+static int32_t interp_function(IrInterp *interp, const IrFunction *fn, const int64_t *args) {
+  int64_t *values = calloc(fn->inst_count ? fn->inst_count : 1, sizeof(int64_t));
+  int64_t *scratch = calloc(fn->inst_count ? fn->inst_count : 1, sizeof(int64_t));
+  int64_t *frame_addr = calloc(fn->frame_count ? fn->frame_count : 1, sizeof(int64_t));
+  if (!values || !scratch || !frame_addr) {
+    LOG(FATAL, "out of memory");
+  }
+  uint32_t saved_sp = interp->sp;
+  for (uint32_t i = 0; i < fn->frame_count; i++) {
+    uint32_t align = fn->frame[i].align > 0 ? (uint32_t) fn->frame[i].align : 1;
+    interp->sp = (interp->sp + align - 1) & ~(align - 1);
+    frame_addr[i] = INTERP_MEMORY_BASE + interp->sp;
+    interp->sp += (uint32_t) fn->frame[i].size;
+  }
+  if (interp->sp > INTERP_MEMORY_SIZE) {
+    interp->status = IR_INTERP_STACK_OVERFLOW;
+  }
+  int32_t result = 0;
+  IrBlockId block = 0;
+  while (interp->status == IR_INTERP_OK) {
+    const IrIdVector *insts = &fn->blocks[block].insts;
+    IrBlockId next = IR_NONE;
+    IrFunctionProfile *profile = interp_profile_for(interp, fn, block);
+    if (profile) {
+      profile->blocks[block]++;
+    }
+    for (uint32_t i = 0; i < insts->count && interp->status == IR_INTERP_OK; i++) {
+      IrValueId id = insts->items[i];
+      const IrInst *inst = &fn->insts[id];
+      if (inst->op == IR_OP_NOP || inst->op == IR_OP_PHI) {
+        continue;
+      }
+      if (++interp->steps > interp->step_limit) {
+        interp->status = IR_INTERP_STEP_LIMIT;
+        break;
+      }
+      uint32_t flags = ir_op_flags(inst->op);
+      int64_t a = inst->ops[0] != IR_NONE && !(flags & IR_OPF_TERMINATOR) ? values[inst->ops[0]] : 0;
+      if (flags & IR_OPF_BINARY) {
+        int64_t b = values[inst->ops[1]];
+        if (inst->type == IR_TYPE_PTR && inst->op == IR_OP_ADD) {
+          int64_t ptr = fn->insts[inst->ops[0]].type == IR_TYPE_PTR ? a : b;
+          int64_t off = fn->insts[inst->ops[0]].type == IR_TYPE_PTR ? b : a;
+          values[id] = ptr + (int32_t) off;
+        } else if (inst->type == IR_TYPE_PTR && inst->op == IR_OP_SUB) {
+          values[id] = a - (int32_t) b;
+        } else if ((flags & IR_OPF_COMPARE) && fn->insts[inst->ops[0]].type == IR_TYPE_PTR) {
+          values[id] = interp_compare_ptr((IrOp) inst->op, a, b);
+        } else {
+          values[id] = interp_binary(inst->op, (int32_t) a, (int32_t) b);
+        }
+        continue;
+      }
+      switch (inst->op) {
+        case IR_OP_CONST:
+          values[id] = inst->imm;
+          break;
+        case IR_OP_PARAM:
+          values[id] = (int32_t) args[inst->imm];
+          break;
+        case IR_OP_ALLOCA:
+          values[id] = frame_addr[inst->imm];
+          break;
+        case IR_OP_DATA:
+          values[id] = interp->data_addr[inst->imm];
+          break;
+        case IR_OP_NEG:
+        case IR_OP_NOT:
+        case IR_OP_SEXT8: {
+          int32_t folded = 0;
+          ir_fold_unary(inst->op, (int32_t) a, &folded);
+          values[id] = folded;
+          break;
+        }
+        case IR_OP_COPY:
+          values[id] = a;
+          break;
+        case IR_OP_LOAD:
+          values[id] = interp_load(interp, a + inst->imm, inst->width);
+          break;
+        case IR_OP_STORE:
+          interp_store(interp, a + inst->imm, inst->width, values[inst->ops[1]]);
+          break;
+        case IR_OP_CALL: {
+          int64_t *call_args = calloc(inst->list_count ? inst->list_count : 1, sizeof(int64_t));
+          if (!call_args) {
+            LOG(FATAL, "out of memory");
+          }
+          for (uint32_t k = 0; k < inst->list_count; k++) {
+            call_args[k] = values[fn->operands[inst->list + k]];
+          }
+          if (inst->flags & IR_INST_TAIL) {
+            interp->tail_function = inst->imm;
+            interp->tail_args = call_args;
+            goto done;
+          }
+          values[id] = interp_call(interp, inst->imm, call_args, inst->list_count);
+          free(call_args);
+          break;
+        }
+        case IR_OP_JUMP:
+          next = inst->ops[0];
+          break;
+        case IR_OP_BRANCH:
+          next = (int32_t) values[inst->ops[0]] != 0 ? inst->ops[1] : inst->ops[2];
+          if (profile && next == inst->ops[1]) {
+            profile->taken[block]++;
+          }
+          break;
+        case IR_OP_RET:
+          result = inst->ops[0] != IR_NONE ? (int32_t) values[inst->ops[0]] : 0;
+          goto done;
+        default:
+          interp->status = IR_INTERP_INVALID;
+          break;
+      }
+      if (next != IR_NONE) {
+        break;
+      }
+    }
+    if (interp->status != IR_INTERP_OK) {
+      break;
+    }
+    if (next == IR_NONE) {
+      interp->status = IR_INTERP_INVALID;
+      break;
+    }
+    interp_enter_block(fn, values, scratch, block, next);
+    block = next;
+  }
+done:
+  interp->sp = saved_sp;
+  free(values);
+  free(scratch);
+  free(frame_addr);
+  return result;
+}
+
+static int32_t interp_call(IrInterp *interp, const int32_t function, const int64_t *args, const uint32_t arg_count) {
+  if (function < 0 || (uint32_t) function >= interp->module->function_count) {
+    interp->status = IR_INTERP_INVALID;
+    return 0;
+  }
+  const IrFunction *fn = interp->module->functions[function];
+  if ((int32_t) arg_count != fn->param_count) {
+    interp->status = IR_INTERP_INVALID;
+    return 0;
+  }
+  if (++interp->depth > INTERP_MAX_DEPTH) {
+    interp->status = IR_INTERP_STACK_OVERFLOW;
+    interp->depth--;
+    return 0;
+  }
+  int32_t result = interp_function(interp, fn, args);
+  while (interp->tail_function >= 0) {
+    int64_t *tail_args = interp->tail_args;
+    fn = interp->module->functions[interp->tail_function];
+    interp->tail_function = -1;
+    interp->tail_args = NULL;
+    if (interp->status == IR_INTERP_OK) {
+      result = interp_function(interp, fn, tail_args);
+    }
+    free(tail_args);
+  }
+  interp->depth--;
+  return result;
+}
+
+static IrInterpResult interp_run(const IrModule *module, const int32_t function, const int32_t *args,
+                                 const uint32_t arg_count, const uint64_t step_limit, IrProfile *profile) {
+  IrInterp interp = {
+    .module = module,
+    .memory = calloc(INTERP_MEMORY_SIZE, 1),
+    .data_addr = NULL,
+    .sp = 0,
+    .steps = 0,
+    .step_limit = step_limit,
+    .depth = 0,
+    .tail_function = -1,
+    .tail_args = NULL,
+    .profile = profile,
+    .status = IR_INTERP_OK
+  };
+  if (!interp.memory) {
+    LOG(FATAL, "out of memory");
+  }
+  int64_t *wide_args = calloc(arg_count ? arg_count : 1, sizeof(int64_t));
+  interp.data_addr = calloc(module->data_count ? module->data_count : 1, sizeof(int64_t));
+  if (!wide_args || !interp.data_addr) {
+    LOG(FATAL, "out of memory");
+  }
+  for (uint32_t d = 0; d < module->data_count && interp.status == IR_INTERP_OK; d++) {
+    uint32_t size = module->data[d].word_count * (uint32_t) sizeof(int32_t);
+    if (interp.sp + size > INTERP_MEMORY_SIZE) {
+      interp.status = IR_INTERP_STACK_OVERFLOW;
+      break;
+    }
+    memcpy(interp.memory + interp.sp, module->data[d].words, size);
+    interp.data_addr[d] = INTERP_MEMORY_BASE + interp.sp;
+    interp.sp += size;
+  }
+  for (uint32_t i = 0; i < arg_count; i++) {
+    wide_args[i] = args[i];
+  }
+  int32_t value = interp.status == IR_INTERP_OK ? interp_call(&interp, function, wide_args, arg_count) : 0;
+  free(wide_args);
+  free(interp.data_addr);
+  free(interp.memory);
+  IrInterpResult result = {
+    .status = interp.status,
+    .value = value,
+    .steps = interp.steps
+  };
+  return result;
+}
+
+IrInterpResult ir_interp_run(const IrModule *module, const int32_t function, const int32_t *args,
+                             const uint32_t arg_count, const uint64_t step_limit) {
+  return interp_run(module, function, args, arg_count, step_limit, NULL);
+}
+
+IrInterpResult ir_interp_profile(const IrModule *module, const int32_t function, const int32_t *args,
+                                 const uint32_t arg_count, const uint64_t step_limit, IrProfile *profile) {
+  return interp_run(module, function, args, arg_count, step_limit, profile);
+}
+
+void ir_profile_init(IrProfile *profile, const IrModule *module) {
+  profile->function_count = module->function_count;
+  profile->functions = calloc(module->function_count ? module->function_count : 1, sizeof(IrFunctionProfile));
+  if (!profile->functions) {
+    LOG(FATAL, "out of memory");
+  }
+  for (uint32_t f = 0; f < module->function_count; f++) {
+    IrFunctionProfile *data = &profile->functions[f];
+    uint32_t count = module->functions[f]->block_count;
+    data->block_count = count;
+    data->blocks = calloc(count ? count : 1, sizeof(uint64_t));
+    data->taken = calloc(count ? count : 1, sizeof(uint64_t));
+    if (!data->blocks || !data->taken) {
+      LOG(FATAL, "out of memory");
+    }
+  }
+}
+
+void ir_profile_destroy(IrProfile *profile) {
+  for (uint32_t f = 0; f < profile->function_count; f++) {
+    free(profile->functions[f].blocks);
+    free(profile->functions[f].taken);
+  }
+  free(profile->functions);
+  memset(profile, 0, sizeof(*profile));
+}
+
+const char *ir_interp_status_name(const IrInterpStatus status) {
+  switch (status) {
+    case IR_INTERP_OK: return "ok";
+    case IR_INTERP_MEMORY_FAULT: return "memory fault";
+    case IR_INTERP_STACK_OVERFLOW: return "stack overflow";
+    case IR_INTERP_STEP_LIMIT: return "step limit exceeded";
+    case IR_INTERP_INVALID: return "invalid instruction";
+    default: return "?";
+  }
+}
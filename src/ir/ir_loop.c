@@ -0,0 +1,179 @@
+#include "ir/ir_loop.h"
+#include "utils/diagnostic.h"
+#include <stdlib.h>
+#include <string.h>
+
+static void *loop_alloc(const size_t count, const size_t size) {
+  void *ptr = malloc((count ? count : 1) * size);
+  if (!ptr) {
+    LOG(FATAL, "out of memory");
+  }
+  return ptr;
+}
+
+void ir_loops_compute(IrLoopInfo *info, const IrFunction *fn, const IrDomTree *dom) {
+  uint32_t n = fn->block_count;
+  memset(info, 0, sizeof(*info));
+  info->block_count = n;
+  info->loops = loop_alloc(n, sizeof(IrLoop));
+  info->block_loop = loop_alloc(n, sizeof(uint32_t));
+  info->block_depth = loop_alloc(n, sizeof(uint32_t));
+  uint32_t *mark = loop_alloc(n, sizeof(uint32_t));
+  uint32_t *stack = loop_alloc(n, sizeof(uint32_t));
+  uint32_t block_capacity = n ? n : 1;
+  info->blocks = loop_alloc(block_capacity, sizeof(uint32_t));
+  uint32_t block_total = 0;
+  for (uint32_t b = 0; b < n; b++) {
+    info->block_loop[b] = IR_NONE;
+    info->block_depth[b] = 0;
+    mark[b] = IR_NONE;
+  }
+  for (uint32_t r = 0; r < dom->rpo_count; r++) {
+    IrBlockId header = dom->rpo[r];
+    const IrIdVector *preds = &fn->blocks[header].preds;
+    uint32_t loop = info->loop_count;
+    uint32_t sp = 0;
+    for (uint32_t p = 0; p < preds->count; p++) {
+      IrBlockId latch = preds->items[p];
+      if (ir_dom_reachable(dom, latch) && ir_dom_dominates(dom, header, latch) && mark[latch] != loop) {
+        mark[latch] = loop;
+        stack[sp++] = latch;
+      }
+    }
+    if (sp == 0) {
+      continue;
+    }
+    mark[header] = loop;
+    IrLoop *data = &info->loops[info->loop_count++];
+    data->header = header;
+    data->block_start = block_total;
+    if (block_total == block_capacity) {
+      block_capacity *= 2;
+      info->blocks = realloc(info->blocks, block_capacity * sizeof(uint32_t));
+      if (!info->blocks) {
+        LOG(FATAL, "out of memory");
+      }
+    }
+    info->blocks[block_total++] = header;
+    while (sp > 0) {
+      IrBlockId block = stack[--sp];
+      if (block_total == block_capacity) {
+        block_capacity *= 2;
+        info->blocks = realloc(info->blocks, block_capacity * sizeof(uint32_t));
+        if (!info->blocks) {
+          LOG(FATAL, "out of memory");
+        }
+      }
+      info->blocks[block_total++] = block;
+      const IrIdVector *block_preds = &fn->blocks[block].preds;
+      for (uint32_t p = 0; p < block_preds->count; p++) {
+        IrBlockId pred = block_preds->items[p];
+        if (mark[pred] != loop && ir_dom_reachable(dom, pred)) {
+          mark[pred] = loop;
+          stack[sp++] = pred;
+        }
+      }
+    }
+    data->block_count = block_total - data->block_start;
+    data->parent = info->block_loop[header];
+    data->depth = data->parent == IR_NONE ? 1 : info->loops[data->parent].depth + 1;
+    for (uint32_t i = 0; i < data->block_count; i++) {
+      IrBlockId block = info->blocks[data->block_start + i];
+      info->block_loop[block] = loop;
+      info->block_depth[block] = data->depth;
+    }
+  }
+  free(mark);
+  free(stack);
+}
+
+int32_t ir_loop_contains(const IrLoopInfo *info, const uint32_t loop, const IrBlockId block) {
+  if (block >= info->block_count) {
+    return 0;
+  }
+  for (uint32_t l = info->block_loop[block]; l != IR_NONE; l = info->loops[l].parent) {
+    if (l == loop) {
+      return 1;
+    }
+  }
+  return 0;
+}
+
+IrBlockId ir_loop_preheader(const IrFunction *fn, const IrLoopInfo *info, const uint32_t loop) {
+  IrBlockId header = info->loops[loop].header;
+  const IrIdVector *preds = &fn->blocks[header].preds;
+  IrBlockId outside = IR_NONE;
+  for (uint32_t p = 0; p < preds->count; p++) {
+    if (ir_loop_contains(info, loop, preds->items[p])) {
+      continue;
+    }
+    if (outside != IR_NONE) {
+      return IR_NONE;
+    }
+    outside = preds->items[p];
+  }
+  if (outside == IR_NONE) {
+    return IR_NONE;
+  }
+  IrBlockId succs[2];
+  return ir_block_succs(fn, outside, succs) == 1 ? outside : IR_NONE;
+}
+
+IrBlockId ir_loop_ensure_preheader(IrFunction *fn, const IrLoopInfo *info, const uint32_t loop) {
+  IrBlockId existing = ir_loop_preheader(fn, info, loop);
+  if (existing != IR_NONE) {
+    return existing;
+  }
+  IrBlockId header = info->loops[loop].header;
+  if (header == 0) {
+    return IR_NONE;
+  }
+  uint32_t pred_count = fn->blocks[header].preds.count;
+  IrBlockId *outside = loop_alloc(pred_count, sizeof(IrBlockId));
+  uint32_t outside_count = 0;
+  for (uint32_t p = 0; p < pred_count; p++) {
+    IrBlockId pred = fn->blocks[header].preds.items[p];
+    if (!ir_loop_contains(info, loop, pred)) {
+      outside[outside_count++] = pred;
+    }
+  }
+  IrBlockId preheader = ir_block_create(fn);
+  const IrIdVector *insts = &fn->blocks[header].insts;
+  for (uint32_t i = 0; i < insts->count; i++) {
+    IrValueId phi = insts->items[i];
+    if (fn->insts[phi].op != IR_OP_PHI) {
+      continue;
+    }
+    IrValueId merged = IR_NONE;
+    if (outside_count == 1) {
+      merged = ir_phi_incoming_for(fn, phi, outside[0]);
+    } else {
+      merged = ir_inst_create(fn, IR_OP_PHI, (IrType) fn->insts[phi].type);
+      ir_block_append(fn, preheader, merged);
+      for (uint32_t o = 0; o < outside_count; o++) {
+        ir_phi_add_incoming(fn, merged, outside[o], ir_phi_incoming_for(fn, phi, outside[o]));
+      }
+    }
+    for (uint32_t o = 0; o < outside_count; o++) {
+      ir_phi_remove_incoming(fn, phi, outside[o]);
+    }
+    ir_phi_add_incoming(fn, phi, preheader, merged);
+  }
+  IrValueId jump = ir_inst_create(fn, IR_OP_JUMP, IR_TYPE_VOID);
+  fn->insts[jump].ops[0] = header;
+  ir_block_append(fn, preheader, jump);
+  for (uint32_t o = 0; o < outside_count; o++) {
+    ir_replace_successor(fn, outside[o], header, preheader);
+  }
+  free(outside);
+  ir_compute_preds(fn);
+  return preheader;
+}
+
+void ir_loops_destroy(IrLoopInfo *info) {
+  free(info->loops);
+  free(info->blocks);
+  free(info->block_loop);
+  free(info->block_depth);
+  memset(info, 0, sizeof(*info));
+}
@@ -0,0 +1,158 @@
+#include "ir/ir_printer.h"
+#include <stdio.h>
+
+static const char *type_suffix(const IrType type) {
+  switch (type) {
+    case IR_TYPE_I32: return "i32";
+    case IR_TYPE_PTR: return "ptr";
+    default: return "void";
+  }
+}
+
+static void print_value(const IrValueId value) {
+  if (value == IR_NONE) {
+    printf("<none>");
+  } else {
+    printf("%%%u", value);
+  }
+}
+
+static void print_inst(const IrFunction *fn, const IrValueId id) {
+  const IrInst *inst = &fn->insts[id];
+  uint32_t flags = ir_op_flags(inst->op);
+  printf("  ");
+  if (inst->type != IR_TYPE_VOID) {
+    printf("%%%u = ", id);
+  }
+  if (inst->flags & IR_INST_TAIL) {
+    printf("tail ");
+  }
+  printf("%s", ir_op_name(inst->op));
+  if (inst->op == IR_OP_LOAD || inst->op == IR_OP_STORE) {
+    printf(".%s", inst->width == 1 ? "i8" : "i32");
+  } else if (inst->type != IR_TYPE_VOID) {
+    printf(".%s", type_suffix(inst->type));
+  }
+  switch (inst->op) {
+    case IR_OP_CONST:
+    case IR_OP_PARAM:
+      printf(" %d", inst->imm);
+      break;
+    case IR_OP_ALLOCA: {
+      const IrFrameObject *object = &fn->frame[inst->imm];
+      printf(" $%s (%d bytes)", object->name ? object->name : "?", object->size);
+      break;
+    }
+    case IR_OP_DATA:
+      printf(" @data%d (%u words)", inst->imm, fn->module->data[inst->imm].word_count);
+      break;
+    case IR_OP_LOAD:
+      printf(" ");
+      print_value(inst->ops[0]);
+      if (inst->imm) {
+        printf(" + %d", inst->imm);
+      }
+      break;
+    case IR_OP_STORE:
+      printf(" ");
+      print_value(inst->ops[0]);
+      if (inst->imm) {
+        printf(" + %d", inst->imm);
+      }
+      printf(", ");
+      print_value(inst->ops[1]);
+      break;
+    case IR_OP_CALL: {
+      const IrModule *module = fn->module;
+      if (inst->imm >= 0 && (uint32_t) inst->imm < module->function_count) {
+        printf(" @%s(", module->functions[inst->imm]->name);
+      } else {
+        printf(" @%d(", inst->imm);
+      }
+      for (uint32_t i = 0; i < inst->list_count; i++) {
+        if (i) printf(", ");
+        print_value(fn->operands[inst->list + i]);
+      }
+      printf(")");
+      break;
+    }
+    case IR_OP_PHI:
+      for (uint32_t i = 0; i < inst->list_count; i++) {
+        printf("%s [bb%u: ", i ? "," : "", fn->operands[inst->list + 2 * i]);
+        print_value(fn->operands[inst->list + 2 * i + 1]);
+        printf("]");
+      }
+      break;
+    case IR_OP_JUMP:
+      printf(" bb%u", inst->ops[0]);
+      break;
+    case IR_OP_BRANCH:
+      printf(" ");
+      print_value(inst->ops[0]);
+      printf(", bb%u, bb%u", inst->ops[1], inst->ops[2]);
+      break;
+    case IR_OP_RET:
+      if (inst->ops[0] != IR_NONE) {
+        printf(" ");
+        print_value(inst->ops[0]);
+      }
+      break;
+    default:
+      if (flags & (IR_OPF_BINARY | IR_OPF_UNARY)) {
+        printf(" ");
+        print_value(inst->ops[0]);
+        if (flags & IR_OPF_BINARY) {
+          printf(", ");
+          print_value(inst->ops[1]);
+        }
+      }
+      break;
+  }
+  printf("\n");
+}
+
+void ir_print_function(const IrFunction *fn) {
+  printf("fn %s(%d)", fn->name, fn->param_count);
+  if (fn->attrs & IR_FUNCTION_PURE) {
+    printf(" pure");
+  } else if (fn->attrs & IR_FUNCTION_READONLY) {
+    printf(" readonly");
+  }
+  printf(" {\n");
+  for (uint32_t b = 0; b < fn->block_count; b++) {
+    const IrBlock *block = &fn->blocks[b];
+    if (block->flags & IR_BLOCK_DEAD) {
+      continue;
+    }
+    printf("bb%u:", b);
+    if (block->preds.count > 0) {
+      printf(" ; preds:");
+      for (uint32_t i = 0; i < block->preds.count; i++) {
+        printf("%s bb%u", i ? "," : "", block->preds.items[i]);
+      }
+    }
+    printf("\n");
+    for (uint32_t i = 0; i < block->insts.count; i++) {
+      if (fn->insts[block->insts.items[i]].op != IR_OP_NOP) {
+        print_inst(fn, block->insts.items[i]);
+      }
+    }
+  }
+  printf("}\n");
+}
+
+void ir_print_module(const IrModule *module) {
+  for (uint32_t d = 0; d < module->data_count; d++) {
+    printf("@data%u = {", d);
+    for (uint32_t w = 0; w < module->data[d].word_count; w++) {
+      printf("%s%d", w ? ", " : "", module->data[d].words[w]);
+    }
+    printf("}\n\n");
+  }
+  for (uint32_t i = 0; i < module->function_count; i++) {
+    if (i) {
+      printf("\n");
+    }
+    ir_print_function(module->functions[i]);
+  }
+}
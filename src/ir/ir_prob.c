@@ -0,0 +1,257 @@
+#include "ir/ir_prob.h"
+#include "utils/diagnostic.h"
+#include "utils/stats.h"
+#include <stdlib.h>
+#include <string.h>
+
+#define PROB_MIN 0.0001f
+#define PROB_MAX_CYCLIC 0.999999f
+#define PROB_RETURN_DEPTH 4
+
+typedef struct {
+  const IrFunction *fn;
+  const IrDomTree *dom;
+  const IrLoopInfo *loops;
+  IrBlockId block;
+  IrValueId cond;
+  IrBlockId succs[2];
+} ProbBranch;
+
+typedef int32_t (*ProbPredict)(const ProbBranch *branch);
+
+typedef struct {
+  const char *stat;
+  ProbPredict predict;
+  float prob;
+} ProbHeuristic;
+
+static void *prob_alloc(const size_t count, const size_t size) {
+  void *ptr = calloc(count ? count : 1, size);
+  if (!ptr) {
+    LOG(FATAL, "out of memory");
+  }
+  return ptr;
+}
+
+static int32_t prob_prefer(const int32_t first, const int32_t second) {
+  return first && !second ? 1 : second && !first ? -1 : 0;
+}
+
+static IrValueId prob_return_of(const IrFunction *fn, IrBlockId block) {
+  for (uint32_t depth = 0; depth < PROB_RETURN_DEPTH; depth++) {
+    IrValueId id = ir_block_terminator(fn, block);
+    if (id == IR_NONE) {
+      return IR_NONE;
+    }
+    const IrInst *term = &fn->insts[id];
+    if (term->op == IR_OP_RET) {
+      return id;
+    }
+    if (term->op != IR_OP_JUMP) {
+      return IR_NONE;
+    }
+    block = term->ops[0];
+  }
+  return IR_NONE;
+}
+
+static int32_t prob_is_error(const IrFunction *fn, const IrBlockId block) {
+  IrValueId ret = prob_return_of(fn, block);
+  int32_t value;
+  return ret != IR_NONE && ir_value_const(fn, fn->insts[ret].ops[0], &value) && value < 0;
+}
+
+static int32_t prob_loop_branch(const ProbBranch *branch) {
+  return prob_prefer(ir_dom_dominates(branch->dom, branch->succs[0], branch->block),
+                     ir_dom_dominates(branch->dom, branch->succs[1], branch->block));
+}
+
+static int32_t prob_loop_exit(const ProbBranch *branch) {
+  uint32_t loop = branch->loops->block_loop[branch->block];
+  if (loop == IR_NONE) {
+    return 0;
+  }
+  return prob_prefer(ir_loop_contains(branch->loops, loop, branch->succs[0]),
+                     ir_loop_contains(branch->loops, loop, branch->succs[1]));
+}
+
+static int32_t prob_error(const ProbBranch *branch) {
+  return prob_prefer(prob_is_error(branch->fn, branch->succs[1]), prob_is_error(branch->fn, branch->succs[0]));
+}
+
+static int32_t prob_return(const ProbBranch *branch) {
+  return prob_prefer(prob_return_of(branch->fn, branch->succs[1]) != IR_NONE,
+                     prob_return_of(branch->fn, branch->succs[0]) != IR_NONE);
+}
+
+static IrOp prob_swap(const IrOp op) {
+  switch (op) {
+    case IR_OP_LT: return IR_OP_GT;
+    case IR_OP_GT: return IR_OP_LT;
+    case IR_OP_LE: return IR_OP_GE;
+    case IR_OP_GE: return IR_OP_LE;
+    default: return op;
+  }
+}
+
+static int32_t prob_opcode(const ProbBranch *branch) {
+  const IrFunction *fn = branch->fn;
+  const IrInst *cond = &fn->insts[branch->cond];
+  if (!(ir_op_flags((IrOp) cond->op) & IR_OPF_COMPARE)) {
+    return 1;
+  }
+  IrOp op = (IrOp) cond->op;
+  int32_t value;
+  if (!ir_value_const(fn, cond->ops[1], &value)) {
+    if (!ir_value_const(fn, cond->ops[0], &value)) {
+      return 0;
+    }
+    op = prob_swap(op);
+  }
+  switch (op) {
+    case IR_OP_NE: return 1;
+    case IR_OP_EQ: return -1;
+    case IR_OP_LT:
+    case IR_OP_LE: return value == 0 ? -1 : 0;
+    case IR_OP_GT:
+    case IR_OP_GE: return value == 0 ? 1 : 0;
+    default: return 0;
+  }
+}
+
+static const ProbHeuristic prob_heuristics[] = {
+#define IR_PROB_HEURISTIC(name, percent) {"prob." #name, prob_##name, (percent) / 100.0f},
+#include "ir/ir_prob.def"
+};
+
+static float prob_combine(const float a, const float b) {
+  float yes = a * b;
+  float no = (1.0f - a) * (1.0f - b);
+  return yes / (yes + no);
+}
+
+static float prob_clamp(const float prob) {
+  return prob < PROB_MIN ? PROB_MIN : prob > 1.0f - PROB_MIN ? 1.0f - PROB_MIN : prob;
+}
+
+static float prob_estimate(const ProbBranch *branch) {
+  float prob = 0.5f;
+  for (size_t h = 0; h < sizeof(prob_heuristics) / sizeof(prob_heuristics[0]); h++) {
+    const ProbHeuristic *heuristic = &prob_heuristics[h];
+    int32_t prediction = heuristic->predict(branch);
+    if (prediction == 0) {
+      continue;
+    }
+    stats_add(heuristic->stat, 1);
+    prob = prob_combine(prob, prediction > 0 ? heuristic->prob : 1.0f - heuristic->prob);
+  }
+  return prob;
+}
+
+static float prob_branch(const IrFunction *fn, const IrDomTree *dom, const IrLoopInfo *loops,
+                         const IrFunctionProfile *profile, const IrBlockId block) {
+  const IrInst *term = &fn->insts[ir_block_terminator(fn, block)];
+  int32_t value;
+  if (ir_value_const(fn, term->ops[0], &value)) {
+    return value ? 1.0f : 0.0f;
+  }
+  if (term->ops[1] == term->ops[2]) {
+    return 1.0f;
+  }
+  if (profile && block < profile->block_count && profile->blocks[block] > 0) {
+    stats_add("prob.profiled_branches", 1);
+    return prob_clamp((float) ((double) profile->taken[block] / (double) profile->blocks[block]));
+  }
+  ProbBranch branch = {fn, dom, loops, block, term->ops[0], {term->ops[1], term->ops[2]}};
+  return prob_clamp(prob_estimate(&branch));
+}
+
+float ir_probs_edge(const IrBlockProbs *probs, const IrFunction *fn, const IrBlockId from, const IrBlockId to) {
+  IrValueId id = ir_block_terminator(fn, from);
+  if (id == IR_NONE) {
+    return 0.0f;
+  }
+  const IrInst *term = &fn->insts[id];
+  if (term->op == IR_OP_JUMP) {
+    return term->ops[0] == to ? 1.0f : 0.0f;
+  }
+  if (term->op != IR_OP_BRANCH) {
+    return 0.0f;
+  }
+  float prob = 0.0f;
+  if (term->ops[1] == to) {
+    prob += probs->taken[from];
+  }
+  if (term->ops[2] == to) {
+    prob += 1.0f - probs->taken[from];
+  }
+  return prob;
+}
+
+static void prob_propagate(const IrBlockProbs *probs, const IrFunction *fn, const IrDomTree *dom,
+                           const IrLoopInfo *loops, const uint32_t loop, const float *scale, float *out) {
+  IrBlockId top = loop == IR_NONE ? 0 : loops->loops[loop].header;
+  for (uint32_t r = 0; r < dom->rpo_count; r++) {
+    IrBlockId block = dom->rpo[r];
+    if (loop != IR_NONE && !ir_loop_contains(loops, loop, block)) {
+      continue;
+    }
+    if (block == top) {
+      out[block] = loop == IR_NONE ? scale[block] : 1.0f;
+      continue;
+    }
+    float sum = 0.0f;
+    const IrIdVector *preds = &fn->blocks[block].preds;
+    for (uint32_t p = 0; p < preds->count; p++) {
+      IrBlockId pred = preds->items[p];
+      if (!ir_dom_reachable(dom, pred) || ir_dom_dominates(dom, block, pred) ||
+          (loop != IR_NONE && !ir_loop_contains(loops, loop, pred))) {
+        continue;
+      }
+      sum += out[pred] * ir_probs_edge(probs, fn, pred, block);
+    }
+    out[block] = sum * scale[block];
+  }
+}
+
+void ir_probs_compute(IrBlockProbs *probs, const IrFunction *fn, const IrDomTree *dom, const IrLoopInfo *loops,
+                      const IrFunctionProfile *profile) {
+  uint32_t n = fn->block_count;
+  probs->block_count = n;
+  probs->taken = prob_alloc(n, sizeof(float));
+  probs->frequency = prob_alloc(n, sizeof(float));
+  for (uint32_t r = 0; r < dom->rpo_count; r++) {
+    IrBlockId block = dom->rpo[r];
+    IrValueId term = ir_block_terminator(fn, block);
+    if (term != IR_NONE && fn->insts[term].op == IR_OP_BRANCH) {
+      probs->taken[block] = prob_branch(fn, dom, loops, profile, block);
+    }
+  }
+  float *scale = prob_alloc(n, sizeof(float));
+  float *local = prob_alloc(n, sizeof(float));
+  for (uint32_t b = 0; b < n; b++) {
+    scale[b] = 1.0f;
+  }
+  for (uint32_t l = loops->loop_count; l-- > 0;) {
+    IrBlockId header = loops->loops[l].header;
+    prob_propagate(probs, fn, dom, loops, l, scale, local);
+    float back = 0.0f;
+    const IrIdVector *preds = &fn->blocks[header].preds;
+    for (uint32_t p = 0; p < preds->count; p++) {
+      IrBlockId pred = preds->items[p];
+      if (ir_dom_reachable(dom, pred) && ir_dom_dominates(dom, header, pred)) {
+        back += local[pred] * ir_probs_edge(probs, fn, pred, header);
+      }
+    }
+    scale[header] = 1.0f / (1.0f - (back < PROB_MAX_CYCLIC ? back : PROB_MAX_CYCLIC));
+  }
+  prob_propagate(probs, fn, dom, loops, IR_NONE, scale, probs->frequency);
+  free(scale);
+  free(local);
+}
+
+void ir_probs_destroy(IrBlockProbs *probs) {
+  free(probs->taken);
+  free(probs->frequency);
+  memset(probs, 0, sizeof(*probs));
+}
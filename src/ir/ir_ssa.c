@@ -0,0 +1,322 @@
+#include "ir/ir_ssa.h"
+#include "ir/ir_dom.h"
+#include "utils/diagnostic.h"
+#include <stdlib.h>
+#include <string.h>
+
+typedef struct {
+  uint32_t *items;
+  uint32_t count;
+  uint32_t capacity;
+} SsaStack;
+
+static void *ssa_calloc(const size_t count, const size_t size) {
+  void *ptr = calloc(count ? count : 1, size);
+  if (!ptr) {
+    LOG(FATAL, "out of memory");
+  }
+  return ptr;
+}
+
+static void ssa_stack_push(SsaStack *stack, const uint32_t value) {
+  if (stack->count == stack->capacity) {
+    stack->capacity = stack->capacity ? stack->capacity * 2 : 8;
+    stack->items = realloc(stack->items, stack->capacity * sizeof(uint32_t));
+    if (!stack->items) {
+      LOG(FATAL, "out of memory");
+    }
+  }
+  stack->items[stack->count++] = value;
+}
+
+static int32_t ssa_slot_of(const IrFunction *fn, const uint32_t *var_of_alloca, const IrValueId addr) {
+  if (addr == IR_NONE || fn->insts[addr].op != IR_OP_ALLOCA) {
+    return -1;
+  }
+  return (int32_t) var_of_alloca[addr];
+}
+
+static uint32_t ssa_collect_promotable(IrFunction *fn, uint32_t *var_of_alloca, IrValueId **allocas_out) {
+  for (uint32_t i = 0; i < fn->inst_count; i++) {
+    var_of_alloca[i] = IR_NONE;
+  }
+  uint8_t *candidate = ssa_calloc(fn->inst_count, 1);
+  for (uint32_t i = 0; i < fn->inst_count; i++) {
+    const IrInst *inst = &fn->insts[i];
+    if (inst->op == IR_OP_ALLOCA && inst->block != IR_NONE && (fn->frame[inst->imm].flags & IR_FRAME_SCALAR)) {
+      candidate[i] = 1;
+    }
+  }
+  for (uint32_t i = 0; i < fn->inst_count; i++) {
+    const IrInst *inst = &fn->insts[i];
+    if (inst->op == IR_OP_NOP) {
+      continue;
+    }
+    uint32_t count = ir_operand_count(fn, inst);
+    for (uint32_t k = 0; k < count; k++) {
+      uint32_t value = *ir_operand_slot(fn, inst, k);
+      if (value == IR_NONE || !candidate[value]) {
+        continue;
+      }
+      int32_t width = fn->frame[fn->insts[value].imm].elem_width;
+      int32_t direct = k == 0 && inst->imm == 0 && inst->width == width &&
+                       (inst->op == IR_OP_LOAD || inst->op == IR_OP_STORE);
+      if (!direct) {
+        candidate[value] = 0;
+      }
+    }
+  }
+  uint32_t var_count = 0;
+  for (uint32_t i = 0; i < fn->inst_count; i++) {
+    if (candidate[i]) {
+      var_count++;
+    }
+  }
+  IrValueId *allocas = ssa_calloc(var_count, sizeof(IrValueId));
+  var_count = 0;
+  for (uint32_t i = 0; i < fn->inst_count; i++) {
+    if (candidate[i]) {
+      var_of_alloca[i] = var_count;
+      allocas[var_count++] = i;
+    }
+  }
+  free(candidate);
+  *allocas_out = allocas;
+  return var_count;
+}
+
+static void ssa_place_phis(IrFunction *fn, const IrDomTree *dom, const uint32_t var_count,
+                           const uint32_t *var_of_alloca, uint32_t **phi_var_out, uint32_t *phi_base_out) {
+  uint32_t n = fn->block_count;
+  uint32_t *has_phi = ssa_calloc(n, sizeof(uint32_t));
+  uint32_t *in_work = ssa_calloc(n, sizeof(uint32_t));
+  uint32_t *worklist = ssa_calloc(n, sizeof(uint32_t));
+  uint32_t *def_blocks_start = ssa_calloc(var_count + 1, sizeof(uint32_t));
+  uint32_t store_count = 0;
+  for (uint32_t i = 0; i < fn->inst_count; i++) {
+    const IrInst *inst = &fn->insts[i];
+    if (inst->op == IR_OP_STORE && inst->block != IR_NONE) {
+      int32_t var = ssa_slot_of(fn, var_of_alloca, inst->ops[0]);
+      if (var >= 0) {
+        def_blocks_start[var + 1]++;
+        store_count++;
+      }
+    }
+  }
+  for (uint32_t v = 0; v < var_count; v++) {
+    def_blocks_start[v + 1] += def_blocks_start[v];
+  }
+  uint32_t *def_blocks = ssa_calloc(store_count, sizeof(uint32_t));
+  uint32_t *fill = ssa_calloc(var_count, sizeof(uint32_t));
+  memcpy(fill, def_blocks_start, var_count * sizeof(uint32_t));
+  for (uint32_t i = 0; i < fn->inst_count; i++) {
+    const IrInst *inst = &fn->insts[i];
+    if (inst->op == IR_OP_STORE && inst->block != IR_NONE) {
+      int32_t var = ssa_slot_of(fn, var_of_alloca, inst->ops[0]);
+      if (var >= 0) {
+        def_blocks[fill[var]++] = inst->block;
+      }
+    }
+  }
+  free(fill);
+
+  uint32_t phi_base = fn->inst_count;
+  uint32_t *phi_var = NULL;
+  uint32_t phi_count = 0;
+  uint32_t phi_capacity = 0;
+  for (uint32_t v = 0; v < var_count; v++) {
+    uint32_t stamp = v + 1;
+    uint32_t wl_count = 0;
+    for (uint32_t k = def_blocks_start[v]; k < def_blocks_start[v + 1]; k++) {
+      uint32_t b = def_blocks[k];
+      if (in_work[b] != stamp) {
+        in_work[b] = stamp;
+        worklist[wl_count++] = b;
+      }
+    }
+    while (wl_count > 0) {
+      uint32_t b = worklist[--wl_count];
+      for (uint32_t k = dom->df_start[b]; k < dom->df_start[b + 1]; k++) {
+        uint32_t f = dom->df[k];
+        if (has_phi[f] == stamp) {
+          continue;
+        }
+        has_phi[f] = stamp;
+        IrValueId phi = ir_inst_create(fn, IR_OP_PHI, IR_TYPE_I32);
+        ir_block_insert(fn, f, 0, phi);
+        if (phi_count == phi_capacity) {
+          phi_capacity = phi_capacity ? phi_capacity * 2 : 16;
+          phi_var = realloc(phi_var, phi_capacity * sizeof(uint32_t));
+          if (!phi_var) {
+            LOG(FATAL, "out of memory");
+          }
+        }
+        phi_var[phi_count++] = v;
+        if (in_work[f] != stamp) {
+          in_work[f] = stamp;
+          worklist[wl_count++] = f;
+        }
+      }
+    }
+  }
+  free(has_phi);
+  free(in_work);
+  free(worklist);
+  free(def_blocks_start);
+  free(def_blocks);
+  *phi_var_out = phi_var;
+  *phi_base_out = phi_base;
+}
+
+static uint32_t ssa_top(const SsaStack *stacks, const uint32_t var, const IrValueId undef) {
+  if (!stacks) {
+    return undef;
+  }
+  const SsaStack *stack = &stacks[var];
+  return stack->count ? stack->items[stack->count - 1] : undef;
+}
+
+static void ssa_fill_successor_phis(IrFunction *fn, const IrBlockId block, const uint32_t phi_base,
+                                    const uint32_t *phi_var, const SsaStack *stacks, const IrValueId undef) {
+  IrBlockId succs[2];
+  uint32_t succ_count = ir_block_succs(fn, block, succs);
+  for (uint32_t s = 0; s < succ_count; s++) {
+    IrIdVector *insts = &fn->blocks[succs[s]].insts;
+    for (uint32_t i = 0; i < insts->count; i++) {
+      IrValueId id = insts->items[i];
+      uint8_t op = fn->insts[id].op;
+      if (op != IR_OP_PHI && op != IR_OP_NOP) {
+        break;
+      }
+      if (op == IR_OP_PHI && id >= phi_base) {
+        ir_phi_add_incoming(fn, id, block, ssa_top(stacks, phi_var[id - phi_base], undef));
+      }
+    }
+  }
+}
+
+uint32_t ir_promote_slots(IrFunction *fn) {
+  uint32_t *var_of_alloca = ssa_calloc(fn->inst_count, sizeof(uint32_t));
+  IrValueId *allocas = NULL;
+  uint32_t var_count = ssa_collect_promotable(fn, var_of_alloca, &allocas);
+  if (var_count == 0) {
+    free(var_of_alloca);
+    free(allocas);
+    return 0;
+  }
+  ir_compute_preds(fn);
+  IrDomTree dom;
+  ir_dom_compute(&dom, fn);
+  ir_dom_compute_frontiers(&dom, fn);
+
+  uint32_t *phi_var = NULL;
+  uint32_t phi_base = 0;
+  ssa_place_phis(fn, &dom, var_count, var_of_alloca, &phi_var, &phi_base);
+
+  IrValueId undef = ir_inst_create(fn, IR_OP_CONST, IR_TYPE_I32);
+  ir_block_insert(fn, 0, 0, undef);
+
+  var_of_alloca = realloc(var_of_alloca, fn->inst_count * sizeof(uint32_t));
+  if (!var_of_alloca) {
+    LOG(FATAL, "out of memory");
+  }
+  for (uint32_t i = phi_base; i < fn->inst_count; i++) {
+    var_of_alloca[i] = IR_NONE;
+  }
+  IrValueId *map = ssa_calloc(fn->inst_count, sizeof(IrValueId));
+  for (uint32_t i = 0; i < fn->inst_count; i++) {
+    map[i] = IR_NONE;
+  }
+  SsaStack *stacks = ssa_calloc(var_count, sizeof(SsaStack));
+  SsaStack undo = {0};
+  uint32_t *work = ssa_calloc(2 * (size_t) fn->block_count + 2, sizeof(uint32_t));
+  uint32_t *undo_mark = ssa_calloc(fn->block_count, sizeof(uint32_t));
+  uint32_t sp = 0;
+  if (dom.rpo_count > 0) {
+    work[sp++] = dom.rpo[0];
+  }
+  while (sp > 0) {
+    uint32_t entry = work[--sp];
+    if (entry & 0x80000000u) {
+      uint32_t b = entry & 0x7fffffffu;
+      while (undo.count > undo_mark[b]) {
+        stacks[undo.items[--undo.count]].count--;
+      }
+      continue;
+    }
+    uint32_t b = entry;
+    undo_mark[b] = undo.count;
+    IrIdVector *insts = &fn->blocks[b].insts;
+    for (uint32_t i = 0; i < insts->count; i++) {
+      IrValueId id = insts->items[i];
+      IrInst *inst = &fn->insts[id];
+      if (inst->op == IR_OP_PHI && id >= phi_base) {
+        uint32_t var = phi_var[id - phi_base];
+        ssa_stack_push(&stacks[var], id);
+        ssa_stack_push(&undo, var);
+      } else if (inst->op == IR_OP_LOAD) {
+        int32_t var = ssa_slot_of(fn, var_of_alloca, inst->ops[0]);
+        if (var >= 0) {
+          map[id] = ssa_top(stacks, (uint32_t) var, undef);
+          ir_inst_kill(fn, id);
+        }
+      } else if (inst->op == IR_OP_STORE) {
+        int32_t var = ssa_slot_of(fn, var_of_alloca, inst->ops[0]);
+        if (var >= 0) {
+          IrValueId value = inst->ops[1];
+          if (inst->width == 1) {
+            inst->op = IR_OP_SEXT8;
+            inst->type = IR_TYPE_I32;
+            inst->ops[0] = value;
+            inst->ops[1] = IR_NONE;
+            inst->width = 0;
+            value = id;
+          } else {
+            ir_inst_kill(fn, id);
+          }
+          ssa_stack_push(&stacks[var], value);
+          ssa_stack_push(&undo, (uint32_t) var);
+        }
+      }
+    }
+    ssa_fill_successor_phis(fn, b, phi_base, phi_var, stacks, undef);
+    work[sp++] = b | 0x80000000u;
+    for (uint32_t k = dom.child_start[b]; k < dom.child_start[b + 1]; k++) {
+      work[sp++] = dom.children[k];
+    }
+  }
+  for (uint32_t b = 0; b < fn->block_count; b++) {
+    if (ir_dom_reachable(&dom, b) || (fn->blocks[b].flags & IR_BLOCK_DEAD)) {
+      continue;
+    }
+    ssa_fill_successor_phis(fn, b, phi_base, phi_var, NULL, undef);
+    IrIdVector *insts = &fn->blocks[b].insts;
+    for (uint32_t i = 0; i < insts->count; i++) {
+      IrValueId id = insts->items[i];
+      IrInst *inst = &fn->insts[id];
+      if ((inst->op == IR_OP_LOAD || inst->op == IR_OP_STORE) && ssa_slot_of(fn, var_of_alloca, inst->ops[0]) >= 0) {
+        if (inst->op == IR_OP_LOAD) {
+          map[id] = undef;
+        }
+        ir_inst_kill(fn, id);
+      }
+    }
+  }
+  ir_rewrite_operands(fn, map);
+  for (uint32_t v = 0; v < var_count; v++) {
+    fn->frame[fn->insts[allocas[v]].imm].flags |= IR_FRAME_DEAD;
+    ir_inst_kill(fn, allocas[v]);
+    free(stacks[v].items);
+  }
+  ir_sweep(fn);
+  free(stacks);
+  free(undo.items);
+  free(work);
+  free(undo_mark);
+  free(map);
+  free(phi_var);
+  free(allocas);
+  free(var_of_alloca);
+  ir_dom_destroy(&dom);
+  return var_count;
+}
@@ -0,0 +1,229 @@
+#include "ir/ir_verify.h"
+#include "ir/ir_dom.h"
+#include "utils/diagnostic.h"
+#include <stdarg.h>
+#include <stdio.h>
+#include <stdlib.h>
+#include <string.h>
+
+static int32_t verify_fail(const IrFunction *fn, const char *fmt, ...) {
+  char message[256];
+  va_list args;
+  va_start(args, fmt);
+  vsnprintf(message, sizeof(message), fmt, args);
+  va_end(args);
+  LOG(ERROR, "ir verify: %s: %s", fn->name, message);
+  return 1;
+}
+
+static int32_t verify_preds(const IrFunction *fn) {
+  int32_t errors = 0;
+  uint32_t *expected = calloc(fn->block_count ? fn->block_count : 1, sizeof(uint32_t));
+  if (!expected) {
+    LOG(FATAL, "out of memory");
+  }
+  for (uint32_t b = 0; b < fn->block_count; b++) {
+    if (fn->blocks[b].flags & IR_BLOCK_DEAD) {
+      continue;
+    }
+    IrBlockId succs[2];
+    uint32_t count = ir_block_succs(fn, b, succs);
+    for (uint32_t i = 0; i < count; i++) {
+      if (succs[i] >= fn->block_count || (fn->blocks[succs[i]].flags & IR_BLOCK_DEAD)) {
+        errors += verify_fail(fn, "bb%u branches to invalid block %u", b, succs[i]);
+        continue;
+      }
+      expected[succs[i]]++;
+      const IrIdVector *preds = &fn->blocks[succs[i]].preds;
+      int32_t found = 0;
+      for (uint32_t k = 0; k < preds->count; k++) {
+        found |= preds->items[k] == b;
+      }
+      if (!found) {
+        errors += verify_fail(fn, "bb%u is missing predecessor bb%u", succs[i], b);
+      }
+    }
+  }
+  for (uint32_t b = 0; b < fn->block_count; b++) {
+    if (!(fn->blocks[b].flags & IR_BLOCK_DEAD) && expected[b] != fn->blocks[b].preds.count) {
+      errors += verify_fail(fn, "bb%u has %u recorded predecessors, expected %u", b, fn->blocks[b].preds.count, expected[b]);
+    }
+  }
+  free(expected);
+  return errors;
+}
+
+static int32_t verify_structure(const IrFunction *fn, uint32_t *position) {
+  int32_t errors = 0;
+  uint8_t *seen = calloc(fn->inst_count ? fn->inst_count : 1, 1);
+  if (!seen) {
+    LOG(FATAL, "out of memory");
+  }
+  for (uint32_t b = 0; b < fn->block_count; b++) {
+    const IrBlock *block = &fn->blocks[b];
+    if (block->flags & IR_BLOCK_DEAD) {
+      continue;
+    }
+    int32_t seen_non_phi = 0;
+    int32_t terminated = 0;
+    uint32_t index = 0;
+    for (uint32_t i = 0; i < block->insts.count; i++) {
+      IrValueId id = block->insts.items[i];
+      if (id >= fn->inst_count) {
+        errors += verify_fail(fn, "bb%u references invalid instruction %u", b, id);
+        continue;
+      }
+      const IrInst *inst = &fn->insts[id];
+      if (inst->op == IR_OP_NOP) {
+        continue;
+      }
+      if (seen[id]) {
+        errors += verify_fail(fn, "%%%u appears more than once", id);
+      }
+      seen[id] = 1;
+      position[id] = index++;
+      if (inst->block != b) {
+        errors += verify_fail(fn, "%%%u records block %u but lives in bb%u", id, inst->block, b);
+      }
+      if (terminated) {
+        errors += verify_fail(fn, "%%%u follows the terminator of bb%u", id, b);
+      }
+      if (ir_op_flags(inst->op) & IR_OPF_TERMINATOR) {
+        terminated = 1;
+      }
+      if (inst->op == IR_OP_PHI) {
+        if (seen_non_phi) {
+          errors += verify_fail(fn, "phi %%%u is not at the start of bb%u", id, b);
+        }
+        if (inst->list_count != block->preds.count) {
+          errors += verify_fail(fn, "phi %%%u has %u incoming values but bb%u has %u predecessors", id, inst->list_count, b,
+                      block->preds.count);
+        }
+        for (uint32_t k = 0; k < block->preds.count; k++) {
+          if (ir_phi_incoming_for(fn, id, block->preds.items[k]) == IR_NONE) {
+            errors += verify_fail(fn, "phi %%%u has no value for predecessor bb%u", id, block->preds.items[k]);
+          }
+        }
+      } else {
+        seen_non_phi = 1;
+      }
+    }
+    if (!terminated) {
+      errors += verify_fail(fn, "bb%u has no terminator", b);
+    }
+  }
+  free(seen);
+  return errors;
+}
+
+static int32_t verify_operands(const IrFunction *fn, const IrDomTree *dom, const uint32_t *position) {
+  int32_t errors = 0;
+  const IrModule *module = fn->module;
+  for (uint32_t b = 0; b < fn->block_count; b++) {
+    const IrBlock *block = &fn->blocks[b];
+    if ((block->flags & IR_BLOCK_DEAD) || !ir_dom_reachable(dom, b)) {
+      continue;
+    }
+    for (uint32_t i = 0; i < block->insts.count; i++) {
+      IrValueId id = block->insts.items[i];
+      const IrInst *inst = &fn->insts[id];
+      if (inst->op == IR_OP_NOP) {
+        continue;
+      }
+      uint32_t count = ir_operand_count(fn, inst);
+      for (uint32_t k = 0; k < count; k++) {
+        IrValueId value = *ir_operand_slot(fn, inst, k);
+        if (value == IR_NONE || value >= fn->inst_count) {
+          errors += verify_fail(fn, "%%%u has an invalid operand %u", id, k);
+          continue;
+        }
+        const IrInst *def = &fn->insts[value];
+        if (def->op == IR_OP_NOP || def->block == IR_NONE) {
+          errors += verify_fail(fn, "%%%u uses deleted value %%%u", id, value);
+          continue;
+        }
+        if (def->type == IR_TYPE_VOID) {
+          errors += verify_fail(fn, "%%%u uses %%%u which produces no value", id, value);
+          continue;
+        }
+        IrBlockId use_block = b;
+        if (inst->op == IR_OP_PHI) {
+          use_block = fn->operands[inst->list + 2 * k];
+          if (!ir_dom_reachable(dom, use_block)) {
+            continue;
+          }
+          if (!ir_dom_dominates(dom, def->block, use_block)) {
+            errors += verify_fail(fn, "phi %%%u operand %%%u does not dominate bb%u", id, value, use_block);
+          }
+          continue;
+        }
+        if (def->block == use_block) {
+          if (position[value] >= position[id]) {
+            errors += verify_fail(fn, "%%%u is used by %%%u before its definition", value, id);
+          }
+        } else if (!ir_dom_dominates(dom, def->block, use_block)) {
+          errors += verify_fail(fn, "%%%u does not dominate its use in %%%u", value, id);
+        }
+      }
+      if ((inst->op == IR_OP_LOAD || inst->op == IR_OP_STORE) && inst->ops[0] != IR_NONE &&
+          fn->insts[inst->ops[0]].type != IR_TYPE_PTR) {
+        errors += verify_fail(fn, "memory access %%%u uses a non-pointer address", id);
+      }
+      if (inst->op == IR_OP_DATA && (inst->imm < 0 || (uint32_t) inst->imm >= module->data_count)) {
+        errors += verify_fail(fn, "data %%%u refers to invalid table %d", id, inst->imm);
+      }
+      if (inst->op == IR_OP_CALL) {
+        if (inst->imm < 0 || (uint32_t) inst->imm >= module->function_count) {
+          errors += verify_fail(fn, "call %%%u targets invalid function %d", id, inst->imm);
+        } else if ((int32_t) inst->list_count != module->functions[inst->imm]->param_count) {
+          errors += verify_fail(fn, "call %%%u passes %u arguments to %s", id, inst->list_count,
+                      module->functions[inst->imm]->name);
+        }
+        if (inst->flags & IR_INST_TAIL) {
+          uint32_t next = i + 1;
+          while (next < block->insts.count && fn->insts[block->insts.items[next]].op == IR_OP_NOP) {
+            next++;
+          }
+          if (next == block->insts.count || fn->insts[block->insts.items[next]].op != IR_OP_RET ||
+              fn->insts[block->insts.items[next]].ops[0] != id) {
+            errors += verify_fail(fn, "tail call %%%u is not followed by a return of its value", id);
+          }
+        }
+      }
+    }
+  }
+  return errors;
+}
+
+int32_t ir_verify_function(const IrFunction *fn) {
+  int32_t errors = 0;
+  if (fn->block_count == 0 || (fn->blocks[0].flags & IR_BLOCK_DEAD)) {
+    errors += verify_fail(fn, "function has no entry block");
+    return errors;
+  }
+  if (fn->blocks[0].preds.count != 0) {
+    errors += verify_fail(fn, "entry block has predecessors");
+  }
+  errors += verify_preds(fn);
+  uint32_t *position = calloc(fn->inst_count ? fn->inst_count : 1, sizeof(uint32_t));
+  if (!position) {
+    LOG(FATAL, "out of memory");
+  }
+  errors += verify_structure(fn, position);
+  if (errors == 0) {
+    IrDomTree dom;
+    ir_dom_compute(&dom, fn);
+    errors += verify_operands(fn, &dom, position);
+    ir_dom_destroy(&dom);
+  }
+  free(position);
+  return errors;
+}
+
+int32_t ir_verify_module(const IrModule *module) {
+  int32_t errors = 0;
+  for (uint32_t i = 0; i < module->function_count; i++) {
+    errors += ir_verify_function(module->functions[i]);
+  }
+  return errors;
+}
@@ -0,0 +1,94 @@
+#include "opt/analysis.h"
+#include "utils/diagnostic.h"
+#include "utils/stats.h"
+#include "utils/timing.h"
+#include <string.h>
+
+void opt_analyses_init(OptAnalyses *analyses, IrFunction *fn, const OptOptions *options) {
+  memset(analyses, 0, sizeof(*analyses));
+  analyses->fn = fn;
+  analyses->options = options;
+}
+
+const IrDomTree *opt_analyses_dom(OptAnalyses *analyses) {
+  if (!(analyses->valid & OPT_ANALYSIS_DOM)) {
+    double start = timing_now();
+    ir_compute_preds(analyses->fn);
+    ir_dom_compute(&analyses->dom, analyses->fn);
+    analyses->valid |= OPT_ANALYSIS_DOM;
+    double elapsed = timing_now() - start;
+    timing_add("analysis: dom", elapsed);
+    analyses->seconds += elapsed;
+    stats_add("analysis.dom_computed", 1);
+  }
+#if defined(DEBUG)
+  if (analyses->dom.block_count != analyses->fn->block_count) {
+    LOG(FATAL, "stale dominator tree for %s", analyses->fn->name);
+  }
+#endif
+  return &analyses->dom;
+}
+
+const IrLoopInfo *opt_analyses_loops(OptAnalyses *analyses) {
+  if (!(analyses->valid & OPT_ANALYSIS_LOOPS)) {
+    const IrDomTree *dom = opt_analyses_dom(analyses);
+    double start = timing_now();
+    ir_loops_compute(&analyses->loops, analyses->fn, dom);
+    analyses->valid |= OPT_ANALYSIS_LOOPS;
+    double elapsed = timing_now() - start;
+    timing_add("analysis: loops", elapsed);
+    analyses->seconds += elapsed;
+    stats_add("analysis.loops_computed", 1);
+  }
+  return &analyses->loops;
+}
+
+const IrUses *opt_analyses_uses(OptAnalyses *analyses) {
+  if ((analyses->valid & OPT_ANALYSIS_USES) && analyses->uses.value_count != analyses->fn->inst_count) {
+    opt_analyses_invalidate(analyses, OPT_PRESERVE_CFG);
+  }
+  if (!(analyses->valid & OPT_ANALYSIS_USES)) {
+    double start = timing_now();
+    ir_uses_compute(&analyses->uses, analyses->fn);
+    analyses->valid |= OPT_ANALYSIS_USES;
+    double elapsed = timing_now() - start;
+    timing_add("analysis: uses", elapsed);
+    analyses->seconds += elapsed;
+    stats_add("analysis.uses_computed", 1);
+  }
+  return &analyses->uses;
+}
+
+const IrLoopInfo *opt_analyses_loops_with_preheaders(OptAnalyses *analyses) {
+  const IrLoopInfo *loops = opt_analyses_loops(analyses);
+  uint32_t block_count = analyses->fn->block_count;
+  for (uint32_t l = 0; l < loops->loop_count; l++) {
+    ir_loop_ensure_preheader(analyses->fn, loops, l);
+  }
+  if (analyses->fn->block_count != block_count) {
+    opt_analyses_invalidate(analyses, OPT_PRESERVE_NONE);
+    loops = opt_analyses_loops(analyses);
+  }
+  return loops;
+}
+
+void opt_analyses_invalidate(OptAnalyses *analyses, const uint32_t preserved) {
+  uint32_t dropped = analyses->valid & ~preserved;
+  if (dropped & OPT_ANALYSIS_DOM) {
+    dropped |= analyses->valid & OPT_ANALYSIS_LOOPS;
+  }
+  if (dropped & OPT_ANALYSIS_LOOPS) {
+    ir_loops_destroy(&analyses->loops);
+  }
+  if (dropped & OPT_ANALYSIS_DOM) {
+    ir_dom_destroy(&analyses->dom);
+  }
+  if (dropped & OPT_ANALYSIS_USES) {
+    ir_uses_destroy(&analyses->uses);
+  }
+  analyses->valid &= ~dropped;
+}
+
+void opt_analyses_destroy(OptAnalyses *analyses) {
+  opt_analyses_invalidate(analyses, OPT_PRESERVE_NONE);
+}
@@ -0,0 +1,170 @@
+#include "opt/dce.h"
+#include "utils/diagnostic.h"
+#include "utils/stats.h"
+#include <stdlib.h>
+
+#define DSE_MAX_PENDING 32
+
+typedef struct {
+  IrValueId addr;
+  IrValueId base;
+  int32_t offset;
+  int32_t exact;
+  uint8_t width;
+} PendingStore;
+
+static void *dce_calloc(const size_t count, const size_t size) {
+  void *ptr = calloc(count ? count : 1, size);
+  if (!ptr) {
+    LOG(FATAL, "out of memory");
+  }
+  return ptr;
+}
+
+static PendingStore dse_pending(const IrFunction *fn, const IrInst *inst) {
+  PendingStore store = {inst->ops[0], ir_address_base(fn, inst->ops[0]), 0, 0, inst->width};
+  if (store.base != IR_NONE) {
+    store.exact = ir_address_constant_offset(fn, inst->ops[0], &store.offset);
+  }
+  store.offset += inst->imm;
+  return store;
+}
+
+static int32_t dse_covers(const PendingStore *later, const PendingStore *earlier) {
+  if (later->width < earlier->width || later->offset != earlier->offset) {
+    return 0;
+  }
+  return later->addr == earlier->addr || (later->exact && earlier->exact && later->base == earlier->base);
+}
+
+static int32_t dce_inst_live(const IrInst *inst) {
+  return inst->op != IR_OP_NOP && inst->block != IR_NONE;
+}
+
+static uint32_t dse_unread_slots(IrFunction *fn) {
+  uint8_t *read = dce_calloc(fn->inst_count, 1);
+  for (uint32_t i = 0; i < fn->inst_count; i++) {
+    const IrInst *inst = &fn->insts[i];
+    if (!dce_inst_live(inst)) {
+      continue;
+    }
+    uint32_t count = ir_operand_count(fn, inst);
+    for (uint32_t k = 0; k < count; k++) {
+      IrValueId value = *ir_operand_slot(fn, inst, k);
+      if (value == IR_NONE || fn->insts[value].type != IR_TYPE_PTR) {
+        continue;
+      }
+      IrValueId base = ir_address_base(fn, value);
+      if (base == IR_NONE) {
+        continue;
+      }
+      int32_t derived = inst->op == IR_OP_ADD && inst->type == IR_TYPE_PTR;
+      int32_t store_addr = inst->op == IR_OP_STORE && k == 0;
+      if (!derived && !store_addr) {
+        read[base] = 1;
+      }
+    }
+  }
+  uint32_t removed = 0;
+  for (uint32_t i = 0; i < fn->inst_count; i++) {
+    const IrInst *inst = &fn->insts[i];
+    if (!dce_inst_live(inst) || inst->op != IR_OP_STORE) {
+      continue;
+    }
+    IrValueId base = ir_address_base(fn, inst->ops[0]);
+    if (base != IR_NONE && !read[base]) {
+      ir_inst_kill(fn, i);
+      removed++;
+    }
+  }
+  free(read);
+  return removed;
+}
+
+static uint32_t dse_overwritten(IrFunction *fn, const IrBlockId block) {
+  PendingStore pending[DSE_MAX_PENDING];
+  uint32_t pending_count = 0;
+  uint32_t removed = 0;
+  const IrIdVector *insts = &fn->blocks[block].insts;
+  for (uint32_t i = insts->count; i > 0; i--) {
+    IrValueId id = insts->items[i - 1];
+    IrInst *inst = &fn->insts[id];
+    if (inst->op == IR_OP_STORE) {
+      PendingStore store = dse_pending(fn, inst);
+      int32_t dead = 0;
+      for (uint32_t p = 0; p < pending_count; p++) {
+        if (dse_covers(&pending[p], &store)) {
+          dead = 1;
+          break;
+        }
+      }
+      if (dead) {
+        ir_inst_kill(fn, id);
+        removed++;
+      } else if (pending_count < DSE_MAX_PENDING) {
+        pending[pending_count++] = store;
+      }
+    } else if (inst->op == IR_OP_LOAD) {
+      IrValueId base = ir_address_base(fn, inst->ops[0]);
+      uint32_t out = 0;
+      for (uint32_t p = 0; p < pending_count; p++) {
+        if (base != IR_NONE && pending[p].base != IR_NONE && pending[p].base != base) {
+          pending[out++] = pending[p];
+        }
+      }
+      pending_count = out;
+    } else if (ir_op_flags(inst->op) & IR_OPF_READS_MEMORY) {
+      pending_count = 0;
+    }
+  }
+  return removed;
+}
+
+uint32_t opt_dead_stores(IrFunction *fn) {
+  uint32_t removed = dse_unread_slots(fn);
+  for (uint32_t b = 0; b < fn->block_count; b++) {
+    removed += dse_overwritten(fn, b);
+  }
+  ir_sweep(fn);
+  stats_add("dse.stores_removed", removed);
+  return removed;
+}
+
+uint32_t opt_dce(IrFunction *fn) {
+  uint8_t *live = dce_calloc(fn->inst_count, 1);
+  uint32_t *work = dce_calloc(fn->inst_count, sizeof(uint32_t));
+  uint32_t work_count = 0;
+  for (uint32_t i = 0; i < fn->inst_count; i++) {
+    const IrInst *inst = &fn->insts[i];
+    if (!dce_inst_live(inst)) {
+      continue;
+    }
+    if (ir_op_flags(inst->op) & (IR_OPF_SIDE_EFFECT | IR_OPF_TERMINATOR)) {
+      live[i] = 1;
+      work[work_count++] = i;
+    }
+  }
+  while (work_count > 0) {
+    const IrInst *inst = &fn->insts[work[--work_count]];
+    uint32_t count = ir_operand_count(fn, inst);
+    for (uint32_t k = 0; k < count; k++) {
+      IrValueId value = *ir_operand_slot(fn, inst, k);
+      if (value != IR_NONE && !live[value]) {
+        live[value] = 1;
+        work[work_count++] = value;
+      }
+    }
+  }
+  uint32_t removed = 0;
+  for (uint32_t i = 0; i < fn->inst_count; i++) {
+    if (!live[i] && dce_inst_live(&fn->insts[i])) {
+      ir_inst_kill(fn, i);
+      removed++;
+    }
+  }
+  free(live);
+  free(work);
+  ir_sweep(fn);
+  stats_add("dce.insts_removed", removed);
+  return removed;
+}
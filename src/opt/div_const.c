@@ -0,0 +1,229 @@
+#include "opt/div_const.h"
+#include "utils/stats.h"
+
+#define DIVC_NONNEG_DEPTH 4
+
+typedef struct {
+  IrFunction *fn;
+  IrBlockId block;
+  uint32_t position;
+} DivEmitter;
+
+static IrValueId divc_insert(DivEmitter *emit, const IrValueId id) {
+  ir_block_insert(emit->fn, emit->block, emit->position++, id);
+  return id;
+}
+
+static IrValueId divc_const(DivEmitter *emit, const int32_t value) {
+  IrValueId id = ir_inst_create(emit->fn, IR_OP_CONST, IR_TYPE_I32);
+  emit->fn->insts[id].imm = value;
+  return divc_insert(emit, id);
+}
+
+static IrValueId divc_binary(DivEmitter *emit, const IrOp op, const IrValueId a, const IrValueId b) {
+  IrValueId id = ir_inst_create(emit->fn, op, IR_TYPE_I32);
+  emit->fn->insts[id].ops[0] = a;
+  emit->fn->insts[id].ops[1] = b;
+  return divc_insert(emit, id);
+}
+
+static IrValueId divc_binary_imm(DivEmitter *emit, const IrOp op, const IrValueId a, const int32_t imm) {
+  return divc_binary(emit, op, a, divc_const(emit, imm));
+}
+
+static int32_t divc_log2(const uint32_t value) {
+  if (value == 0 || (value & (value - 1)) != 0) {
+    return -1;
+  }
+  int32_t k = 0;
+  while ((1u << k) != value) {
+    k++;
+  }
+  return k;
+}
+
+static int32_t divc_nonnegative(const IrFunction *fn, const IrValueId value, const int32_t depth) {
+  int32_t c;
+  if (ir_value_const(fn, value, &c)) {
+    return c >= 0;
+  }
+  const IrInst *inst = &fn->insts[value];
+  if (ir_op_flags(inst->op) & IR_OPF_COMPARE) {
+    return 1;
+  }
+  if (depth == 0) {
+    return 0;
+  }
+  switch (inst->op) {
+    case IR_OP_AND:
+      return divc_nonnegative(fn, inst->ops[0], depth - 1) || divc_nonnegative(fn, inst->ops[1], depth - 1);
+    case IR_OP_OR:
+      return divc_nonnegative(fn, inst->ops[0], depth - 1) && divc_nonnegative(fn, inst->ops[1], depth - 1);
+    case IR_OP_SHR:
+    case IR_OP_REM:
+      return divc_nonnegative(fn, inst->ops[0], depth - 1);
+    case IR_OP_SHRU:
+      return ir_value_const(fn, inst->ops[1], &c) && (c & 31) != 0;
+    case IR_OP_DIV:
+      return divc_nonnegative(fn, inst->ops[0], depth - 1) && ir_value_const(fn, inst->ops[1], &c) && c > 0;
+    default:
+      return 0;
+  }
+}
+
+static void divc_signed_magic(const int32_t d, int32_t *multiplier, int32_t *shift) {
+  const uint32_t two31 = 0x80000000u;
+  uint32_t ad = d < 0 ? 0u - (uint32_t) d : (uint32_t) d;
+  uint32_t t = two31 + ((uint32_t) d >> 31);
+  uint32_t anc = t - 1 - t % ad;
+  int32_t p = 31;
+  uint32_t q1 = two31 / anc;
+  uint32_t r1 = two31 - q1 * anc;
+  uint32_t q2 = two31 / ad;
+  uint32_t r2 = two31 - q2 * ad;
+  uint32_t delta;
+  do {
+    p++;
+    q1 *= 2;
+    r1 *= 2;
+    if (r1 >= anc) {
+      q1++;
+      r1 -= anc;
+    }
+    q2 *= 2;
+    r2 *= 2;
+    if (r2 >= ad) {
+      q2++;
+      r2 -= ad;
+    }
+    delta = ad - r2;
+  } while (q1 < delta || (q1 == delta && r1 == 0));
+  uint32_t m = q2 + 1;
+  *multiplier = (int32_t) (d < 0 ? 0u - m : m);
+  *shift = p - 32;
+}
+
+static void divc_unsigned_magic(const uint32_t d, uint32_t *multiplier, int32_t *shift) {
+  int32_t p = 32;
+  uint64_t m = ((1ull << p) + d - 1) / d;
+  while (m * d - (1ull << p) > (1ull << (p - 31))) {
+    p++;
+    m = ((1ull << p) + d - 1) / d;
+  }
+  *multiplier = (uint32_t) m;
+  *shift = p - 32;
+}
+
+static IrValueId divc_neg(DivEmitter *emit, const IrValueId value) {
+  IrValueId id = ir_inst_create(emit->fn, IR_OP_NEG, IR_TYPE_I32);
+  emit->fn->insts[id].ops[0] = value;
+  return divc_insert(emit, id);
+}
+
+static IrValueId divc_pow2_bias(DivEmitter *emit, const IrValueId n, const int32_t k) {
+  IrValueId sign = k == 1 ? n : divc_binary_imm(emit, IR_OP_SHR, n, k - 1);
+  IrValueId bias = divc_binary_imm(emit, IR_OP_SHRU, sign, 32 - k);
+  return divc_binary(emit, IR_OP_ADD, n, bias);
+}
+
+static IrValueId divc_quotient(DivEmitter *emit, const IrValueId n, const int32_t d, const int32_t nonneg) {
+  uint32_t ad = d < 0 ? 0u - (uint32_t) d : (uint32_t) d;
+  if (nonneg && d > 0) {
+    uint32_t m;
+    int32_t s;
+    divc_unsigned_magic(ad, &m, &s);
+    IrValueId q = divc_binary_imm(emit, IR_OP_MULHU, n, (int32_t) m);
+    return s > 0 ? divc_binary_imm(emit, IR_OP_SHRU, q, s) : q;
+  }
+  int32_t m;
+  int32_t s;
+  divc_signed_magic(d, &m, &s);
+  IrValueId q = divc_binary_imm(emit, IR_OP_MULH, n, m);
+  if (d > 0 && m < 0) {
+    q = divc_binary(emit, IR_OP_ADD, q, n);
+  } else if (d < 0 && m > 0) {
+    q = divc_binary(emit, IR_OP_SUB, q, n);
+  }
+  if (s > 0) {
+    q = divc_binary_imm(emit, IR_OP_SHR, q, s);
+  }
+  return divc_binary(emit, IR_OP_ADD, q, divc_binary_imm(emit, IR_OP_SHRU, q, 31));
+}
+
+static IrValueId divc_lower(DivEmitter *emit, const IrOp op, const IrValueId n, const int32_t d, const int32_t nonneg,
+                            const int32_t has_mul) {
+  if (d == 1 || d == -1) {
+    if (op == IR_OP_REM) {
+      return divc_const(emit, 0);
+    }
+    return d == 1 ? n : divc_neg(emit, n);
+  }
+  if (d == INT32_MIN) {
+    IrValueId q = divc_binary_imm(emit, IR_OP_EQ, n, INT32_MIN);
+    return op == IR_OP_DIV ? q : divc_binary(emit, IR_OP_SUB, n, divc_binary_imm(emit, IR_OP_SHL, q, 31));
+  }
+  uint32_t ad = d < 0 ? 0u - (uint32_t) d : (uint32_t) d;
+  int32_t k = divc_log2(ad);
+  if (k > 0) {
+    if (op == IR_OP_REM) {
+      if (nonneg) {
+        return divc_binary_imm(emit, IR_OP_AND, n, (int32_t) (ad - 1));
+      }
+      IrValueId rounded = divc_binary_imm(emit, IR_OP_AND, divc_pow2_bias(emit, n, k), (int32_t) (0u - ad));
+      return divc_binary(emit, IR_OP_SUB, n, rounded);
+    }
+    IrValueId q = divc_binary_imm(emit, IR_OP_SHR, nonneg ? n : divc_pow2_bias(emit, n, k), k);
+    return d < 0 ? divc_neg(emit, q) : q;
+  }
+  if (!has_mul) {
+    return IR_NONE;
+  }
+  IrValueId q = divc_quotient(emit, n, d, nonneg);
+  if (op == IR_OP_DIV) {
+    return q;
+  }
+  return divc_binary(emit, IR_OP_SUB, n, divc_binary_imm(emit, IR_OP_MUL, q, d));
+}
+
+uint32_t opt_div_const(IrFunction *fn, const int32_t has_mul) {
+  uint32_t divs = 0;
+  uint32_t rems = 0;
+  for (uint32_t b = 0; b < fn->block_count; b++) {
+    if (fn->blocks[b].flags & IR_BLOCK_DEAD) {
+      continue;
+    }
+    for (uint32_t i = 0; i < fn->blocks[b].insts.count; i++) {
+      IrValueId id = fn->blocks[b].insts.items[i];
+      IrInst *inst = &fn->insts[id];
+      int32_t d;
+      if ((inst->op != IR_OP_DIV && inst->op != IR_OP_REM) || !ir_value_const(fn, inst->ops[1], &d) || d == 0) {
+        continue;
+      }
+      IrOp op = (IrOp) inst->op;
+      IrValueId n = inst->ops[0];
+      DivEmitter emit = {fn, b, i};
+      IrValueId result = divc_lower(&emit, op, n, d, divc_nonnegative(fn, n, DIVC_NONNEG_DEPTH), has_mul);
+      if (result == IR_NONE) {
+        continue;
+      }
+      ir_replace_all_uses(fn, id, result);
+      ir_inst_kill(fn, id);
+      i = emit.position;
+      if (op == IR_OP_DIV) {
+        divs++;
+      } else {
+        rems++;
+      }
+    }
+  }
+  if (divs + rems > 0) {
+    ir_sweep(fn);
+  }
+  stats_add("divconst.divs_lowered", divs);
+  stats_add("divconst.rems_lowered", rems);
+  return divs + rems;
+}
+
+uint32_t opt_div_const_pass(IrFunction *fn, OptAnalyses *analyses) {
+  return opt_div_const(fn, analyses->options->target.ext_m);
+}
@@ -0,0 +1,306 @@
+#include "opt/gvn.h"
+#include "ir/ir_dom.h"
+#include "utils/diagnostic.h"
+#include "utils/stats.h"
+#include <stdlib.h>
+#include <string.h>
+
+#define GVN_MAX_MEMORY 32
+
+typedef struct {
+  IrValueId addr;
+  IrValueId base;
+  IrValueId value;
+  int32_t imm;
+  int32_t offset;
+  int32_t exact;
+  uint8_t width;
+  uint8_t type;
+} GvnMemoryEntry;
+
+typedef struct {
+  GvnMemoryEntry entries[GVN_MAX_MEMORY];
+  uint32_t count;
+} GvnMemory;
+
+typedef struct {
+  IrFunction *fn;
+  const IrDomTree *dom;
+  IrValueId *leader;
+  uint32_t *table;
+  uint32_t table_mask;
+  uint32_t *undo;
+  uint32_t undo_count;
+  uint32_t removed;
+  uint32_t loads_removed;
+} Gvn;
+
+static void *gvn_alloc(const size_t count, const size_t size) {
+  void *ptr = malloc((count ? count : 1) * size);
+  if (!ptr) {
+    LOG(FATAL, "out of memory");
+  }
+  return ptr;
+}
+
+static IrValueId gvn_leader(const Gvn *gvn, IrValueId value) {
+  while (value != IR_NONE && gvn->leader[value] != IR_NONE) {
+    value = gvn->leader[value];
+  }
+  return value;
+}
+
+static void gvn_replace(Gvn *gvn, const IrValueId id, const IrValueId with) {
+  gvn->leader[id] = with;
+  ir_inst_kill(gvn->fn, id);
+}
+
+static uint32_t gvn_hash(const IrInst *inst) {
+  uint32_t hash = 2166136261u;
+  uint32_t fields[6] = {inst->op, inst->type, inst->width, (uint32_t) inst->imm, inst->ops[0], inst->ops[1]};
+  for (uint32_t i = 0; i < 6; i++) {
+    hash = (hash ^ fields[i]) * 16777619u;
+  }
+  return hash;
+}
+
+static int32_t gvn_equal(const IrInst *a, const IrInst *b) {
+  return a->op == b->op && a->type == b->type && a->width == b->width && a->imm == b->imm &&
+         a->ops[0] == b->ops[0] && a->ops[1] == b->ops[1];
+}
+
+static int32_t gvn_is_expression(const IrInst *inst) {
+  uint32_t flags = ir_op_flags(inst->op);
+  return inst->op == IR_OP_CONST || (flags & (IR_OPF_BINARY | IR_OPF_UNARY));
+}
+
+static void gvn_canonicalize(IrInst *inst) {
+  if (inst->op == IR_OP_GT || inst->op == IR_OP_GE) {
+    inst->op = inst->op == IR_OP_GT ? IR_OP_LT : IR_OP_LE;
+  } else if (!(ir_op_flags(inst->op) & IR_OPF_COMMUTATIVE) || inst->type == IR_TYPE_PTR ||
+             inst->ops[0] <= inst->ops[1]) {
+    return;
+  }
+  uint32_t tmp = inst->ops[0];
+  inst->ops[0] = inst->ops[1];
+  inst->ops[1] = tmp;
+}
+
+static IrValueId gvn_simplify(const IrFunction *fn, const IrInst *inst) {
+  int32_t rhs;
+  if (!(ir_op_flags(inst->op) & IR_OPF_BINARY)) {
+    return IR_NONE;
+  }
+  if ((inst->op == IR_OP_AND || inst->op == IR_OP_OR) && inst->ops[0] == inst->ops[1]) {
+    return inst->ops[0];
+  }
+  IrValueId lhs = inst->ops[0];
+  if (!ir_value_const(fn, inst->ops[1], &rhs)) {
+    if (!(ir_op_flags(inst->op) & IR_OPF_COMMUTATIVE) || !ir_value_const(fn, inst->ops[0], &rhs)) {
+      return IR_NONE;
+    }
+    lhs = inst->ops[1];
+  }
+  switch (inst->op) {
+    case IR_OP_ADD:
+    case IR_OP_SUB:
+    case IR_OP_OR:
+    case IR_OP_XOR:
+    case IR_OP_SHL:
+    case IR_OP_SHR:
+    case IR_OP_SHRU:
+      return rhs == 0 ? lhs : IR_NONE;
+    case IR_OP_MUL:
+    case IR_OP_DIV:
+      return rhs == 1 ? lhs : IR_NONE;
+    case IR_OP_AND:
+      return rhs == -1 ? lhs : IR_NONE;
+    default:
+      return IR_NONE;
+  }
+}
+
+static IrValueId gvn_lookup_or_insert(Gvn *gvn, const IrValueId id) {
+  const IrInst *inst = &gvn->fn->insts[id];
+  uint32_t slot = gvn_hash(inst) & gvn->table_mask;
+  while (gvn->table[slot] != IR_NONE) {
+    if (gvn_equal(&gvn->fn->insts[gvn->table[slot]], inst)) {
+      return gvn->table[slot];
+    }
+    slot = (slot + 1) & gvn->table_mask;
+  }
+  gvn->table[slot] = id;
+  gvn->undo[gvn->undo_count++] = slot;
+  return IR_NONE;
+}
+
+static GvnMemoryEntry gvn_memory_entry(const IrFunction *fn, const IrInst *inst, const IrValueId value) {
+  GvnMemoryEntry entry;
+  entry.addr = inst->ops[0];
+  entry.base = ir_address_base(fn, inst->ops[0]);
+  entry.value = value;
+  entry.imm = inst->imm;
+  entry.exact = ir_address_constant_offset(fn, inst->ops[0], &entry.offset);
+  entry.offset += inst->imm;
+  entry.width = inst->width;
+  entry.type = fn->insts[value].type;
+  return entry;
+}
+
+static int32_t gvn_may_alias(const GvnMemoryEntry *a, const GvnMemoryEntry *b) {
+  if (a->base == IR_NONE || b->base == IR_NONE) {
+    return 1;
+  }
+  if (a->base != b->base) {
+    return 0;
+  }
+  if (!a->exact || !b->exact) {
+    return 1;
+  }
+  return a->offset < b->offset + b->width && b->offset < a->offset + a->width;
+}
+
+static void gvn_memory_add(GvnMemory *memory, const GvnMemoryEntry *entry) {
+  if (memory->count == GVN_MAX_MEMORY) {
+    memmove(memory->entries, memory->entries + 1, (GVN_MAX_MEMORY - 1) * sizeof(GvnMemoryEntry));
+    memory->count--;
+  }
+  memory->entries[memory->count++] = *entry;
+}
+
+static void gvn_visit_load(Gvn *gvn, GvnMemory *memory, const IrValueId id) {
+  const IrInst *inst = &gvn->fn->insts[id];
+  for (uint32_t i = memory->count; i > 0; i--) {
+    const GvnMemoryEntry *entry = &memory->entries[i - 1];
+    if (entry->addr == inst->ops[0] && entry->imm == inst->imm && entry->width == inst->width &&
+        entry->type == inst->type) {
+      gvn_replace(gvn, id, entry->value);
+      gvn->loads_removed++;
+      return;
+    }
+  }
+  GvnMemoryEntry entry = gvn_memory_entry(gvn->fn, inst, id);
+  gvn_memory_add(memory, &entry);
+}
+
+static void gvn_visit_store(Gvn *gvn, GvnMemory *memory, const IrValueId id) {
+  const IrInst *inst = &gvn->fn->insts[id];
+  GvnMemoryEntry store = gvn_memory_entry(gvn->fn, inst, inst->ops[1]);
+  uint32_t out = 0;
+  for (uint32_t i = 0; i < memory->count; i++) {
+    if (!gvn_may_alias(&memory->entries[i], &store)) {
+      memory->entries[out++] = memory->entries[i];
+    }
+  }
+  memory->count = out;
+  if (inst->width == 4) {
+    gvn_memory_add(memory, &store);
+  }
+}
+
+static void gvn_visit_phi(Gvn *gvn, const IrValueId id) {
+  const IrInst *inst = &gvn->fn->insts[id];
+  IrValueId same = IR_NONE;
+  for (uint32_t k = 0; k < inst->list_count; k++) {
+    IrValueId value = gvn_leader(gvn, gvn->fn->operands[inst->list + 2 * k + 1]);
+    if (value == id || value == same) {
+      continue;
+    }
+    if (same != IR_NONE) {
+      return;
+    }
+    same = value;
+  }
+  if (same != IR_NONE) {
+    gvn_replace(gvn, id, same);
+    gvn->removed++;
+  }
+}
+
+static void gvn_visit_block(Gvn *gvn, const IrBlockId block, GvnMemory *memory) {
+  IrFunction *fn = gvn->fn;
+  uint32_t undo_mark = gvn->undo_count;
+  const IrIdVector *insts = &fn->blocks[block].insts;
+  for (uint32_t i = 0; i < insts->count; i++) {
+    IrValueId id = insts->items[i];
+    IrInst *inst = &fn->insts[id];
+    if (inst->op == IR_OP_NOP) {
+      continue;
+    }
+    if (inst->op == IR_OP_PHI) {
+      gvn_visit_phi(gvn, id);
+      continue;
+    }
+    uint32_t count = ir_operand_count(fn, inst);
+    for (uint32_t k = 0; k < count; k++) {
+      uint32_t *slot = ir_operand_slot(fn, inst, k);
+      *slot = gvn_leader(gvn, *slot);
+    }
+    if (inst->op == IR_OP_COPY) {
+      gvn_replace(gvn, id, inst->ops[0]);
+      gvn->removed++;
+    } else if (gvn_is_expression(inst)) {
+      gvn_canonicalize(inst);
+      IrValueId existing = gvn_simplify(fn, inst);
+      if (existing == IR_NONE) {
+        existing = gvn_lookup_or_insert(gvn, id);
+      }
+      if (existing != IR_NONE) {
+        gvn_replace(gvn, id, existing);
+        gvn->removed++;
+      }
+    } else if (inst->op == IR_OP_LOAD) {
+      gvn_visit_load(gvn, memory, id);
+    } else if (inst->op == IR_OP_STORE) {
+      gvn_visit_store(gvn, memory, id);
+    } else if (inst->op == IR_OP_CALL && (fn->module->functions[inst->imm]->attrs & IR_FUNCTION_READONLY)) {
+      continue;
+    } else if (ir_op_flags(inst->op) & IR_OPF_SIDE_EFFECT) {
+      memory->count = 0;
+    }
+  }
+  for (uint32_t c = gvn->dom->child_start[block]; c < gvn->dom->child_start[block + 1]; c++) {
+    IrBlockId child = gvn->dom->children[c];
+    GvnMemory child_memory;
+    child_memory.count = 0;
+    const IrIdVector *preds = &fn->blocks[child].preds;
+    if (preds->count == 1 && preds->items[0] == block) {
+      child_memory = *memory;
+    }
+    gvn_visit_block(gvn, child, &child_memory);
+  }
+  while (gvn->undo_count > undo_mark) {
+    gvn->table[gvn->undo[--gvn->undo_count]] = IR_NONE;
+  }
+}
+
+uint32_t opt_gvn(IrFunction *fn, OptAnalyses *analyses) {
+  if (fn->block_count == 0) {
+    return 0;
+  }
+  Gvn gvn;
+  memset(&gvn, 0, sizeof(gvn));
+  gvn.fn = fn;
+  gvn.dom = opt_analyses_dom(analyses);
+  uint32_t capacity = 16;
+  while (capacity < fn->inst_count * 2) {
+    capacity *= 2;
+  }
+  gvn.table_mask = capacity - 1;
+  gvn.table = gvn_alloc(capacity, sizeof(uint32_t));
+  memset(gvn.table, 0xff, capacity * sizeof(uint32_t));
+  gvn.undo = gvn_alloc(fn->inst_count, sizeof(uint32_t));
+  gvn.leader = gvn_alloc(fn->inst_count, sizeof(IrValueId));
+  memset(gvn.leader, 0xff, fn->inst_count * sizeof(IrValueId));
+  GvnMemory memory;
+  memory.count = 0;
+  gvn_visit_block(&gvn, 0, &memory);
+  ir_rewrite_operands(fn, gvn.leader);
+  ir_sweep(fn);
+  stats_add("gvn.insts_removed", gvn.removed);
+  stats_add("gvn.loads_removed", gvn.loads_removed);
+  free(gvn.table);
+  free(gvn.undo);
+  free(gvn.leader);
+  return gvn.removed + gvn.loads_removed;
+}
@@ -0,0 +1,271 @@
+#include "opt/inline.h"
+#include "ir/ir_callgraph.h"
+#include "utils/diagnostic.h"
+#include "utils/stats.h"
+#include <stdlib.h>
+#include <string.h>
+
+#define INLINE_CALL_OVERHEAD 4
+#define INLINE_CONST_ARG_BONUS 3
+
+typedef struct {
+  IrModule *module;
+  IrCallGraph graph;
+  int32_t limit;
+  uint32_t *size;
+  uint32_t *call_sites;
+  uint32_t module_size;
+  uint32_t module_budget;
+  uint32_t inlined;
+} Inliner;
+
+static uint32_t *inline_alloc(const uint32_t count) {
+  uint32_t *ptr = malloc((count ? count : 1) * sizeof(uint32_t));
+  if (!ptr) {
+    LOG(FATAL, "out of memory");
+  }
+  return ptr;
+}
+
+static uint32_t inline_function_size(const IrFunction *fn) {
+  uint32_t size = 0;
+  for (uint32_t b = 0; b < fn->block_count; b++) {
+    const IrIdVector *insts = &fn->blocks[b].insts;
+    for (uint32_t i = 0; i < insts->count; i++) {
+      uint8_t op = fn->insts[insts->items[i]].op;
+      if (op != IR_OP_NOP && op != IR_OP_PARAM && op != IR_OP_ALLOCA && op != IR_OP_PHI) {
+        size++;
+      }
+    }
+  }
+  return size;
+}
+
+static int32_t inline_should_inline(const Inliner *inliner, const IrFunction *caller, const IrInst *call,
+                                    const uint32_t caller_budget) {
+  uint32_t callee = (uint32_t) call->imm;
+  if (callee == (uint32_t) caller->index || inliner->graph.recursive[callee] ||
+      inliner->graph.scc[callee] == inliner->graph.scc[caller->index]) {
+    return 0;
+  }
+  const IrFunction *target = inliner->module->functions[callee];
+  if (target->block_count == 0) {
+    return 0;
+  }
+  int32_t cost = (int32_t) inliner->size[callee];
+  int32_t bonus = INLINE_CALL_OVERHEAD + (int32_t) call->list_count;
+  for (uint32_t a = 0; a < call->list_count; a++) {
+    if (caller->insts[caller->operands[call->list + a]].op == IR_OP_CONST) {
+      bonus += INLINE_CONST_ARG_BONUS;
+    }
+  }
+  int32_t threshold = inliner->limit + bonus;
+  if (inliner->call_sites[callee] == 1) {
+    threshold = inliner->limit * 4 + bonus;
+  }
+  if (cost > threshold) {
+    return 0;
+  }
+  if (inliner->size[caller->index] + (uint32_t) cost > caller_budget) {
+    return 0;
+  }
+  return inliner->module_size + (uint32_t) cost <= inliner->module_budget;
+}
+
+static IrBlockId inline_split_block(IrFunction *fn, const IrBlockId block, const uint32_t position) {
+  IrBlockId rest = ir_block_create(fn);
+  IrIdVector *insts = &fn->blocks[block].insts;
+  for (uint32_t i = position + 1; i < insts->count; i++) {
+    ir_block_append(fn, rest, insts->items[i]);
+    insts = &fn->blocks[block].insts;
+  }
+  insts->count = position;
+  IrBlockId succs[2];
+  uint32_t count = ir_block_succs(fn, rest, succs);
+  for (uint32_t s = 0; s < count; s++) {
+    ir_phis_rename_pred(fn, succs[s], block, rest);
+  }
+  return rest;
+}
+
+static IrValueId inline_map_value(const IrValueId *value_map, const IrValueId value) {
+  return value == IR_NONE ? IR_NONE : value_map[value];
+}
+
+static void inline_call(Inliner *inliner, IrFunction *fn, const IrBlockId block, const uint32_t position) {
+  IrValueId call = fn->blocks[block].insts.items[position];
+  const IrFunction *callee = inliner->module->functions[fn->insts[call].imm];
+  IrBlockId rest = inline_split_block(fn, block, position);
+
+  IrBlockId *block_map = inline_alloc(callee->block_count);
+  for (uint32_t b = 0; b < callee->block_count; b++) {
+    block_map[b] = ir_block_create(fn);
+  }
+  uint32_t *frame_map = inline_alloc(callee->frame_count);
+  for (uint32_t f = 0; f < callee->frame_count; f++) {
+    const IrFrameObject *object = &callee->frame[f];
+    frame_map[f] = (uint32_t) ir_frame_object_create(fn, object->name, object->size, object->align,
+                                                     object->elem_width, object->flags);
+  }
+  IrValueId *value_map = inline_alloc(callee->inst_count);
+  for (uint32_t i = 0; i < callee->inst_count; i++) {
+    value_map[i] = IR_NONE;
+  }
+  uint32_t ret_count = 0;
+  for (uint32_t b = 0; b < callee->block_count; b++) {
+    const IrIdVector *insts = &callee->blocks[b].insts;
+    for (uint32_t i = 0; i < insts->count; i++) {
+      IrValueId id = insts->items[i];
+      const IrInst *inst = &callee->insts[id];
+      if (inst->op == IR_OP_NOP) {
+        continue;
+      }
+      if (inst->op == IR_OP_PARAM) {
+        value_map[id] = fn->operands[fn->insts[call].list + (uint32_t) inst->imm];
+        continue;
+      }
+      if (inst->op == IR_OP_RET) {
+        ret_count++;
+      }
+      value_map[id] = ir_inst_create(fn, (IrOp) inst->op, (IrType) inst->type);
+    }
+  }
+  IrValueId result = IR_NONE;
+  IrType result_type = (IrType) fn->insts[call].type;
+  if (ret_count > 1 && result_type != IR_TYPE_VOID) {
+    result = ir_inst_create(fn, IR_OP_PHI, result_type);
+    ir_block_insert(fn, rest, 0, result);
+  }
+  for (uint32_t b = 0; b < callee->block_count; b++) {
+    const IrIdVector *insts = &callee->blocks[b].insts;
+    for (uint32_t i = 0; i < insts->count; i++) {
+      IrValueId id = insts->items[i];
+      const IrInst *inst = &callee->insts[id];
+      if (inst->op == IR_OP_NOP || inst->op == IR_OP_PARAM) {
+        continue;
+      }
+      IrValueId copy = value_map[id];
+      IrInst *out = &fn->insts[copy];
+      out->width = inst->width;
+      out->flags = inst->flags & (uint8_t) ~IR_INST_TAIL;
+      out->imm = inst->imm;
+      switch (inst->op) {
+        case IR_OP_ALLOCA:
+          out->imm = (int32_t) frame_map[inst->imm];
+          ir_block_insert_before_terminator(fn, 0, copy);
+          continue;
+        case IR_OP_JUMP:
+          out->ops[0] = block_map[inst->ops[0]];
+          break;
+        case IR_OP_BRANCH:
+          out->ops[0] = value_map[inst->ops[0]];
+          out->ops[1] = block_map[inst->ops[1]];
+          out->ops[2] = block_map[inst->ops[2]];
+          break;
+        case IR_OP_RET: {
+          IrValueId value = inline_map_value(value_map, inst->ops[0]);
+          if (result_type != IR_TYPE_VOID && value == IR_NONE) {
+            value = ir_emit_const(fn, block_map[b], 0);
+          }
+          if (result != IR_NONE) {
+            ir_phi_add_incoming(fn, result, block_map[b], value);
+          } else if (result_type != IR_TYPE_VOID) {
+            result = value;
+          }
+          out = &fn->insts[copy];
+          out->op = IR_OP_JUMP;
+          out->type = IR_TYPE_VOID;
+          out->ops[0] = rest;
+          break;
+        }
+        case IR_OP_PHI: {
+          for (uint32_t k = 0; k < inst->list_count; k++) {
+            ir_phi_add_incoming(fn, copy, block_map[callee->operands[inst->list + 2 * k]],
+                                value_map[callee->operands[inst->list + 2 * k + 1]]);
+          }
+          break;
+        }
+        case IR_OP_CALL: {
+          uint32_t *args = inline_alloc(inst->list_count);
+          for (uint32_t k = 0; k < inst->list_count; k++) {
+            args[k] = value_map[callee->operands[inst->list + k]];
+          }
+          ir_inst_set_list(fn, copy, args, inst->list_count);
+          free(args);
+          inliner->call_sites[inst->imm]++;
+          break;
+        }
+        default:
+          for (uint32_t k = 0; k < 3; k++) {
+            fn->insts[copy].ops[k] = inline_map_value(value_map, inst->ops[k]);
+          }
+          break;
+      }
+      ir_block_append(fn, block_map[b], copy);
+    }
+  }
+  if (result == IR_NONE && result_type != IR_TYPE_VOID) {
+    result = ir_inst_create(fn, IR_OP_CONST, IR_TYPE_I32);
+    ir_block_insert(fn, rest, 0, result);
+  }
+  IrValueId jump = ir_inst_create(fn, IR_OP_JUMP, IR_TYPE_VOID);
+  fn->insts[jump].ops[0] = block_map[0];
+  ir_block_append(fn, block, jump);
+  if (result != IR_NONE) {
+    ir_replace_all_uses(fn, call, result);
+  }
+  inliner->call_sites[fn->insts[call].imm]--;
+  ir_inst_kill(fn, call);
+  fn->insts[call].block = IR_NONE;
+  free(block_map);
+  free(frame_map);
+  free(value_map);
+  ir_compute_preds(fn);
+}
+
+static void inline_into(Inliner *inliner, IrFunction *fn) {
+  uint32_t original = inliner->size[fn->index];
+  uint32_t caller_budget = original + (original > (uint32_t) inliner->limit * 4 ? original : (uint32_t) inliner->limit * 4);
+  for (uint32_t b = 0; b < fn->block_count; b++) {
+    for (uint32_t i = 0; i < fn->blocks[b].insts.count; i++) {
+      IrValueId id = fn->blocks[b].insts.items[i];
+      if (fn->insts[id].op != IR_OP_CALL || !inline_should_inline(inliner, fn, &fn->insts[id], caller_budget)) {
+        continue;
+      }
+      uint32_t callee = (uint32_t) fn->insts[id].imm;
+      inline_call(inliner, fn, b, i);
+      uint32_t growth = inliner->size[callee];
+      inliner->size[fn->index] += growth;
+      inliner->module_size += growth;
+      inliner->inlined++;
+      break;
+    }
+  }
+}
+
+uint32_t opt_inline_module(IrModule *module, const int32_t limit) {
+  if (limit <= 0 || module->function_count == 0) {
+    return 0;
+  }
+  Inliner inliner;
+  memset(&inliner, 0, sizeof(inliner));
+  inliner.module = module;
+  inliner.limit = limit;
+  ir_callgraph_compute(&inliner.graph, module);
+  inliner.size = inline_alloc(module->function_count);
+  inliner.call_sites = inline_alloc(module->function_count);
+  for (uint32_t f = 0; f < module->function_count; f++) {
+    inliner.size[f] = inline_function_size(module->functions[f]);
+    inliner.call_sites[f] = inliner.graph.call_sites[f];
+    inliner.module_size += inliner.size[f];
+  }
+  inliner.module_budget = inliner.module_size + inliner.module_size / 2 + (uint32_t) limit * 4;
+  for (uint32_t i = 0; i < module->function_count; i++) {
+    inline_into(&inliner, module->functions[inliner.graph.bottom_up[i]]);
+  }
+  stats_add("inline.calls_inlined", inliner.inlined);
+  free(inliner.size);
+  free(inliner.call_sites);
+  ir_callgraph_destroy(&inliner.graph);
+  return inliner.inlined;
+}
@@ -0,0 +1,138 @@
+#include "opt/ipo.h"
+#include "ir/ir_callgraph.h"
+#include "ir/ir_interp.h"
+#include "utils/diagnostic.h"
+#include "utils/stats.h"
+#include <stdlib.h>
+#include <string.h>
+
+static uint32_t *ipo_alloc(const uint32_t count) {
+  uint32_t *ptr = malloc((count ? count : 1) * sizeof(uint32_t));
+  if (!ptr) {
+    LOG(FATAL, "out of memory");
+  }
+  return ptr;
+}
+
+static int32_t ipo_constant_args(const IrFunction *fn, const IrInst *call, int32_t *args) {
+  for (uint32_t a = 0; a < call->list_count; a++) {
+    if (!ir_value_const(fn, fn->operands[call->list + a], &args[a])) {
+      return 0;
+    }
+  }
+  return 1;
+}
+
+static int32_t ipo_find_main(const IrModule *module) {
+  for (uint32_t f = 0; f < module->function_count; f++) {
+    if (strcmp(module->functions[f]->name, "main") == 0) {
+      return (int32_t) f;
+    }
+  }
+  return -1;
+}
+
+uint32_t opt_fold_pure_calls(IrModule *module, const int32_t whole_program) {
+  if (!whole_program || module->function_count == 0) {
+    return 0;
+  }
+  IrCallGraph graph;
+  ir_callgraph_compute(&graph, module);
+  ir_callgraph_infer_attrs(&graph, module);
+  ir_callgraph_destroy(&graph);
+  uint32_t max_params = 1;
+  for (uint32_t f = 0; f < module->function_count; f++) {
+    if ((uint32_t) module->functions[f]->param_count > max_params) {
+      max_params = (uint32_t) module->functions[f]->param_count;
+    }
+  }
+  int32_t *args = (int32_t *) ipo_alloc(max_params);
+  uint64_t budget = OPT_IPO_EVAL_BUDGET;
+  uint32_t folded = 0;
+  for (uint32_t f = 0; f < module->function_count && budget > 0; f++) {
+    IrFunction *fn = module->functions[f];
+    for (uint32_t i = 0; i < fn->inst_count && budget > 0; i++) {
+      IrInst *inst = &fn->insts[i];
+      if (inst->op != IR_OP_CALL || inst->block == IR_NONE) {
+        continue;
+      }
+      const IrFunction *callee = module->functions[inst->imm];
+      if (!(callee->attrs & IR_FUNCTION_PURE) || !ipo_constant_args(fn, inst, args)) {
+        continue;
+      }
+      uint64_t limit = budget < OPT_IPO_EVAL_STEP_LIMIT ? budget : OPT_IPO_EVAL_STEP_LIMIT;
+      IrInterpResult result = ir_interp_run(module, inst->imm, args, inst->list_count, limit);
+      budget -= result.steps < budget ? result.steps : budget;
+      if (result.status != IR_INTERP_OK) {
+        continue;
+      }
+      if (inst->type == IR_TYPE_VOID) {
+        ir_inst_kill(fn, i);
+      } else {
+        ir_inst_make_const(fn, i, result.value);
+      }
+      folded++;
+    }
+  }
+  free(args);
+  stats_add("ipo.calls_folded", folded);
+  return folded;
+}
+
+uint32_t opt_global_dce(IrModule *module, const int32_t whole_program) {
+  int32_t main_index = ipo_find_main(module);
+  if (!whole_program || main_index < 0) {
+    return 0;
+  }
+  uint32_t n = module->function_count;
+  IrCallGraph graph;
+  ir_callgraph_compute(&graph, module);
+  uint32_t *remap = ipo_alloc(n);
+  uint32_t *stack = ipo_alloc(n);
+  for (uint32_t f = 0; f < n; f++) {
+    remap[f] = IR_NONE;
+  }
+  uint32_t count = 0;
+  remap[main_index] = 0;
+  stack[count++] = (uint32_t) main_index;
+  while (count > 0) {
+    uint32_t f = stack[--count];
+    for (uint32_t e = graph.edge_start[f]; e < graph.edge_start[f + 1]; e++) {
+      uint32_t callee = graph.edges[e];
+      if (remap[callee] == IR_NONE) {
+        remap[callee] = 0;
+        stack[count++] = callee;
+      }
+    }
+  }
+  ir_callgraph_destroy(&graph);
+  uint32_t kept = 0;
+  for (uint32_t f = 0; f < n; f++) {
+    if (remap[f] != IR_NONE) {
+      remap[f] = kept;
+      module->functions[kept] = module->functions[f];
+      module->functions[kept]->index = (int32_t) kept;
+      kept++;
+    }
+  }
+  uint32_t removed = n - kept;
+  module->function_count = kept;
+  for (uint32_t f = 0; removed > 0 && f < kept; f++) {
+    IrFunction *fn = module->functions[f];
+    for (uint32_t i = 0; i < fn->inst_count; i++) {
+      IrInst *inst = &fn->insts[i];
+      if (inst->op != IR_OP_CALL) {
+        continue;
+      }
+      if (remap[inst->imm] == IR_NONE) {
+        ir_inst_kill(fn, i);
+      } else {
+        inst->imm = (int32_t) remap[inst->imm];
+      }
+    }
+  }
+  free(remap);
+  free(stack);
+  stats_add("ipo.functions_removed", removed);
+  return removed;
+}
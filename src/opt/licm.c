@@ -0,0 +1,165 @@
+#include "opt/licm.h"
+#include "ir/ir_dom.h"
+#include "ir/ir_loop.h"
+#include "utils/diagnostic.h"
+#include "utils/stats.h"
+#include <stdlib.h>
+
+typedef struct {
+  IrValueId base;
+  int32_t offset;
+  int32_t exact;
+  uint8_t width;
+} LicmAccess;
+
+typedef struct {
+  IrFunction *fn;
+  const IrDomTree *dom;
+  const IrLoopInfo *loops;
+  LicmAccess *stores;
+  uint32_t store_count;
+  int32_t has_call;
+} Licm;
+
+static int32_t licm_defined_outside(const Licm *licm, const uint32_t loop, const IrValueId value) {
+  return value == IR_NONE || !ir_loop_contains(licm->loops, loop, licm->fn->insts[value].block);
+}
+
+static LicmAccess licm_access(const IrFunction *fn, const IrInst *inst) {
+  LicmAccess access;
+  access.base = ir_address_base(fn, inst->ops[0]);
+  access.exact = ir_address_constant_offset(fn, inst->ops[0], &access.offset);
+  access.offset += inst->imm;
+  access.width = inst->width;
+  return access;
+}
+
+static int32_t licm_may_alias(const LicmAccess *a, const LicmAccess *b) {
+  if (a->base == IR_NONE || b->base == IR_NONE) {
+    return 1;
+  }
+  if (a->base != b->base) {
+    return 0;
+  }
+  if (!a->exact || !b->exact) {
+    return 1;
+  }
+  return a->offset < b->offset + b->width && b->offset < a->offset + a->width;
+}
+
+static void licm_collect_memory(Licm *licm, const uint32_t loop) {
+  const IrFunction *fn = licm->fn;
+  const IrLoop *data = &licm->loops->loops[loop];
+  licm->store_count = 0;
+  licm->has_call = 0;
+  for (uint32_t i = 0; i < data->block_count; i++) {
+    const IrIdVector *insts = &fn->blocks[licm->loops->blocks[data->block_start + i]].insts;
+    for (uint32_t k = 0; k < insts->count; k++) {
+      const IrInst *inst = &fn->insts[insts->items[k]];
+      if (inst->op == IR_OP_STORE) {
+        licm->stores[licm->store_count++] = licm_access(fn, inst);
+      } else if (inst->op == IR_OP_CALL) {
+        licm->has_call = 1;
+      }
+    }
+  }
+}
+
+static int32_t licm_load_is_safe(const Licm *licm, const IrInst *inst) {
+  if (licm->has_call) {
+    return 0;
+  }
+  const IrFunction *fn = licm->fn;
+  LicmAccess access = licm_access(fn, inst);
+  if (access.base == IR_NONE || !access.exact) {
+    return 0;
+  }
+  const IrFrameObject *object = &fn->frame[fn->insts[access.base].imm];
+  if (access.offset < 0 || access.offset + access.width > object->size) {
+    return 0;
+  }
+  for (uint32_t i = 0; i < licm->store_count; i++) {
+    if (licm_may_alias(&licm->stores[i], &access)) {
+      return 0;
+    }
+  }
+  return 1;
+}
+
+static int32_t licm_can_hoist(const Licm *licm, const uint32_t loop, const IrInst *inst) {
+  uint32_t flags = ir_op_flags(inst->op);
+  int32_t expression = inst->op == IR_OP_CONST || (flags & (IR_OPF_BINARY | IR_OPF_UNARY));
+  if (!expression && inst->op != IR_OP_LOAD) {
+    return 0;
+  }
+  uint32_t count = ir_operand_count(licm->fn, inst);
+  for (uint32_t k = 0; k < count; k++) {
+    if (!licm_defined_outside(licm, loop, *ir_operand_slot(licm->fn, inst, k))) {
+      return 0;
+    }
+  }
+  return inst->op != IR_OP_LOAD || licm_load_is_safe(licm, inst);
+}
+
+static uint32_t licm_hoist_loop(Licm *licm, const uint32_t loop, const IrBlockId preheader) {
+  IrFunction *fn = licm->fn;
+  licm_collect_memory(licm, loop);
+  uint32_t hoisted = 0;
+  for (uint32_t r = 0; r < licm->dom->rpo_count; r++) {
+    IrBlockId block = licm->dom->rpo[r];
+    if (!ir_loop_contains(licm->loops, loop, block)) {
+      continue;
+    }
+    IrIdVector *insts = &fn->blocks[block].insts;
+    uint32_t out = 0;
+    for (uint32_t i = 0; i < insts->count; i++) {
+      IrValueId id = insts->items[i];
+      if (fn->insts[id].op != IR_OP_NOP && licm_can_hoist(licm, loop, &fn->insts[id])) {
+        ir_block_insert_before_terminator(fn, preheader, id);
+        hoisted++;
+        continue;
+      }
+      insts->items[out++] = id;
+    }
+    insts->count = out;
+  }
+  return hoisted;
+}
+
+uint32_t opt_licm(IrFunction *fn, OptAnalyses *analyses) {
+  if (fn->block_count == 0) {
+    return 0;
+  }
+  Licm licm;
+  licm.fn = fn;
+  licm.loops = opt_analyses_loops_with_preheaders(analyses);
+  if (licm.loops->loop_count == 0) {
+    return 0;
+  }
+  licm.dom = opt_analyses_dom(analyses);
+  licm.stores = malloc((fn->inst_count ? fn->inst_count : 1) * sizeof(LicmAccess));
+  if (!licm.stores) {
+    LOG(FATAL, "out of memory");
+  }
+  uint32_t max_depth = 0;
+  for (uint32_t l = 0; l < licm.loops->loop_count; l++) {
+    if (licm.loops->loops[l].depth > max_depth) {
+      max_depth = licm.loops->loops[l].depth;
+    }
+  }
+  uint32_t hoisted = 0;
+  for (uint32_t depth = max_depth; depth > 0; depth--) {
+    for (uint32_t l = 0; l < licm.loops->loop_count; l++) {
+      if (licm.loops->loops[l].depth != depth) {
+        continue;
+      }
+      IrBlockId preheader = ir_loop_preheader(fn, licm.loops, l);
+      if (preheader != IR_NONE) {
+        hoisted += licm_hoist_loop(&licm, l, preheader);
+      }
+    }
+  }
+  free(licm.stores);
+  stats_add("licm.insts_hoisted", hoisted);
+  return hoisted;
+}
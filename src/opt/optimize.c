@@ -0,0 +1,44 @@
+#include "opt/optimize.h"
+#include "opt/inline.h"
+#include "opt/pass_manager.h"
+#include "utils/stats.h"
+
+static const char *const opt_pipelines[] = {
+  "",
+  "sccp,purecall,globaldce,sccp,sroa,tailrec,divconst,dse,dce,simplifycfg,dce,tailcall",
+  "sccp,dce,simplifycfg,tailrec,purecall,inline,sccp,purecall,globaldce,"
+  "gvn,sccp,dce,sroa,tailrec,licm,gvn,sccp,ivsr,divconst,dse,dce,simplifycfg,dce,tailcall"
+};
+
+void opt_options_init(OptOptions *options, const int32_t level) {
+  options->level = level;
+  options->inline_limit = OPT_INLINE_DEFAULT_LIMIT;
+  options->whole_program = 0;
+  target_init(&options->target);
+  options->pipeline = NULL;
+}
+
+const char *opt_default_pipeline(const int32_t level) {
+  if (level <= 0) {
+    return opt_pipelines[0];
+  }
+  return opt_pipelines[level >= 2 ? 2 : 1];
+}
+
+void opt_optimize_module(IrModule *module, const OptOptions *options) {
+  const char *pipeline = options->pipeline ? options->pipeline : opt_default_pipeline(options->level);
+  if (pipeline[0] == '\0') {
+    return;
+  }
+  for (uint32_t i = 0; i < module->function_count; i++) {
+    IrFunction *fn = module->functions[i];
+    stats_add("ir.insts_before_opt", ir_live_inst_count(fn));
+    stats_add("ir.blocks_before_opt", fn->block_count);
+  }
+  opt_pipeline_run(module, pipeline, options);
+  for (uint32_t i = 0; i < module->function_count; i++) {
+    IrFunction *fn = module->functions[i];
+    stats_add("ir.insts_after_opt", ir_live_inst_count(fn));
+    stats_add("ir.blocks_after_opt", fn->block_count);
+  }
+}
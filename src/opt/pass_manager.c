@@ -0,0 +1,159 @@
+#include "opt/pass_manager.h"
+#include "opt/analysis.h"
+#include "opt/dce.h"
+#include "opt/div_const.h"
+#include "opt/gvn.h"
+#include "opt/inline.h"
+#include "opt/ipo.h"
+#include "opt/licm.h"
+#include "opt/sccp.h"
+#include "opt/simplify_cfg.h"
+#include "opt/sroa.h"
+#include "opt/strength_reduce.h"
+#include "opt/tail_call.h"
+#include "ir/ir_verify.h"
+#include "utils/diagnostic.h"
+#include "utils/timing.h"
+#include <string.h>
+
+#define OPT_PIPELINE_MAX_PASSES 128
+
+typedef enum {
+  OPT_PASS_FUNCTION,
+  OPT_PASS_ANALYSIS,
+  OPT_PASS_MODULE
+} OptPassKind;
+
+typedef struct {
+  const char *name;
+  OptPassKind kind;
+  uint32_t (*run_function)(IrFunction *fn);
+  uint32_t (*run_analysis)(IrFunction *fn, OptAnalyses *analyses);
+  uint32_t (*run_module)(IrModule *module, const OptOptions *options);
+  uint32_t preserves;
+} OptPassInfo;
+
+typedef struct {
+  const OptPassInfo *passes[OPT_PIPELINE_MAX_PASSES];
+  uint32_t count;
+} OptPipeline;
+
+static uint32_t opt_inline_pass(IrModule *module, const OptOptions *options) {
+  return opt_inline_module(module, options->inline_limit);
+}
+
+static uint32_t opt_pure_call_pass(IrModule *module, const OptOptions *options) {
+  return opt_fold_pure_calls(module, options->whole_program);
+}
+
+static uint32_t opt_global_dce_pass(IrModule *module, const OptOptions *options) {
+  return opt_global_dce(module, options->whole_program);
+}
+
+static const OptPassInfo opt_passes[] = {
+#define OPT_FUNCTION_PASS(text, run, preserves) {text, OPT_PASS_FUNCTION, run, NULL, NULL, preserves},
+#define OPT_ANALYSIS_PASS(text, run, preserves) {text, OPT_PASS_ANALYSIS, NULL, run, NULL, preserves},
+#define OPT_MODULE_PASS(text, run) {text, OPT_PASS_MODULE, NULL, NULL, run, OPT_PRESERVE_NONE},
+#include "opt/passes.def"
+};
+
+static const OptPassInfo *opt_pass_find(const char *name, const size_t length) {
+  for (size_t i = 0; i < sizeof(opt_passes) / sizeof(opt_passes[0]); i++) {
+    if (strlen(opt_passes[i].name) == length && strncmp(opt_passes[i].name, name, length) == 0) {
+      return &opt_passes[i];
+    }
+  }
+  return NULL;
+}
+
+static int32_t opt_pipeline_parse(OptPipeline *pipeline, const char *text) {
+  pipeline->count = 0;
+  const char *cursor = text;
+  while (*cursor) {
+    if (*cursor == ',' || *cursor == ' ') {
+      cursor++;
+      continue;
+    }
+    const char *start = cursor;
+    while (*cursor && *cursor != ',' && *cursor != ' ') {
+      cursor++;
+    }
+    const OptPassInfo *info = opt_pass_find(start, (size_t) (cursor - start));
+    if (!info) {
+      LOG(ERROR, "unknown optimization pass '%.*s'", (int) (cursor - start), start);
+      return 0;
+    }
+    if (pipeline->count == OPT_PIPELINE_MAX_PASSES) {
+      LOG(ERROR, "optimization pipeline has more than %d passes", OPT_PIPELINE_MAX_PASSES);
+      return 0;
+    }
+    pipeline->passes[pipeline->count++] = info;
+  }
+  return 1;
+}
+
+static void opt_verify_function(const IrFunction *fn, const char *name) {
+#if defined(DEBUG)
+  if (ir_verify_function(fn) != 0) {
+    LOG(FATAL, "IR verification failed after %s on %s", name, fn->name);
+  }
+#else
+  (void) fn;
+  (void) name;
+#endif
+}
+
+static void opt_run_function_passes(IrModule *module, const OptPipeline *pipeline, const uint32_t first,
+                                    const uint32_t last, const OptOptions *options) {
+  for (uint32_t f = 0; f < module->function_count; f++) {
+    IrFunction *fn = module->functions[f];
+    OptAnalyses analyses;
+    opt_analyses_init(&analyses, fn, options);
+    for (uint32_t p = first; p < last; p++) {
+      const OptPassInfo *info = pipeline->passes[p];
+      double start = timing_now();
+      double analysis_start = analyses.seconds;
+      uint32_t changed = info->kind == OPT_PASS_ANALYSIS ? info->run_analysis(fn, &analyses) : info->run_function(fn);
+      timing_add(info->name, timing_now() - start - (analyses.seconds - analysis_start));
+      if (changed) {
+        opt_analyses_invalidate(&analyses, info->preserves);
+      }
+      opt_verify_function(fn, info->name);
+    }
+    opt_analyses_destroy(&analyses);
+  }
+}
+
+int32_t opt_pipeline_validate(const char *pipeline) {
+  OptPipeline parsed;
+  return opt_pipeline_parse(&parsed, pipeline);
+}
+
+void opt_pipeline_run(IrModule *module, const char *pipeline, const OptOptions *options) {
+  OptPipeline parsed;
+  if (!opt_pipeline_parse(&parsed, pipeline)) {
+    return;
+  }
+  uint32_t p = 0;
+  while (p < parsed.count) {
+    const OptPassInfo *info = parsed.passes[p];
+    if (info->kind == OPT_PASS_MODULE) {
+      double start = timing_now();
+      info->run_module(module, options);
+      timing_add(info->name, timing_now() - start);
+#if defined(DEBUG)
+      if (ir_verify_module(module) != 0) {
+        LOG(FATAL, "IR verification failed after %s", info->name);
+      }
+#endif
+      p++;
+      continue;
+    }
+    uint32_t last = p;
+    while (last < parsed.count && parsed.passes[last]->kind != OPT_PASS_MODULE) {
+      last++;
+    }
+    opt_run_function_passes(module, &parsed, p, last, options);
+    p = last;
+  }
+}
@@ -0,0 +1,327 @@
+#include "opt/sccp.h"
+#include "ir/ir_fold.h"
+#include "utils/diagnostic.h"
+#include "utils/stats.h"
+#include <stdlib.h>
+#include <string.h>
+
+typedef enum {
+  LATTICE_TOP,
+  LATTICE_CONST,
+  LATTICE_BOTTOM
+} LatticeKind;
+
+typedef struct {
+  uint8_t kind;
+  int32_t value;
+} LatticeValue;
+
+typedef struct {
+  IrFunction *fn;
+  const IrUses *uses;
+  LatticeValue *lattice;
+  uint8_t *block_executable;
+  uint8_t *edge_executable;
+  uint32_t *edge_start;
+  uint32_t *block_work;
+  uint32_t block_work_count;
+  uint32_t *value_work;
+  uint32_t value_work_count;
+  uint32_t value_work_capacity;
+  uint8_t *in_value_work;
+} Sccp;
+
+static void *sccp_calloc(const size_t count, const size_t size) {
+  void *ptr = calloc(count ? count : 1, size);
+  if (!ptr) {
+    LOG(FATAL, "out of memory");
+  }
+  return ptr;
+}
+
+static uint32_t sccp_edge_index(const Sccp *sccp, const IrBlockId from, const IrBlockId to) {
+  IrBlockId succs[2];
+  uint32_t count = ir_block_succs(sccp->fn, from, succs);
+  for (uint32_t i = 0; i < count; i++) {
+    if (succs[i] == to) {
+      return sccp->edge_start[from] + i;
+    }
+  }
+  return IR_NONE;
+}
+
+static void sccp_push_value(Sccp *sccp, const IrValueId value) {
+  if (sccp->in_value_work[value]) {
+    return;
+  }
+  if (sccp->value_work_count == sccp->value_work_capacity) {
+    sccp->value_work_capacity = sccp->value_work_capacity ? sccp->value_work_capacity * 2 : 64;
+    sccp->value_work = realloc(sccp->value_work, sccp->value_work_capacity * sizeof(uint32_t));
+    if (!sccp->value_work) {
+      LOG(FATAL, "out of memory");
+    }
+  }
+  sccp->in_value_work[value] = 1;
+  sccp->value_work[sccp->value_work_count++] = value;
+}
+
+static void sccp_set(Sccp *sccp, const IrValueId value, const LatticeValue next) {
+  LatticeValue *current = &sccp->lattice[value];
+  if (current->kind == next.kind && (next.kind != LATTICE_CONST || current->value == next.value)) {
+    return;
+  }
+  if (current->kind == LATTICE_BOTTOM) {
+    return;
+  }
+  *current = next;
+  for (uint32_t i = sccp->uses->start[value]; i < sccp->uses->start[value + 1]; i++) {
+    sccp_push_value(sccp, sccp->uses->users[i]);
+  }
+}
+
+static void sccp_mark_edge(Sccp *sccp, const IrBlockId from, const IrBlockId to) {
+  uint32_t edge = sccp_edge_index(sccp, from, to);
+  if (edge == IR_NONE || sccp->edge_executable[edge]) {
+    return;
+  }
+  sccp->edge_executable[edge] = 1;
+  if (!sccp->block_executable[to]) {
+    sccp->block_executable[to] = 1;
+    sccp->block_work[sccp->block_work_count++] = to;
+  } else {
+    const IrIdVector *insts = &sccp->fn->blocks[to].insts;
+    for (uint32_t i = 0; i < insts->count; i++) {
+      uint8_t op = sccp->fn->insts[insts->items[i]].op;
+      if (op == IR_OP_PHI) {
+        sccp_push_value(sccp, insts->items[i]);
+      } else if (op != IR_OP_NOP) {
+        break;
+      }
+    }
+  }
+}
+
+static LatticeValue lattice_meet(const LatticeValue a, const LatticeValue b) {
+  if (a.kind == LATTICE_TOP) {
+    return b;
+  }
+  if (b.kind == LATTICE_TOP) {
+    return a;
+  }
+  if (a.kind == LATTICE_CONST && b.kind == LATTICE_CONST && a.value == b.value) {
+    return a;
+  }
+  LatticeValue bottom = {LATTICE_BOTTOM, 0};
+  return bottom;
+}
+
+static LatticeValue sccp_evaluate(const Sccp *sccp, const IrValueId id) {
+  const IrFunction *fn = sccp->fn;
+  const IrInst *inst = &fn->insts[id];
+  LatticeValue top = {LATTICE_TOP, 0};
+  LatticeValue bottom = {LATTICE_BOTTOM, 0};
+  if (inst->type != IR_TYPE_I32) {
+    return bottom;
+  }
+  uint32_t flags = ir_op_flags(inst->op);
+  if (inst->op == IR_OP_CONST) {
+    LatticeValue value = {LATTICE_CONST, inst->imm};
+    return value;
+  }
+  if (inst->op == IR_OP_PHI) {
+    LatticeValue result = top;
+    for (uint32_t i = 0; i < inst->list_count; i++) {
+      IrBlockId pred = fn->operands[inst->list + 2 * i];
+      uint32_t edge = sccp_edge_index(sccp, pred, inst->block);
+      if (edge == IR_NONE || !sccp->edge_executable[edge]) {
+        continue;
+      }
+      result = lattice_meet(result, sccp->lattice[fn->operands[inst->list + 2 * i + 1]]);
+      if (result.kind == LATTICE_BOTTOM) {
+        break;
+      }
+    }
+    return result;
+  }
+  if (flags & IR_OPF_UNARY) {
+    LatticeValue a = sccp->lattice[inst->ops[0]];
+    if (a.kind != LATTICE_CONST) {
+      return a;
+    }
+    LatticeValue result = {LATTICE_CONST, 0};
+    return ir_fold_unary(inst->op, a.value, &result.value) ? result : bottom;
+  }
+  if (flags & IR_OPF_BINARY) {
+    LatticeValue a = sccp->lattice[inst->ops[0]];
+    LatticeValue b = sccp->lattice[inst->ops[1]];
+    LatticeValue result = {LATTICE_CONST, 0};
+    if ((inst->op == IR_OP_MUL || inst->op == IR_OP_AND) &&
+        ((a.kind == LATTICE_CONST && a.value == 0) || (b.kind == LATTICE_CONST && b.value == 0))) {
+      return result;
+    }
+    if (a.kind == LATTICE_BOTTOM || b.kind == LATTICE_BOTTOM) {
+      return bottom;
+    }
+    if (a.kind == LATTICE_TOP || b.kind == LATTICE_TOP) {
+      return top;
+    }
+    return ir_fold_binary(inst->op, a.value, b.value, &result.value) ? result : bottom;
+  }
+  return bottom;
+}
+
+static void sccp_visit(Sccp *sccp, const IrValueId id) {
+  IrFunction *fn = sccp->fn;
+  const IrInst *inst = &fn->insts[id];
+  if (inst->op == IR_OP_NOP || !sccp->block_executable[inst->block]) {
+    return;
+  }
+  switch (inst->op) {
+    case IR_OP_JUMP:
+      sccp_mark_edge(sccp, inst->block, inst->ops[0]);
+      return;
+    case IR_OP_BRANCH: {
+      LatticeValue cond = sccp->lattice[inst->ops[0]];
+      if (cond.kind == LATTICE_CONST) {
+        sccp_mark_edge(sccp, inst->block, cond.value != 0 ? inst->ops[1] : inst->ops[2]);
+      } else if (cond.kind == LATTICE_BOTTOM) {
+        sccp_mark_edge(sccp, inst->block, inst->ops[1]);
+        sccp_mark_edge(sccp, inst->block, inst->ops[2]);
+      }
+      return;
+    }
+    default:
+      if (inst->type != IR_TYPE_VOID) {
+        sccp_set(sccp, id, sccp_evaluate(sccp, id));
+      }
+      return;
+  }
+}
+
+static void sccp_solve(Sccp *sccp) {
+  IrFunction *fn = sccp->fn;
+  sccp->block_executable[0] = 1;
+  sccp->block_work[sccp->block_work_count++] = 0;
+  while (sccp->block_work_count > 0 || sccp->value_work_count > 0) {
+    while (sccp->value_work_count > 0) {
+      IrValueId id = sccp->value_work[--sccp->value_work_count];
+      sccp->in_value_work[id] = 0;
+      sccp_visit(sccp, id);
+    }
+    if (sccp->block_work_count > 0) {
+      IrBlockId block = sccp->block_work[--sccp->block_work_count];
+      const IrIdVector *insts = &fn->blocks[block].insts;
+      for (uint32_t i = 0; i < insts->count; i++) {
+        sccp_visit(sccp, insts->items[i]);
+      }
+    }
+  }
+}
+
+static uint32_t sccp_rewrite(Sccp *sccp) {
+  IrFunction *fn = sccp->fn;
+  uint32_t values = 0;
+  uint32_t branches = 0;
+  uint32_t blocks = 0;
+  uint32_t original_count = fn->inst_count;
+  IrValueId *map = sccp_calloc(original_count, sizeof(IrValueId));
+  for (uint32_t i = 0; i < original_count; i++) {
+    map[i] = IR_NONE;
+  }
+  for (uint32_t b = 0; b < fn->block_count; b++) {
+    if (!sccp->block_executable[b]) {
+      continue;
+    }
+    const IrIdVector *insts = &fn->blocks[b].insts;
+    for (uint32_t i = 0; i < insts->count; i++) {
+      IrValueId id = insts->items[i];
+      IrInst *inst = &fn->insts[id];
+      if (inst->op == IR_OP_NOP || inst->op == IR_OP_CONST || sccp->lattice[id].kind != LATTICE_CONST) {
+        continue;
+      }
+      if (!(ir_op_flags(inst->op) & IR_OPF_PURE)) {
+        continue;
+      }
+      if (inst->op == IR_OP_PHI) {
+        IrValueId constant = ir_inst_create(fn, IR_OP_CONST, IR_TYPE_I32);
+        fn->insts[constant].imm = sccp->lattice[id].value;
+        ir_block_insert_before_terminator(fn, 0, constant);
+        map[id] = constant;
+        ir_inst_kill(fn, id);
+      } else {
+        ir_inst_make_const(fn, id, sccp->lattice[id].value);
+      }
+      values++;
+    }
+    IrValueId term = ir_block_terminator(fn, b);
+    if (term != IR_NONE && fn->insts[term].op == IR_OP_BRANCH) {
+      IrInst *inst = &fn->insts[term];
+      LatticeValue cond = sccp->lattice[inst->ops[0]];
+      if (cond.kind == LATTICE_CONST) {
+        IrBlockId taken = cond.value != 0 ? inst->ops[1] : inst->ops[2];
+        IrBlockId dropped = cond.value != 0 ? inst->ops[2] : inst->ops[1];
+        if (dropped != taken) {
+          const IrIdVector *succ_insts = &fn->blocks[dropped].insts;
+          for (uint32_t i = 0; i < succ_insts->count; i++) {
+            if (fn->insts[succ_insts->items[i]].op == IR_OP_PHI) {
+              ir_phi_remove_incoming(fn, succ_insts->items[i], b);
+            }
+          }
+        }
+        inst->op = IR_OP_JUMP;
+        inst->ops[0] = taken;
+        inst->ops[1] = IR_NONE;
+        inst->ops[2] = IR_NONE;
+        branches++;
+      }
+    }
+  }
+  map = realloc(map, fn->inst_count * sizeof(IrValueId));
+  if (!map) {
+    LOG(FATAL, "out of memory");
+  }
+  for (uint32_t i = original_count; i < fn->inst_count; i++) {
+    map[i] = IR_NONE;
+  }
+  ir_rewrite_operands(fn, map);
+  for (uint32_t b = 0; b < fn->block_count; b++) {
+    if (!sccp->block_executable[b] && !(fn->blocks[b].flags & IR_BLOCK_DEAD)) {
+      ir_block_kill(fn, b);
+      blocks++;
+    }
+  }
+  free(map);
+  ir_sweep(fn);
+  ir_compact_blocks(fn);
+  stats_add("sccp.values_folded", values);
+  stats_add("sccp.branches_folded", branches);
+  stats_add("sccp.blocks_removed", blocks);
+  return values + branches + blocks;
+}
+
+uint32_t opt_sccp(IrFunction *fn, OptAnalyses *analyses) {
+  ir_compute_preds(fn);
+  Sccp sccp;
+  memset(&sccp, 0, sizeof(sccp));
+  sccp.fn = fn;
+  sccp.uses = opt_analyses_uses(analyses);
+  sccp.lattice = sccp_calloc(fn->inst_count, sizeof(LatticeValue));
+  sccp.in_value_work = sccp_calloc(fn->inst_count, 1);
+  sccp.block_executable = sccp_calloc(fn->block_count, 1);
+  sccp.block_work = sccp_calloc(fn->block_count, sizeof(uint32_t));
+  sccp.edge_start = sccp_calloc(fn->block_count + 1, sizeof(uint32_t));
+  for (uint32_t b = 0; b < fn->block_count; b++) {
+    sccp.edge_start[b + 1] = sccp.edge_start[b] + 2;
+  }
+  sccp.edge_executable = sccp_calloc(sccp.edge_start[fn->block_count], 1);
+  sccp_solve(&sccp);
+  uint32_t changes = sccp_rewrite(&sccp);
+  free(sccp.lattice);
+  free(sccp.in_value_work);
+  free(sccp.block_executable);
+  free(sccp.block_work);
+  free(sccp.edge_start);
+  free(sccp.edge_executable);
+  free(sccp.value_work);
+  return changes;
+}
@@ -0,0 +1,300 @@
+#include "opt/simplify_cfg.h"
+#include "utils/diagnostic.h"
+#include "utils/stats.h"
+#include <stdlib.h>
+
+static int32_t cfg_block_has_succ(const IrFunction *fn, const IrBlockId block, const IrBlockId succ) {
+  IrBlockId succs[2];
+  uint32_t count = ir_block_succs(fn, block, succs);
+  for (uint32_t i = 0; i < count; i++) {
+    if (succs[i] == succ) {
+      return 1;
+    }
+  }
+  return 0;
+}
+
+static void cfg_replace_pred(IrFunction *fn, const IrBlockId block, const IrBlockId from, const IrBlockId to) {
+  IrIdVector *preds = &fn->blocks[block].preds;
+  for (uint32_t i = 0; i < preds->count; i++) {
+    if (preds->items[i] == from) {
+      preds->items[i] = to;
+    }
+  }
+}
+
+static uint32_t cfg_fold_branches(IrFunction *fn) {
+  uint32_t folded = 0;
+  for (uint32_t b = 0; b < fn->block_count; b++) {
+    if (fn->blocks[b].flags & IR_BLOCK_DEAD) {
+      continue;
+    }
+    IrValueId term = ir_block_terminator(fn, b);
+    if (term == IR_NONE || fn->insts[term].op != IR_OP_BRANCH) {
+      continue;
+    }
+    IrInst *inst = &fn->insts[term];
+    int32_t cond;
+    IrBlockId taken;
+    if (inst->ops[1] == inst->ops[2]) {
+      taken = inst->ops[1];
+    } else if (ir_value_const(fn, inst->ops[0], &cond)) {
+      taken = cond != 0 ? inst->ops[1] : inst->ops[2];
+      IrBlockId dropped = cond != 0 ? inst->ops[2] : inst->ops[1];
+      const IrIdVector *insts = &fn->blocks[dropped].insts;
+      for (uint32_t i = 0; i < insts->count; i++) {
+        if (fn->insts[insts->items[i]].op == IR_OP_PHI) {
+          ir_phi_remove_incoming(fn, insts->items[i], b);
+        }
+      }
+    } else {
+      continue;
+    }
+    inst = &fn->insts[term];
+    inst->op = IR_OP_JUMP;
+    inst->ops[0] = taken;
+    inst->ops[1] = IR_NONE;
+    inst->ops[2] = IR_NONE;
+    folded++;
+  }
+  return folded;
+}
+
+static uint32_t cfg_remove_unreachable(IrFunction *fn) {
+  uint8_t *seen = calloc(fn->block_count ? fn->block_count : 1, 1);
+  uint32_t *stack = malloc((fn->block_count ? fn->block_count : 1) * sizeof(uint32_t));
+  if (!seen || !stack) {
+    LOG(FATAL, "out of memory");
+  }
+  uint32_t top = 0;
+  seen[0] = 1;
+  stack[top++] = 0;
+  while (top > 0) {
+    IrBlockId block = stack[--top];
+    IrBlockId succs[2];
+    uint32_t count = ir_block_succs(fn, block, succs);
+    for (uint32_t i = 0; i < count; i++) {
+      if (!seen[succs[i]]) {
+        seen[succs[i]] = 1;
+        stack[top++] = succs[i];
+      }
+    }
+  }
+  uint32_t removed = 0;
+  for (uint32_t b = 0; b < fn->block_count; b++) {
+    if (!seen[b] && !(fn->blocks[b].flags & IR_BLOCK_DEAD)) {
+      ir_block_kill(fn, b);
+      removed++;
+    }
+  }
+  free(seen);
+  free(stack);
+  return removed;
+}
+
+static uint32_t cfg_fold_trivial_phis(IrFunction *fn) {
+  uint32_t folded = 0;
+  for (uint32_t b = 0; b < fn->block_count; b++) {
+    const IrIdVector *insts = &fn->blocks[b].insts;
+    for (uint32_t i = 0; i < insts->count; i++) {
+      IrValueId phi = insts->items[i];
+      const IrInst *inst = &fn->insts[phi];
+      if (inst->op != IR_OP_PHI) {
+        continue;
+      }
+      IrValueId same = IR_NONE;
+      int32_t trivial = 1;
+      for (uint32_t k = 0; k < inst->list_count; k++) {
+        IrValueId value = fn->operands[inst->list + 2 * k + 1];
+        if (value == phi || value == same) {
+          continue;
+        }
+        if (same != IR_NONE) {
+          trivial = 0;
+          break;
+        }
+        same = value;
+      }
+      if (!trivial || same == IR_NONE) {
+        continue;
+      }
+      ir_replace_all_uses(fn, phi, same);
+      ir_inst_kill(fn, phi);
+      folded++;
+    }
+  }
+  return folded;
+}
+
+static int32_t cfg_block_is_forwarder(const IrFunction *fn, const IrBlockId block) {
+  const IrIdVector *insts = &fn->blocks[block].insts;
+  for (uint32_t i = 0; i < insts->count; i++) {
+    uint8_t op = fn->insts[insts->items[i]].op;
+    if (op != IR_OP_NOP && op != IR_OP_JUMP) {
+      return 0;
+    }
+  }
+  IrValueId term = ir_block_terminator(fn, block);
+  return term != IR_NONE && fn->insts[term].op == IR_OP_JUMP;
+}
+
+static int32_t cfg_phis_agree(const IrFunction *fn, const IrBlockId target, const IrBlockId a, const IrBlockId b) {
+  const IrIdVector *insts = &fn->blocks[target].insts;
+  for (uint32_t i = 0; i < insts->count; i++) {
+    IrValueId phi = insts->items[i];
+    if (fn->insts[phi].op == IR_OP_PHI && ir_phi_incoming_for(fn, phi, a) != ir_phi_incoming_for(fn, phi, b)) {
+      return 0;
+    }
+  }
+  return 1;
+}
+
+static uint32_t cfg_postorder(const IrFunction *fn, uint32_t *post) {
+  uint32_t n = fn->block_count ? fn->block_count : 1;
+  uint32_t *stack = malloc(n * sizeof(uint32_t));
+  uint32_t *next_succ = malloc(n * sizeof(uint32_t));
+  uint8_t *visited = calloc(n, 1);
+  if (!stack || !next_succ || !visited) {
+    LOG(FATAL, "out of memory");
+  }
+  uint32_t count = 0;
+  uint32_t sp = 0;
+  if (fn->block_count > 0) {
+    stack[sp++] = 0;
+    next_succ[0] = 0;
+    visited[0] = 1;
+  }
+  while (sp > 0) {
+    IrBlockId b = stack[sp - 1];
+    IrBlockId succs[2];
+    uint32_t succ_count = ir_block_succs(fn, b, succs);
+    if (next_succ[b] < succ_count) {
+      IrBlockId succ = succs[next_succ[b]++];
+      if (!visited[succ]) {
+        visited[succ] = 1;
+        next_succ[succ] = 0;
+        stack[sp++] = succ;
+      }
+      continue;
+    }
+    post[count++] = b;
+    sp--;
+  }
+  free(stack);
+  free(next_succ);
+  free(visited);
+  return count;
+}
+
+static uint32_t cfg_forward_empty_blocks(IrFunction *fn) {
+  uint32_t forwarded = 0;
+  uint32_t *order = malloc((fn->block_count ? fn->block_count : 1) * sizeof(uint32_t));
+  if (!order) {
+    LOG(FATAL, "out of memory");
+  }
+  uint32_t order_count = cfg_postorder(fn, order);
+  for (uint32_t o = 0; o < order_count; o++) {
+    IrBlockId b = order[o];
+    if (b == 0 || (fn->blocks[b].flags & IR_BLOCK_DEAD) || !cfg_block_is_forwarder(fn, b)) {
+      continue;
+    }
+    IrBlockId target = fn->insts[ir_block_terminator(fn, b)].ops[0];
+    if (target == b || target == 0) {
+      continue;
+    }
+    IrIdVector *preds = &fn->blocks[b].preds;
+    uint32_t kept = 0;
+    for (uint32_t p = 0; p < preds->count; p++) {
+      IrBlockId pred = preds->items[p];
+      if (cfg_block_has_succ(fn, pred, target)) {
+        if (!cfg_phis_agree(fn, target, pred, b)) {
+          preds->items[kept++] = pred;
+          continue;
+        }
+      } else {
+        const IrIdVector *insts = &fn->blocks[target].insts;
+        for (uint32_t i = 0; i < insts->count; i++) {
+          IrValueId phi = insts->items[i];
+          if (fn->insts[phi].op == IR_OP_PHI) {
+            ir_phi_add_incoming(fn, phi, pred, ir_phi_incoming_for(fn, phi, b));
+          }
+        }
+        ir_id_vector_push(fn, &fn->blocks[target].preds, pred);
+      }
+      ir_replace_successor(fn, pred, b, target);
+    }
+    if (kept != preds->count) {
+      preds->count = kept;
+      forwarded++;
+    }
+  }
+  free(order);
+  return forwarded;
+}
+
+static uint32_t cfg_merge_blocks(IrFunction *fn) {
+  uint32_t merged = 0;
+  for (IrBlockId b = 0; b < fn->block_count; b++) {
+    if (fn->blocks[b].flags & IR_BLOCK_DEAD) {
+      continue;
+    }
+    IrValueId term = ir_block_terminator(fn, b);
+    if (term == IR_NONE || fn->insts[term].op != IR_OP_JUMP) {
+      continue;
+    }
+    IrBlockId succ = fn->insts[term].ops[0];
+    if (succ == b || succ == 0 || fn->blocks[succ].preds.count != 1) {
+      continue;
+    }
+    IrIdVector *succ_insts = &fn->blocks[succ].insts;
+    for (uint32_t i = 0; i < succ_insts->count; i++) {
+      IrValueId id = succ_insts->items[i];
+      if (fn->insts[id].op == IR_OP_PHI) {
+        ir_replace_all_uses(fn, id, ir_phi_incoming_for(fn, id, b));
+        ir_inst_kill(fn, id);
+      }
+    }
+    ir_inst_kill(fn, term);
+    IrBlockId succs[2];
+    uint32_t count = ir_block_succs(fn, succ, succs);
+    for (uint32_t s = 0; s < count; s++) {
+      ir_phis_rename_pred(fn, succs[s], succ, b);
+      cfg_replace_pred(fn, succs[s], succ, b);
+    }
+    for (uint32_t i = 0; i < succ_insts->count; i++) {
+      IrValueId id = succ_insts->items[i];
+      if (fn->insts[id].op != IR_OP_NOP) {
+        ir_block_append(fn, b, id);
+      }
+    }
+    succ_insts->count = 0;
+    fn->blocks[succ].preds.count = 0;
+    fn->blocks[succ].flags |= IR_BLOCK_DEAD;
+    merged++;
+    b--;
+  }
+  return merged;
+}
+
+uint32_t opt_simplify_cfg(IrFunction *fn) {
+  uint32_t before = fn->block_count;
+  uint32_t changes = 0;
+  uint32_t round;
+  do {
+    ir_compute_preds(fn);
+    uint32_t branches = cfg_fold_branches(fn);
+    round = branches + cfg_remove_unreachable(fn);
+    ir_compute_preds(fn);
+    round += cfg_fold_trivial_phis(fn);
+    round += cfg_forward_empty_blocks(fn);
+    round += cfg_remove_unreachable(fn);
+    ir_compute_preds(fn);
+    round += cfg_merge_blocks(fn);
+    stats_add("simplifycfg.branches_folded", branches);
+    changes += round;
+  } while (round > 0);
+  ir_sweep(fn);
+  ir_compact_blocks(fn);
+  stats_add("simplifycfg.blocks_removed", before - fn->block_count);
+  return changes;
+}
@@ -0,0 +1,124 @@
+#include "opt/sroa.h"
+#include "ir/ir_ssa.h"
+#include "utils/diagnostic.h"
+#include "utils/stats.h"
+#include <stdlib.h>
+
+static uint32_t *sroa_alloc(const uint32_t count) {
+  uint32_t *ptr = malloc((count ? count : 1) * sizeof(uint32_t));
+  if (!ptr) {
+    LOG(FATAL, "out of memory");
+  }
+  return ptr;
+}
+
+static int32_t sroa_access_index(const IrFunction *fn, const IrFrameObject *object, const IrInst *access) {
+  int32_t offset;
+  if (access->width != object->elem_width || !ir_address_constant_offset(fn, access->ops[0], &offset)) {
+    return -1;
+  }
+  offset += access->imm;
+  if (offset < 0 || offset + access->width > object->size || offset % object->elem_width != 0) {
+    return -1;
+  }
+  return offset / object->elem_width;
+}
+
+static int32_t sroa_collect(const IrFunction *fn, const IrUses *uses, const IrValueId alloca, uint32_t *addrs,
+                            uint32_t *addr_count) {
+  const IrFrameObject *object = &fn->frame[fn->insts[alloca].imm];
+  uint32_t count = 0;
+  addrs[count++] = alloca;
+  for (uint32_t w = 0; w < count; w++) {
+    IrValueId addr = addrs[w];
+    for (uint32_t u = uses->start[addr]; u < uses->start[addr + 1]; u++) {
+      IrValueId user = uses->users[u];
+      const IrInst *inst = &fn->insts[user];
+      if (inst->op == IR_OP_LOAD || (inst->op == IR_OP_STORE && inst->ops[1] != addr)) {
+        if (sroa_access_index(fn, object, inst) < 0) {
+          return 0;
+        }
+      } else if (inst->op == IR_OP_ADD && inst->type == IR_TYPE_PTR && inst->ops[0] != inst->ops[1]) {
+        int32_t step;
+        if (!ir_value_const(fn, inst->ops[0] == addr ? inst->ops[1] : inst->ops[0], &step)) {
+          return 0;
+        }
+        int32_t seen = 0;
+        for (uint32_t k = 0; k < count; k++) {
+          seen |= addrs[k] == user;
+        }
+        if (!seen) {
+          addrs[count++] = user;
+        }
+      } else {
+        return 0;
+      }
+    }
+  }
+  *addr_count = count;
+  return 1;
+}
+
+static void sroa_split(IrFunction *fn, const IrUses *uses, const uint32_t *addrs, const uint32_t addr_count) {
+  IrValueId alloca = addrs[0];
+  IrFrameObject object = fn->frame[fn->insts[alloca].imm];
+  uint32_t elements = (uint32_t) (object.size / object.elem_width);
+  IrValueId element_alloca[OPT_SROA_MAX_ELEMENTS];
+  for (uint32_t e = 0; e < elements; e++) {
+    element_alloca[e] = IR_NONE;
+  }
+  for (uint32_t a = 0; a < addr_count; a++) {
+    IrValueId addr = addrs[a];
+    for (uint32_t u = uses->start[addr]; u < uses->start[addr + 1]; u++) {
+      IrValueId user = uses->users[u];
+      IrInst *inst = &fn->insts[user];
+      if (inst->op != IR_OP_LOAD && inst->op != IR_OP_STORE) {
+        continue;
+      }
+      uint32_t e = (uint32_t) sroa_access_index(fn, &object, inst);
+      if (element_alloca[e] == IR_NONE) {
+        int32_t slot = ir_frame_object_create(fn, object.name, object.elem_width, object.elem_width,
+                                              object.elem_width, IR_FRAME_SCALAR);
+        element_alloca[e] = ir_inst_create(fn, IR_OP_ALLOCA, IR_TYPE_PTR);
+        fn->insts[element_alloca[e]].imm = slot;
+        ir_block_insert(fn, 0, 0, element_alloca[e]);
+      }
+      inst = &fn->insts[user];
+      inst->ops[0] = element_alloca[e];
+      inst->imm = 0;
+    }
+  }
+  fn->frame[fn->insts[alloca].imm].flags |= IR_FRAME_DEAD;
+  for (uint32_t a = 0; a < addr_count; a++) {
+    ir_inst_kill(fn, addrs[a]);
+  }
+}
+
+uint32_t opt_sroa(IrFunction *fn, OptAnalyses *analyses) {
+  const IrUses *uses = opt_analyses_uses(analyses);
+  uint32_t *addrs = sroa_alloc(uses->value_count);
+  uint32_t split = 0;
+  for (uint32_t i = 0; i < uses->value_count; i++) {
+    const IrInst *inst = &fn->insts[i];
+    if (inst->op != IR_OP_ALLOCA || inst->block == IR_NONE) {
+      continue;
+    }
+    const IrFrameObject *object = &fn->frame[inst->imm];
+    if ((object->flags & (IR_FRAME_SCALAR | IR_FRAME_DEAD)) || object->elem_width == 0 ||
+        object->size / object->elem_width > OPT_SROA_MAX_ELEMENTS) {
+      continue;
+    }
+    uint32_t addr_count = 0;
+    if (sroa_collect(fn, uses, i, addrs, &addr_count)) {
+      sroa_split(fn, uses, addrs, addr_count);
+      split++;
+    }
+  }
+  free(addrs);
+  if (split > 0) {
+    ir_sweep(fn);
+    ir_promote_slots(fn);
+    stats_add("sroa.arrays_split", split);
+  }
+  return split;
+}
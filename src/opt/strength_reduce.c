@@ -0,0 +1,377 @@
+#include "opt/strength_reduce.h"
+#include "opt/dce.h"
+#include "ir/ir_dom.h"
+#include "ir/ir_loop.h"
+#include "utils/diagnostic.h"
+#include "utils/stats.h"
+#include <stdlib.h>
+#include <string.h>
+
+typedef struct {
+  IrValueId phi;
+  IrValueId next;
+  IrValueId init;
+  int32_t stride;
+} SrInduction;
+
+typedef struct {
+  uint32_t loop;
+  IrBlockId preheader;
+  IrBlockId latch;
+  IrValueId counter;
+  IrValueId counter_next;
+  IrValueId init;
+  IrValueId base;
+  uint32_t shift;
+  IrValueId pointer;
+  int32_t every_iteration;
+} SrGroup;
+
+typedef struct {
+  IrFunction *fn;
+  const IrDomTree *dom;
+  const IrLoopInfo *loops;
+  SrGroup *groups;
+  uint32_t group_count;
+  uint32_t group_capacity;
+  uint32_t rewritten;
+  uint32_t counters_removed;
+} StrengthReduce;
+
+static int32_t sr_defined_outside(const StrengthReduce *sr, const uint32_t loop, const IrValueId value) {
+  return !ir_loop_contains(sr->loops, loop, sr->fn->insts[value].block);
+}
+
+static IrBlockId sr_single_latch(const StrengthReduce *sr, const uint32_t loop) {
+  const IrFunction *fn = sr->fn;
+  const IrIdVector *preds = &fn->blocks[sr->loops->loops[loop].header].preds;
+  IrBlockId latch = IR_NONE;
+  for (uint32_t p = 0; p < preds->count; p++) {
+    if (!ir_loop_contains(sr->loops, loop, preds->items[p])) {
+      continue;
+    }
+    if (latch != IR_NONE) {
+      return IR_NONE;
+    }
+    latch = preds->items[p];
+  }
+  return latch;
+}
+
+static int32_t sr_match_induction(const IrFunction *fn, const IrValueId phi, const IrBlockId preheader,
+                                  const IrBlockId latch, SrInduction *out) {
+  const IrInst *inst = &fn->insts[phi];
+  if (inst->op != IR_OP_PHI || inst->type != IR_TYPE_I32 || inst->list_count != 2) {
+    return 0;
+  }
+  out->phi = phi;
+  out->init = ir_phi_incoming_for(fn, phi, preheader);
+  out->next = ir_phi_incoming_for(fn, phi, latch);
+  if (out->init == IR_NONE || out->next == IR_NONE) {
+    return 0;
+  }
+  const IrInst *next = &fn->insts[out->next];
+  int32_t step;
+  if (next->op == IR_OP_ADD && next->ops[0] == phi && ir_value_const(fn, next->ops[1], &step)) {
+    out->stride = step;
+  } else if (next->op == IR_OP_ADD && next->ops[1] == phi && ir_value_const(fn, next->ops[0], &step)) {
+    out->stride = step;
+  } else if (next->op == IR_OP_SUB && next->ops[0] == phi && ir_value_const(fn, next->ops[1], &step) &&
+             step != INT32_MIN) {
+    out->stride = -step;
+  } else {
+    return 0;
+  }
+  return out->stride != 0;
+}
+
+static int32_t sr_match_index(const IrFunction *fn, IrValueId index, IrValueId *counter, uint32_t *shift,
+                              int32_t *offset) {
+  const IrInst *inst = &fn->insts[index];
+  int32_t value;
+  *shift = 0;
+  if (inst->op == IR_OP_SHL && ir_value_const(fn, inst->ops[1], &value) && value >= 0 && value <= 3) {
+    *shift = (uint32_t) value;
+    index = inst->ops[0];
+  } else if (inst->op == IR_OP_MUL) {
+    uint32_t other = ir_value_const(fn, inst->ops[1], &value) ? 0 : 1;
+    if (!ir_value_const(fn, inst->ops[1 - other], &value) || (value != 1 && value != 2 && value != 4 && value != 8)) {
+      return 0;
+    }
+    while ((1 << *shift) < value) {
+      (*shift)++;
+    }
+    index = inst->ops[other];
+  }
+  inst = &fn->insts[index];
+  *offset = 0;
+  if (inst->op == IR_OP_ADD && ir_value_const(fn, inst->ops[1], &value)) {
+    *offset = value;
+    index = inst->ops[0];
+  } else if (inst->op == IR_OP_ADD && ir_value_const(fn, inst->ops[0], &value)) {
+    *offset = value;
+    index = inst->ops[1];
+  } else if (inst->op == IR_OP_SUB && ir_value_const(fn, inst->ops[1], &value) && value != INT32_MIN) {
+    *offset = -value;
+    index = inst->ops[0];
+  }
+  if (*offset > (INT32_MAX >> 3) || *offset < -(INT32_MAX >> 3)) {
+    return 0;
+  }
+  *counter = index;
+  return 1;
+}
+
+static IrValueId sr_emit_scaled(IrFunction *fn, const IrBlockId block, const IrValueId value, const uint32_t shift) {
+  int32_t known;
+  if (shift == 0) {
+    return value;
+  }
+  if (ir_value_const(fn, value, &known)) {
+    IrValueId scaled = ir_inst_create(fn, IR_OP_CONST, IR_TYPE_I32);
+    fn->insts[scaled].imm = (int32_t) ((uint32_t) known << shift);
+    ir_block_insert_before_terminator(fn, block, scaled);
+    return scaled;
+  }
+  IrValueId amount = ir_inst_create(fn, IR_OP_CONST, IR_TYPE_I32);
+  fn->insts[amount].imm = (int32_t) shift;
+  ir_block_insert_before_terminator(fn, block, amount);
+  IrValueId scaled = ir_inst_create(fn, IR_OP_SHL, IR_TYPE_I32);
+  fn->insts[scaled].ops[0] = value;
+  fn->insts[scaled].ops[1] = amount;
+  ir_block_insert_before_terminator(fn, block, scaled);
+  return scaled;
+}
+
+static IrValueId sr_emit_address(IrFunction *fn, const IrBlockId block, const IrValueId base, const IrValueId index,
+                                 const uint32_t shift) {
+  IrValueId scaled = sr_emit_scaled(fn, block, index, shift);
+  int32_t known;
+  if (ir_value_const(fn, scaled, &known) && known == 0) {
+    return base;
+  }
+  IrValueId address = ir_inst_create(fn, IR_OP_ADD, IR_TYPE_PTR);
+  fn->insts[address].ops[0] = base;
+  fn->insts[address].ops[1] = scaled;
+  ir_block_insert_before_terminator(fn, block, address);
+  return address;
+}
+
+static SrGroup *sr_group_for(StrengthReduce *sr, const uint32_t loop, const IrBlockId preheader,
+                             const IrBlockId latch, const SrInduction *iv, const IrValueId base, const uint32_t shift) {
+  for (uint32_t g = 0; g < sr->group_count; g++) {
+    SrGroup *group = &sr->groups[g];
+    if (group->counter == iv->phi && group->base == base && group->shift == shift) {
+      return group;
+    }
+  }
+  IrFunction *fn = sr->fn;
+  if (sr->group_count == sr->group_capacity) {
+    sr->group_capacity = sr->group_capacity ? sr->group_capacity * 2 : 8;
+    sr->groups = realloc(sr->groups, sr->group_capacity * sizeof(SrGroup));
+    if (!sr->groups) {
+      LOG(FATAL, "out of memory");
+    }
+  }
+  SrGroup *group = &sr->groups[sr->group_count++];
+  group->loop = loop;
+  group->preheader = preheader;
+  group->latch = latch;
+  group->counter = iv->phi;
+  group->counter_next = iv->next;
+  group->init = iv->init;
+  group->base = base;
+  group->shift = shift;
+  group->every_iteration = 0;
+  IrValueId start = sr_emit_address(fn, preheader, base, iv->init, shift);
+  group->pointer = ir_inst_create(fn, IR_OP_PHI, IR_TYPE_PTR);
+  ir_block_insert(fn, sr->loops->loops[loop].header, 0, group->pointer);
+  IrValueId step = ir_inst_create(fn, IR_OP_CONST, IR_TYPE_I32);
+  fn->insts[step].imm = (int32_t) ((uint32_t) iv->stride << shift);
+  ir_block_insert_before_terminator(fn, latch, step);
+  IrValueId advanced = ir_inst_create(fn, IR_OP_ADD, IR_TYPE_PTR);
+  fn->insts[advanced].ops[0] = group->pointer;
+  fn->insts[advanced].ops[1] = step;
+  ir_block_insert_before_terminator(fn, latch, advanced);
+  ir_phi_add_incoming(fn, group->pointer, preheader, start);
+  ir_phi_add_incoming(fn, group->pointer, latch, advanced);
+  return group;
+}
+
+static void sr_rewrite_access(StrengthReduce *sr, const uint32_t loop, const IrBlockId preheader,
+                              const IrBlockId latch, const SrInduction *ivs, const uint32_t iv_count,
+                              const IrValueId id) {
+  IrFunction *fn = sr->fn;
+  const IrInst *address = &fn->insts[fn->insts[id].ops[0]];
+  if (address->op != IR_OP_ADD || address->type != IR_TYPE_PTR) {
+    return;
+  }
+  uint32_t ptr = fn->insts[address->ops[0]].type == IR_TYPE_PTR ? 0 : 1;
+  IrValueId base = address->ops[ptr];
+  if (!sr_defined_outside(sr, loop, base)) {
+    return;
+  }
+  IrValueId counter;
+  uint32_t shift;
+  int32_t offset;
+  if (!sr_match_index(fn, address->ops[1 - ptr], &counter, &shift, &offset)) {
+    return;
+  }
+  for (uint32_t v = 0; v < iv_count; v++) {
+    if (ivs[v].phi != counter || ivs[v].stride > (INT32_MAX >> 3) || ivs[v].stride < -(INT32_MAX >> 3)) {
+      continue;
+    }
+    SrGroup *group = sr_group_for(sr, loop, preheader, latch, &ivs[v], base, shift);
+    IrInst *access = &fn->insts[id];
+    access->ops[0] = group->pointer;
+    access->imm += (int32_t) ((uint32_t) offset << shift);
+    if (ir_dom_dominates(sr->dom, access->block, latch)) {
+      group->every_iteration = 1;
+    }
+    sr->rewritten++;
+    return;
+  }
+}
+
+static void sr_reduce_loop(StrengthReduce *sr, const uint32_t loop) {
+  IrFunction *fn = sr->fn;
+  IrBlockId preheader = ir_loop_preheader(fn, sr->loops, loop);
+  IrBlockId latch = sr_single_latch(sr, loop);
+  if (preheader == IR_NONE || latch == IR_NONE) {
+    return;
+  }
+  const IrLoop *data = &sr->loops->loops[loop];
+  const IrIdVector *header_insts = &fn->blocks[data->header].insts;
+  SrInduction *ivs = malloc((header_insts->count ? header_insts->count : 1) * sizeof(SrInduction));
+  if (!ivs) {
+    LOG(FATAL, "out of memory");
+  }
+  uint32_t iv_count = 0;
+  for (uint32_t i = 0; i < header_insts->count; i++) {
+    if (sr_match_induction(fn, header_insts->items[i], preheader, latch, &ivs[iv_count])) {
+      iv_count++;
+    }
+  }
+  for (uint32_t b = 0; b < data->block_count && iv_count > 0; b++) {
+    IrBlockId block = sr->loops->blocks[data->block_start + b];
+    if (sr->loops->block_loop[block] != loop) {
+      continue;
+    }
+    for (uint32_t i = 0; i < fn->blocks[block].insts.count; i++) {
+      IrValueId id = fn->blocks[block].insts.items[i];
+      uint8_t op = fn->insts[id].op;
+      if (op == IR_OP_LOAD || op == IR_OP_STORE) {
+        sr_rewrite_access(sr, loop, preheader, latch, ivs, iv_count, id);
+      }
+    }
+  }
+  free(ivs);
+}
+
+static int32_t sr_single_exit(const StrengthReduce *sr, const uint32_t loop) {
+  const IrLoop *data = &sr->loops->loops[loop];
+  for (uint32_t b = 0; b < data->block_count; b++) {
+    IrBlockId block = sr->loops->blocks[data->block_start + b];
+    if (block == data->header) {
+      continue;
+    }
+    IrBlockId succs[2];
+    uint32_t count = ir_block_succs(sr->fn, block, succs);
+    for (uint32_t s = 0; s < count; s++) {
+      if (!ir_loop_contains(sr->loops, loop, succs[s])) {
+        return 0;
+      }
+    }
+  }
+  return 1;
+}
+
+static uint32_t sr_use_count(const IrUses *uses, const IrValueId value) {
+  return uses->start[value + 1] - uses->start[value];
+}
+
+static int32_t sr_object_size(const IrFunction *fn, const IrValueId base) {
+  const IrInst *inst = &fn->insts[base];
+  if (inst->op == IR_OP_ALLOCA) {
+    return fn->frame[inst->imm].size;
+  }
+  if (inst->op == IR_OP_DATA) {
+    return (int32_t) fn->module->data[inst->imm].word_count * 4;
+  }
+  return -1;
+}
+
+static int32_t sr_bound_in_object(const IrFunction *fn, const SrGroup *group, const IrValueId limit) {
+  int32_t length = sr_object_size(fn, group->base) >> group->shift;
+  int32_t init;
+  int32_t bound;
+  return ir_value_const(fn, group->init, &init) && ir_value_const(fn, limit, &bound) && init >= 0 &&
+         init <= length && bound >= 0 && bound <= length;
+}
+
+static void sr_replace_counter(StrengthReduce *sr, const IrUses *uses, const SrGroup *group) {
+  IrFunction *fn = sr->fn;
+  const IrLoop *data = &sr->loops->loops[group->loop];
+  if (!group->every_iteration || fn->insts[group->counter].op != IR_OP_PHI ||
+      fn->insts[group->pointer].op != IR_OP_PHI || fn->insts[group->base].op == IR_OP_NOP ||
+      !sr_single_exit(sr, group->loop)) {
+    return;
+  }
+  IrValueId term = ir_block_terminator(fn, data->header);
+  if (term == IR_NONE || fn->insts[term].op != IR_OP_BRANCH) {
+    return;
+  }
+  IrValueId cond = fn->insts[term].ops[0];
+  IrInst *compare = &fn->insts[cond];
+  if (!(ir_op_flags(compare->op) & IR_OPF_COMPARE) || compare->block != data->header ||
+      sr_use_count(uses, cond) != 1 || sr_use_count(uses, group->counter) != 2 ||
+      sr_use_count(uses, group->counter_next) != 1) {
+    return;
+  }
+  uint32_t side;
+  if (compare->ops[0] == group->counter) {
+    side = 0;
+  } else if (compare->ops[1] == group->counter) {
+    side = 1;
+  } else {
+    return;
+  }
+  IrValueId limit = compare->ops[1 - side];
+  if (!sr_defined_outside(sr, group->loop, limit) || !sr_bound_in_object(fn, group, limit)) {
+    return;
+  }
+  IrValueId end = sr_emit_address(fn, group->preheader, group->base, limit, group->shift);
+  compare = &fn->insts[cond];
+  compare->ops[side] = group->pointer;
+  compare->ops[1 - side] = end;
+  ir_inst_kill(fn, group->counter);
+  ir_inst_kill(fn, group->counter_next);
+  sr->counters_removed++;
+}
+
+uint32_t opt_strength_reduce(IrFunction *fn, OptAnalyses *analyses) {
+  if (fn->block_count == 0) {
+    return 0;
+  }
+  StrengthReduce sr;
+  memset(&sr, 0, sizeof(sr));
+  sr.fn = fn;
+  sr.loops = opt_analyses_loops_with_preheaders(analyses);
+  sr.dom = opt_analyses_dom(analyses);
+  for (uint32_t l = 0; l < sr.loops->loop_count; l++) {
+    sr_reduce_loop(&sr, l);
+  }
+  if (sr.group_count > 0) {
+    opt_dce(fn);
+    opt_analyses_invalidate(analyses, OPT_PRESERVE_CFG);
+    const IrUses *uses = opt_analyses_uses(analyses);
+    for (uint32_t g = 0; g < sr.group_count; g++) {
+      sr_replace_counter(&sr, uses, &sr.groups[g]);
+    }
+    ir_sweep(fn);
+  }
+  stats_add("ivsr.accesses_rewritten", sr.rewritten);
+  stats_add("ivsr.counters_removed", sr.counters_removed);
+  free(sr.groups);
+  return sr.rewritten + sr.counters_removed;
+}
@@ -0,0 +1,129 @@
+#include "opt/tail_call.h"
+#include "utils/diagnostic.h"
+#include "utils/stats.h"
+#include <stdlib.h>
+
+static IrValueId tail_call_site(const IrFunction *fn, const IrBlockId block) {
+  const IrIdVector *insts = &fn->blocks[block].insts;
+  uint32_t i = insts->count;
+  while (i > 0 && fn->insts[insts->items[i - 1]].op == IR_OP_NOP) {
+    i--;
+  }
+  if (i == 0 || fn->insts[insts->items[i - 1]].op != IR_OP_RET) {
+    return IR_NONE;
+  }
+  IrValueId ret = insts->items[--i];
+  while (i > 0 && fn->insts[insts->items[i - 1]].op == IR_OP_NOP) {
+    i--;
+  }
+  if (i == 0) {
+    return IR_NONE;
+  }
+  IrValueId call = insts->items[i - 1];
+  if (fn->insts[call].op != IR_OP_CALL || fn->insts[ret].ops[0] != call) {
+    return IR_NONE;
+  }
+  return call;
+}
+
+static IrBlockId tail_make_header(IrFunction *fn, IrValueId *param_phi) {
+  IrBlockId header = ir_block_create(fn);
+  IrIdVector *entry = &fn->blocks[0].insts;
+  uint32_t kept = 0;
+  for (uint32_t i = 0; i < entry->count; i++) {
+    IrValueId id = entry->items[i];
+    uint8_t op = fn->insts[id].op;
+    if (op == IR_OP_PARAM || op == IR_OP_ALLOCA) {
+      entry->items[kept++] = id;
+    } else if (op != IR_OP_NOP) {
+      ir_block_append(fn, header, id);
+      entry = &fn->blocks[0].insts;
+    }
+  }
+  entry->count = kept;
+  IrValueId jump = ir_inst_create(fn, IR_OP_JUMP, IR_TYPE_VOID);
+  fn->insts[jump].ops[0] = header;
+  ir_block_append(fn, 0, jump);
+
+  IrBlockId succs[2];
+  uint32_t count = ir_block_succs(fn, header, succs);
+  for (uint32_t s = 0; s < count; s++) {
+    ir_phis_rename_pred(fn, succs[s], 0, header);
+  }
+
+  uint32_t position = 0;
+  for (uint32_t i = 0; i < kept; i++) {
+    IrValueId param = fn->blocks[0].insts.items[i];
+    if (fn->insts[param].op != IR_OP_PARAM) {
+      continue;
+    }
+    IrValueId phi = ir_inst_create(fn, IR_OP_PHI, (IrType) fn->insts[param].type);
+    ir_replace_all_uses(fn, param, phi);
+    ir_block_insert(fn, header, position++, phi);
+    ir_phi_add_incoming(fn, phi, 0, param);
+    param_phi[fn->insts[param].imm] = phi;
+  }
+  return header;
+}
+
+uint32_t opt_tail_recursion(IrFunction *fn) {
+  uint32_t count = 0;
+  for (uint32_t b = 0; b < fn->block_count; b++) {
+    if (fn->blocks[b].flags & IR_BLOCK_DEAD) {
+      continue;
+    }
+    IrValueId call = tail_call_site(fn, b);
+    count += call != IR_NONE && fn->insts[call].imm == fn->index;
+  }
+  if (count == 0) {
+    return 0;
+  }
+  IrValueId *param_phi = malloc((fn->param_count ? (size_t) fn->param_count : 1) * sizeof(IrValueId));
+  if (!param_phi) {
+    LOG(FATAL, "out of memory");
+  }
+  for (int32_t p = 0; p < fn->param_count; p++) {
+    param_phi[p] = IR_NONE;
+  }
+  IrBlockId header = tail_make_header(fn, param_phi);
+  for (uint32_t b = 0; b < fn->block_count; b++) {
+    if (b == header || (fn->blocks[b].flags & IR_BLOCK_DEAD)) {
+      continue;
+    }
+    IrValueId call = tail_call_site(fn, b);
+    if (call == IR_NONE || fn->insts[call].imm != fn->index) {
+      continue;
+    }
+    for (int32_t p = 0; p < fn->param_count; p++) {
+      if (param_phi[p] != IR_NONE) {
+        ir_phi_add_incoming(fn, param_phi[p], b, fn->operands[fn->insts[call].list + (uint32_t) p]);
+      }
+    }
+    IrValueId ret = ir_block_terminator(fn, b);
+    ir_inst_kill(fn, ret);
+    fn->insts[ret].op = IR_OP_JUMP;
+    fn->insts[ret].ops[0] = header;
+    ir_inst_kill(fn, call);
+    fn->insts[call].block = IR_NONE;
+  }
+  free(param_phi);
+  ir_compute_preds(fn);
+  stats_add("tailcall.recursion_to_loop", count);
+  return count;
+}
+
+uint32_t opt_mark_tail_calls(IrFunction *fn) {
+  uint32_t count = 0;
+  for (uint32_t b = 0; b < fn->block_count; b++) {
+    if (fn->blocks[b].flags & IR_BLOCK_DEAD) {
+      continue;
+    }
+    IrValueId call = tail_call_site(fn, b);
+    if (call != IR_NONE && fn->insts[call].list_count <= OPT_TAIL_CALL_MAX_ARGS) {
+      fn->insts[call].flags |= IR_INST_TAIL;
+      count++;
+    }
+  }
+  stats_add("tailcall.calls_marked", count);
+  return count;
+}
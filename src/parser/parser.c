@@ -211,6 +211,10 @@ static AstNode *parse_expression(Parser *parser);
 
 static AstNode *parse_assignment(Parser *parser);
 
+static AstNode *parse_logical_or(Parser *parser);
+
+static AstNode *parse_logical_and(Parser *parser);
+
 static AstNode *parse_bitwise_or(Parser *parser);
 
 static AstNode *parse_bitwise_and(Parser *parser);
@@ -291,7 +295,10 @@ static AstFunction *parse_function(Parser *parser) {
       AstParam param = {
         .type = param_type,
         .name = parser_copy_lexeme(parser, param_name),
-        .length = param_name->length
+        .length = param_name->length,
+        .line = param_name->line,
+        .column = param_name->column,
+        .symbol = AST_NO_SYMBOL
       };
       param_vector_push(parser, &params, param);
       if (parser_match(parser, TOKEN_COMMA)) {
@@ -313,6 +320,9 @@ static AstFunction *parse_function(Parser *parser) {
   fn->return_type = return_type;
   fn->body = body;
   fn->params = params;
+  fn->line = name_tok->line;
+  fn->column = name_tok->column;
+  fn->symbol = AST_NO_SYMBOL;
   return fn;
 }
 
@@ -356,6 +366,7 @@ static AstNode *parse_variable_declaration(Parser *parser, const Token *type_tok
   node->data.var_decl.name = parser_copy_lexeme(parser, name_tok);
   node->data.var_decl.length = name_tok->length;
   node->data.var_decl.initializer = initializer;
+  node->data.var_decl.symbol = AST_NO_SYMBOL;
   return node;
 }
 
@@ -497,6 +508,7 @@ static AstNode *make_identifier(Parser *parser, const Token *token) {
   AstNode *node = parser_new_node(parser, AST_NODE_IDENTIFIER, token);
   node->data.identifier.name = parser_copy_lexeme(parser, token);
   node->data.identifier.length = token->length;
+  node->data.identifier.symbol = AST_NO_SYMBOL;
   return node;
 }
 
@@ -505,7 +517,7 @@ static AstNode *parse_expression(Parser *parser) {
 }
 
 static AstNode *parse_assignment(Parser *parser) {
-  AstNode *left = parse_bitwise_or(parser);
+  AstNode *left = parse_logical_or(parser);
   if (parser_match(parser, TOKEN_ASSIGN)) {
     const Token *op = parser_previous(parser);
     AstNode *right = parse_assignment(parser);
@@ -535,6 +547,16 @@ static AstNode *parse_left_associative(Parser *parser, AstNode *(*next)(Parser *
   return expr;
 }
 
+static AstNode *parse_logical_or(Parser *parser) {
+  const TokenKind ops[] = {TOKEN_LOGICAL_OR};
+  return parse_left_associative(parser, parse_logical_and, ops, 1);
+}
+
+static AstNode *parse_logical_and(Parser *parser) {
+  const TokenKind ops[] = {TOKEN_LOGICAL_AND};
+  return parse_left_associative(parser, parse_bitwise_or, ops, 1);
+}
+
 static AstNode *parse_bitwise_or(Parser *parser) {
   const TokenKind ops[] = {TOKEN_PIPE};
   return parse_left_associative(parser, parse_bitwise_and, ops, 1);
@@ -0,0 +1,510 @@
+#include "sema/sema.h"
+#include "utils/diagnostic.h"
+#include "utils/attributes.h"
+#include <stdarg.h>
+#include <stdio.h>
+#include <stdlib.h>
+#include <string.h>
+
+#define SEMA_INITIAL_SCOPE_CAPACITY 16
+
+static void *sema_realloc(void *ptr, const size_t size) {
+  void *result = realloc(ptr, size);
+  if (!result) {
+    LOG(FATAL, "out of memory");
+  }
+  return result;
+}
+
+static INLINE uint32_t sema_hash(const char *name, const size_t length) {
+  uint32_t hash = 2166136261u;
+  for (size_t i = 0; i < length; i++) {
+    hash ^= (uint8_t) name[i];
+    hash *= 16777619u;
+  }
+  return hash;
+}
+
+static char *sema_get_source_line(const Sema *sema, const int32_t line) {
+  if (!sema->source_begin || line <= 0) {
+    return NULL;
+  }
+  const char *line_start = sema->source_begin;
+  for (int32_t i = 1; i < line && *line_start; i++) {
+    while (*line_start && *line_start != '\n') {
+      line_start++;
+    }
+    if (*line_start == '\n') {
+      line_start++;
+    }
+  }
+  const char *line_end = line_start;
+  while (*line_end && *line_end != '\n') {
+    line_end++;
+  }
+  size_t len = (size_t) (line_end - line_start);
+  char *buf = malloc(len + 1);
+  if (!buf) {
+    LOG(FATAL, "out of memory");
+  }
+  memcpy(buf, line_start, len);
+  buf[len] = '\0';
+  return buf;
+}
+
+static void sema_report(Sema *sema, const DiagnosticLevel level, const int32_t line, const int32_t column,
+                        const char *fmt, ...) {
+  if (level >= DIAG_LEVEL_ERROR) {
+    sema->had_error = 1;
+  }
+  char message[256];
+  va_list args;
+  va_start(args, fmt);
+  vsnprintf(message, sizeof(message), fmt, args);
+  va_end(args);
+  char *source_line = sema_get_source_line(sema, line);
+  SourceLocation loc = {
+    .filename = sema->filename,
+    .line = line,
+    .column = column,
+    .source_line = source_line
+  };
+  diagnostic_log(level, loc, "%s", message);
+  free(source_line);
+}
+
+#define sema_error_at(sema, node, ...) sema_report((sema), DIAG_LEVEL_ERROR, (node)->line, (node)->column, __VA_ARGS__)
+
+static int32_t sema_add_symbol(Sema *sema, const SemaSymbol symbol) {
+  SemaSymbolVector *vec = &sema->symbols;
+  if (vec->count == vec->capacity) {
+    vec->capacity = vec->capacity ? vec->capacity * 2 : 32;
+    vec->items = sema_realloc(vec->items, vec->capacity * sizeof(SemaSymbol));
+  }
+  vec->items[vec->count] = symbol;
+  return (int32_t) vec->count++;
+}
+
+static void scope_push(Sema *sema) {
+  if (sema->scope_depth == sema->scope_capacity) {
+    int32_t new_cap = sema->scope_capacity ? sema->scope_capacity * 2 : 8;
+    sema->scopes = sema_realloc(sema->scopes, (size_t) new_cap * sizeof(SemaScope));
+    memset(sema->scopes + sema->scope_capacity, 0, (size_t) (new_cap - sema->scope_capacity) * sizeof(SemaScope));
+    sema->scope_capacity = new_cap;
+  }
+  SemaScope *scope = &sema->scopes[sema->scope_depth++];
+  if (!scope->entries) {
+    scope->capacity = SEMA_INITIAL_SCOPE_CAPACITY;
+    scope->entries = sema_realloc(NULL, scope->capacity * sizeof(SemaScopeEntry));
+    memset(scope->entries, 0xff, scope->capacity * sizeof(SemaScopeEntry));
+  }
+  scope->count = 0;
+}
+
+static void scope_pop(Sema *sema) {
+  SemaScope *scope = &sema->scopes[--sema->scope_depth];
+  memset(scope->entries, 0xff, scope->capacity * sizeof(SemaScopeEntry));
+  scope->count = 0;
+}
+
+static int32_t scope_find(const Sema *sema, const SemaScope *scope, const uint32_t hash, const char *name,
+                          const size_t length) {
+  uint32_t mask = scope->capacity - 1;
+  for (uint32_t i = hash & mask;; i = (i + 1) & mask) {
+    const SemaScopeEntry *entry = &scope->entries[i];
+    if (entry->symbol < 0) {
+      return -1;
+    }
+    if (entry->hash == hash) {
+      const SemaSymbol *sym = &sema->symbols.items[entry->symbol];
+      if (sym->length == length && memcmp(sym->name, name, length) == 0) {
+        return entry->symbol;
+      }
+    }
+  }
+}
+
+static void scope_insert_entry(SemaScope *scope, const uint32_t hash, const int32_t symbol) {
+  uint32_t mask = scope->capacity - 1;
+  uint32_t i = hash & mask;
+  while (scope->entries[i].symbol >= 0) {
+    i = (i + 1) & mask;
+  }
+  scope->entries[i].hash = hash;
+  scope->entries[i].symbol = symbol;
+  scope->count++;
+}
+
+static void scope_insert(SemaScope *scope, const uint32_t hash, const int32_t symbol) {
+  if ((scope->count + 1) * 2 > scope->capacity) {
+    SemaScopeEntry *old = scope->entries;
+    uint32_t old_cap = scope->capacity;
+    scope->capacity *= 2;
+    scope->entries = sema_realloc(NULL, scope->capacity * sizeof(SemaScopeEntry));
+    memset(scope->entries, 0xff, scope->capacity * sizeof(SemaScopeEntry));
+    scope->count = 0;
+    for (uint32_t i = 0; i < old_cap; i++) {
+      if (old[i].symbol >= 0) {
+        scope_insert_entry(scope, old[i].hash, old[i].symbol);
+      }
+    }
+    free(old);
+  }
+  scope_insert_entry(scope, hash, symbol);
+}
+
+static int32_t sema_lookup(const Sema *sema, const char *name, const size_t length) {
+  uint32_t hash = sema_hash(name, length);
+  for (int32_t depth = sema->scope_depth - 1; depth >= 0; depth--) {
+    int32_t symbol = scope_find(sema, &sema->scopes[depth], hash, name, length);
+    if (symbol >= 0) {
+      return symbol;
+    }
+  }
+  return AST_NO_SYMBOL;
+}
+
+static int32_t sema_declare(Sema *sema, SemaSymbol symbol) {
+  SemaScope *scope = &sema->scopes[sema->scope_depth - 1];
+  uint32_t hash = sema_hash(symbol.name, symbol.length);
+  int32_t previous = scope_find(sema, scope, hash, symbol.name, symbol.length);
+  if (previous >= 0) {
+    const SemaSymbol *prev = &sema->symbols.items[previous];
+    sema_report(sema, DIAG_LEVEL_ERROR, symbol.line, symbol.column,
+                "redeclaration of '%.*s' (previously declared at line %d)", (int32_t) symbol.length, symbol.name,
+                prev->line);
+    return previous;
+  }
+  if (symbol.kind != SEMA_SYMBOL_FUNCTION) {
+    SemaFunctionInfo *info = &sema->functions[sema->current_function];
+    symbol.function = sema->current_function;
+    symbol.slot = info->local_count++;
+  }
+  int32_t index = sema_add_symbol(sema, symbol);
+  scope_insert(scope, hash, index);
+  return index;
+}
+
+static INLINE int32_t type_is_scalar(const AstType *type) {
+  return type->kind == AST_TYPE_INT || type->kind == AST_TYPE_CHAR;
+}
+
+static const char *type_describe(const AstType *type) {
+  switch (type->kind) {
+    case AST_TYPE_INT: return "int";
+    case AST_TYPE_CHAR: return "char";
+    case AST_TYPE_ARRAY: return type->element_kind == AST_TYPE_CHAR ? "char array" : "int array";
+    default: return "?";
+  }
+}
+
+static const AstType sema_int_type = {AST_TYPE_INT, AST_TYPE_INT, 0};
+
+static AstType sema_expr(Sema *sema, AstNode *node);
+
+static void sema_expect_scalar(Sema *sema, AstNode *node, const AstType *type, const char *what) {
+  if (!type_is_scalar(type)) {
+    sema_error_at(sema, node, "%s must be a scalar, got %s", what, type_describe(type));
+  }
+}
+
+static AstType sema_identifier(Sema *sema, AstNode *node, const int32_t allow_function) {
+  int32_t symbol = sema_lookup(sema, node->data.identifier.name, node->data.identifier.length);
+  node->data.identifier.symbol = symbol;
+  if (symbol == AST_NO_SYMBOL) {
+    sema_error_at(sema, node, "use of undeclared identifier '%s'", node->data.identifier.name);
+    return sema_int_type;
+  }
+  const SemaSymbol *sym = &sema->symbols.items[symbol];
+  if (sym->kind == SEMA_SYMBOL_FUNCTION && !allow_function) {
+    sema_error_at(sema, node, "function '%s' used as a value", node->data.identifier.name);
+    return sema_int_type;
+  }
+  return sym->type;
+}
+
+static AstType sema_call(Sema *sema, AstNode *node) {
+  AstNode *callee = node->data.call.callee;
+  AstNodeVector *args = &node->data.call.args;
+  for (size_t i = 0; i < args->count; i++) {
+    AstType arg_type = sema_expr(sema, args->items[i]);
+    sema_expect_scalar(sema, args->items[i], &arg_type, "call argument");
+  }
+  if (!callee || callee->kind != AST_NODE_IDENTIFIER) {
+    sema_error_at(sema, node, "called object is not a function");
+    if (callee) {
+      sema_expr(sema, callee);
+    }
+    return sema_int_type;
+  }
+  sema_identifier(sema, callee, 1);
+  int32_t symbol = callee->data.identifier.symbol;
+  if (symbol == AST_NO_SYMBOL) {
+    return sema_int_type;
+  }
+  const SemaSymbol *sym = &sema->symbols.items[symbol];
+  if (sym->kind != SEMA_SYMBOL_FUNCTION) {
+    sema_error_at(sema, callee, "called object '%s' is not a function", callee->data.identifier.name);
+    return sema_int_type;
+  }
+  const SemaFunctionInfo *info = &sema->functions[sym->function];
+  if ((int32_t) args->count != info->param_count) {
+    sema_error_at(sema, node, "function '%s' expects %d argument(s), got %zu", callee->data.identifier.name,
+                  info->param_count, args->count);
+  }
+  return sym->type;
+}
+
+static AstType sema_subscript(Sema *sema, AstNode *node) {
+  AstType base_type = sema_expr(sema, node->data.subscript.base);
+  AstType index_type = sema_expr(sema, node->data.subscript.index);
+  sema_expect_scalar(sema, node->data.subscript.index, &index_type, "array index");
+  if (base_type.kind != AST_TYPE_ARRAY) {
+    sema_error_at(sema, node, "subscripted value is not an array");
+    return sema_int_type;
+  }
+  const AstNode *index = node->data.subscript.index;
+  if (index && index->kind == AST_NODE_INT_LITERAL &&
+      (index->data.int_literal.value < 0 || index->data.int_literal.value >= base_type.array_size)) {
+    sema_report(sema, DIAG_LEVEL_WARN, index->line, index->column,
+                "array index %d is out of bounds for array of size %d", index->data.int_literal.value,
+                base_type.array_size);
+  }
+  AstType result = {base_type.element_kind, base_type.element_kind, 0};
+  return result;
+}
+
+static AstType sema_assignment(Sema *sema, AstNode *node) {
+  AstNode *target = node->data.binary.left;
+  AstType target_type = sema_expr(sema, target);
+  AstType value_type = sema_expr(sema, node->data.binary.right);
+  if (!target || (target->kind != AST_NODE_IDENTIFIER && target->kind != AST_NODE_SUBSCRIPT_EXPR)) {
+    sema_error_at(sema, node, "expression is not assignable");
+  } else if (!type_is_scalar(&target_type)) {
+    sema_error_at(sema, node, "cannot assign to a value of type %s", type_describe(&target_type));
+  }
+  sema_expect_scalar(sema, node->data.binary.right, &value_type, "assigned value");
+  return target_type;
+}
+
+static AstType sema_expr(Sema *sema, AstNode *node) {
+  if (!node) {
+    return sema_int_type;
+  }
+  switch (node->kind) {
+    case AST_NODE_INT_LITERAL:
+      return sema_int_type;
+    case AST_NODE_IDENTIFIER:
+      return sema_identifier(sema, node, 0);
+    case AST_NODE_BINARY_EXPR: {
+      if (node->data.binary.op == TOKEN_ASSIGN) {
+        return sema_assignment(sema, node);
+      }
+      AstType left = sema_expr(sema, node->data.binary.left);
+      AstType right = sema_expr(sema, node->data.binary.right);
+      sema_expect_scalar(sema, node->data.binary.left, &left, "operand");
+      sema_expect_scalar(sema, node->data.binary.right, &right, "operand");
+      return sema_int_type;
+    }
+    case AST_NODE_UNARY_EXPR: {
+      AstType operand = sema_expr(sema, node->data.unary.operand);
+      sema_expect_scalar(sema, node->data.unary.operand, &operand, "operand");
+      return sema_int_type;
+    }
+    case AST_NODE_SUBSCRIPT_EXPR:
+      return sema_subscript(sema, node);
+    case AST_NODE_CALL_EXPR:
+      return sema_call(sema, node);
+    case AST_NODE_INIT_LIST:
+      sema_error_at(sema, node, "initializer list is not allowed here");
+      return sema_int_type;
+    default:
+      sema_error_at(sema, node, "expected expression");
+      return sema_int_type;
+  }
+}
+
+static void sema_var_decl(Sema *sema, AstNode *node) {
+  AstType type = node->data.var_decl.type;
+  AstNode *init = node->data.var_decl.initializer;
+  const char *name = node->data.var_decl.name;
+  if (type.kind == AST_TYPE_ARRAY && type.array_size <= 0) {
+    sema_error_at(sema, node, "array '%s' must have a positive size", name);
+  }
+  if (init && type.kind == AST_TYPE_ARRAY) {
+    if (init->kind != AST_NODE_INIT_LIST) {
+      sema_error_at(sema, init, "array '%s' must be initialized with an initializer list", name);
+      sema_expr(sema, init);
+    } else {
+      AstNodeVector *elements = &init->data.init_list.elements;
+      if ((int64_t) elements->count > type.array_size) {
+        sema_error_at(sema, init, "excess elements in initializer of '%s' (%zu > %d)", name, elements->count,
+                      type.array_size);
+      }
+      for (size_t i = 0; i < elements->count; i++) {
+        AstType elem_type = sema_expr(sema, elements->items[i]);
+        sema_expect_scalar(sema, elements->items[i], &elem_type, "array element initializer");
+      }
+    }
+  } else if (init) {
+    if (init->kind == AST_NODE_INIT_LIST) {
+      sema_error_at(sema, init, "scalar '%s' cannot be initialized with an initializer list", name);
+    } else {
+      AstType init_type = sema_expr(sema, init);
+      sema_expect_scalar(sema, init, &init_type, "initializer");
+    }
+  }
+  SemaSymbol symbol = {
+    .kind = SEMA_SYMBOL_LOCAL,
+    .type = type,
+    .name = name,
+    .length = node->data.var_decl.length,
+    .line = node->line,
+    .column = node->column
+  };
+  node->data.var_decl.symbol = sema_declare(sema, symbol);
+}
+
+static void sema_statement(Sema *sema, AstNode *node);
+
+static void sema_block_statements(Sema *sema, AstNode *block) {
+  for (size_t i = 0; i < block->data.block.statements.count; i++) {
+    sema_statement(sema, block->data.block.statements.items[i]);
+  }
+}
+
+static void sema_condition(Sema *sema, AstNode *node) {
+  AstType type = sema_expr(sema, node);
+  sema_expect_scalar(sema, node, &type, "condition");
+}
+
+static void sema_statement(Sema *sema, AstNode *node) {
+  if (!node) {
+    return;
+  }
+  switch (node->kind) {
+    case AST_NODE_BLOCK:
+      scope_push(sema);
+      sema_block_statements(sema, node);
+      scope_pop(sema);
+      break;
+    case AST_NODE_VAR_DECL:
+      sema_var_decl(sema, node);
+      break;
+    case AST_NODE_RETURN_STMT: {
+      AstType type = sema_expr(sema, node->data.return_stmt.expr);
+      sema_expect_scalar(sema, node->data.return_stmt.expr ? node->data.return_stmt.expr : node, &type,
+                         "return value");
+      break;
+    }
+    case AST_NODE_EXPR_STMT:
+      sema_expr(sema, node->data.expr_stmt.expr);
+      break;
+    case AST_NODE_IF_STMT:
+      sema_condition(sema, node->data.if_stmt.condition);
+      sema_statement(sema, node->data.if_stmt.then_branch);
+      sema_statement(sema, node->data.if_stmt.else_branch);
+      break;
+    case AST_NODE_WHILE_STMT:
+      sema_condition(sema, node->data.while_stmt.condition);
+      sema->loop_depth++;
+      sema_statement(sema, node->data.while_stmt.body);
+      sema->loop_depth--;
+      break;
+    case AST_NODE_BREAK_STMT:
+      if (sema->loop_depth == 0) {
+        sema_error_at(sema, node, "'break' statement not in loop");
+      }
+      break;
+    default:
+      sema_error_at(sema, node, "expected statement");
+      break;
+  }
+}
+
+static void sema_function(Sema *sema, AstFunction *fn, const int32_t index) {
+  SemaFunctionInfo *info = &sema->functions[index];
+  info->first_local = (int32_t) sema->symbols.count;
+  info->local_count = 0;
+  sema->current_function = index;
+  sema->loop_depth = 0;
+  scope_push(sema);
+  for (size_t i = 0; i < fn->params.count; i++) {
+    AstParam *param = &fn->params.items[i];
+    SemaSymbol symbol = {
+      .kind = SEMA_SYMBOL_PARAM,
+      .type = param->type,
+      .name = param->name,
+      .length = param->length,
+      .line = param->line,
+      .column = param->column
+    };
+    param->symbol = sema_declare(sema, symbol);
+  }
+  if (fn->body) {
+    sema_block_statements(sema, fn->body);
+  }
+  scope_pop(sema);
+  sema->current_function = -1;
+}
+
+void sema_init(Sema *sema, AstModule *module, const char *source, const char *filename) {
+  memset(sema, 0, sizeof(*sema));
+  sema->module = module;
+  sema->source_begin = source;
+  sema->filename = filename;
+  sema->current_function = -1;
+}
+
+SemaResult sema_analyze(Sema *sema) {
+  AstModule *module = sema->module;
+  size_t fn_count = module ? module->functions.count : 0;
+  sema->functions = calloc(fn_count ? fn_count : 1, sizeof(SemaFunctionInfo));
+  if (!sema->functions) {
+    LOG(FATAL, "out of memory");
+  }
+  scope_push(sema);
+  for (size_t i = 0; i < fn_count; i++) {
+    AstFunction *fn = module->functions.items[i];
+    SemaSymbol symbol = {
+      .kind = SEMA_SYMBOL_FUNCTION,
+      .type = fn->return_type,
+      .name = fn->name,
+      .length = fn->length,
+      .line = fn->line,
+      .column = fn->column,
+      .function = (int32_t) i,
+      .slot = 0
+    };
+    fn->symbol = sema_declare(sema, symbol);
+    sema->functions[i].symbol = fn->symbol;
+    sema->functions[i].param_count = (int32_t) fn->params.count;
+  }
+  for (size_t i = 0; i < fn_count; i++) {
+    sema_function(sema, module->functions.items[i], (int32_t) i);
+  }
+  scope_pop(sema);
+  SemaResult result = {
+    .sema = sema,
+    .had_error = sema->had_error
+  };
+  return result;
+}
+
+INLINE const SemaSymbol *sema_symbol(const Sema *sema, const int32_t symbol) {
+  return &sema->symbols.items[symbol];
+}
+
+INLINE const SemaFunctionInfo *sema_function_info(const Sema *sema, const int32_t function) {
+  return &sema->functions[function];
+}
+
+void sema_destroy(Sema *sema) {
+  for (int32_t i = 0; i < sema->scope_capacity; i++) {
+    free(sema->scopes[i].entries);
+  }
+  free(sema->scopes);
+  free(sema->symbols.items);
+  free(sema->functions);
+  memset(sema, 0, sizeof(*sema));
+}
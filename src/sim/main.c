@@ -0,0 +1,133 @@
+#include <stdio.h>
+#include <stdlib.h>
+#include <string.h>
+#include "sim/sim.h"
+#include "utils/diagnostic.h"
+#include "utils/timing.h"
+
+#define SIM_DEFAULT_MEMORY (64u << 20)
+#define SIM_DEFAULT_STEP_LIMIT 10000000000ull
+
+typedef struct {
+  const char *input;
+  const MachineModel *tune;
+  uint64_t step_limit;
+  uint64_t memory_size;
+  int32_t quiet;
+} SimOptions;
+
+static void print_usage(const char *argv0) {
+  fprintf(stderr,
+          "usage: %s [options] <file.o>\n"
+          "  -mtune=CPU        estimate cycles for a core model: generic, rocket, sifive-7 (default generic)\n"
+          "  --max-steps=N     stop after N retired instructions (default %llu)\n"
+          "  --memory=MIB      size of the simulated memory in MiB (default %u)\n"
+          "  -q                do not print the simulation report\n",
+          argv0, SIM_DEFAULT_STEP_LIMIT, SIM_DEFAULT_MEMORY >> 20);
+}
+
+static int32_t parse_number(const char *text, const char *what, const uint64_t max, uint64_t *out) {
+  char *end;
+  unsigned long long value = strtoull(text, &end, 10);
+  if (*end != '\0' || end == text || value == 0 || value > max) {
+    fprintf(stderr, "invalid %s '%s'\n", what, text);
+    return 0;
+  }
+  *out = value;
+  return 1;
+}
+
+static int32_t parse_options(SimOptions *options, const int argc, char **argv) {
+  memset(options, 0, sizeof(*options));
+  options->step_limit = SIM_DEFAULT_STEP_LIMIT;
+  options->memory_size = SIM_DEFAULT_MEMORY;
+  for (int i = 1; i < argc; i++) {
+    const char *arg = argv[i];
+    if (strncmp(arg, "-mtune=", 7) == 0) {
+      options->tune = machine_model_find(arg + 7);
+      if (!options->tune) {
+        fprintf(stderr, "unknown tuning model '%s'\n", arg + 7);
+        return 0;
+      }
+    } else if (strncmp(arg, "--max-steps=", 12) == 0) {
+      if (!parse_number(arg + 12, "step limit", UINT64_MAX, &options->step_limit)) {
+        return 0;
+      }
+    } else if (strncmp(arg, "--memory=", 9) == 0) {
+      if (!parse_number(arg + 9, "memory size", 4096, &options->memory_size)) {
+        return 0;
+      }
+      options->memory_size <<= 20;
+    } else if (strcmp(arg, "-q") == 0) {
+      options->quiet = 1;
+    } else if (arg[0] == '-') {
+      fprintf(stderr, "unknown option '%s'\n", arg);
+      return 0;
+    } else if (options->input) {
+      fprintf(stderr, "multiple input files are not supported\n");
+      return 0;
+    } else {
+      options->input = arg;
+    }
+  }
+  return options->input != NULL;
+}
+
+static uint8_t *read_file(const char *path, size_t *size) {
+  FILE *f = fopen(path, "rb");
+  if (!f) return NULL;
+  if (fseek(f, 0, SEEK_END) != 0) {
+    fclose(f);
+    return NULL;
+  }
+  long length = ftell(f);
+  if (length < 0) {
+    fclose(f);
+    return NULL;
+  }
+  rewind(f);
+  uint8_t *buffer = malloc((size_t) length + 1);
+  if (!buffer) {
+    fclose(f);
+    return NULL;
+  }
+  *size = fread(buffer, 1, (size_t) length, f);
+  fclose(f);
+  return buffer;
+}
+
+int main(int argc, char **argv) {
+  SimOptions options;
+  if (!parse_options(&options, argc, argv)) {
+    print_usage(argv[0]);
+    return 2;
+  }
+  size_t size = 0;
+  uint8_t *image = read_file(options.input, &size);
+  if (!image) {
+    fprintf(stderr, "cannot read '%s'\n", options.input);
+    return 2;
+  }
+  SimMachine sim;
+  sim_init(&sim, options.memory_size, options.tune);
+  int32_t status = 2;
+  if (sim_load_elf(&sim, image, size)) {
+    double start = timing_now();
+    SimResult result = sim_run(&sim, options.step_limit);
+    double seconds = timing_now() - start;
+    fflush(stdout);
+    if (result.status != SIM_OK) {
+      fprintf(stderr, "simulation stopped at 0x%llx: %s\n", (unsigned long long) result.pc,
+              sim_status_name(result.status));
+    } else {
+      status = (int32_t) (result.value & 0xff);
+    }
+    if (!options.quiet) {
+      fprintf(stderr, "exit value: %lld (model %s)\n", (long long) result.value, sim.model->name);
+      sim_print_stats(&sim.stats, seconds, stderr);
+    }
+  }
+  sim_destroy(&sim);
+  free(image);
+  return status;
+}
@@ -0,0 +1,763 @@
+#include "sim/sim.h"
+#include "utils/diagnostic.h"
+#include <stdlib.h>
+#include <string.h>
+
+#define SIM_BLOCK_MAX_INSTS 64
+#define SIM_MISPREDICT_PENALTY 3
+#define SIM_RETURN_ADDRESS 0
+
+#define SIM_SYS_WRITE 64
+#define SIM_SYS_EXIT 93
+#define SIM_SYS_EXIT_GROUP 94
+#define SIM_EBADF 9
+#define SIM_EFAULT 14
+#define SIM_ENOSYS 38
+
+typedef struct {
+  void *handler;
+  int64_t imm;
+  uint64_t next;
+  uint16_t op;
+  uint8_t rd;
+  uint8_t rs1;
+  uint8_t rs2;
+  uint8_t size;
+  uint8_t backward;
+} SimInst;
+
+struct SimBlock {
+  uint64_t pc;
+  SimBlock *hash_next;
+  SimBlock *succ[2];
+  uint64_t succ_pc[2];
+  uint32_t count;
+  uint32_t loads;
+  uint32_t stores;
+  uint32_t branches;
+  uint32_t jumps;
+  uint32_t vectors;
+  uint32_t cycles;
+  SimInst insts[];
+};
+
+void sim_init(SimMachine *sim, const uint64_t memory_size, const MachineModel *model) {
+  memset(sim, 0, sizeof(*sim));
+  sim->memory = calloc(memory_size, 1);
+  if (!sim->memory) {
+    LOG(FATAL, "out of memory");
+  }
+  sim->memory_size = memory_size;
+  sim->model = model ? model : machine_model_default();
+  arena_init(&sim->arena);
+}
+
+void sim_destroy(SimMachine *sim) {
+  free(sim->memory);
+  arena_destroy(&sim->arena);
+  memset(sim, 0, sizeof(*sim));
+}
+
+static SchedUnit sim_resource(const SimUnit unit) {
+  switch (unit) {
+    case SIM_UNIT_MUL:
+    case SIM_UNIT_DIV: return SCHED_UNIT_MUL;
+    case SIM_UNIT_LOAD:
+    case SIM_UNIT_STORE: return SCHED_UNIT_MEM;
+    default: return SCHED_UNIT_ALU;
+  }
+}
+
+static uint32_t sim_latency(const MachineModel *model, const SimUnit unit) {
+  switch (unit) {
+    case SIM_UNIT_MUL: return model->mul_latency;
+    case SIM_UNIT_DIV: return model->div_latency;
+    case SIM_UNIT_LOAD: return model->load_latency;
+    default: return model->alu_latency;
+  }
+}
+
+static uint32_t sim_block_cycles(const MachineModel *model, const SimInst *insts, const uint32_t count) {
+  uint32_t ready[SIM_REG_COUNT] = {0};
+  uint32_t used[SCHED_UNIT_COUNT] = {0};
+  uint32_t cycle = 0;
+  uint32_t issued = 0;
+  uint32_t div_free = 0;
+  for (uint32_t i = 0; i < count; i++) {
+    const SimInst *inst = &insts[i];
+    SimUnit unit = sim_op_unit((SimOp) inst->op);
+    SchedUnit resource = sim_resource(unit);
+    uint32_t start = ready[inst->rs1] > ready[inst->rs2] ? ready[inst->rs1] : ready[inst->rs2];
+    if (unit == SIM_UNIT_DIV && div_free > start) {
+      start = div_free;
+    }
+    for (;;) {
+      if (start > cycle) {
+        cycle = start;
+        issued = 0;
+        memset(used, 0, sizeof(used));
+      }
+      if (issued < model->issue_width && used[resource] < model->units[resource]) {
+        break;
+      }
+      start = cycle + 1;
+    }
+    issued++;
+    used[resource]++;
+    ready[inst->rd] = cycle + sim_latency(model, unit);
+    if (unit == SIM_UNIT_DIV) {
+      div_free = ready[inst->rd];
+    }
+  }
+  return count > 0 ? cycle + 1 : 0;
+}
+
+static SimBlock *sim_block_build(SimMachine *sim, const uint64_t pc) {
+  SimInst insts[SIM_BLOCK_MAX_INSTS + 1];
+  SimBlock header;
+  memset(&header, 0, sizeof(header));
+  header.pc = pc;
+  uint32_t total = 0;
+  uint64_t at = pc;
+  for (;;) {
+    SimDecoded decoded;
+    uint32_t size = at < sim->memory_size
+                      ? sim_decode(sim->memory + at, sim->memory_size - at, at, sim->xlen, &decoded)
+                      : 0;
+    if (size == 0 || total == SIM_BLOCK_MAX_INSTS) {
+      if (total == 0) {
+        return NULL;
+      }
+      decoded.op = SIM_OP_FALLTHROUGH;
+      decoded.rd = SIM_REG_SINK;
+      decoded.rs1 = decoded.rs2 = 0;
+      decoded.size = 0;
+      decoded.imm = (int64_t) at;
+    } else if (decoded.op == SIM_OP_ILLEGAL) {
+      decoded.imm = (int64_t) at;
+    }
+    SimInst *inst = &insts[total++];
+    inst->handler = sim->handlers[decoded.op];
+    inst->imm = decoded.imm;
+    inst->next = at + decoded.size;
+    inst->op = (uint16_t) decoded.op;
+    inst->rd = decoded.rd;
+    inst->rs1 = decoded.rs1;
+    inst->rs2 = decoded.rs2;
+    inst->size = decoded.size;
+    inst->backward = decoded.imm <= (int64_t) at;
+    at = inst->next;
+    SimUnit unit = sim_op_unit(decoded.op);
+    if (unit == SIM_UNIT_NONE) {
+      break;
+    }
+    header.count++;
+    header.loads += unit == SIM_UNIT_LOAD;
+    header.stores += unit == SIM_UNIT_STORE;
+    header.branches += unit == SIM_UNIT_BRANCH;
+    header.jumps += unit == SIM_UNIT_JUMP;
+    header.vectors += (sim_op_flags(decoded.op) & SIM_OPF_VECTOR) != 0;
+    if (unit == SIM_UNIT_BRANCH || unit == SIM_UNIT_JUMP || unit == SIM_UNIT_SYSTEM) {
+      break;
+    }
+  }
+  header.cycles = sim_block_cycles(sim->model, insts, header.count);
+  SimBlock *block = arena_alloc(&sim->arena, sizeof(SimBlock) + total * sizeof(SimInst));
+  if (!block) {
+    LOG(FATAL, "out of memory");
+  }
+  *block = header;
+  memcpy(block->insts, insts, total * sizeof(SimInst));
+  return block;
+}
+
+static SimBlock *sim_block_at(SimMachine *sim, const uint64_t pc, SimResult *result) {
+  result->pc = pc;
+  if (pc == SIM_RETURN_ADDRESS) {
+    result->status = SIM_OK;
+    return NULL;
+  }
+  if ((pc & 1) != 0) {
+    result->status = SIM_FETCH_FAULT;
+    return NULL;
+  }
+  SimBlock **bucket = &sim->buckets[(pc >> 1) & (SIM_BLOCK_BUCKETS - 1)];
+  for (SimBlock *block = *bucket; block; block = block->hash_next) {
+    if (block->pc == pc) {
+      return block;
+    }
+  }
+  SimBlock *block = sim_block_build(sim, pc);
+  if (!block) {
+    result->status = SIM_FETCH_FAULT;
+    return NULL;
+  }
+  block->hash_next = *bucket;
+  *bucket = block;
+  sim->stats.blocks++;
+  return block;
+}
+
+static uint64_t sim_write(const SimMachine *sim, const uint64_t fd, const uint64_t buffer, const uint64_t length) {
+  FILE *out = fd == 1 ? stdout : fd == 2 ? stderr : NULL;
+  if (!out) {
+    return (uint64_t) -SIM_EBADF;
+  }
+  if (buffer > sim->memory_size || length > sim->memory_size - buffer) {
+    return (uint64_t) -SIM_EFAULT;
+  }
+  return fwrite(sim->memory + buffer, 1, length, out);
+}
+
+static uint64_t sim_sext32(const uint64_t value) {
+  return (uint64_t) (int64_t) (int32_t) (uint32_t) value;
+}
+
+static uint64_t sim_div(const int64_t a, const int64_t b) {
+  return (uint64_t) (b == 0 ? -1 : b == -1 && a == INT64_MIN ? a : a / b);
+}
+
+static uint64_t sim_rem(const int64_t a, const int64_t b) {
+  return (uint64_t) (b == 0 ? a : b == -1 ? 0 : a % b);
+}
+
+static uint64_t sim_divw(const int32_t a, const int32_t b) {
+  return sim_sext32((uint64_t) (b == 0 ? -1 : b == -1 && a == INT32_MIN ? a : a / b));
+}
+
+static uint64_t sim_remw(const int32_t a, const int32_t b) {
+  return sim_sext32((uint64_t) (b == 0 ? a : b == -1 ? 0 : a % b));
+}
+
+static int64_t sim_vsext(const uint64_t value, const uint32_t bytes) {
+  uint32_t shift = 64 - bytes * 8;
+  return (int64_t) (value << shift) >> shift;
+}
+
+static uint64_t sim_vzext(const int64_t value, const uint32_t bytes) {
+  return bytes == 8 ? (uint64_t) value : (uint64_t) value & ((1ull << (bytes * 8)) - 1);
+}
+
+static int32_t sim_vfits(const SimMachine *sim, const uint32_t reg, const uint32_t bytes) {
+  return sim->vsew != 0 && bytes != 0 && (uint64_t) reg * SIM_VLENB + sim->vl * bytes <= sizeof(sim->vregs);
+}
+
+static int64_t sim_vget(const SimMachine *sim, const uint32_t reg, const uint64_t index, const uint32_t bytes) {
+  uint64_t value = 0;
+  const uint8_t *at = sim->vregs + reg * SIM_VLENB + index * bytes;
+  for (uint32_t b = 0; b < bytes; b++) {
+    value |= (uint64_t) at[b] << (b * 8);
+  }
+  return sim_vsext(value, bytes);
+}
+
+static void sim_vput(SimMachine *sim, const uint32_t reg, const uint64_t index, const uint32_t bytes,
+                     const uint64_t value) {
+  uint8_t *at = sim->vregs + reg * SIM_VLENB + index * bytes;
+  for (uint32_t b = 0; b < bytes; b++) {
+    at[b] = (uint8_t) (value >> (b * 8));
+  }
+}
+
+static int32_t sim_vmask(const SimMachine *sim, const uint64_t index) {
+  return (sim->vregs[index / 8] >> (index % 8)) & 1;
+}
+
+static void sim_vput_mask(SimMachine *sim, const uint32_t reg, const uint64_t index, const int32_t bit) {
+  uint8_t *at = &sim->vregs[reg * SIM_VLENB + index / 8];
+  *at = (uint8_t) ((*at & ~(1u << (index % 8))) | ((uint32_t) (bit != 0) << (index % 8)));
+}
+
+static uint64_t sim_vsetvli(SimMachine *sim, const uint64_t avl, const int32_t keep, const uint64_t vtype) {
+  uint32_t sew = 8u << ((vtype >> 3) & 7);
+  uint32_t lmul = vtype & 7;
+  if (sew > 64 || lmul == 4 || (vtype >> 8) != 0) {
+    sim->vtype = 1ull << (sim->xlen - 1);
+    sim->vsew = 0;
+    sim->vl = 0;
+    return 0;
+  }
+  uint64_t vlmax = lmul < 4 ? ((uint64_t) SIM_VLEN / sew) << lmul : ((uint64_t) SIM_VLEN / sew) >> (8 - lmul);
+  sim->vtype = vtype;
+  sim->vsew = sew / 8;
+  if (!keep) {
+    sim->vl = avl < vlmax ? avl : vlmax;
+  } else if (sim->vl > vlmax) {
+    sim->vl = vlmax;
+  }
+  return sim->vl;
+}
+
+#pragma GCC diagnostic push
+#pragma GCC diagnostic ignored "-Wpedantic"
+
+SimResult sim_run(SimMachine *sim, const uint64_t step_limit) {
+  static void *const handlers[SIM_OP_COUNT] = {
+#define SIM_OP(name, unit, format, opcode, funct3, funct7, flags) &&op_##name,
+#include "sim/sim_ops.def"
+#define SIM_VOP(name, unit, format, opcode, funct3, funct6, vs1, flags) &&op_##name,
+#include "sim/sim_rvv.def"
+  };
+  sim->handlers = handlers;
+  SimResult result = {SIM_OK, 0, sim->entry};
+  uint64_t *x = sim->regs;
+  uint8_t *memory = sim->memory;
+  const uint64_t size = sim->memory_size;
+  SimStats stats = sim->stats;
+  const SimInst *inst = NULL;
+  SimBlock *block = sim_block_at(sim, sim->entry, &result);
+  if (!block) {
+    goto stop;
+  }
+
+#define RS1 x[inst->rs1]
+#define RS2 x[inst->rs2]
+#define IMM inst->imm
+#define SIM_NEXT()         \
+  do {                     \
+    inst++;                \
+    goto *inst->handler;   \
+  } while (0)
+#define SIM_ENTER(slot, target)                                     \
+  do {                                                              \
+    uint64_t pc = (target);                                         \
+    if (block->succ_pc[slot] != pc || !block->succ[slot]) {         \
+      SimBlock *next = sim_block_at(sim, pc, &result);              \
+      if (!next) {                                                  \
+        goto stop;                                                  \
+      }                                                             \
+      block->succ[slot] = next;                                     \
+      block->succ_pc[slot] = pc;                                    \
+    }                                                               \
+    block = block->succ[slot];                                      \
+    goto enter;                                                     \
+  } while (0)
+#define SIM_ALU(name, expr)         \
+  op_##name:                        \
+  x[inst->rd] = (uint64_t) (expr);  \
+  SIM_NEXT();
+#define SIM_LOAD(name, type, cast)                 \
+  op_##name: {                                     \
+    uint64_t address = RS1 + (uint64_t) IMM;       \
+    type value;                                    \
+    if (address > size - sizeof(type)) {           \
+      goto memory_fault;                           \
+    }                                              \
+    memcpy(&value, memory + address, sizeof(type)); \
+    x[inst->rd] = (uint64_t) (cast) value;         \
+    SIM_NEXT();                                    \
+  }
+#define SIM_STORE(name, type)                      \
+  op_##name: {                                     \
+    uint64_t address = RS1 + (uint64_t) IMM;       \
+    type value = (type) RS2;                       \
+    if (address > size - sizeof(type)) {           \
+      goto memory_fault;                           \
+    }                                              \
+    memcpy(memory + address, &value, sizeof(type)); \
+    SIM_NEXT();                                    \
+  }
+#define SIM_BRANCH(name, cond) \
+  op_##name:                   \
+  if (cond) {                  \
+    goto taken;                \
+  }                            \
+  goto not_taken;
+#define SEW sim->vsew
+#define SIM_VCHECK(reg, bytes)           \
+  if (!sim_vfits(sim, (reg), (bytes))) { \
+    goto vector_fault;                   \
+  }
+#define SIM_VBINARY(name, vector_rs1, operand, expr)    \
+  op_##name:                                            \
+  SIM_VCHECK(inst->rd, SEW)                             \
+  SIM_VCHECK(inst->rs2, SEW)                            \
+  SIM_VCHECK((vector_rs1) ? inst->rs1 : inst->rs2, SEW) \
+  for (uint64_t i = 0; i < sim->vl; i++) {              \
+    int64_t a = sim_vget(sim, inst->rs2, i, SEW);       \
+    int64_t b = (operand);                              \
+    sim_vput(sim, inst->rd, i, SEW, (uint64_t) (expr)); \
+  }                                                     \
+  SIM_NEXT();
+#define SIM_VCOMPARE(name, vector_rs1, operand, cond)   \
+  op_##name:                                            \
+  SIM_VCHECK(inst->rs2, SEW)                            \
+  SIM_VCHECK((vector_rs1) ? inst->rs1 : inst->rs2, SEW) \
+  for (uint64_t i = 0; i < sim->vl; i++) {              \
+    int64_t a = sim_vget(sim, inst->rs2, i, SEW);       \
+    int64_t b = (operand);                              \
+    sim_vput_mask(sim, inst->rd, i, cond);              \
+  }                                                     \
+  SIM_NEXT();
+#define SIM_VV(name, expr) SIM_VBINARY(name##_VV, 1, sim_vget(sim, inst->rs1, i, SEW), expr)
+#define SIM_VX(name, expr) SIM_VBINARY(name##_VX, 0, sim_vsext(RS1, SEW), expr)
+#define SIM_VI(name, expr) SIM_VBINARY(name##_VI, 0, IMM, expr)
+#define SIM_VMS_VV(name, cond) SIM_VCOMPARE(name##_VV, 1, sim_vget(sim, inst->rs1, i, SEW), cond)
+#define SIM_VMS_VX(name, cond) SIM_VCOMPARE(name##_VX, 0, sim_vsext(RS1, SEW), cond)
+#define SIM_VREDUCE(name, expr)                      \
+  op_##name:                                         \
+  SIM_VCHECK(inst->rs2, SEW)                         \
+  if (sim->vl > 0) {                                 \
+    int64_t acc = sim_vget(sim, inst->rs1, 0, SEW);  \
+    for (uint64_t i = 0; i < sim->vl; i++) {         \
+      int64_t a = sim_vget(sim, inst->rs2, i, SEW);  \
+      acc = (expr);                                  \
+    }                                                \
+    sim_vput(sim, inst->rd, 0, SEW, (uint64_t) acc); \
+  }                                                  \
+  SIM_NEXT();
+#define SIM_VLOAD(name, bytes)                                                      \
+  op_##name: {                                                                      \
+    uint64_t address = RS1;                                                         \
+    SIM_VCHECK(inst->rd, bytes)                                                     \
+    if (address > size || sim->vl * (bytes) > size - address) {                     \
+      goto memory_fault;                                                            \
+    }                                                                               \
+    memcpy(sim->vregs + inst->rd * SIM_VLENB, memory + address, sim->vl * (bytes)); \
+    SIM_NEXT();                                                                     \
+  }
+#define SIM_VSTORE(name, bytes)                                                      \
+  op_##name: {                                                                       \
+    uint64_t address = RS1;                                                          \
+    SIM_VCHECK(inst->rs2, bytes)                                                     \
+    if (address > size || sim->vl * (bytes) > size - address) {                      \
+      goto memory_fault;                                                             \
+    }                                                                                \
+    memcpy(memory + address, sim->vregs + inst->rs2 * SIM_VLENB, sim->vl * (bytes)); \
+    SIM_NEXT();                                                                      \
+  }
+#define SIM_VSHIFT(b) ((b) & (SEW * 8 - 1))
+
+enter:
+  if (stats.instructions >= step_limit) {
+    result.status = SIM_STEP_LIMIT;
+    result.pc = block->pc;
+    goto stop;
+  }
+  stats.instructions += block->count;
+  stats.loads += block->loads;
+  stats.stores += block->stores;
+  stats.branches += block->branches;
+  stats.jumps += block->jumps;
+  stats.vector_insts += block->vectors;
+  stats.cycles += block->cycles;
+  inst = block->insts;
+  goto *inst->handler;
+
+  SIM_ALU(LUI, IMM)
+  SIM_ALU(AUIPC, IMM)
+  SIM_ALU(ADDI, RS1 + (uint64_t) IMM)
+  SIM_ALU(SLTI, (int64_t) RS1 < IMM)
+  SIM_ALU(SLTIU, RS1 < (uint64_t) IMM)
+  SIM_ALU(XORI, RS1 ^ (uint64_t) IMM)
+  SIM_ALU(ORI, RS1 | (uint64_t) IMM)
+  SIM_ALU(ANDI, RS1 & (uint64_t) IMM)
+  SIM_ALU(SLLI, RS1 << IMM)
+  SIM_ALU(SRLI, RS1 >> IMM)
+  SIM_ALU(SRAI, (int64_t) RS1 >> IMM)
+  SIM_ALU(ADD, RS1 + RS2)
+  SIM_ALU(SUB, RS1 - RS2)
+  SIM_ALU(SLL, RS1 << (RS2 & 63))
+  SIM_ALU(SLT, (int64_t) RS1 < (int64_t) RS2)
+  SIM_ALU(SLTU, RS1 < RS2)
+  SIM_ALU(XOR, RS1 ^ RS2)
+  SIM_ALU(SRL, RS1 >> (RS2 & 63))
+  SIM_ALU(SRA, (int64_t) RS1 >> (RS2 & 63))
+  SIM_ALU(OR, RS1 | RS2)
+  SIM_ALU(AND, RS1 & RS2)
+  SIM_ALU(ADDIW, sim_sext32(RS1 + (uint64_t) IMM))
+  SIM_ALU(SLLIW, sim_sext32((uint32_t) RS1 << IMM))
+  SIM_ALU(SRLIW, sim_sext32((uint32_t) RS1 >> IMM))
+  SIM_ALU(SRAIW, (int64_t) ((int32_t) RS1 >> IMM))
+  SIM_ALU(ADDW, sim_sext32(RS1 + RS2))
+  SIM_ALU(SUBW, sim_sext32(RS1 - RS2))
+  SIM_ALU(SLLW, sim_sext32((uint32_t) RS1 << (RS2 & 31)))
+  SIM_ALU(SRLW, sim_sext32((uint32_t) RS1 >> (RS2 & 31)))
+  SIM_ALU(SRAW, (int64_t) ((int32_t) RS1 >> (RS2 & 31)))
+  SIM_ALU(MUL, RS1 * RS2)
+  SIM_ALU(MULH, ((__int128) (int64_t) RS1 * (int64_t) RS2) >> 64)
+  SIM_ALU(MULHSU, ((__int128) (int64_t) RS1 * (__int128) RS2) >> 64)
+  SIM_ALU(MULHU, ((unsigned __int128) RS1 * RS2) >> 64)
+  SIM_ALU(DIV, sim_div((int64_t) RS1, (int64_t) RS2))
+  SIM_ALU(DIVU, RS2 == 0 ? UINT64_MAX : RS1 / RS2)
+  SIM_ALU(REM, sim_rem((int64_t) RS1, (int64_t) RS2))
+  SIM_ALU(REMU, RS2 == 0 ? RS1 : RS1 % RS2)
+  SIM_ALU(MULW, sim_sext32((uint32_t) RS1 * (uint32_t) RS2))
+  SIM_ALU(DIVW, sim_divw((int32_t) RS1, (int32_t) RS2))
+  SIM_ALU(DIVUW, sim_sext32((uint32_t) RS2 == 0 ? UINT32_MAX : (uint32_t) RS1 / (uint32_t) RS2))
+  SIM_ALU(REMW, sim_remw((int32_t) RS1, (int32_t) RS2))
+  SIM_ALU(REMUW, sim_sext32((uint32_t) RS2 == 0 ? (uint32_t) RS1 : (uint32_t) RS1 % (uint32_t) RS2))
+  SIM_ALU(MULH32, sim_sext32((uint64_t) ((int64_t) (int32_t) RS1 * (int32_t) RS2) >> 32))
+  SIM_ALU(MULHSU32, sim_sext32((uint64_t) ((int64_t) (int32_t) RS1 * (int64_t) (uint32_t) RS2) >> 32))
+  SIM_ALU(MULHU32, sim_sext32((uint64_t) (uint32_t) RS1 * (uint32_t) RS2 >> 32))
+
+  SIM_LOAD(LB, int8_t, int64_t)
+  SIM_LOAD(LH, int16_t, int64_t)
+  SIM_LOAD(LW, int32_t, int64_t)
+  SIM_LOAD(LD, uint64_t, uint64_t)
+  SIM_LOAD(LBU, uint8_t, uint64_t)
+  SIM_LOAD(LHU, uint16_t, uint64_t)
+  SIM_LOAD(LWU, uint32_t, uint64_t)
+  SIM_STORE(SB, uint8_t)
+  SIM_STORE(SH, uint16_t)
+  SIM_STORE(SW, uint32_t)
+  SIM_STORE(SD, uint64_t)
+
+  SIM_BRANCH(BEQ, RS1 == RS2)
+  SIM_BRANCH(BNE, RS1 != RS2)
+  SIM_BRANCH(BLT, (int64_t) RS1 < (int64_t) RS2)
+  SIM_BRANCH(BGE, (int64_t) RS1 >= (int64_t) RS2)
+  SIM_BRANCH(BLTU, RS1 < RS2)
+  SIM_BRANCH(BGEU, RS1 >= RS2)
+
+op_VSETVLI:
+  x[inst->rd] = sim_vsetvli(sim, inst->rs1 == 0 ? UINT64_MAX : RS1, inst->rs1 == 0 && inst->rd == SIM_REG_SINK,
+                            (uint64_t) IMM);
+  SIM_NEXT();
+
+  SIM_VLOAD(VLE8_V, 1)
+  SIM_VLOAD(VLE32_V, 4)
+  SIM_VSTORE(VSE8_V, 1)
+  SIM_VSTORE(VSE32_V, 4)
+
+  SIM_VV(VADD, a + b)
+  SIM_VX(VADD, a + b)
+  SIM_VI(VADD, a + b)
+  SIM_VV(VSUB, a - b)
+  SIM_VX(VSUB, a - b)
+  SIM_VX(VRSUB, b - a)
+  SIM_VV(VAND, a & b)
+  SIM_VX(VAND, a & b)
+  SIM_VV(VOR, a | b)
+  SIM_VX(VOR, a | b)
+  SIM_VV(VXOR, a ^ b)
+  SIM_VX(VXOR, a ^ b)
+  SIM_VI(VXOR, a ^ b)
+  SIM_VV(VSLL, (uint64_t) a << SIM_VSHIFT(b))
+  SIM_VX(VSLL, (uint64_t) a << SIM_VSHIFT(b))
+  SIM_VI(VSLL, (uint64_t) a << SIM_VSHIFT(b))
+  SIM_VV(VSRL, sim_vzext(a, SEW) >> SIM_VSHIFT(b))
+  SIM_VX(VSRL, sim_vzext(a, SEW) >> SIM_VSHIFT(b))
+  SIM_VV(VSRA, a >> SIM_VSHIFT(b))
+  SIM_VX(VSRA, a >> SIM_VSHIFT(b))
+  SIM_VI(VSRA, a >> SIM_VSHIFT(b))
+  SIM_VV(VMUL, (uint64_t) a * (uint64_t) b)
+  SIM_VX(VMUL, (uint64_t) a * (uint64_t) b)
+  SIM_VV(VMULH, ((__int128) a * b) >> (SEW * 8))
+  SIM_VX(VMULH, ((__int128) a * b) >> (SEW * 8))
+  SIM_VV(VMULHU, ((unsigned __int128) sim_vzext(a, SEW) * sim_vzext(b, SEW)) >> (SEW * 8))
+  SIM_VX(VMULHU, ((unsigned __int128) sim_vzext(a, SEW) * sim_vzext(b, SEW)) >> (SEW * 8))
+
+  SIM_VMS_VV(VMSEQ, a == b)
+  SIM_VMS_VX(VMSEQ, a == b)
+  SIM_VMS_VV(VMSNE, a != b)
+  SIM_VMS_VX(VMSNE, a != b)
+  SIM_VMS_VV(VMSLT, a < b)
+  SIM_VMS_VX(VMSLT, a < b)
+  SIM_VMS_VV(VMSLE, a <= b)
+  SIM_VMS_VX(VMSLE, a <= b)
+  SIM_VMS_VX(VMSGT, a > b)
+
+  SIM_VREDUCE(VREDSUM_VS, (int64_t) ((uint64_t) acc + (uint64_t) a))
+  SIM_VREDUCE(VREDAND_VS, acc & a)
+  SIM_VREDUCE(VREDOR_VS, acc | a)
+  SIM_VREDUCE(VREDXOR_VS, acc ^ a)
+
+op_VMV_V_X:
+  SIM_VCHECK(inst->rd, SEW)
+  for (uint64_t i = 0; i < sim->vl; i++) {
+    sim_vput(sim, inst->rd, i, SEW, RS1);
+  }
+  SIM_NEXT();
+
+op_VMERGE_VIM:
+  SIM_VCHECK(inst->rd, SEW)
+  SIM_VCHECK(inst->rs2, SEW)
+  for (uint64_t i = 0; i < sim->vl; i++) {
+    sim_vput(sim, inst->rd, i, SEW, sim_vmask(sim, i) ? (uint64_t) IMM : (uint64_t) sim_vget(sim, inst->rs2, i, SEW));
+  }
+  SIM_NEXT();
+
+op_VNSRL_WI:
+  SIM_VCHECK(inst->rd, SEW)
+  SIM_VCHECK(inst->rs2, SEW * 2)
+  if (SEW > 4) {
+    goto vector_fault;
+  }
+  for (uint64_t i = 0; i < sim->vl; i++) {
+    uint64_t wide = sim_vzext(sim_vget(sim, inst->rs2, i, SEW * 2), SEW * 2);
+    sim_vput(sim, inst->rd, i, SEW, wide >> (IMM & (SEW * 16 - 1)));
+  }
+  SIM_NEXT();
+
+op_VSEXT_VF4:
+  SIM_VCHECK(inst->rd, SEW)
+  SIM_VCHECK(inst->rs2, SEW / 4)
+  for (uint64_t i = 0; i < sim->vl; i++) {
+    sim_vput(sim, inst->rd, i, SEW, (uint64_t) sim_vget(sim, inst->rs2, i, SEW / 4));
+  }
+  SIM_NEXT();
+
+op_VID_V:
+  SIM_VCHECK(inst->rd, SEW)
+  for (uint64_t i = 0; i < sim->vl; i++) {
+    sim_vput(sim, inst->rd, i, SEW, i);
+  }
+  SIM_NEXT();
+
+op_VMV_X_S:
+  if (SEW == 0) {
+    goto vector_fault;
+  }
+  x[inst->rd] = (uint64_t) sim_vget(sim, inst->rs2, 0, SEW);
+  if (sim->xlen == 32) {
+    x[inst->rd] = sim_sext32(x[inst->rd]);
+  }
+  SIM_NEXT();
+
+taken:
+  stats.taken_branches++;
+  stats.mispredicts += !inst->backward;
+  stats.cycles += !inst->backward * SIM_MISPREDICT_PENALTY;
+  SIM_ENTER(0, (uint64_t) IMM);
+
+not_taken:
+  stats.mispredicts += inst->backward;
+  stats.cycles += inst->backward * SIM_MISPREDICT_PENALTY;
+  SIM_ENTER(1, inst->next);
+
+op_JAL:
+  x[inst->rd] = inst->next;
+  if (inst->rd == RV_RA) {
+    sim->returns[sim->return_top++ % SIM_RETURN_STACK] = inst->next;
+  }
+  SIM_ENTER(0, (uint64_t) IMM);
+
+op_JALR: {
+  uint64_t target = (RS1 + (uint64_t) IMM) & ~(uint64_t) 1;
+  uint64_t predicted = block->succ_pc[0];
+  if (inst->rd == SIM_REG_SINK && inst->rs1 == RV_RA && sim->return_top > 0) {
+    predicted = sim->returns[--sim->return_top % SIM_RETURN_STACK];
+  } else if (inst->rd == RV_RA) {
+    sim->returns[sim->return_top++ % SIM_RETURN_STACK] = inst->next;
+  }
+  if (predicted != target) {
+    stats.mispredicts++;
+    stats.cycles += SIM_MISPREDICT_PENALTY;
+  }
+  x[inst->rd] = inst->next;
+  SIM_ENTER(0, target);
+}
+
+op_FENCE:
+  SIM_NEXT();
+
+op_ECALL:
+  switch (x[RV_A7]) {
+    case SIM_SYS_EXIT:
+    case SIM_SYS_EXIT_GROUP:
+      result.status = SIM_OK;
+      result.pc = inst->next - inst->size;
+      goto stop;
+    case SIM_SYS_WRITE:
+      x[RV_A0] = sim_write(sim, x[RV_A0], x[RV_A0 + 1], x[RV_A0 + 2]);
+      break;
+    default:
+      x[RV_A0] = (uint64_t) -SIM_ENOSYS;
+      break;
+  }
+  SIM_ENTER(1, inst->next);
+
+op_EBREAK:
+  result.status = SIM_BREAKPOINT;
+  result.pc = inst->next - inst->size;
+  goto stop;
+
+op_FALLTHROUGH:
+  SIM_ENTER(1, (uint64_t) IMM);
+
+op_ILLEGAL:
+  result.status = SIM_ILLEGAL_INSTRUCTION;
+  result.pc = (uint64_t) IMM;
+  goto stop;
+
+vector_fault:
+  result.status = SIM_ILLEGAL_INSTRUCTION;
+  result.pc = inst->next - inst->size;
+  goto stop;
+
+memory_fault:
+  result.status = SIM_MEMORY_FAULT;
+  result.pc = inst->next - inst->size;
+
+stop:
+  result.value = (int64_t) x[RV_A0];
+  stats.blocks = sim->stats.blocks;
+  sim->stats = stats;
+  return result;
+
+#undef RS1
+#undef RS2
+#undef IMM
+#undef SIM_NEXT
+#undef SIM_ENTER
+#undef SIM_ALU
+#undef SIM_LOAD
+#undef SIM_STORE
+#undef SIM_BRANCH
+#undef SEW
+#undef SIM_VCHECK
+#undef SIM_VBINARY
+#undef SIM_VCOMPARE
+#undef SIM_VV
+#undef SIM_VX
+#undef SIM_VI
+#undef SIM_VMS_VV
+#undef SIM_VMS_VX
+#undef SIM_VREDUCE
+#undef SIM_VLOAD
+#undef SIM_VSTORE
+#undef SIM_VSHIFT
+}
+
+#pragma GCC diagnostic pop
+
+void sim_print_stats(const SimStats *stats, const double seconds, FILE *out) {
+  const struct {
+    const char *name;
+    uint64_t value;
+  } counters[] = {
+    {"instructions", stats->instructions},
+    {"loads", stats->loads},
+    {"stores", stats->stores},
+    {"branches", stats->branches},
+    {"taken branches", stats->taken_branches},
+    {"mispredicts", stats->mispredicts},
+    {"jumps", stats->jumps},
+    {"vector insts", stats->vector_insts},
+    {"cycles", stats->cycles},
+    {"cached blocks", stats->blocks},
+  };
+  fprintf(out, "simulation report:\n");
+  for (size_t i = 0; i < sizeof(counters) / sizeof(counters[0]); i++) {
+    fprintf(out, "  %-16s %llu\n", counters[i].name, (unsigned long long) counters[i].value);
+  }
+  if (stats->cycles > 0) {
+    fprintf(out, "  %-16s %.3f\n", "ipc", (double) stats->instructions / (double) stats->cycles);
+  }
+  if (seconds > 0) {
+    fprintf(out, "  %-16s %.1f\n", "host mips", (double) stats->instructions / seconds / 1e6);
+  }
+}
+
+const char *sim_status_name(const SimStatus status) {
+  switch (status) {
+    case SIM_OK: return "ok";
+    case SIM_MEMORY_FAULT: return "memory fault";
+    case SIM_FETCH_FAULT: return "fetch fault";
+    case SIM_ILLEGAL_INSTRUCTION: return "illegal instruction";
+    case SIM_BREAKPOINT: return "breakpoint";
+    case SIM_STEP_LIMIT: return "step limit exceeded";
+    default: return "?";
+  }
+}
@@ -0,0 +1,358 @@
+#include "sim/sim_decode.h"
+
+typedef enum {
+  SIM_FMT_R,
+  SIM_FMT_I,
+  SIM_FMT_S,
+  SIM_FMT_B,
+  SIM_FMT_U,
+  SIM_FMT_J,
+  SIM_FMT_SHIFT,
+  SIM_FMT_SYSTEM,
+  SIM_FMT_NONE,
+  SIM_FMT_VSETVLI,
+  SIM_FMT_VLOAD,
+  SIM_FMT_VSTORE,
+  SIM_FMT_VV,
+  SIM_FMT_VX,
+  SIM_FMT_VI,
+  SIM_FMT_VSPLAT,
+  SIM_FMT_VUNARY,
+  SIM_FMT_VINDEX,
+  SIM_FMT_VTOX
+} SimFormat;
+
+typedef struct {
+  const char *name;
+  SimUnit unit;
+  SimFormat format;
+  uint8_t opcode;
+  uint8_t funct3;
+  uint8_t funct7;
+  uint8_t vs1;
+  uint32_t flags;
+} SimOpInfo;
+
+static const SimOpInfo sim_op_infos[SIM_OP_COUNT] = {
+#define SIM_OP(name, unit, format, opcode, funct3, funct7, flags) \
+  {#name, SIM_UNIT_##unit, SIM_FMT_##format, opcode, funct3, funct7, 0, flags},
+#include "sim/sim_ops.def"
+#define SIM_VOP(name, unit, format, opcode, funct3, funct6, vs1, flags) \
+  {#name, SIM_UNIT_##unit, SIM_FMT_##format, opcode, funct3, funct6, vs1, (flags) | SIM_OPF_VECTOR},
+#include "sim/sim_rvv.def"
+};
+
+static const SimOp sim_rv32_ops[][2] = {
+  {SIM_OP_ADD, SIM_OP_ADDW},     {SIM_OP_SUB, SIM_OP_SUBW},       {SIM_OP_SLL, SIM_OP_SLLW},
+  {SIM_OP_SRL, SIM_OP_SRLW},     {SIM_OP_SRA, SIM_OP_SRAW},       {SIM_OP_ADDI, SIM_OP_ADDIW},
+  {SIM_OP_SLLI, SIM_OP_SLLIW},   {SIM_OP_SRLI, SIM_OP_SRLIW},     {SIM_OP_SRAI, SIM_OP_SRAIW},
+  {SIM_OP_MUL, SIM_OP_MULW},     {SIM_OP_MULH, SIM_OP_MULH32},    {SIM_OP_MULHSU, SIM_OP_MULHSU32},
+  {SIM_OP_MULHU, SIM_OP_MULHU32}, {SIM_OP_DIV, SIM_OP_DIVW},      {SIM_OP_DIVU, SIM_OP_DIVUW},
+  {SIM_OP_REM, SIM_OP_REMW},     {SIM_OP_REMU, SIM_OP_REMUW},
+};
+
+SimUnit sim_op_unit(const SimOp op) {
+  return sim_op_infos[op].unit;
+}
+
+uint32_t sim_op_flags(const SimOp op) {
+  return sim_op_infos[op].flags;
+}
+
+const char *sim_op_name(const SimOp op) {
+  return sim_op_infos[op].name;
+}
+
+static uint32_t sim_field(const uint32_t bits, const uint32_t pos, const uint32_t width) {
+  return (bits >> pos) & ((1u << width) - 1);
+}
+
+static int64_t sim_sext(const uint64_t value, const uint32_t width) {
+  uint32_t shift = 64 - width;
+  return (int64_t) (value << shift) >> shift;
+}
+
+static uint8_t sim_rd(const uint32_t reg) {
+  return (uint8_t) (reg == 0 ? SIM_REG_SINK : reg);
+}
+
+static uint32_t sim_set(SimDecoded *out, const SimOp op, const uint32_t rd, const uint32_t rs1, const uint32_t rs2,
+                        const int64_t imm) {
+  out->op = op;
+  out->rd = sim_rd(rd);
+  out->rs1 = (uint8_t) rs1;
+  out->rs2 = (uint8_t) rs2;
+  out->imm = imm;
+  return out->size;
+}
+
+static uint32_t sim_set_vector(SimDecoded *out, const SimOp op, const uint32_t vd, const uint32_t rs1,
+                               const uint32_t vs2, const int64_t imm) {
+  out->op = op;
+  out->rd = (uint8_t) vd;
+  out->rs1 = (uint8_t) rs1;
+  out->rs2 = (uint8_t) vs2;
+  out->imm = imm;
+  return out->size;
+}
+
+static uint32_t sim_illegal(SimDecoded *out) {
+  return sim_set(out, SIM_OP_ILLEGAL, 0, 0, 0, 0);
+}
+
+static int32_t sim_matches(const SimOpInfo *info, const uint32_t bits, const int32_t xlen) {
+  uint32_t funct7 = sim_field(bits, 25, 7);
+  switch (info->format) {
+    case SIM_FMT_NONE:
+      return 0;
+    case SIM_FMT_U:
+    case SIM_FMT_J:
+      return 1;
+    case SIM_FMT_SYSTEM:
+      return bits >> 20 == info->funct7 && sim_field(bits, 7, 13) == 0;
+    case SIM_FMT_I:
+    case SIM_FMT_S:
+    case SIM_FMT_B:
+      return sim_field(bits, 12, 3) == info->funct3;
+    case SIM_FMT_SHIFT:
+      if (xlen == 64 && info->opcode == 0x13) {
+        funct7 &= 0x7e;
+      }
+      return sim_field(bits, 12, 3) == info->funct3 && funct7 == info->funct7;
+    case SIM_FMT_R:
+      return sim_field(bits, 12, 3) == info->funct3 && funct7 == info->funct7;
+    case SIM_FMT_VSETVLI:
+      return sim_field(bits, 12, 3) == info->funct3 && sim_field(bits, 31, 1) == 0;
+    case SIM_FMT_VLOAD:
+    case SIM_FMT_VSTORE:
+      return sim_field(bits, 12, 3) == info->funct3 && sim_field(bits, 25, 7) == 1 && sim_field(bits, 20, 5) == 0;
+    case SIM_FMT_VV:
+    case SIM_FMT_VX:
+    case SIM_FMT_VI:
+    case SIM_FMT_VSPLAT:
+    case SIM_FMT_VUNARY:
+    case SIM_FMT_VINDEX:
+    case SIM_FMT_VTOX:
+      if (sim_field(bits, 12, 3) != info->funct3 || sim_field(bits, 26, 6) != info->funct7 ||
+          sim_field(bits, 25, 1) != !(info->flags & SIM_OPF_VMASK)) {
+        return 0;
+      }
+      if (info->format == SIM_FMT_VSPLAT || info->format == SIM_FMT_VINDEX) {
+        if (sim_field(bits, 20, 5) != 0) {
+          return 0;
+        }
+      }
+      if (info->format == SIM_FMT_VUNARY || info->format == SIM_FMT_VINDEX || info->format == SIM_FMT_VTOX) {
+        return sim_field(bits, 15, 5) == info->vs1;
+      }
+      return 1;
+  }
+  return 0;
+}
+
+static SimOp sim_narrow(const SimOp op) {
+  for (size_t i = 0; i < sizeof(sim_rv32_ops) / sizeof(sim_rv32_ops[0]); i++) {
+    if (sim_rv32_ops[i][0] == op) {
+      return sim_rv32_ops[i][1];
+    }
+  }
+  return op;
+}
+
+static uint32_t sim_decode_full(const uint32_t bits, const uint64_t pc, const int32_t xlen, SimDecoded *out) {
+  uint32_t opcode = bits & 0x7f;
+  uint32_t rd = sim_field(bits, 7, 5);
+  uint32_t rs1 = sim_field(bits, 15, 5);
+  uint32_t rs2 = sim_field(bits, 20, 5);
+  for (uint32_t op = 0; op < SIM_OP_COUNT; op++) {
+    const SimOpInfo *info = &sim_op_infos[op];
+    if (info->opcode != opcode || !sim_matches(info, bits, xlen)) {
+      continue;
+    }
+    if ((info->flags & SIM_OPF_RV64) && xlen != 64) {
+      return sim_illegal(out);
+    }
+    SimOp sim_op = xlen == 64 ? (SimOp) op : sim_narrow((SimOp) op);
+    switch (info->format) {
+      case SIM_FMT_R:
+        return sim_set(out, sim_op, rd, rs1, rs2, 0);
+      case SIM_FMT_I:
+        return sim_set(out, sim_op, rd, rs1, 0, sim_sext(bits >> 20, 12));
+      case SIM_FMT_SHIFT:
+        return sim_set(out, sim_op, rd, rs1, 0, sim_field(bits, 20, xlen == 64 && opcode == 0x13 ? 6 : 5));
+      case SIM_FMT_S:
+        return sim_set(out, sim_op, 0, rs1, rs2, sim_sext((bits >> 25) << 5 | rd, 12));
+      case SIM_FMT_B: {
+        uint32_t offset = sim_field(bits, 31, 1) << 12 | sim_field(bits, 7, 1) << 11 | sim_field(bits, 25, 6) << 5 |
+                          sim_field(bits, 8, 4) << 1;
+        return sim_set(out, sim_op, 0, rs1, rs2, (int64_t) pc + sim_sext(offset, 13));
+      }
+      case SIM_FMT_U: {
+        int64_t imm = sim_sext(bits & 0xfffff000u, 32);
+        return sim_set(out, sim_op, rd, 0, 0, sim_op == SIM_OP_AUIPC ? (int64_t) pc + imm : imm);
+      }
+      case SIM_FMT_J: {
+        uint32_t offset = sim_field(bits, 31, 1) << 20 | sim_field(bits, 12, 8) << 12 | sim_field(bits, 20, 1) << 11 |
+                          sim_field(bits, 21, 10) << 1;
+        return sim_set(out, sim_op, rd, 0, 0, (int64_t) pc + sim_sext(offset, 21));
+      }
+      case SIM_FMT_SYSTEM:
+      case SIM_FMT_NONE:
+        return sim_set(out, sim_op, 0, 0, 0, 0);
+      case SIM_FMT_VSETVLI:
+        return sim_set(out, sim_op, rd, rs1, 0, sim_field(bits, 20, 11));
+      case SIM_FMT_VLOAD:
+      case SIM_FMT_VV:
+      case SIM_FMT_VX:
+      case SIM_FMT_VSPLAT:
+        return sim_set_vector(out, sim_op, rd, rs1, rs2, 0);
+      case SIM_FMT_VSTORE:
+        return sim_set_vector(out, sim_op, SIM_REG_SINK, rs1, rd, 0);
+      case SIM_FMT_VI:
+        return sim_set_vector(out, sim_op, rd, 0, rs2, sim_sext(rs1, 5));
+      case SIM_FMT_VUNARY:
+      case SIM_FMT_VINDEX:
+        return sim_set_vector(out, sim_op, rd, 0, rs2, 0);
+      case SIM_FMT_VTOX:
+        return sim_set(out, sim_op, rd, 0, rs2, 0);
+    }
+  }
+  return sim_illegal(out);
+}
+
+static uint32_t sim_creg(const uint32_t bits, const uint32_t pos) {
+  return 8 + sim_field(bits, pos, 3);
+}
+
+static uint32_t sim_decode_q0(const uint32_t bits, const int32_t xlen, SimDecoded *out) {
+  uint32_t rd = sim_creg(bits, 2);
+  uint32_t rs1 = sim_creg(bits, 7);
+  uint32_t word = sim_field(bits, 10, 3) << 3 | sim_field(bits, 6, 1) << 2 | sim_field(bits, 5, 1) << 6;
+  uint32_t dword = sim_field(bits, 10, 3) << 3 | sim_field(bits, 5, 2) << 6;
+  switch (sim_field(bits, 13, 3)) {
+    case 0: {
+      uint32_t imm = sim_field(bits, 11, 2) << 4 | sim_field(bits, 7, 4) << 6 | sim_field(bits, 6, 1) << 2 |
+                     sim_field(bits, 5, 1) << 3;
+      return imm == 0 ? sim_illegal(out) : sim_set(out, xlen == 64 ? SIM_OP_ADDI : SIM_OP_ADDIW, rd, 2, 0, imm);
+    }
+    case 2: return sim_set(out, SIM_OP_LW, rd, rs1, 0, word);
+    case 3: return xlen == 64 ? sim_set(out, SIM_OP_LD, rd, rs1, 0, dword) : sim_illegal(out);
+    case 6: return sim_set(out, SIM_OP_SW, 0, rs1, rd, word);
+    case 7: return xlen == 64 ? sim_set(out, SIM_OP_SD, 0, rs1, rd, dword) : sim_illegal(out);
+    default: return sim_illegal(out);
+  }
+}
+
+static uint32_t sim_decode_q1(const uint32_t bits, const uint64_t pc, const int32_t xlen, SimDecoded *out) {
+  uint32_t rd = sim_field(bits, 7, 5);
+  uint32_t crd = sim_creg(bits, 7);
+  uint32_t crs2 = sim_creg(bits, 2);
+  int64_t imm = sim_sext(sim_field(bits, 12, 1) << 5 | sim_field(bits, 2, 5), 6);
+  SimOp add = xlen == 64 ? SIM_OP_ADDI : SIM_OP_ADDIW;
+  uint32_t jump = sim_field(bits, 12, 1) << 11 | sim_field(bits, 11, 1) << 4 | sim_field(bits, 9, 2) << 8 |
+                  sim_field(bits, 8, 1) << 10 | sim_field(bits, 7, 1) << 6 | sim_field(bits, 6, 1) << 7 |
+                  sim_field(bits, 3, 3) << 1 | sim_field(bits, 2, 1) << 5;
+  uint32_t branch = sim_field(bits, 12, 1) << 8 | sim_field(bits, 10, 2) << 3 | sim_field(bits, 5, 2) << 6 |
+                    sim_field(bits, 3, 2) << 1 | sim_field(bits, 2, 1) << 5;
+  switch (sim_field(bits, 13, 3)) {
+    case 0: return sim_set(out, add, rd, rd, 0, imm);
+    case 1:
+      if (xlen == 64) {
+        return rd == 0 ? sim_illegal(out) : sim_set(out, SIM_OP_ADDIW, rd, rd, 0, imm);
+      }
+      return sim_set(out, SIM_OP_JAL, 1, 0, 0, (int64_t) pc + sim_sext(jump, 12));
+    case 2: return sim_set(out, add, rd, 0, 0, imm);
+    case 3:
+      if (rd == 2) {
+        uint32_t offset = sim_field(bits, 12, 1) << 9 | sim_field(bits, 6, 1) << 4 | sim_field(bits, 5, 1) << 6 |
+                          sim_field(bits, 3, 2) << 7 | sim_field(bits, 2, 1) << 5;
+        return offset == 0 ? sim_illegal(out) : sim_set(out, add, 2, 2, 0, sim_sext(offset, 10));
+      }
+      return imm == 0 ? sim_illegal(out) : sim_set(out, SIM_OP_LUI, rd, 0, 0, imm * 4096);
+    case 4: {
+      uint32_t shamt = sim_field(bits, 12, 1) << 5 | sim_field(bits, 2, 5);
+      if (xlen == 32 && shamt >= 32 && sim_field(bits, 10, 2) < 2) {
+        return sim_illegal(out);
+      }
+      switch (sim_field(bits, 10, 2)) {
+        case 0: return sim_set(out, xlen == 64 ? SIM_OP_SRLI : SIM_OP_SRLIW, crd, crd, 0, shamt);
+        case 1: return sim_set(out, xlen == 64 ? SIM_OP_SRAI : SIM_OP_SRAIW, crd, crd, 0, shamt);
+        case 2: return sim_set(out, SIM_OP_ANDI, crd, crd, 0, imm);
+        default: break;
+      }
+      static const SimOp arith[2][4] = {{SIM_OP_SUB, SIM_OP_XOR, SIM_OP_OR, SIM_OP_AND},
+                                        {SIM_OP_SUBW, SIM_OP_ADDW, SIM_OP_ILLEGAL, SIM_OP_ILLEGAL}};
+      SimOp op = arith[sim_field(bits, 12, 1)][sim_field(bits, 5, 2)];
+      if (op == SIM_OP_ILLEGAL || (sim_field(bits, 12, 1) && xlen != 64)) {
+        return sim_illegal(out);
+      }
+      return sim_set(out, xlen == 64 ? op : sim_narrow(op), crd, crd, crs2, 0);
+    }
+    case 5: return sim_set(out, SIM_OP_JAL, 0, 0, 0, (int64_t) pc + sim_sext(jump, 12));
+    case 6: return sim_set(out, SIM_OP_BEQ, 0, crd, 0, (int64_t) pc + sim_sext(branch, 9));
+    default: return sim_set(out, SIM_OP_BNE, 0, crd, 0, (int64_t) pc + sim_sext(branch, 9));
+  }
+}
+
+static uint32_t sim_decode_q2(const uint32_t bits, const int32_t xlen, SimDecoded *out) {
+  uint32_t rd = sim_field(bits, 7, 5);
+  uint32_t rs2 = sim_field(bits, 2, 5);
+  uint32_t high = sim_field(bits, 12, 1);
+  switch (sim_field(bits, 13, 3)) {
+    case 0: {
+      uint32_t shamt = high << 5 | rs2;
+      if (xlen == 32 && high) {
+        return sim_illegal(out);
+      }
+      return sim_set(out, xlen == 64 ? SIM_OP_SLLI : SIM_OP_SLLIW, rd, rd, 0, shamt);
+    }
+    case 2: {
+      uint32_t offset = high << 5 | sim_field(bits, 4, 3) << 2 | sim_field(bits, 2, 2) << 6;
+      return rd == 0 ? sim_illegal(out) : sim_set(out, SIM_OP_LW, rd, 2, 0, offset);
+    }
+    case 3: {
+      uint32_t offset = high << 5 | sim_field(bits, 5, 2) << 3 | sim_field(bits, 2, 3) << 6;
+      return rd == 0 || xlen != 64 ? sim_illegal(out) : sim_set(out, SIM_OP_LD, rd, 2, 0, offset);
+    }
+    case 4:
+      if (rs2 != 0) {
+        SimOp add = xlen == 64 ? SIM_OP_ADD : SIM_OP_ADDW;
+        return sim_set(out, add, rd, high ? rd : 0, rs2, 0);
+      }
+      if (rd == 0) {
+        return high ? sim_set(out, SIM_OP_EBREAK, 0, 0, 0, 0) : sim_illegal(out);
+      }
+      return sim_set(out, SIM_OP_JALR, high, rd, 0, 0);
+    case 6: {
+      uint32_t offset = sim_field(bits, 9, 4) << 2 | sim_field(bits, 7, 2) << 6;
+      return sim_set(out, SIM_OP_SW, 0, 2, rs2, offset);
+    }
+    case 7: {
+      uint32_t offset = sim_field(bits, 10, 3) << 3 | sim_field(bits, 7, 3) << 6;
+      return xlen == 64 ? sim_set(out, SIM_OP_SD, 0, 2, rs2, offset) : sim_illegal(out);
+    }
+    default: return sim_illegal(out);
+  }
+}
+
+uint32_t sim_decode(const uint8_t *code, const size_t available, const uint64_t pc, const int32_t xlen,
+                    SimDecoded *out) {
+  if (available < 2) {
+    return 0;
+  }
+  uint32_t bits = (uint32_t) code[0] | (uint32_t) code[1] << 8;
+  if ((bits & 3) != 3) {
+    out->size = 2;
+    switch (bits & 3) {
+      case 0: return bits == 0 ? sim_illegal(out) : sim_decode_q0(bits, xlen, out);
+      case 1: return sim_decode_q1(bits, pc, xlen, out);
+      default: return sim_decode_q2(bits, xlen, out);
+    }
+  }
+  if (available < 4) {
+    return 0;
+  }
+  bits |= (uint32_t) code[2] << 16 | (uint32_t) code[3] << 24;
+  out->size = 4;
+  return sim_decode_full(bits, pc, xlen, out);
+}
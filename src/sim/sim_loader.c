@@ -0,0 +1,450 @@
+#include "sim/sim.h"
+#include "target/elf_writer.h"
+#include "utils/diagnostic.h"
+#include <stdlib.h>
+#include <string.h>
+
+#define SIM_LOAD_BASE 0x10000u
+#define SIM_STACK_ALIGN 16u
+
+#define SIM_ET_REL 1
+#define SIM_ET_EXEC 2
+#define SIM_PT_LOAD 1
+#define SIM_SHT_SYMTAB 2
+#define SIM_SHT_RELA 4
+#define SIM_SHT_NOBITS 8
+#define SIM_SHF_ALLOC 0x2u
+#define SIM_SHN_UNDEF 0
+#define SIM_SHN_ABS 0xfff1u
+
+typedef struct {
+  const uint8_t *image;
+  size_t size;
+  int32_t is64;
+  uint32_t word;
+} SimElf;
+
+typedef struct {
+  uint32_t name;
+  uint32_t type;
+  uint64_t flags;
+  uint64_t offset;
+  uint64_t size;
+  uint32_t link;
+  uint32_t info;
+  uint64_t align;
+  uint64_t entsize;
+} SimSection;
+
+typedef struct {
+  uint64_t offset;
+  uint32_t symbol;
+  uint32_t type;
+  int64_t addend;
+} SimReloc;
+
+typedef struct {
+  SimSection *sections;
+  uint64_t *base;
+  uint32_t count;
+  uint32_t symtab;
+} SimObject;
+
+static int32_t sim_elf_fits(const SimElf *elf, const uint64_t offset, const uint64_t size) {
+  return offset <= elf->size && size <= elf->size - offset;
+}
+
+static uint64_t sim_elf_read(const SimElf *elf, const uint64_t offset, const uint32_t bytes) {
+  uint64_t value = 0;
+  for (uint32_t i = 0; i < bytes; i++) {
+    value |= (uint64_t) elf->image[offset + i] << (8 * i);
+  }
+  return value;
+}
+
+static int32_t sim_mem_fits(const SimMachine *sim, const uint64_t address, const uint64_t size) {
+  return address <= sim->memory_size && size <= sim->memory_size - address;
+}
+
+static uint32_t sim_mem_read32(const SimMachine *sim, const uint64_t address) {
+  uint32_t value;
+  memcpy(&value, sim->memory + address, sizeof(value));
+  return value;
+}
+
+static void sim_mem_write32(SimMachine *sim, const uint64_t address, const uint32_t value) {
+  memcpy(sim->memory + address, &value, sizeof(value));
+}
+
+static void sim_mem_write16(SimMachine *sim, const uint64_t address, const uint16_t value) {
+  memcpy(sim->memory + address, &value, sizeof(value));
+}
+
+static uint32_t sim_bits(const int64_t value, const uint32_t high, const uint32_t low, const uint32_t pos) {
+  return (uint32_t) (((uint64_t) value >> low) & ((1u << (high - low + 1)) - 1)) << pos;
+}
+
+static int32_t sim_fits(const int64_t value, const uint32_t bits) {
+  int64_t limit = (int64_t) 1 << (bits - 1);
+  return value >= -limit && value < limit;
+}
+
+static uint32_t sim_patch_b(const uint32_t inst, const int64_t offset) {
+  return (inst & 0x01fff07fu) | sim_bits(offset, 12, 12, 31) | sim_bits(offset, 10, 5, 25) |
+         sim_bits(offset, 4, 1, 8) | sim_bits(offset, 11, 11, 7);
+}
+
+static uint32_t sim_patch_j(const uint32_t inst, const int64_t offset) {
+  return (inst & 0xfffu) | sim_bits(offset, 20, 20, 31) | sim_bits(offset, 10, 1, 21) | sim_bits(offset, 11, 11, 20) |
+         sim_bits(offset, 19, 12, 12);
+}
+
+static uint32_t sim_patch_u(const uint32_t inst, const int64_t value) {
+  return (inst & 0xfffu) | (uint32_t) ((uint64_t) (value + 0x800) & 0xfffff000u);
+}
+
+static uint32_t sim_patch_i(const uint32_t inst, const int64_t value) {
+  return (inst & 0xfffffu) | sim_bits(value, 11, 0, 20);
+}
+
+static uint32_t sim_patch_s(const uint32_t inst, const int64_t value) {
+  return (inst & 0x01fff07fu) | sim_bits(value, 11, 5, 25) | sim_bits(value, 4, 0, 7);
+}
+
+static uint16_t sim_patch_cb(const uint32_t inst, const int64_t offset) {
+  return (uint16_t) ((inst & 0xe383u) | sim_bits(offset, 8, 8, 12) | sim_bits(offset, 4, 3, 10) |
+                     sim_bits(offset, 7, 6, 5) | sim_bits(offset, 2, 1, 3) | sim_bits(offset, 5, 5, 2));
+}
+
+static uint16_t sim_patch_cj(const uint32_t inst, const int64_t offset) {
+  return (uint16_t) ((inst & 0xe003u) | sim_bits(offset, 11, 11, 12) | sim_bits(offset, 4, 4, 11) |
+                     sim_bits(offset, 9, 8, 9) | sim_bits(offset, 10, 10, 8) | sim_bits(offset, 6, 6, 7) |
+                     sim_bits(offset, 7, 7, 6) | sim_bits(offset, 3, 1, 3) | sim_bits(offset, 5, 5, 2));
+}
+
+static int32_t sim_patch(SimMachine *sim, const uint64_t place, const uint32_t type, const int64_t value) {
+  int64_t offset = value - (int64_t) place;
+  uint32_t inst = type == R_RISCV_RVC_BRANCH || type == R_RISCV_RVC_JUMP
+                    ? sim->memory[place] | (uint32_t) sim->memory[place + 1] << 8
+                    : sim_mem_read32(sim, place);
+  switch (type) {
+    case R_RISCV_32:
+      sim_mem_write32(sim, place, (uint32_t) value);
+      return 1;
+    case R_RISCV_64:
+      memcpy(sim->memory + place, &value, sizeof(value));
+      return 1;
+    case R_RISCV_BRANCH:
+      sim_mem_write32(sim, place, sim_patch_b(inst, offset));
+      return sim_fits(offset, 13);
+    case R_RISCV_JAL:
+      sim_mem_write32(sim, place, sim_patch_j(inst, offset));
+      return sim_fits(offset, 21);
+    case R_RISCV_CALL:
+    case R_RISCV_CALL_PLT:
+      sim_mem_write32(sim, place, sim_patch_u(inst, offset));
+      sim_mem_write32(sim, place + 4, sim_patch_i(sim_mem_read32(sim, place + 4), offset));
+      return sim_fits(offset, 32);
+    case R_RISCV_HI20:
+      sim_mem_write32(sim, place, sim_patch_u(inst, value));
+      return sim_fits(value, 32);
+    case R_RISCV_PCREL_HI20:
+      sim_mem_write32(sim, place, sim_patch_u(inst, offset));
+      return sim_fits(offset, 32);
+    case R_RISCV_LO12_I:
+    case R_RISCV_PCREL_LO12_I:
+      sim_mem_write32(sim, place, sim_patch_i(inst, value));
+      return 1;
+    case R_RISCV_LO12_S:
+    case R_RISCV_PCREL_LO12_S:
+      sim_mem_write32(sim, place, sim_patch_s(inst, value));
+      return 1;
+    case R_RISCV_RVC_BRANCH:
+      sim_mem_write16(sim, place, sim_patch_cb(inst, offset));
+      return sim_fits(offset, 9);
+    case R_RISCV_RVC_JUMP:
+      sim_mem_write16(sim, place, sim_patch_cj(inst, offset));
+      return sim_fits(offset, 12);
+    default:
+      return 1;
+  }
+}
+
+static int32_t sim_apply_reloc(SimMachine *sim, const uint64_t place, const uint32_t type, const int64_t value,
+                               const char *name) {
+  uint32_t size;
+  switch (type) {
+    case R_RISCV_ALIGN:
+    case R_RISCV_RELAX:
+      return 1;
+    case R_RISCV_32:
+    case R_RISCV_BRANCH:
+    case R_RISCV_JAL:
+    case R_RISCV_HI20:
+    case R_RISCV_LO12_I:
+    case R_RISCV_LO12_S:
+    case R_RISCV_PCREL_HI20:
+    case R_RISCV_PCREL_LO12_I:
+    case R_RISCV_PCREL_LO12_S: size = 4; break;
+    case R_RISCV_64:
+    case R_RISCV_CALL:
+    case R_RISCV_CALL_PLT: size = 8; break;
+    case R_RISCV_RVC_BRANCH:
+    case R_RISCV_RVC_JUMP: size = 2; break;
+    default:
+      LOG(ERROR, "sim: unsupported relocation type %u against '%s'", type, name);
+      return 0;
+  }
+  if (!sim_mem_fits(sim, place, size)) {
+    LOG(ERROR, "sim: relocation at 0x%llx is outside memory", (unsigned long long) place);
+    return 0;
+  }
+  if (!sim_patch(sim, place, type, value)) {
+    LOG(ERROR, "sim: relocation against '%s' at 0x%llx is out of range", name, (unsigned long long) place);
+    return 0;
+  }
+  return 1;
+}
+
+static SimSection sim_read_section(const SimElf *elf, const uint64_t at) {
+  SimSection section;
+  uint32_t w = elf->word;
+  section.name = (uint32_t) sim_elf_read(elf, at, 4);
+  section.type = (uint32_t) sim_elf_read(elf, at + 4, 4);
+  section.flags = sim_elf_read(elf, at + 8, w);
+  section.offset = sim_elf_read(elf, at + 8 + 2 * w, w);
+  section.size = sim_elf_read(elf, at + 8 + 3 * w, w);
+  section.link = (uint32_t) sim_elf_read(elf, at + 8 + 4 * w, 4);
+  section.info = (uint32_t) sim_elf_read(elf, at + 12 + 4 * w, 4);
+  section.align = sim_elf_read(elf, at + 16 + 4 * w, w);
+  section.entsize = sim_elf_read(elf, at + 16 + 5 * w, w);
+  return section;
+}
+
+static int32_t sim_symbol(const SimElf *elf, const SimObject *object, const uint32_t index, uint64_t *address,
+                          const char **name) {
+  const SimSection *symtab = &object->sections[object->symtab];
+  uint64_t entsize = elf->is64 ? 24 : 16;
+  uint64_t at = symtab->offset + index * entsize;
+  if ((uint64_t) index >= symtab->size / entsize) {
+    return 0;
+  }
+  uint32_t name_offset = (uint32_t) sim_elf_read(elf, at, 4);
+  uint64_t value = sim_elf_read(elf, at + (elf->is64 ? 8 : 4), elf->word);
+  uint32_t shndx = (uint32_t) sim_elf_read(elf, at + (elf->is64 ? 6 : 14), 2);
+  const SimSection *strtab = symtab->link < object->count ? &object->sections[symtab->link] : NULL;
+  *name = strtab && name_offset < strtab->size ? (const char *) elf->image + strtab->offset + name_offset : "";
+  if (shndx == SIM_SHN_ABS) {
+    *address = value;
+    return 1;
+  }
+  if (shndx == SIM_SHN_UNDEF || shndx >= object->count || !(object->sections[shndx].flags & SIM_SHF_ALLOC)) {
+    return 0;
+  }
+  *address = object->base[shndx] + value;
+  return 1;
+}
+
+static SimReloc sim_read_reloc(const SimElf *elf, const uint64_t at) {
+  SimReloc reloc;
+  uint64_t info = sim_elf_read(elf, at + elf->word, elf->word);
+  reloc.offset = sim_elf_read(elf, at, elf->word);
+  reloc.symbol = (uint32_t) (elf->is64 ? info >> 32 : info >> 8);
+  reloc.type = (uint32_t) (elf->is64 ? info & 0xffffffffu : info & 0xffu);
+  reloc.addend = (int64_t) sim_elf_read(elf, at + 2 * elf->word, elf->word);
+  if (!elf->is64) {
+    reloc.addend = (int32_t) reloc.addend;
+  }
+  return reloc;
+}
+
+static int32_t sim_reloc_target(const SimElf *elf, const SimObject *object, const SimReloc *reloc, int64_t *target,
+                                const char **name) {
+  uint64_t address = 0;
+  *name = "";
+  if (reloc->symbol != 0 && !sim_symbol(elf, object, reloc->symbol, &address, name)) {
+    LOG(ERROR, "sim: undefined symbol '%s'", *name);
+    return 0;
+  }
+  *target = (int64_t) address + reloc->addend;
+  return 1;
+}
+
+static int32_t sim_pcrel_offset(const SimElf *elf, const SimObject *object, const SimSection *rela,
+                                const uint64_t auipc, int64_t *offset) {
+  uint64_t entsize = elf->is64 ? 24 : 12;
+  uint64_t base = object->base[rela->info];
+  for (uint64_t at = rela->offset; at + entsize <= rela->offset + rela->size; at += entsize) {
+    SimReloc reloc = sim_read_reloc(elf, at);
+    const char *name;
+    if (reloc.type == R_RISCV_PCREL_HI20 && base + reloc.offset == auipc) {
+      if (!sim_reloc_target(elf, object, &reloc, offset, &name)) {
+        return 0;
+      }
+      *offset -= (int64_t) auipc;
+      return 1;
+    }
+  }
+  LOG(ERROR, "sim: no R_RISCV_PCREL_HI20 relocation at 0x%llx", (unsigned long long) auipc);
+  return 0;
+}
+
+static int32_t sim_relocate(SimMachine *sim, const SimElf *elf, const SimObject *object, const SimSection *rela) {
+  uint64_t entsize = elf->is64 ? 24 : 12;
+  if (rela->info >= object->count || !(object->sections[rela->info].flags & SIM_SHF_ALLOC)) {
+    return 1;
+  }
+  uint64_t base = object->base[rela->info];
+  for (uint64_t at = rela->offset; at + entsize <= rela->offset + rela->size; at += entsize) {
+    SimReloc reloc = sim_read_reloc(elf, at);
+    int64_t target;
+    const char *name;
+    if (!sim_reloc_target(elf, object, &reloc, &target, &name)) {
+      return 0;
+    }
+    if ((reloc.type == R_RISCV_PCREL_LO12_I || reloc.type == R_RISCV_PCREL_LO12_S) &&
+        !sim_pcrel_offset(elf, object, rela, (uint64_t) target, &target)) {
+      return 0;
+    }
+    if (!sim_apply_reloc(sim, base + reloc.offset, reloc.type, target, name)) {
+      return 0;
+    }
+  }
+  return 1;
+}
+
+static int32_t sim_find_entry(SimMachine *sim, const SimElf *elf, const SimObject *object) {
+  static const char *const entries[] = {"_start", "main"};
+  const SimSection *symtab = &object->sections[object->symtab];
+  uint32_t count = (uint32_t) (symtab->size / (elf->is64 ? 24 : 16));
+  for (size_t e = 0; e < sizeof(entries) / sizeof(entries[0]); e++) {
+    for (uint32_t i = 1; i < count; i++) {
+      uint64_t address;
+      const char *name;
+      if (sim_symbol(elf, object, i, &address, &name) && strcmp(name, entries[e]) == 0) {
+        sim->entry = address;
+        return 1;
+      }
+    }
+  }
+  LOG(ERROR, "sim: object defines neither _start nor main");
+  return 0;
+}
+
+static int32_t sim_load_relocatable(SimMachine *sim, const SimElf *elf, SimObject *object) {
+  uint64_t address = SIM_LOAD_BASE;
+  object->symtab = 0;
+  for (uint32_t s = 1; s < object->count; s++) {
+    const SimSection *section = &object->sections[s];
+    if (section->type == SIM_SHT_SYMTAB) {
+      object->symtab = s;
+    }
+    if (!(section->flags & SIM_SHF_ALLOC)) {
+      continue;
+    }
+    uint64_t align = section->align > 1 ? section->align : 1;
+    address = (address + align - 1) & ~(align - 1);
+    if (!sim_mem_fits(sim, address, section->size)) {
+      LOG(ERROR, "sim: sections do not fit into %llu bytes of memory", (unsigned long long) sim->memory_size);
+      return 0;
+    }
+    object->base[s] = address;
+    if (section->type != SIM_SHT_NOBITS) {
+      memcpy(sim->memory + address, elf->image + section->offset, section->size);
+    }
+    address += section->size;
+  }
+  if (object->symtab == 0 || object->sections[object->symtab].offset + object->sections[object->symtab].size >
+                                 elf->size) {
+    LOG(ERROR, "sim: relocatable object has no symbol table");
+    return 0;
+  }
+  for (uint32_t s = 1; s < object->count; s++) {
+    if (object->sections[s].type == SIM_SHT_RELA && !sim_relocate(sim, elf, object, &object->sections[s])) {
+      return 0;
+    }
+  }
+  return sim_find_entry(sim, elf, object);
+}
+
+static int32_t sim_load_executable(SimMachine *sim, const SimElf *elf) {
+  uint32_t w = elf->word;
+  uint64_t phoff = sim_elf_read(elf, 24 + w, w);
+  uint32_t phentsize = (uint32_t) sim_elf_read(elf, 24 + 3 * w + 6, 2);
+  uint32_t phnum = (uint32_t) sim_elf_read(elf, 24 + 3 * w + 8, 2);
+  if (!sim_elf_fits(elf, phoff, (uint64_t) phentsize * phnum) || phentsize < (elf->is64 ? 56u : 32u)) {
+    LOG(ERROR, "sim: malformed program header table");
+    return 0;
+  }
+  for (uint32_t p = 0; p < phnum; p++) {
+    uint64_t at = phoff + (uint64_t) p * phentsize;
+    if (sim_elf_read(elf, at, 4) != SIM_PT_LOAD) {
+      continue;
+    }
+    uint64_t base = at + (elf->is64 ? 8 : 4);
+    uint64_t offset = sim_elf_read(elf, base, w);
+    uint64_t vaddr = sim_elf_read(elf, base + w, w);
+    uint64_t filesz = sim_elf_read(elf, base + 3 * w, w);
+    uint64_t memsz = sim_elf_read(elf, base + 4 * w, w);
+    if (filesz > memsz || !sim_elf_fits(elf, offset, filesz) || !sim_mem_fits(sim, vaddr, memsz)) {
+      LOG(ERROR, "sim: segment at 0x%llx does not fit into memory", (unsigned long long) vaddr);
+      return 0;
+    }
+    memcpy(sim->memory + vaddr, elf->image + offset, filesz);
+  }
+  sim->entry = sim_elf_read(elf, 24, w);
+  return 1;
+}
+
+int32_t sim_load_elf(SimMachine *sim, const uint8_t *image, const size_t size) {
+  SimElf elf = {image, size, 0, 4};
+  if (size < 52 || memcmp(image, "\x7f" "ELF", 4) != 0 || (image[4] != 1 && image[4] != 2) || image[5] != 1) {
+    LOG(ERROR, "sim: not a little-endian ELF file");
+    return 0;
+  }
+  elf.is64 = image[4] == 2;
+  elf.word = elf.is64 ? 8 : 4;
+  if (!sim_elf_fits(&elf, 0, elf.is64 ? 64 : 52) || sim_elf_read(&elf, 18, 2) != ELF_EM_RISCV) {
+    LOG(ERROR, "sim: not a RISC-V ELF file");
+    return 0;
+  }
+  sim->xlen = elf.is64 ? 64 : 32;
+  uint32_t type = (uint32_t) sim_elf_read(&elf, 16, 2);
+  int32_t ok = 0;
+  if (type == SIM_ET_EXEC) {
+    ok = sim_load_executable(sim, &elf);
+  } else if (type == SIM_ET_REL) {
+    uint32_t w = elf.word;
+    uint64_t shoff = sim_elf_read(&elf, 24 + 2 * w, w);
+    uint32_t shentsize = (uint32_t) sim_elf_read(&elf, 24 + 3 * w + 10, 2);
+    SimObject object = {NULL, NULL, (uint32_t) sim_elf_read(&elf, 24 + 3 * w + 12, 2), 0};
+    if (!sim_elf_fits(&elf, shoff, (uint64_t) shentsize * object.count) || shentsize < (elf.is64 ? 64u : 40u)) {
+      LOG(ERROR, "sim: malformed section header table");
+      return 0;
+    }
+    object.sections = calloc(object.count ? object.count : 1, sizeof(SimSection));
+    object.base = calloc(object.count ? object.count : 1, sizeof(uint64_t));
+    if (!object.sections || !object.base) {
+      LOG(FATAL, "out of memory");
+    }
+    ok = 1;
+    for (uint32_t s = 0; s < object.count; s++) {
+      object.sections[s] = sim_read_section(&elf, shoff + (uint64_t) s * shentsize);
+      if (object.sections[s].type != SIM_SHT_NOBITS &&
+          !sim_elf_fits(&elf, object.sections[s].offset, object.sections[s].size)) {
+        LOG(ERROR, "sim: section %u lies outside the file", s);
+        ok = 0;
+      }
+    }
+    ok = ok && sim_load_relocatable(sim, &elf, &object);
+    free(object.sections);
+    free(object.base);
+  } else {
+    LOG(ERROR, "sim: unsupported ELF file type %u", type);
+  }
+  if (ok) {
+    memset(sim->regs, 0, sizeof(sim->regs));
+    sim->regs[2] = sim->memory_size & ~(uint64_t) (SIM_STACK_ALIGN - 1);
+  }
+  return ok;
+}
@@ -0,0 +1,171 @@
+#include "target/asm_printer.h"
+#include "target/rvc.h"
+
+static const char *const asm_vlmul_names[8] = {"m1", "m2", "m4", "m8", "?", "mf8", "mf4", "mf2"};
+
+static const char *asm_reg(const MirReg reg) {
+  return rv_reg_name(reg);
+}
+
+static void asm_vtype(const int32_t vtype, FILE *out) {
+  fprintf(out, "e%d, %s, %s, %s", 8 << ((vtype >> 3) & 7), asm_vlmul_names[vtype & 7], (vtype & 0x40) ? "ta" : "tu",
+          (vtype & 0x80) ? "ma" : "mu");
+}
+
+static void asm_label(const MirFunction *fn, const uint32_t block, FILE *out) {
+  fprintf(out, ".LBB%d_%u", fn->index, block);
+}
+
+static const char *asm_symbol(const MirFunction *fn, const uint32_t callee) {
+  return fn->module->functions[callee]->name;
+}
+
+static void asm_print_inst(const MirFunction *fn, const MirInst *inst, FILE *out) {
+  const RvInstInfo *info = rv_inst_info((RvOpcode) inst->op);
+  fprintf(out, "  ");
+  RvcInst compressed;
+  if (fn->module->target.ext_c && rvc_select(inst, fn->module->target.xlen, &compressed)) {
+    rvc_print(&compressed, out);
+    fputc('\n', out);
+    return;
+  }
+  switch (info->format) {
+    case RV_FMT_R:
+      if ((inst->op == RV_SUB || inst->op == RV_SUBW) && inst->rs1 == RV_ZERO) {
+        fprintf(out, "%s %s, %s", inst->op == RV_SUB ? "neg" : "negw", asm_reg(inst->rd), asm_reg(inst->rs2));
+      } else if (inst->op == RV_SLTU && inst->rs1 == RV_ZERO) {
+        fprintf(out, "snez %s, %s", asm_reg(inst->rd), asm_reg(inst->rs2));
+      } else {
+        fprintf(out, "%s %s, %s, %s", info->name, asm_reg(inst->rd), asm_reg(inst->rs1), asm_reg(inst->rs2));
+      }
+      break;
+    case RV_FMT_I:
+      if (info->flags & (RV_IF_LOAD | RV_IF_JUMP)) {
+        fprintf(out, "%s %s, %d(%s)", info->name, asm_reg(inst->rd), inst->imm, asm_reg(inst->rs1));
+      } else if (inst->flags & MIR_INST_DATA) {
+        fprintf(out, "%s %s, %s, %%lo(.LC%u)", info->name, asm_reg(inst->rd), asm_reg(inst->rs1), inst->target);
+      } else if (inst->op == RV_ADDI && inst->rs1 == RV_ZERO) {
+        fprintf(out, "li %s, %d", asm_reg(inst->rd), inst->imm);
+      } else if (inst->op == RV_ADDI && inst->imm == 0) {
+        fprintf(out, "mv %s, %s", asm_reg(inst->rd), asm_reg(inst->rs1));
+      } else if (inst->op == RV_ADDIW && inst->imm == 0) {
+        fprintf(out, "sext.w %s, %s", asm_reg(inst->rd), asm_reg(inst->rs1));
+      } else if (inst->op == RV_SLTIU && inst->imm == 1) {
+        fprintf(out, "seqz %s, %s", asm_reg(inst->rd), asm_reg(inst->rs1));
+      } else if (inst->op == RV_XORI && inst->imm == -1) {
+        fprintf(out, "not %s, %s", asm_reg(inst->rd), asm_reg(inst->rs1));
+      } else {
+        fprintf(out, "%s %s, %s, %d", info->name, asm_reg(inst->rd), asm_reg(inst->rs1), inst->imm);
+      }
+      break;
+    case RV_FMT_SHIFT:
+      fprintf(out, "%s %s, %s, %d", info->name, asm_reg(inst->rd), asm_reg(inst->rs1), inst->imm);
+      break;
+    case RV_FMT_S:
+      fprintf(out, "%s %s, %d(%s)", info->name, asm_reg(inst->rs2), inst->imm, asm_reg(inst->rs1));
+      break;
+    case RV_FMT_B:
+      if ((inst->rs1 == RV_ZERO || inst->rs2 == RV_ZERO) && (inst->op == RV_BEQ || inst->op == RV_BNE)) {
+        fprintf(out, "%s %s, ", inst->op == RV_BEQ ? "beqz" : "bnez",
+                asm_reg(inst->rs2 == RV_ZERO ? inst->rs1 : inst->rs2));
+      } else {
+        fprintf(out, "%s %s, %s, ", info->name, asm_reg(inst->rs1), asm_reg(inst->rs2));
+      }
+      asm_label(fn, inst->target, out);
+      break;
+    case RV_FMT_U:
+      if (inst->flags & MIR_INST_DATA) {
+        fprintf(out, "%s %s, %%hi(.LC%u)", info->name, asm_reg(inst->rd), inst->target);
+      } else {
+        fprintf(out, "%s %s, %d", info->name, asm_reg(inst->rd), inst->imm & 0xfffff);
+      }
+      break;
+    case RV_FMT_J:
+      if (inst->rd == RV_ZERO) {
+        fprintf(out, "j ");
+      } else {
+        fprintf(out, "%s %s, ", info->name, asm_reg(inst->rd));
+      }
+      asm_label(fn, inst->target, out);
+      break;
+    case RV_FMT_PSEUDO:
+      if (inst->op == RV_RET) {
+        fprintf(out, "ret");
+      } else {
+        fprintf(out, "%s %s", info->name, asm_symbol(fn, inst->target));
+      }
+      break;
+    case RV_FMT_VSETVLI:
+      fprintf(out, "%s %s, %s, ", info->name, asm_reg(inst->rd), asm_reg(inst->rs1));
+      asm_vtype(inst->imm, out);
+      break;
+    case RV_FMT_VLOAD:
+    case RV_FMT_VSTORE:
+      fprintf(out, "%s v%u, (%s)", info->name, inst->rd, asm_reg(inst->rs1));
+      break;
+    case RV_FMT_VV:
+      fprintf(out, "%s v%u, v%u, v%u", info->name, inst->rd, inst->rs2, inst->rs1);
+      break;
+    case RV_FMT_VX:
+      fprintf(out, "%s v%u, v%u, %s", info->name, inst->rd, inst->rs2, asm_reg(inst->rs1));
+      break;
+    case RV_FMT_VI:
+      fprintf(out, "%s v%u, v%u, %d%s", info->name, inst->rd, inst->rs2, inst->imm,
+              (info->flags & RV_IF_VMASK) ? ", v0" : "");
+      break;
+    case RV_FMT_VSPLAT:
+      fprintf(out, "%s v%u, %s", info->name, inst->rd, asm_reg(inst->rs1));
+      break;
+    case RV_FMT_VUNARY:
+      fprintf(out, "%s v%u, v%u", info->name, inst->rd, inst->rs2);
+      break;
+    case RV_FMT_VINDEX:
+      fprintf(out, "%s v%u", info->name, inst->rd);
+      break;
+    case RV_FMT_VTOX:
+      fprintf(out, "%s %s, v%u", info->name, asm_reg(inst->rd), inst->rs2);
+      break;
+  }
+  fputc('\n', out);
+}
+
+static void asm_print_function(const MirFunction *fn, FILE *out) {
+  if (fn->block_count == 0) {
+    return;
+  }
+  if (fn->global) {
+    fprintf(out, "  .globl %s\n", fn->name);
+  }
+  fprintf(out, "  .p2align %d\n", fn->module->target.ext_c ? 1 : 2);
+  fprintf(out, "  .type %s,@function\n", fn->name);
+  fprintf(out, "%s:\n", fn->name);
+  for (uint32_t b = 0; b < fn->block_count; b++) {
+    if (fn->blocks[b].align > 0) {
+      fprintf(out, "  .p2align %d\n", __builtin_ctz(fn->blocks[b].align));
+    }
+    if (b > 0) {
+      asm_label(fn, b, out);
+      fprintf(out, ":\n");
+    }
+    for (uint32_t i = 0; i < fn->blocks[b].count; i++) {
+      asm_print_inst(fn, &fn->blocks[b].insts[i], out);
+    }
+  }
+  fprintf(out, "  .size %s, .-%s\n\n", fn->name, fn->name);
+}
+
+void asm_print_module(const MirModule *module, FILE *out) {
+  fprintf(out, "  .text\n");
+  for (uint32_t f = 0; f < module->function_count; f++) {
+    asm_print_function(module->functions[f], out);
+  }
+  if (module->data_count > 0) {
+    fprintf(out, "  .section .rodata\n");
+  }
+  for (uint32_t d = 0; d < module->data_count; d++) {
+    fprintf(out, "  .p2align 2\n.LC%u:\n", d);
+    for (uint32_t w = 0; w < module->data[d].word_count; w++) {
+      fprintf(out, "  .word %d\n", module->data[d].words[w]);
+    }
+  }
+}
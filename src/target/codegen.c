@@ -0,0 +1,110 @@
+#include "target/codegen.h"
+#include "target/asm_printer.h"
+#include "target/frame.h"
+#include "target/isel.h"
+#include "target/layout.h"
+#include "target/mir.h"
+#include "target/obj_emitter.h"
+#include "target/peephole.h"
+#include "target/regalloc.h"
+#include "utils/diagnostic.h"
+#include "utils/timing.h"
+#include <stdlib.h>
+#include <string.h>
+
+void codegen_options_init(CodegenOptions *options, const TargetInfo *target, const int32_t opt_level) {
+  memset(options, 0, sizeof(*options));
+  options->target = *target;
+  options->opt_level = opt_level;
+  options->regalloc = opt_level >= 2 ? REGALLOC_GRAPH_COLORING : REGALLOC_LINEAR_SCAN;
+  options->tune = machine_model_default();
+  options->schedule = opt_level >= 1;
+  options->peephole = opt_level >= 1;
+  options->vectorize = opt_level >= 2 && target->ext_v;
+  options->layout = opt_level >= 1;
+  options->shrink_wrap = opt_level >= 1;
+}
+
+int32_t codegen_parse_regalloc(CodegenOptions *options, const char *name) {
+  if (strcmp(name, "linear") == 0) {
+    options->regalloc = REGALLOC_LINEAR_SCAN;
+  } else if (strcmp(name, "graph") == 0) {
+    options->regalloc = REGALLOC_GRAPH_COLORING;
+  } else {
+    return 0;
+  }
+  return 1;
+}
+
+int32_t codegen_module(IrModule *module, const CodegenOptions *options, FILE *out) {
+  MirModule mir;
+  mir_module_init(&mir, &options->target);
+  double start = timing_now();
+  isel_select_module(&mir, module, options->vectorize, options->profile);
+  timing_add("codegen: isel", timing_now() - start);
+  start = timing_now();
+  for (uint32_t f = 0; f < mir.function_count && options->schedule; f++) {
+    sched_function(mir.functions[f], options->tune, 0);
+  }
+  timing_add("codegen: pre-RA scheduling", timing_now() - start);
+  start = timing_now();
+  RegallocReport *reports = calloc(mir.function_count ? mir.function_count : 1, sizeof(RegallocReport));
+  if (!reports) {
+    LOG(FATAL, "out of memory");
+  }
+  for (uint32_t f = 0; f < mir.function_count; f++) {
+    regalloc_function(mir.functions[f], options->regalloc, &reports[f]);
+  }
+  timing_add("codegen: regalloc", timing_now() - start);
+  if (options->regalloc_report) {
+    regalloc_print_reports(reports, mir.function_count, stderr);
+  }
+  free(reports);
+  start = timing_now();
+  for (uint32_t f = 0; f < mir.function_count && options->schedule; f++) {
+    sched_function(mir.functions[f], options->tune, 1);
+  }
+  timing_add("codegen: post-RA scheduling", timing_now() - start);
+  start = timing_now();
+  for (uint32_t f = 0; f < mir.function_count; f++) {
+    frame_lower_function(mir.functions[f], options->shrink_wrap);
+  }
+  timing_add("codegen: frame", timing_now() - start);
+  start = timing_now();
+  for (uint32_t f = 0; f < mir.function_count && options->layout; f++) {
+    layout_function(mir.functions[f], options->tune);
+  }
+  timing_add("codegen: block layout", timing_now() - start);
+  start = timing_now();
+  for (uint32_t f = 0; f < mir.function_count; f++) {
+    if (options->peephole) {
+      peephole_function(mir.functions[f]);
+    }
+    mir_remove_fallthrough_jumps(mir.functions[f]);
+  }
+  timing_add("codegen: peephole", timing_now() - start);
+  if (options->compress_report) {
+    RvcReport *sizes = calloc(mir.function_count ? mir.function_count : 1, sizeof(RvcReport));
+    if (!sizes) {
+      LOG(FATAL, "out of memory");
+    }
+    for (uint32_t f = 0; f < mir.function_count; f++) {
+      obj_measure_function(mir.functions[f], &sizes[f]);
+    }
+    rvc_print_reports(sizes, mir.function_count, stderr);
+    free(sizes);
+  }
+  start = timing_now();
+  int32_t status = 0;
+  if (options->emit_object) {
+    status = obj_emit_module(&mir, out);
+  } else {
+    asm_print_module(&mir, out);
+  }
+  timing_add("codegen: emit", timing_now() - start);
+  if (ferror(out)) {
+    status = 1;
+  }
+  mir_module_destroy(&mir);
+  return status;
+}
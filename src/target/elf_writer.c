@@ -0,0 +1,350 @@
+#include "target/elf_writer.h"
+#include "utils/diagnostic.h"
+#include <stdlib.h>
+#include <string.h>
+
+#define ELF_SHT_PROGBITS 1
+#define ELF_SHT_SYMTAB 2
+#define ELF_SHT_STRTAB 3
+#define ELF_SHT_RELA 4
+#define ELF_SHT_NOBITS 8
+
+#define ELF_SHF_WRITE 0x1u
+#define ELF_SHF_ALLOC 0x2u
+#define ELF_SHF_EXECINSTR 0x4u
+#define ELF_SHF_INFO_LINK 0x40u
+
+#define ELF_MAX_SECTIONS (1 + ELF_SECTION_COUNT * 2 + 3)
+
+typedef struct {
+  const char *name;
+  uint32_t type;
+  uint32_t flags;
+} ElfSectionInfo;
+
+static const ElfSectionInfo elf_section_info[ELF_SECTION_COUNT] = {
+  {".text", ELF_SHT_PROGBITS, ELF_SHF_ALLOC | ELF_SHF_EXECINSTR},
+  {".data", ELF_SHT_PROGBITS, ELF_SHF_ALLOC | ELF_SHF_WRITE},
+  {".rodata", ELF_SHT_PROGBITS, ELF_SHF_ALLOC},
+  {".bss", ELF_SHT_NOBITS, ELF_SHF_ALLOC | ELF_SHF_WRITE},
+};
+
+typedef struct {
+  uint32_t name;
+  uint32_t type;
+  uint64_t flags;
+  uint64_t offset;
+  uint64_t size;
+  uint32_t link;
+  uint32_t info;
+  uint64_t align;
+  uint64_t entsize;
+} ElfHeader;
+
+void elf_buffer_append(ElfBuffer *buffer, const void *data, const size_t size) {
+  if (buffer->size + size > buffer->capacity) {
+    size_t capacity = buffer->capacity ? buffer->capacity : 256;
+    while (capacity < buffer->size + size) {
+      capacity *= 2;
+    }
+    buffer->data = realloc(buffer->data, capacity);
+    if (!buffer->data) {
+      LOG(FATAL, "out of memory");
+    }
+    buffer->capacity = capacity;
+  }
+  if (data) {
+    memcpy(buffer->data + buffer->size, data, size);
+  } else {
+    memset(buffer->data + buffer->size, 0, size);
+  }
+  buffer->size += size;
+}
+
+void elf_buffer_append_u16(ElfBuffer *buffer, const uint16_t value) {
+  uint8_t bytes[2] = {(uint8_t) value, (uint8_t) (value >> 8)};
+  elf_buffer_append(buffer, bytes, sizeof(bytes));
+}
+
+void elf_buffer_append_u32(ElfBuffer *buffer, const uint32_t value) {
+  uint8_t bytes[4] = {(uint8_t) value, (uint8_t) (value >> 8), (uint8_t) (value >> 16), (uint8_t) (value >> 24)};
+  elf_buffer_append(buffer, bytes, sizeof(bytes));
+}
+
+static void elf_buffer_append_u64(ElfBuffer *buffer, const uint64_t value) {
+  elf_buffer_append_u32(buffer, (uint32_t) value);
+  elf_buffer_append_u32(buffer, (uint32_t) (value >> 32));
+}
+
+static void elf_buffer_append_word(ElfBuffer *buffer, const int32_t is64, const uint64_t value) {
+  if (is64) {
+    elf_buffer_append_u64(buffer, value);
+  } else {
+    elf_buffer_append_u32(buffer, (uint32_t) value);
+  }
+}
+
+void elf_buffer_patch_u32(ElfBuffer *buffer, const size_t offset, const uint32_t value) {
+  buffer->data[offset] = (uint8_t) value;
+  buffer->data[offset + 1] = (uint8_t) (value >> 8);
+  buffer->data[offset + 2] = (uint8_t) (value >> 16);
+  buffer->data[offset + 3] = (uint8_t) (value >> 24);
+}
+
+void elf_buffer_align(ElfBuffer *buffer, const size_t align) {
+  size_t padding = (align - buffer->size % align) % align;
+  if (padding > 0) {
+    elf_buffer_append(buffer, NULL, padding);
+  }
+}
+
+static uint32_t elf_string(ElfBuffer *table, const char *name) {
+  uint32_t offset = (uint32_t) table->size;
+  elf_buffer_append(table, name, strlen(name) + 1);
+  return offset;
+}
+
+void elf_object_init(ElfObject *object, const int32_t xlen, const uint32_t flags) {
+  memset(object, 0, sizeof(*object));
+  object->is64 = xlen == 64;
+  object->flags = flags;
+  for (uint32_t s = 0; s < ELF_SECTION_COUNT; s++) {
+    object->sections[s].align = s == ELF_SECTION_TEXT ? 4 : 1;
+  }
+  elf_buffer_append(&object->strtab, "", 1);
+}
+
+void elf_object_destroy(ElfObject *object) {
+  for (uint32_t s = 0; s < ELF_SECTION_COUNT; s++) {
+    free(object->sections[s].data.data);
+    free(object->sections[s].relocs);
+  }
+  free(object->symbols);
+  free(object->strtab.data);
+}
+
+uint32_t elf_add_symbol(ElfObject *object, const char *name, const ElfSectionId section, const uint64_t value,
+                        const uint64_t size, const ElfSymbolType type, const ElfSymbolBind bind) {
+  if (object->symbol_count == object->symbol_capacity) {
+    object->symbol_capacity = object->symbol_capacity ? object->symbol_capacity * 2 : 32;
+    object->symbols = realloc(object->symbols, object->symbol_capacity * sizeof(ElfSymbol));
+    if (!object->symbols) {
+      LOG(FATAL, "out of memory");
+    }
+  }
+  ElfSymbol *symbol = &object->symbols[object->symbol_count];
+  symbol->name = name[0] ? elf_string(&object->strtab, name) : 0;
+  symbol->value = value;
+  symbol->size = size;
+  symbol->section = section;
+  symbol->type = type;
+  symbol->bind = bind;
+  return object->symbol_count++;
+}
+
+void elf_add_reloc(ElfObject *object, const ElfSectionId section, const uint64_t offset, const uint32_t symbol,
+                   const ElfRelocType type, const int64_t addend) {
+  ElfSection *data = &object->sections[section];
+  if (data->reloc_count == data->reloc_capacity) {
+    data->reloc_capacity = data->reloc_capacity ? data->reloc_capacity * 2 : 32;
+    data->relocs = realloc(data->relocs, data->reloc_capacity * sizeof(ElfReloc));
+    if (!data->relocs) {
+      LOG(FATAL, "out of memory");
+    }
+  }
+  ElfReloc *reloc = &data->relocs[data->reloc_count++];
+  reloc->offset = offset;
+  reloc->symbol = symbol;
+  reloc->type = (uint32_t) type;
+  reloc->addend = addend;
+}
+
+static void elf_write_symbol(ElfBuffer *image, const ElfObject *object, const ElfSymbol *symbol) {
+  uint8_t info = (uint8_t) ((symbol->bind << 4) | symbol->type);
+  uint16_t shndx = (uint16_t) (symbol->section + 1);
+  elf_buffer_append_u32(image, symbol->name);
+  if (object->is64) {
+    elf_buffer_append(image, &info, 1);
+    elf_buffer_append(image, NULL, 1);
+    elf_buffer_append_u16(image, shndx);
+    elf_buffer_append_u64(image, symbol->value);
+    elf_buffer_append_u64(image, symbol->size);
+  } else {
+    elf_buffer_append_u32(image, (uint32_t) symbol->value);
+    elf_buffer_append_u32(image, (uint32_t) symbol->size);
+    elf_buffer_append(image, &info, 1);
+    elf_buffer_append(image, NULL, 1);
+    elf_buffer_append_u16(image, shndx);
+  }
+}
+
+static void elf_write_reloc(ElfBuffer *image, const ElfObject *object, const ElfReloc *reloc,
+                            const uint32_t *symbol_map) {
+  uint64_t symbol = reloc->symbol == ELF_NO_SYMBOL ? 0 : symbol_map[reloc->symbol];
+  if (object->is64) {
+    elf_buffer_append_u64(image, reloc->offset);
+    elf_buffer_append_u64(image, (symbol << 32) | reloc->type);
+    elf_buffer_append_u64(image, (uint64_t) reloc->addend);
+  } else {
+    elf_buffer_append_u32(image, (uint32_t) reloc->offset);
+    elf_buffer_append_u32(image, (uint32_t) ((symbol << 8) | reloc->type));
+    elf_buffer_append_u32(image, (uint32_t) reloc->addend);
+  }
+}
+
+static void elf_write_section_header(ElfBuffer *image, const int32_t is64, const ElfHeader *header) {
+  elf_buffer_append_u32(image, header->name);
+  elf_buffer_append_u32(image, header->type);
+  elf_buffer_append_word(image, is64, header->flags);
+  elf_buffer_append_word(image, is64, 0);
+  elf_buffer_append_word(image, is64, header->offset);
+  elf_buffer_append_word(image, is64, header->size);
+  elf_buffer_append_u32(image, header->link);
+  elf_buffer_append_u32(image, header->info);
+  elf_buffer_append_word(image, is64, header->align);
+  elf_buffer_append_word(image, is64, header->entsize);
+}
+
+int32_t elf_object_write(const ElfObject *object, FILE *out) {
+  int32_t is64 = object->is64;
+  ElfBuffer image = {NULL, 0, 0};
+  ElfBuffer shstrtab = {NULL, 0, 0};
+  ElfHeader headers[ELF_MAX_SECTIONS];
+  uint32_t header_count = 1;
+  memset(headers, 0, sizeof(headers));
+  elf_buffer_append(&shstrtab, "", 1);
+
+  uint8_t ident[16] = {0x7f, 'E', 'L', 'F', (uint8_t) (is64 ? 2 : 1), 1, 1};
+  elf_buffer_append(&image, ident, sizeof(ident));
+  elf_buffer_append_u16(&image, 1);
+  elf_buffer_append_u16(&image, ELF_EM_RISCV);
+  elf_buffer_append_u32(&image, 1);
+  elf_buffer_append_word(&image, is64, 0);
+  elf_buffer_append_word(&image, is64, 0);
+  size_t shoff_at = image.size;
+  elf_buffer_append_word(&image, is64, 0);
+  elf_buffer_append_u32(&image, object->flags);
+  elf_buffer_append_u16(&image, (uint16_t) (is64 ? 64 : 52));
+  elf_buffer_append_u16(&image, 0);
+  elf_buffer_append_u16(&image, 0);
+  elf_buffer_append_u16(&image, (uint16_t) (is64 ? 64 : 40));
+  size_t shnum_at = image.size;
+  elf_buffer_append_u16(&image, 0);
+  elf_buffer_append_u16(&image, 0);
+
+  for (uint32_t s = 0; s < ELF_SECTION_COUNT; s++) {
+    const ElfSection *section = &object->sections[s];
+    ElfHeader *header = &headers[header_count++];
+    header->name = elf_string(&shstrtab, elf_section_info[s].name);
+    header->type = elf_section_info[s].type;
+    header->flags = elf_section_info[s].flags;
+    header->align = section->align;
+    if (header->type == ELF_SHT_NOBITS) {
+      header->offset = image.size;
+      header->size = section->bss_size;
+      continue;
+    }
+    elf_buffer_align(&image, section->align);
+    header->offset = image.size;
+    header->size = section->data.size;
+    elf_buffer_append(&image, section->data.data, section->data.size);
+  }
+
+  uint32_t *symbol_map = calloc(object->symbol_count ? object->symbol_count : 1, sizeof(uint32_t));
+  if (!symbol_map) {
+    LOG(FATAL, "out of memory");
+  }
+  uint32_t next = 1;
+  for (uint32_t pass = 0; pass < 2; pass++) {
+    for (uint32_t i = 0; i < object->symbol_count; i++) {
+      if ((object->symbols[i].bind == ELF_BIND_LOCAL) == (pass == 0)) {
+        symbol_map[i] = next++;
+      }
+    }
+  }
+  uint32_t first_global = 1;
+  for (uint32_t i = 0; i < object->symbol_count; i++) {
+    if (object->symbols[i].bind == ELF_BIND_LOCAL) {
+      first_global++;
+    }
+  }
+  uint32_t symtab_index = header_count + 0;
+  for (uint32_t s = 0; s < ELF_SECTION_COUNT; s++) {
+    if (object->sections[s].reloc_count > 0) {
+      symtab_index++;
+    }
+  }
+
+  for (uint32_t s = 0; s < ELF_SECTION_COUNT; s++) {
+    const ElfSection *section = &object->sections[s];
+    if (section->reloc_count == 0) {
+      continue;
+    }
+    char name[32];
+    snprintf(name, sizeof(name), ".rela%s", elf_section_info[s].name);
+    ElfHeader *header = &headers[header_count++];
+    header->name = elf_string(&shstrtab, name);
+    header->type = ELF_SHT_RELA;
+    header->flags = ELF_SHF_INFO_LINK;
+    header->link = symtab_index;
+    header->info = s + 1;
+    header->align = is64 ? 8 : 4;
+    header->entsize = is64 ? 24 : 12;
+    elf_buffer_align(&image, header->align);
+    header->offset = image.size;
+    for (uint32_t r = 0; r < section->reloc_count; r++) {
+      elf_write_reloc(&image, object, &section->relocs[r], symbol_map);
+    }
+    header->size = image.size - header->offset;
+  }
+
+  ElfHeader *symtab = &headers[header_count++];
+  symtab->name = elf_string(&shstrtab, ".symtab");
+  symtab->type = ELF_SHT_SYMTAB;
+  symtab->link = header_count;
+  symtab->info = first_global;
+  symtab->align = is64 ? 8 : 4;
+  symtab->entsize = is64 ? 24 : 16;
+  elf_buffer_align(&image, symtab->align);
+  symtab->offset = image.size;
+  elf_buffer_append(&image, NULL, symtab->entsize);
+  for (uint32_t pass = 0; pass < 2; pass++) {
+    for (uint32_t i = 0; i < object->symbol_count; i++) {
+      if ((object->symbols[i].bind == ELF_BIND_LOCAL) == (pass == 0)) {
+        elf_write_symbol(&image, object, &object->symbols[i]);
+      }
+    }
+  }
+  symtab->size = image.size - symtab->offset;
+
+  ElfHeader *strtab = &headers[header_count++];
+  strtab->name = elf_string(&shstrtab, ".strtab");
+  strtab->type = ELF_SHT_STRTAB;
+  strtab->align = 1;
+  strtab->offset = image.size;
+  strtab->size = object->strtab.size;
+  elf_buffer_append(&image, object->strtab.data, object->strtab.size);
+
+  ElfHeader *shstrtab_header = &headers[header_count++];
+  shstrtab_header->name = elf_string(&shstrtab, ".shstrtab");
+  shstrtab_header->type = ELF_SHT_STRTAB;
+  shstrtab_header->align = 1;
+  shstrtab_header->offset = image.size;
+  shstrtab_header->size = shstrtab.size;
+  elf_buffer_append(&image, shstrtab.data, shstrtab.size);
+
+  elf_buffer_align(&image, is64 ? 8 : 4);
+  uint64_t shoff = image.size;
+  for (uint32_t h = 0; h < header_count; h++) {
+    elf_write_section_header(&image, is64, &headers[h]);
+  }
+  elf_buffer_patch_u32(&image, shoff_at, (uint32_t) shoff);
+  image.data[shnum_at] = (uint8_t) header_count;
+  image.data[shnum_at + 2] = (uint8_t) (header_count - 1);
+
+  int32_t status = fwrite(image.data, 1, image.size, out) == image.size ? 0 : 1;
+  free(symbol_map);
+  free(image.data);
+  free(shstrtab.data);
+  return status;
+}
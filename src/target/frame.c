@@ -0,0 +1,590 @@
+#include "target/frame.h"
+#include "utils/diagnostic.h"
+#include "utils/stats.h"
+#include <stdlib.h>
+#include <string.h>
+
+#define FRAME_NO_COPY 0xffu
+
+typedef struct {
+  MirFunction *fn;
+  uint32_t *succ_start;
+  uint32_t *succs;
+  uint32_t *pred_start;
+  uint32_t *preds;
+  uint32_t *rpo;
+  uint32_t *rpo_index;
+  uint32_t *idom;
+  uint32_t rpo_count;
+  uint8_t *reach;
+  uint8_t *bypass;
+  uint32_t *stack;
+} FrameCfg;
+
+static void *frame_alloc(const size_t count, const size_t size) {
+  void *ptr = calloc(count ? count : 1, size);
+  if (!ptr) {
+    LOG(FATAL, "out of memory");
+  }
+  return ptr;
+}
+
+static int32_t frame_align(const int32_t value, const int32_t align) {
+  return (value + align - 1) & -align;
+}
+
+static uint32_t frame_saved_regs(const MirFunction *fn) {
+  uint32_t mask = 0;
+  for (uint32_t b = 0; b < fn->block_count; b++) {
+    for (uint32_t i = 0; i < fn->blocks[b].count; i++) {
+      MirReg def = mir_inst_def(&fn->blocks[b].insts[i]);
+      if (def < RV_REG_COUNT) {
+        mask |= 1u << def;
+      }
+    }
+  }
+  mask &= rv_callee_saved_mask();
+  if (fn->has_calls) {
+    mask |= 1u << RV_RA;
+  }
+  return mask;
+}
+
+static void frame_layout(MirFunction *fn) {
+  int32_t offset = frame_align(fn->outgoing_size, 16);
+  for (uint32_t f = 0; f < fn->frame_count; f++) {
+    MirFrameObject *object = &fn->frame[f];
+    if (object->kind == MIR_FRAME_INCOMING) {
+      continue;
+    }
+    offset = frame_align(offset, object->align > 0 ? object->align : 1);
+    object->offset = offset;
+    offset += object->size;
+  }
+  fn->frame_size = frame_align(offset, 16);
+  for (uint32_t f = 0; f < fn->frame_count; f++) {
+    if (fn->frame[f].kind == MIR_FRAME_INCOMING) {
+      fn->frame[f].offset += fn->frame_size;
+    }
+  }
+}
+
+static uint32_t frame_block_succs(const MirFunction *fn, const uint32_t block, uint32_t *out) {
+  const MirBlock *data = &fn->blocks[block];
+  uint32_t count = 0;
+  int32_t falls = 1;
+  for (uint32_t i = 0; i < data->count; i++) {
+    uint32_t flags = rv_inst_info((RvOpcode) data->insts[i].op)->flags;
+    if (flags & RV_IF_RETURN) {
+      falls = 0;
+    } else if (flags & (RV_IF_BRANCH | RV_IF_JUMP)) {
+      if (out) {
+        out[count] = data->insts[i].target;
+      }
+      count++;
+      falls &= !(flags & RV_IF_JUMP);
+    }
+  }
+  if (falls && block + 1 < fn->block_count) {
+    if (out) {
+      out[count] = block + 1;
+    }
+    count++;
+  }
+  return count;
+}
+
+static void frame_cfg_edges(FrameCfg *cfg) {
+  const MirFunction *fn = cfg->fn;
+  uint32_t n = fn->block_count;
+  cfg->succ_start = frame_alloc(n + 1, sizeof(uint32_t));
+  cfg->pred_start = frame_alloc(n + 1, sizeof(uint32_t));
+  for (uint32_t b = 0; b < n; b++) {
+    cfg->succ_start[b + 1] = cfg->succ_start[b] + frame_block_succs(fn, b, NULL);
+  }
+  cfg->succs = frame_alloc(cfg->succ_start[n], sizeof(uint32_t));
+  cfg->preds = frame_alloc(cfg->succ_start[n], sizeof(uint32_t));
+  uint32_t *fill = frame_alloc(n, sizeof(uint32_t));
+  for (uint32_t b = 0; b < n; b++) {
+    frame_block_succs(fn, b, &cfg->succs[cfg->succ_start[b]]);
+    for (uint32_t e = cfg->succ_start[b]; e < cfg->succ_start[b + 1]; e++) {
+      cfg->pred_start[cfg->succs[e] + 1]++;
+    }
+  }
+  for (uint32_t b = 0; b < n; b++) {
+    cfg->pred_start[b + 1] += cfg->pred_start[b];
+  }
+  for (uint32_t b = 0; b < n; b++) {
+    for (uint32_t e = cfg->succ_start[b]; e < cfg->succ_start[b + 1]; e++) {
+      uint32_t to = cfg->succs[e];
+      cfg->preds[cfg->pred_start[to] + fill[to]++] = b;
+    }
+  }
+  free(fill);
+}
+
+static void frame_cfg_order(FrameCfg *cfg) {
+  uint32_t n = cfg->fn->block_count;
+  uint32_t *next = frame_alloc(n, sizeof(uint32_t));
+  uint32_t *post = frame_alloc(n, sizeof(uint32_t));
+  uint8_t *seen = frame_alloc(n, sizeof(uint8_t));
+  cfg->rpo = frame_alloc(n, sizeof(uint32_t));
+  cfg->rpo_index = frame_alloc(n, sizeof(uint32_t));
+  uint32_t depth = 0;
+  uint32_t count = 0;
+  cfg->stack[depth++] = 0;
+  seen[0] = 1;
+  while (depth > 0) {
+    uint32_t b = cfg->stack[depth - 1];
+    if (cfg->succ_start[b] + next[b] < cfg->succ_start[b + 1]) {
+      uint32_t to = cfg->succs[cfg->succ_start[b] + next[b]++];
+      if (!seen[to]) {
+        seen[to] = 1;
+        cfg->stack[depth++] = to;
+      }
+      continue;
+    }
+    post[count++] = b;
+    depth--;
+  }
+  for (uint32_t b = 0; b < n; b++) {
+    cfg->rpo_index[b] = MIR_NONE;
+  }
+  for (uint32_t i = 0; i < count; i++) {
+    cfg->rpo[i] = post[count - 1 - i];
+    cfg->rpo_index[cfg->rpo[i]] = i;
+  }
+  cfg->rpo_count = count;
+  free(next);
+  free(post);
+  free(seen);
+}
+
+static uint32_t frame_intersect(const FrameCfg *cfg, uint32_t a, uint32_t b) {
+  while (a != b) {
+    while (cfg->rpo_index[a] > cfg->rpo_index[b]) {
+      a = cfg->idom[a];
+    }
+    while (cfg->rpo_index[b] > cfg->rpo_index[a]) {
+      b = cfg->idom[b];
+    }
+  }
+  return a;
+}
+
+static void frame_cfg_dominators(FrameCfg *cfg) {
+  uint32_t n = cfg->fn->block_count;
+  cfg->idom = frame_alloc(n, sizeof(uint32_t));
+  for (uint32_t b = 0; b < n; b++) {
+    cfg->idom[b] = MIR_NONE;
+  }
+  cfg->idom[0] = 0;
+  int32_t changed = 1;
+  while (changed) {
+    changed = 0;
+    for (uint32_t r = 1; r < cfg->rpo_count; r++) {
+      uint32_t b = cfg->rpo[r];
+      uint32_t idom = MIR_NONE;
+      for (uint32_t p = cfg->pred_start[b]; p < cfg->pred_start[b + 1]; p++) {
+        uint32_t pred = cfg->preds[p];
+        if (cfg->idom[pred] == MIR_NONE) {
+          continue;
+        }
+        idom = idom == MIR_NONE ? pred : frame_intersect(cfg, pred, idom);
+      }
+      if (idom != cfg->idom[b]) {
+        cfg->idom[b] = idom;
+        changed = 1;
+      }
+    }
+  }
+}
+
+static void frame_cfg_init(FrameCfg *cfg, MirFunction *fn) {
+  cfg->fn = fn;
+  cfg->reach = frame_alloc(fn->block_count, sizeof(uint8_t));
+  cfg->bypass = frame_alloc(fn->block_count, sizeof(uint8_t));
+  frame_cfg_edges(cfg);
+  cfg->stack = frame_alloc(fn->block_count + cfg->succ_start[fn->block_count], sizeof(uint32_t));
+  frame_cfg_order(cfg);
+  frame_cfg_dominators(cfg);
+}
+
+static void frame_cfg_destroy(FrameCfg *cfg) {
+  free(cfg->succ_start);
+  free(cfg->succs);
+  free(cfg->pred_start);
+  free(cfg->preds);
+  free(cfg->rpo);
+  free(cfg->rpo_index);
+  free(cfg->idom);
+  free(cfg->reach);
+  free(cfg->bypass);
+  free(cfg->stack);
+}
+
+static void frame_mark(FrameCfg *cfg, uint8_t *mark, const uint32_t from, const uint32_t avoid,
+                       const int32_t skip_from) {
+  uint32_t depth = 0;
+  if (skip_from) {
+    for (uint32_t e = cfg->succ_start[from]; e < cfg->succ_start[from + 1]; e++) {
+      cfg->stack[depth++] = cfg->succs[e];
+    }
+  } else {
+    cfg->stack[depth++] = from;
+  }
+  while (depth > 0) {
+    uint32_t b = cfg->stack[--depth];
+    if (b == avoid || mark[b]) {
+      continue;
+    }
+    mark[b] = 1;
+    for (uint32_t e = cfg->succ_start[b]; e < cfg->succ_start[b + 1]; e++) {
+      if (!mark[cfg->succs[e]]) {
+        cfg->stack[depth++] = cfg->succs[e];
+      }
+    }
+  }
+}
+
+static int32_t frame_can_wrap(FrameCfg *cfg, const uint32_t block) {
+  uint32_t n = cfg->fn->block_count;
+  for (uint32_t b = 0; b < n; b++) {
+    cfg->reach[b] = 0;
+    cfg->bypass[b] = 0;
+  }
+  frame_mark(cfg, cfg->reach, block, MIR_NONE, 1);
+  if (cfg->reach[block]) {
+    return 0;
+  }
+  frame_mark(cfg, cfg->bypass, 0, block, 0);
+  for (uint32_t b = 0; b < n; b++) {
+    if (cfg->reach[b] && cfg->bypass[b]) {
+      return 0;
+    }
+  }
+  cfg->reach[block] = 1;
+  return 1;
+}
+
+static int32_t frame_block_needs(const MirFunction *fn, const uint32_t block) {
+  uint32_t touched = fn->saved_regs | (1u << RV_SP);
+  const MirBlock *data = &fn->blocks[block];
+  for (uint32_t i = 0; i < data->count; i++) {
+    const MirInst *inst = &data->insts[i];
+    if ((inst->flags & MIR_INST_FRAME) || inst->op == RV_CALL) {
+      return 1;
+    }
+    MirReg def = mir_inst_def(inst);
+    if (def < RV_REG_COUNT && (touched & (1u << def))) {
+      return 1;
+    }
+    MirReg uses[MIR_MAX_USES];
+    uint32_t count = mir_inst_uses(inst, uses);
+    for (uint32_t u = 0; u < count; u++) {
+      if (uses[u] < RV_REG_COUNT && (touched & (1u << uses[u]))) {
+        return 1;
+      }
+    }
+  }
+  return 0;
+}
+
+static int32_t frame_is_copy(const MirInst *inst) {
+  uint32_t sources = rv_caller_saved_mask() & ~((1u << RV_RA) | (1u << RV_SCRATCH));
+  return mir_inst_is_move(inst) && inst->rd < RV_REG_COUNT && (rv_callee_saved_mask() & (1u << inst->rd)) &&
+         inst->rs1 < RV_REG_COUNT && (sources & (1u << inst->rs1));
+}
+
+static void frame_copy_step(MirInst *inst, uint8_t copies[RV_REG_COUNT], const int32_t rewrite) {
+  MirReg *slot;
+  for (uint32_t u = 0; rewrite && (slot = mir_inst_use_slot(inst, u)) != NULL; u++) {
+    if (*slot < RV_REG_COUNT && copies[*slot] != FRAME_NO_COPY) {
+      *slot = copies[*slot];
+      stats_add("frame.copies_forwarded", 1);
+    }
+  }
+  MirReg def = mir_inst_def(inst);
+  uint32_t killed = mir_inst_clobbers(inst) | (def < RV_REG_COUNT ? 1u << def : 0);
+  for (MirReg reg = 0; reg < RV_REG_COUNT; reg++) {
+    if (copies[reg] != FRAME_NO_COPY && (killed & ((1u << reg) | (1u << copies[reg])))) {
+      copies[reg] = FRAME_NO_COPY;
+    }
+  }
+  if (frame_is_copy(inst)) {
+    copies[inst->rd] = (uint8_t) inst->rs1;
+  }
+}
+
+static void frame_forward_copies(FrameCfg *cfg) {
+  MirFunction *fn = cfg->fn;
+  uint8_t *in = frame_alloc((size_t) fn->block_count * RV_REG_COUNT, sizeof(uint8_t));
+  uint8_t *visited = frame_alloc(fn->block_count, sizeof(uint8_t));
+  uint8_t copies[RV_REG_COUNT];
+  memset(in, FRAME_NO_COPY, (size_t) fn->block_count * RV_REG_COUNT);
+  visited[0] = 1;
+  int32_t changed = 1;
+  while (changed) {
+    changed = 0;
+    for (uint32_t r = 0; r < cfg->rpo_count; r++) {
+      uint32_t b = cfg->rpo[r];
+      memcpy(copies, &in[b * RV_REG_COUNT], RV_REG_COUNT);
+      for (uint32_t i = 0; i < fn->blocks[b].count; i++) {
+        frame_copy_step(&fn->blocks[b].insts[i], copies, 0);
+      }
+      for (uint32_t e = cfg->succ_start[b]; e < cfg->succ_start[b + 1]; e++) {
+        uint8_t *succ = &in[cfg->succs[e] * RV_REG_COUNT];
+        if (!visited[cfg->succs[e]]) {
+          visited[cfg->succs[e]] = 1;
+          memcpy(succ, copies, RV_REG_COUNT);
+          changed = 1;
+          continue;
+        }
+        for (MirReg reg = 0; reg < RV_REG_COUNT; reg++) {
+          if (succ[reg] != FRAME_NO_COPY && succ[reg] != copies[reg]) {
+            succ[reg] = FRAME_NO_COPY;
+            changed = 1;
+          }
+        }
+      }
+    }
+  }
+  for (uint32_t r = 0; r < cfg->rpo_count; r++) {
+    uint32_t b = cfg->rpo[r];
+    for (uint32_t i = 0; i < fn->blocks[b].count; i++) {
+      frame_copy_step(&fn->blocks[b].insts[i], &in[b * RV_REG_COUNT], 1);
+    }
+  }
+  free(in);
+  free(visited);
+}
+
+static uint32_t frame_live_step(const MirInst *inst, uint32_t live) {
+  MirReg def = mir_inst_def(inst);
+  live &= ~(mir_inst_clobbers(inst) | (def < RV_REG_COUNT ? 1u << def : 0));
+  MirReg uses[MIR_MAX_USES];
+  uint32_t count = mir_inst_uses(inst, uses);
+  for (uint32_t u = 0; u < count; u++) {
+    live |= uses[u] < RV_REG_COUNT ? 1u << uses[u] : 0;
+  }
+  return live;
+}
+
+static void frame_liveness(const FrameCfg *cfg, uint32_t *live_in) {
+  int32_t changed = 1;
+  while (changed) {
+    changed = 0;
+    for (uint32_t r = cfg->rpo_count; r-- > 0;) {
+      uint32_t b = cfg->rpo[r];
+      uint32_t live = 0;
+      for (uint32_t e = cfg->succ_start[b]; e < cfg->succ_start[b + 1]; e++) {
+        live |= live_in[cfg->succs[e]];
+      }
+      for (uint32_t i = cfg->fn->blocks[b].count; i-- > 0;) {
+        live = frame_live_step(&cfg->fn->blocks[b].insts[i], live);
+      }
+      if (live != live_in[b]) {
+        live_in[b] = live;
+        changed = 1;
+      }
+    }
+  }
+}
+
+static int32_t frame_copy_movable(const MirBlock *block, const uint32_t index) {
+  const MirInst *copy = &block->insts[index];
+  uint32_t regs = (1u << copy->rd) | (1u << copy->rs1);
+  for (uint32_t i = index + 1; i < block->count; i++) {
+    const MirInst *inst = &block->insts[i];
+    MirReg def = mir_inst_def(inst);
+    if ((mir_inst_clobbers(inst) | (def < RV_REG_COUNT ? 1u << def : 0)) & regs) {
+      return 0;
+    }
+    MirReg uses[MIR_MAX_USES];
+    uint32_t count = mir_inst_uses(inst, uses);
+    for (uint32_t u = 0; u < count; u++) {
+      if (uses[u] == copy->rd) {
+        return 0;
+      }
+    }
+  }
+  return 1;
+}
+
+static int32_t frame_only_pred(const FrameCfg *cfg, const uint32_t block, const uint32_t pred) {
+  for (uint32_t p = cfg->pred_start[block]; p < cfg->pred_start[block + 1]; p++) {
+    if (cfg->preds[p] != pred) {
+      return 0;
+    }
+  }
+  return block != 0 && block != pred;
+}
+
+static void frame_sink_copies(FrameCfg *cfg) {
+  MirFunction *fn = cfg->fn;
+  uint32_t *live_in = frame_alloc(fn->block_count, sizeof(uint32_t));
+  frame_liveness(cfg, live_in);
+  for (uint32_t r = 0; r < cfg->rpo_count; r++) {
+    uint32_t b = cfg->rpo[r];
+    for (uint32_t i = fn->blocks[b].count; i-- > 0;) {
+      MirInst copy = fn->blocks[b].insts[i];
+      if (!frame_is_copy(&copy) || !frame_copy_movable(&fn->blocks[b], i)) {
+        continue;
+      }
+      uint32_t target = MIR_NONE;
+      uint32_t targets = 0;
+      for (uint32_t e = cfg->succ_start[b]; e < cfg->succ_start[b + 1]; e++) {
+        uint32_t succ = cfg->succs[e];
+        if ((live_in[succ] & (1u << copy.rd)) && succ != target) {
+          target = succ;
+          targets++;
+        }
+      }
+      if (targets == 0) {
+        mir_remove(fn, b, i);
+        stats_add("frame.copies_removed", 1);
+      } else if (targets == 1 && frame_only_pred(cfg, target, b)) {
+        mir_remove(fn, b, i);
+        mir_insert(fn, target, 0, &copy);
+        live_in[target] = (live_in[target] & ~(1u << copy.rd)) | (1u << copy.rs1);
+        stats_add("frame.copies_sunk", 1);
+      }
+    }
+  }
+  free(live_in);
+}
+
+static uint32_t frame_save_point(FrameCfg *cfg) {
+  const MirFunction *fn = cfg->fn;
+  uint32_t point = MIR_NONE;
+  for (uint32_t r = 0; r < cfg->rpo_count; r++) {
+    uint32_t b = cfg->rpo[r];
+    if (frame_block_needs(fn, b)) {
+      point = point == MIR_NONE ? b : frame_intersect(cfg, point, b);
+    }
+  }
+  if (point == MIR_NONE) {
+    return MIR_NONE;
+  }
+  while (point != 0 && !frame_can_wrap(cfg, point)) {
+    point = cfg->idom[point];
+  }
+  return point;
+}
+
+static uint32_t frame_li(MirFunction *fn, const uint32_t block, uint32_t position, const MirReg rd,
+                         const int32_t value) {
+  uint32_t hi = (((uint32_t) value + 0x800u) >> 12) & 0xfffffu;
+  int32_t lo = (int32_t) ((uint32_t) value - (hi << 12));
+  MirInst inst = mir_make(RV_LUI, rd, MIR_NONE, MIR_NONE, (int32_t) hi);
+  mir_insert(fn, block, position++, &inst);
+  inst = mir_make(fn->module->target.xlen == 64 ? RV_ADDIW : RV_ADDI, rd, rd, MIR_NONE, lo);
+  mir_insert(fn, block, position++, &inst);
+  return position;
+}
+
+static uint32_t frame_adjust_sp(MirFunction *fn, const uint32_t block, uint32_t position, const int32_t amount) {
+  if (rv_fits_imm12(amount)) {
+    MirInst inst = mir_make(RV_ADDI, RV_SP, RV_SP, MIR_NONE, amount);
+    mir_insert(fn, block, position++, &inst);
+    return position;
+  }
+  position = frame_li(fn, block, position, RV_SCRATCH, amount);
+  MirInst inst = mir_make(RV_ADD, RV_SP, RV_SP, RV_SCRATCH, 0);
+  mir_insert(fn, block, position++, &inst);
+  return position;
+}
+
+static uint32_t frame_save_restore(MirFunction *fn, const uint32_t block, uint32_t position,
+                                   const uint32_t slots[RV_REG_COUNT], const int32_t store) {
+  int32_t rv64 = fn->module->target.xlen == 64;
+  for (MirReg reg = 0; reg < RV_REG_COUNT; reg++) {
+    if (!(fn->saved_regs & (1u << reg))) {
+      continue;
+    }
+    MirInst inst = store ? mir_make(rv64 ? RV_SD : RV_SW, MIR_NONE, RV_SP, reg, 0)
+                         : mir_make(rv64 ? RV_LD : RV_LW, reg, RV_SP, MIR_NONE, 0);
+    inst.flags = MIR_INST_FRAME;
+    inst.target = slots[reg];
+    mir_insert(fn, block, position++, &inst);
+  }
+  return position;
+}
+
+static void frame_insert_prologue_epilogue(MirFunction *fn, const uint32_t slots[RV_REG_COUNT], FrameCfg *cfg) {
+  uint32_t save = fn->frame_size == 0 ? MIR_NONE : cfg ? frame_save_point(cfg) : 0;
+  if (save == MIR_NONE) {
+    stats_add("frame.elided", 1);
+    return;
+  }
+  if (save != 0) {
+    stats_add("frame.shrink_wrapped", 1);
+  }
+  uint32_t position = frame_adjust_sp(fn, save, 0, -fn->frame_size);
+  frame_save_restore(fn, save, position, slots, 1);
+  for (uint32_t b = 0; b < fn->block_count; b++) {
+    if (save != 0 && !cfg->reach[b]) {
+      continue;
+    }
+    for (uint32_t i = 0; i < fn->blocks[b].count; i++) {
+      uint16_t op = fn->blocks[b].insts[i].op;
+      if (op != RV_RET && op != RV_TAIL) {
+        continue;
+      }
+      position = frame_save_restore(fn, b, i, slots, 0);
+      i = frame_adjust_sp(fn, b, position, fn->frame_size);
+    }
+  }
+}
+
+static void frame_rewrite_operands(MirFunction *fn) {
+  for (uint32_t b = 0; b < fn->block_count; b++) {
+    for (uint32_t i = 0; i < fn->blocks[b].count; i++) {
+      MirInst *inst = &fn->blocks[b].insts[i];
+      if (!(inst->flags & MIR_INST_FRAME)) {
+        continue;
+      }
+      inst->flags &= (uint8_t) ~MIR_INST_FRAME;
+      inst->imm += fn->frame[inst->target].offset;
+      inst->target = MIR_NONE;
+      if (rv_fits_imm12(inst->imm)) {
+        continue;
+      }
+      int32_t offset = inst->imm;
+      MirReg base = inst->rs1;
+      inst->rs1 = RV_SCRATCH;
+      inst->imm = 0;
+      uint32_t position = frame_li(fn, b, i, RV_SCRATCH, offset);
+      MirInst add = mir_make(RV_ADD, RV_SCRATCH, RV_SCRATCH, base, 0);
+      mir_insert(fn, b, position, &add);
+      i = position + 1;
+    }
+  }
+}
+
+void frame_lower_function(MirFunction *fn, const int32_t shrink_wrap) {
+  if (fn->block_count == 0) {
+    return;
+  }
+  int32_t xlen_bytes = fn->module->target.xlen / 8;
+  uint32_t slots[RV_REG_COUNT];
+  FrameCfg cfg = {0};
+  if (shrink_wrap) {
+    frame_cfg_init(&cfg, fn);
+    frame_forward_copies(&cfg);
+    frame_sink_copies(&cfg);
+  }
+  fn->saved_regs = frame_saved_regs(fn);
+  for (MirReg reg = 0; reg < RV_REG_COUNT; reg++) {
+    slots[reg] = (fn->saved_regs & (1u << reg))
+                   ? mir_frame_object_create(fn, xlen_bytes, xlen_bytes, MIR_FRAME_SPILL)
+                   : MIR_NONE;
+  }
+  frame_layout(fn);
+  frame_insert_prologue_epilogue(fn, slots, shrink_wrap ? &cfg : NULL);
+  frame_rewrite_operands(fn);
+  if (shrink_wrap) {
+    frame_cfg_destroy(&cfg);
+  }
+  stats_add("frame.bytes", (uint32_t) fn->frame_size);
+}
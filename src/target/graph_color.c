@@ -0,0 +1,547 @@
+#include "target/regalloc.h"
+#include "utils/diagnostic.h"
+#include <stdlib.h>
+#include <string.h>
+
+#define COLOR_PRECOLORED_DEGREE (UINT32_MAX / 2)
+
+typedef enum {
+  COLOR_NODE_NONE,
+  COLOR_NODE_PRECOLORED,
+  COLOR_NODE_INITIAL,
+  COLOR_NODE_SIMPLIFY,
+  COLOR_NODE_FREEZE,
+  COLOR_NODE_SPILL,
+  COLOR_NODE_SPILLED,
+  COLOR_NODE_COALESCED,
+  COLOR_NODE_COLORED,
+  COLOR_NODE_SELECT
+} ColorNodeState;
+
+typedef enum {
+  COLOR_MOVE_WORKLIST,
+  COLOR_MOVE_ACTIVE,
+  COLOR_MOVE_COALESCED,
+  COLOR_MOVE_CONSTRAINED,
+  COLOR_MOVE_FROZEN
+} ColorMoveState;
+
+typedef struct {
+  uint32_t *items;
+  uint32_t count;
+  uint32_t capacity;
+} ColorList;
+
+typedef struct {
+  MirReg dst;
+  MirReg src;
+  uint8_t state;
+} ColorMove;
+
+typedef struct {
+  RegallocState *state;
+  uint32_t node_count;
+  uint32_t k;
+  MirReg order[RV_REG_COUNT];
+  uint64_t *adjacency;
+  ColorList *adj_list;
+  ColorList *move_list;
+  uint32_t *degree;
+  MirReg *alias;
+  MirReg *color;
+  uint8_t *node_state;
+  uint32_t *mark;
+  uint32_t stamp;
+  ColorMove *moves;
+  uint32_t move_count;
+  uint32_t move_capacity;
+  ColorList simplify;
+  ColorList freeze;
+  ColorList worklist_moves;
+  ColorList select;
+} GraphColor;
+
+static void *color_alloc(const size_t count, const size_t size) {
+  void *ptr = calloc(count ? count : 1, size);
+  if (!ptr) {
+    LOG(FATAL, "out of memory");
+  }
+  return ptr;
+}
+
+static void color_push(ColorList *list, const uint32_t value) {
+  if (list->count == list->capacity) {
+    list->capacity = list->capacity ? list->capacity * 2 : 8;
+    list->items = realloc(list->items, list->capacity * sizeof(uint32_t));
+    if (!list->items) {
+      LOG(FATAL, "out of memory");
+    }
+  }
+  list->items[list->count++] = value;
+}
+
+static size_t color_pair_index(MirReg u, MirReg v) {
+  if (u < v) {
+    MirReg t = u;
+    u = v;
+    v = t;
+  }
+  return (size_t) u * (u + 1) / 2 + v;
+}
+
+static int32_t color_adjacent(const GraphColor *gc, const MirReg u, const MirReg v) {
+  size_t index = color_pair_index(u, v);
+  return (int32_t) ((gc->adjacency[index >> 6] >> (index & 63)) & 1u);
+}
+
+static int32_t color_precolored(const GraphColor *gc, const MirReg node) {
+  return gc->node_state[node] == COLOR_NODE_PRECOLORED;
+}
+
+static void color_add_edge(GraphColor *gc, const MirReg u, const MirReg v) {
+  if (u == v || color_adjacent(gc, u, v)) {
+    return;
+  }
+  size_t index = color_pair_index(u, v);
+  gc->adjacency[index >> 6] |= 1ull << (index & 63);
+  if (!color_precolored(gc, u)) {
+    color_push(&gc->adj_list[u], v);
+    gc->degree[u]++;
+  }
+  if (!color_precolored(gc, v)) {
+    color_push(&gc->adj_list[v], u);
+    gc->degree[v]++;
+  }
+}
+
+static int32_t color_in_graph(const GraphColor *gc, const MirReg reg) {
+  return reg != MIR_NONE && reg < gc->node_count && gc->node_state[reg] != COLOR_NODE_NONE;
+}
+
+static int32_t color_node_listed(const GraphColor *gc, const MirReg node) {
+  return gc->node_state[node] != COLOR_NODE_SELECT && gc->node_state[node] != COLOR_NODE_COALESCED;
+}
+
+static int32_t color_move_pending(const GraphColor *gc, const uint32_t move) {
+  return gc->moves[move].state == COLOR_MOVE_ACTIVE || gc->moves[move].state == COLOR_MOVE_WORKLIST;
+}
+
+static int32_t color_move_related(const GraphColor *gc, const MirReg node) {
+  const ColorList *list = &gc->move_list[node];
+  for (uint32_t i = 0; i < list->count; i++) {
+    if (color_move_pending(gc, list->items[i])) {
+      return 1;
+    }
+  }
+  return 0;
+}
+
+static MirReg color_alias(const GraphColor *gc, MirReg node) {
+  while (gc->node_state[node] == COLOR_NODE_COALESCED) {
+    node = gc->alias[node];
+  }
+  return node;
+}
+
+static void color_set_state(GraphColor *gc, const MirReg node, const ColorNodeState state) {
+  gc->node_state[node] = (uint8_t) state;
+  if (state == COLOR_NODE_SIMPLIFY) {
+    color_push(&gc->simplify, node);
+  } else if (state == COLOR_NODE_FREEZE) {
+    color_push(&gc->freeze, node);
+  }
+}
+
+static void color_add_move(GraphColor *gc, const MirReg dst, const MirReg src) {
+  if (gc->move_count == gc->move_capacity) {
+    gc->move_capacity = gc->move_capacity ? gc->move_capacity * 2 : 16;
+    gc->moves = realloc(gc->moves, gc->move_capacity * sizeof(ColorMove));
+    if (!gc->moves) {
+      LOG(FATAL, "out of memory");
+    }
+  }
+  uint32_t move = gc->move_count++;
+  gc->moves[move].dst = dst;
+  gc->moves[move].src = src;
+  gc->moves[move].state = COLOR_MOVE_WORKLIST;
+  color_push(&gc->move_list[dst], move);
+  color_push(&gc->move_list[src], move);
+  color_push(&gc->worklist_moves, move);
+}
+
+static void color_build(GraphColor *gc) {
+  RegallocState *state = gc->state;
+  const MirFunction *fn = state->fn;
+  uint32_t words = (state->live.reg_count + 63) / 64;
+  uint64_t *live = color_alloc(words, sizeof(uint64_t));
+  for (uint32_t b = 0; b < fn->block_count; b++) {
+    const MirBlock *block = &fn->blocks[b];
+    const MirRegSet *live_out = mir_live_out(&state->live, b);
+    memset(live, 0, words * sizeof(uint64_t));
+    for (uint32_t i = 0; i < live_out->count; i++) {
+      mir_bit_set(live, live_out->items[i]);
+    }
+    for (uint32_t i = block->count; i-- > 0;) {
+      const MirInst *inst = &block->insts[i];
+      MirReg uses[MIR_MAX_USES];
+      uint32_t use_count = mir_inst_uses(inst, uses);
+      MirReg def = mir_inst_def(inst);
+      if (mir_inst_is_move(inst) && color_in_graph(gc, def) && color_in_graph(gc, inst->rs1)) {
+        mir_bit_clear(live, inst->rs1);
+        color_add_move(gc, def, inst->rs1);
+      }
+      MirReg defs[RV_REG_COUNT + 1];
+      uint32_t def_count = 0;
+      if (color_in_graph(gc, def)) {
+        defs[def_count++] = def;
+      }
+      uint32_t clobbers = mir_inst_clobbers(inst);
+      for (MirReg reg = 0; clobbers && reg < RV_REG_COUNT; reg++) {
+        if ((clobbers & (1u << reg)) && color_in_graph(gc, reg) && reg != def) {
+          defs[def_count++] = reg;
+        }
+      }
+      for (uint32_t d = 0; d < def_count; d++) {
+        mir_bit_set(live, defs[d]);
+      }
+      for (uint32_t d = 0; d < def_count; d++) {
+        for (uint32_t w = 0; w < words; w++) {
+          uint64_t bits = live[w];
+          while (bits) {
+            MirReg other = (MirReg) (w * 64 + (uint32_t) __builtin_ctzll(bits));
+            bits &= bits - 1;
+            if (color_in_graph(gc, other)) {
+              color_add_edge(gc, other, defs[d]);
+            }
+          }
+        }
+      }
+      for (uint32_t d = 0; d < def_count; d++) {
+        mir_bit_clear(live, defs[d]);
+      }
+      for (uint32_t u = 0; u < use_count; u++) {
+        if (color_in_graph(gc, uses[u])) {
+          mir_bit_set(live, uses[u]);
+        }
+      }
+    }
+  }
+  free(live);
+}
+
+static void color_make_worklists(GraphColor *gc) {
+  for (MirReg node = MIR_VREG_BASE; node < gc->node_count; node++) {
+    if (gc->node_state[node] != COLOR_NODE_INITIAL) {
+      continue;
+    }
+    if (gc->degree[node] >= gc->k) {
+      gc->node_state[node] = COLOR_NODE_SPILL;
+    } else if (color_move_related(gc, node)) {
+      color_set_state(gc, node, COLOR_NODE_FREEZE);
+    } else {
+      color_set_state(gc, node, COLOR_NODE_SIMPLIFY);
+    }
+  }
+}
+
+static void color_enable_moves(GraphColor *gc, const MirReg node) {
+  const ColorList *list = &gc->move_list[node];
+  for (uint32_t i = 0; i < list->count; i++) {
+    uint32_t move = list->items[i];
+    if (gc->moves[move].state == COLOR_MOVE_ACTIVE) {
+      gc->moves[move].state = COLOR_MOVE_WORKLIST;
+      color_push(&gc->worklist_moves, move);
+    }
+  }
+}
+
+static void color_decrement_degree(GraphColor *gc, const MirReg node) {
+  if (color_precolored(gc, node)) {
+    return;
+  }
+  uint32_t degree = gc->degree[node]--;
+  if (degree != gc->k) {
+    return;
+  }
+  color_enable_moves(gc, node);
+  const ColorList *adj = &gc->adj_list[node];
+  for (uint32_t i = 0; i < adj->count; i++) {
+    if (color_node_listed(gc, adj->items[i])) {
+      color_enable_moves(gc, adj->items[i]);
+    }
+  }
+  if (gc->node_state[node] == COLOR_NODE_SPILL) {
+    color_set_state(gc, node, color_move_related(gc, node) ? COLOR_NODE_FREEZE : COLOR_NODE_SIMPLIFY);
+  }
+}
+
+static void color_simplify(GraphColor *gc, const MirReg node) {
+  gc->node_state[node] = COLOR_NODE_SELECT;
+  color_push(&gc->select, node);
+  const ColorList *adj = &gc->adj_list[node];
+  for (uint32_t i = 0; i < adj->count; i++) {
+    if (color_node_listed(gc, adj->items[i])) {
+      color_decrement_degree(gc, adj->items[i]);
+    }
+  }
+}
+
+static void color_add_worklist(GraphColor *gc, const MirReg node) {
+  if (!color_precolored(gc, node) && gc->node_state[node] == COLOR_NODE_FREEZE && !color_move_related(gc, node) &&
+      gc->degree[node] < gc->k) {
+    color_set_state(gc, node, COLOR_NODE_SIMPLIFY);
+  }
+}
+
+static int32_t color_ok(const GraphColor *gc, const MirReg t, const MirReg r) {
+  return gc->degree[t] < gc->k || color_precolored(gc, t) || color_adjacent(gc, t, r);
+}
+
+static int32_t color_conservative(GraphColor *gc, const MirReg u, const MirReg v) {
+  gc->stamp++;
+  uint32_t significant = 0;
+  const MirReg nodes[2] = {u, v};
+  for (uint32_t n = 0; n < 2; n++) {
+    const ColorList *adj = &gc->adj_list[nodes[n]];
+    for (uint32_t i = 0; i < adj->count; i++) {
+      MirReg t = adj->items[i];
+      if (!color_node_listed(gc, t) || gc->mark[t] == gc->stamp) {
+        continue;
+      }
+      gc->mark[t] = gc->stamp;
+      if (gc->degree[t] >= gc->k) {
+        significant++;
+      }
+    }
+  }
+  return significant < gc->k;
+}
+
+static int32_t color_george(const GraphColor *gc, const MirReg u, const MirReg v) {
+  const ColorList *adj = &gc->adj_list[v];
+  for (uint32_t i = 0; i < adj->count; i++) {
+    MirReg t = adj->items[i];
+    if (color_node_listed(gc, t) && !color_ok(gc, t, u)) {
+      return 0;
+    }
+  }
+  return 1;
+}
+
+static void color_combine(GraphColor *gc, const MirReg u, const MirReg v) {
+  gc->node_state[v] = COLOR_NODE_COALESCED;
+  gc->alias[v] = u;
+  const ColorList *moves = &gc->move_list[v];
+  for (uint32_t i = 0; i < moves->count; i++) {
+    color_push(&gc->move_list[u], moves->items[i]);
+  }
+  color_enable_moves(gc, v);
+  const ColorList *adj = &gc->adj_list[v];
+  for (uint32_t i = 0; i < adj->count; i++) {
+    MirReg t = adj->items[i];
+    if (!color_node_listed(gc, t)) {
+      continue;
+    }
+    color_add_edge(gc, t, u);
+    color_decrement_degree(gc, t);
+  }
+  if (gc->degree[u] >= gc->k && gc->node_state[u] == COLOR_NODE_FREEZE) {
+    gc->node_state[u] = COLOR_NODE_SPILL;
+  }
+}
+
+static void color_coalesce(GraphColor *gc, const uint32_t move) {
+  MirReg x = color_alias(gc, gc->moves[move].src);
+  MirReg y = color_alias(gc, gc->moves[move].dst);
+  MirReg u = x;
+  MirReg v = y;
+  if (color_precolored(gc, y)) {
+    u = y;
+    v = x;
+  }
+  if (u == v) {
+    gc->moves[move].state = COLOR_MOVE_COALESCED;
+    color_add_worklist(gc, u);
+  } else if (color_precolored(gc, v) || color_adjacent(gc, u, v)) {
+    gc->moves[move].state = COLOR_MOVE_CONSTRAINED;
+    color_add_worklist(gc, u);
+    color_add_worklist(gc, v);
+  } else if ((color_precolored(gc, u) && color_george(gc, u, v)) ||
+             (!color_precolored(gc, u) && color_conservative(gc, u, v))) {
+    gc->moves[move].state = COLOR_MOVE_COALESCED;
+    color_combine(gc, u, v);
+    color_add_worklist(gc, u);
+  } else {
+    gc->moves[move].state = COLOR_MOVE_ACTIVE;
+  }
+}
+
+static void color_freeze_moves(GraphColor *gc, const MirReg node) {
+  const ColorList *list = &gc->move_list[node];
+  for (uint32_t i = 0; i < list->count; i++) {
+    uint32_t move = list->items[i];
+    if (!color_move_pending(gc, move)) {
+      continue;
+    }
+    MirReg x = color_alias(gc, gc->moves[move].src);
+    MirReg y = color_alias(gc, gc->moves[move].dst);
+    MirReg other = y == color_alias(gc, node) ? x : y;
+    gc->moves[move].state = COLOR_MOVE_FROZEN;
+    if (gc->node_state[other] == COLOR_NODE_FREEZE && !color_move_related(gc, other) && gc->degree[other] < gc->k) {
+      color_set_state(gc, other, COLOR_NODE_SIMPLIFY);
+    }
+  }
+}
+
+static float color_spill_cost(const GraphColor *gc, const MirReg node) {
+  const RegallocState *state = gc->state;
+  if (state->temp[node]) {
+    return REGALLOC_INFINITE_WEIGHT;
+  }
+  return state->weight[node] / (float) (gc->degree[node] + 1);
+}
+
+static int32_t color_select_spill(GraphColor *gc) {
+  MirReg best = MIR_NONE;
+  for (MirReg node = MIR_VREG_BASE; node < gc->node_count; node++) {
+    if (gc->node_state[node] == COLOR_NODE_SPILL &&
+        (best == MIR_NONE || color_spill_cost(gc, node) < color_spill_cost(gc, best))) {
+      best = node;
+    }
+  }
+  if (best == MIR_NONE) {
+    return 0;
+  }
+  color_set_state(gc, best, COLOR_NODE_SIMPLIFY);
+  color_freeze_moves(gc, best);
+  return 1;
+}
+
+static int32_t color_pop(GraphColor *gc, ColorList *list, const ColorNodeState state, MirReg *out) {
+  while (list->count > 0) {
+    MirReg node = list->items[--list->count];
+    if (gc->node_state[node] == state) {
+      *out = node;
+      return 1;
+    }
+  }
+  return 0;
+}
+
+static uint32_t color_assign(GraphColor *gc) {
+  uint32_t spilled = 0;
+  while (gc->select.count > 0) {
+    MirReg node = gc->select.items[--gc->select.count];
+    uint32_t forbidden = 0;
+    const ColorList *adj = &gc->adj_list[node];
+    for (uint32_t i = 0; i < adj->count; i++) {
+      MirReg other = color_alias(gc, adj->items[i]);
+      if (gc->node_state[other] == COLOR_NODE_COLORED || color_precolored(gc, other)) {
+        forbidden |= 1u << gc->color[other];
+      }
+    }
+    MirReg chosen = MIR_NONE;
+    for (int32_t hinted = 1; hinted >= 0 && chosen == MIR_NONE; hinted--) {
+      for (uint32_t i = 0; i < gc->k && chosen == MIR_NONE; i++) {
+        MirReg reg = gc->order[i];
+        if (!(forbidden & (1u << reg)) && (!hinted || regalloc_prefers(gc->state, node, reg))) {
+          chosen = reg;
+        }
+      }
+    }
+    if (chosen == MIR_NONE) {
+      gc->node_state[node] = COLOR_NODE_SPILLED;
+      spilled++;
+    } else {
+      gc->node_state[node] = COLOR_NODE_COLORED;
+      gc->color[node] = chosen;
+    }
+  }
+  return spilled;
+}
+
+int32_t regalloc_graph_color(RegallocState *state) {
+  GraphColor gc;
+  memset(&gc, 0, sizeof(gc));
+  gc.state = state;
+  gc.node_count = state->live.reg_count;
+  gc.k = regalloc_order(state->leaf, gc.order);
+  uint32_t n = gc.node_count;
+  size_t pairs = (size_t) n * (n + 1) / 2;
+  gc.adjacency = color_alloc((pairs + 63) / 64, sizeof(uint64_t));
+  gc.adj_list = color_alloc(n, sizeof(ColorList));
+  gc.move_list = color_alloc(n, sizeof(ColorList));
+  gc.degree = color_alloc(n, sizeof(uint32_t));
+  gc.alias = color_alloc(n, sizeof(MirReg));
+  gc.color = color_alloc(n, sizeof(MirReg));
+  gc.node_state = color_alloc(n, 1);
+  gc.mark = color_alloc(n, sizeof(uint32_t));
+  for (uint32_t i = 0; i < gc.k; i++) {
+    MirReg reg = gc.order[i];
+    gc.node_state[reg] = COLOR_NODE_PRECOLORED;
+    gc.color[reg] = reg;
+    gc.degree[reg] = COLOR_PRECOLORED_DEGREE;
+  }
+  const MirFunction *fn = state->fn;
+  for (uint32_t b = 0; b < fn->block_count; b++) {
+    for (uint32_t i = 0; i < fn->blocks[b].count; i++) {
+      const MirInst *inst = &fn->blocks[b].insts[i];
+      MirReg uses[MIR_MAX_USES];
+      uint32_t count = mir_inst_uses(inst, uses);
+      for (uint32_t u = 0; u < count; u++) {
+        if (mir_is_vreg(uses[u])) {
+          gc.node_state[uses[u]] = COLOR_NODE_INITIAL;
+        }
+      }
+      MirReg def = mir_inst_def(inst);
+      if (mir_is_vreg(def)) {
+        gc.node_state[def] = COLOR_NODE_INITIAL;
+      }
+    }
+  }
+  color_build(&gc);
+  color_make_worklists(&gc);
+  for (;;) {
+    MirReg node;
+    if (color_pop(&gc, &gc.simplify, COLOR_NODE_SIMPLIFY, &node)) {
+      color_simplify(&gc, node);
+    } else if (gc.worklist_moves.count > 0) {
+      uint32_t move = gc.worklist_moves.items[--gc.worklist_moves.count];
+      if (gc.moves[move].state == COLOR_MOVE_WORKLIST) {
+        color_coalesce(&gc, move);
+      }
+    } else if (color_pop(&gc, &gc.freeze, COLOR_NODE_FREEZE, &node)) {
+      color_set_state(&gc, node, COLOR_NODE_SIMPLIFY);
+      color_freeze_moves(&gc, node);
+    } else if (!color_select_spill(&gc)) {
+      break;
+    }
+  }
+  uint32_t spilled = color_assign(&gc);
+  for (MirReg node = MIR_VREG_BASE; node < n; node++) {
+    MirReg root = color_alias(&gc, node);
+    if (gc.node_state[root] == COLOR_NODE_SPILLED) {
+      state->split[node] = 0;
+    } else if (gc.node_state[root] == COLOR_NODE_COLORED || gc.node_state[root] == COLOR_NODE_PRECOLORED) {
+      state->assign[node] = gc.color[root];
+    }
+  }
+  for (uint32_t i = 0; i < n; i++) {
+    free(gc.adj_list[i].items);
+    free(gc.move_list[i].items);
+  }
+  free(gc.adjacency);
+  free(gc.adj_list);
+  free(gc.move_list);
+  free(gc.degree);
+  free(gc.alias);
+  free(gc.color);
+  free(gc.node_state);
+  free(gc.mark);
+  free(gc.moves);
+  free(gc.simplify.items);
+  free(gc.freeze.items);
+  free(gc.worklist_moves.items);
+  free(gc.select.items);
+  return (int32_t) spilled;
+}
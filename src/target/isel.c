@@ -0,0 +1,1087 @@
+#include "target/isel.h"
+#include "ir/ir_dom.h"
+#include "ir/ir_loop.h"
+#include "ir/ir_prob.h"
+#include "target/runtime.h"
+#include "target/vectorize.h"
+#include "utils/diagnostic.h"
+#include "utils/stats.h"
+#include <stdlib.h>
+#include <string.h>
+
+typedef enum {
+  ISEL_NONE,
+  ISEL_REG,
+  ISEL_PTR,
+  ISEL_IMM12,
+  ISEL_NIMM12,
+  ISEL_IMM12P1,
+  ISEL_SHAMT,
+  ISEL_POW2,
+  ISEL_ZERO,
+  ISEL_BYTE_MASK,
+  ISEL_LOAD8
+} IselOperand;
+
+typedef enum {
+  ISEL_ACTION_RR,
+  ISEL_ACTION_RI,
+  ISEL_ACTION_RI_NEG,
+  ISEL_ACTION_RI_INC,
+  ISEL_ACTION_RI_LOG2,
+  ISEL_ACTION_RR_SWAP,
+  ISEL_ACTION_RR_NOT,
+  ISEL_ACTION_RR_SWAP_NOT,
+  ISEL_ACTION_RI_NOT,
+  ISEL_ACTION_RI_INC_NOT,
+  ISEL_ACTION_SEQZ,
+  ISEL_ACTION_SNEZ,
+  ISEL_ACTION_RI_SEQZ,
+  ISEL_ACTION_RR_SEQZ,
+  ISEL_ACTION_RI_SNEZ,
+  ISEL_ACTION_RR_SNEZ,
+  ISEL_ACTION_NEG,
+  ISEL_ACTION_NOT,
+  ISEL_ACTION_SEXT8,
+  ISEL_ACTION_LOAD,
+  ISEL_ACTION_COPY,
+  ISEL_ACTION_MULH,
+  ISEL_ACTION_MULHU,
+  ISEL_ACTION_LIBCALL
+} IselAction;
+
+typedef struct {
+  IrOp op;
+  IselOperand left;
+  IselOperand right;
+  RvOpcode rv32;
+  RvOpcode rv64;
+  IselAction action;
+} IselPattern;
+
+typedef struct {
+  IrOp op;
+  IselOperand left;
+  IselOperand right;
+  RvOpcode rv;
+  IselAction action;
+} IselBranch;
+
+typedef struct {
+  uint32_t width;
+  RvOpcode load;
+  RvOpcode store;
+} IselMemory;
+
+static const IselPattern isel_patterns[] = {
+#define ISEL_PATTERN(op, left, right, rv32, rv64, action) \
+  {IR_OP_##op, ISEL_##left, ISEL_##right, RV_##rv32, RV_##rv64, ISEL_ACTION_##action},
+#include "target/isel.def"
+};
+
+static const IselBranch isel_branches[] = {
+#define ISEL_BRANCH(op, left, right, rv, action) {IR_OP_##op, ISEL_##left, ISEL_##right, RV_##rv, ISEL_ACTION_##action},
+#include "target/isel.def"
+};
+
+static const IselMemory isel_memory[] = {
+#define ISEL_MEMORY(width, load, store) {width, RV_##load, RV_##store},
+#include "target/isel.def"
+};
+
+typedef struct {
+  MirModule *mir;
+  const TargetInfo *target;
+  IrFunction *fn;
+  MirFunction *out;
+  IrUses uses;
+  MirReg *vreg;
+  uint8_t *interior;
+  uint32_t *block_map;
+  uint32_t *frame_map;
+  uint32_t *data_map;
+  uint32_t block;
+  const int32_t *helpers;
+  int32_t vectorize;
+  VecLoop *plans;
+  uint32_t plan_count;
+  uint32_t *block_plan;
+  const IrProfile *profile;
+} Isel;
+
+static void *isel_alloc(const size_t count, const size_t size) {
+  void *ptr = calloc(count ? count : 1, size);
+  if (!ptr) {
+    LOG(FATAL, "out of memory");
+  }
+  return ptr;
+}
+
+static const IselMemory *isel_memory_for(const uint32_t width) {
+  for (size_t i = 0; i < sizeof(isel_memory) / sizeof(isel_memory[0]); i++) {
+    if (isel_memory[i].width == width) {
+      return &isel_memory[i];
+    }
+  }
+  LOG(FATAL, "no memory access of width %u", width);
+  return NULL;
+}
+
+static uint32_t isel_use_count(const Isel *isel, const IrValueId value) {
+  return isel->uses.start[value + 1] - isel->uses.start[value];
+}
+
+static MirInst *isel_emit(Isel *isel, const RvOpcode op, const MirReg rd, const MirReg rs1, const MirReg rs2,
+                          const int32_t imm) {
+  return mir_emit(isel->out, isel->block, op, rd, rs1, rs2, imm);
+}
+
+static MirReg isel_temp(Isel *isel) {
+  return mir_vreg_create(isel->out);
+}
+
+static void isel_mv(Isel *isel, const MirReg rd, const MirReg rs) {
+  isel_emit(isel, RV_ADDI, rd, rs, MIR_NONE, 0);
+}
+
+static void isel_li(Isel *isel, const MirReg rd, const int32_t value) {
+  if (rv_fits_imm12(value)) {
+    isel_emit(isel, RV_ADDI, rd, RV_ZERO, MIR_NONE, value);
+    return;
+  }
+  uint32_t hi = (((uint32_t) value + 0x800u) >> 12) & 0xfffffu;
+  int32_t lo = (int32_t) ((uint32_t) value - (hi << 12));
+  isel_emit(isel, RV_LUI, rd, MIR_NONE, MIR_NONE, (int32_t) hi);
+  if (lo != 0) {
+    isel_emit(isel, isel->target->xlen == 64 ? RV_ADDIW : RV_ADDI, rd, rd, MIR_NONE, lo);
+  }
+}
+
+static MirReg isel_value_reg(Isel *isel, const IrValueId value) {
+  if (isel->vreg[value] == MIR_NONE) {
+    isel->vreg[value] = mir_vreg_create(isel->out);
+  }
+  return isel->vreg[value];
+}
+
+static void isel_frame_operand(MirInst *inst, const uint32_t object) {
+  inst->flags |= MIR_INST_FRAME;
+  inst->target = object;
+}
+
+static void isel_select(Isel *isel, IrValueId value, MirReg rd);
+
+static void isel_data_address(Isel *isel, const int32_t index, const MirReg rd) {
+  if (isel->data_map[index] == MIR_NONE) {
+    const IrData *data = &isel->fn->module->data[index];
+    isel->data_map[index] = mir_data_create(isel->mir, data->words, data->word_count);
+  }
+  MirReg high = isel_temp(isel);
+  MirInst *lui = isel_emit(isel, RV_LUI, high, MIR_NONE, MIR_NONE, 0);
+  lui->flags |= MIR_INST_DATA;
+  lui->target = isel->data_map[index];
+  MirInst *addi = isel_emit(isel, RV_ADDI, rd, high, MIR_NONE, 0);
+  addi->flags |= MIR_INST_DATA;
+  addi->target = isel->data_map[index];
+}
+
+static MirReg isel_reg(Isel *isel, const IrValueId value) {
+  const IrInst *inst = &isel->fn->insts[value];
+  if (inst->op == IR_OP_CONST) {
+    if (inst->imm == 0) {
+      return RV_ZERO;
+    }
+    MirReg reg = isel_temp(isel);
+    isel_li(isel, reg, inst->imm);
+    return reg;
+  }
+  if (inst->op == IR_OP_ALLOCA) {
+    MirReg reg = isel_temp(isel);
+    isel_frame_operand(isel_emit(isel, RV_ADDI, reg, RV_SP, MIR_NONE, 0), isel->frame_map[inst->imm]);
+    return reg;
+  }
+  if (isel->interior[value]) {
+    MirReg reg = isel_temp(isel);
+    isel_select(isel, value, reg);
+    return reg;
+  }
+  return isel_value_reg(isel, value);
+}
+
+static int32_t isel_const(const Isel *isel, const IrValueId value) {
+  return isel->fn->insts[value].imm;
+}
+
+static int32_t isel_matches(const Isel *isel, const IselOperand kind, const IrValueId value) {
+  if (value == IR_NONE) {
+    return kind == ISEL_NONE;
+  }
+  const IrInst *inst = &isel->fn->insts[value];
+  int32_t c = inst->imm;
+  int32_t is_const = inst->op == IR_OP_CONST;
+  switch (kind) {
+    case ISEL_NONE: return 0;
+    case ISEL_REG: return 1;
+    case ISEL_PTR: return inst->type == IR_TYPE_PTR;
+    case ISEL_IMM12: return is_const && rv_fits_imm12(c);
+    case ISEL_NIMM12: return is_const && rv_fits_imm12(-(int64_t) c);
+    case ISEL_IMM12P1: return is_const && rv_fits_imm12((int64_t) c + 1);
+    case ISEL_SHAMT: return is_const && c >= 0 && c < 32;
+    case ISEL_POW2: return is_const && c > 0 && (c & (c - 1)) == 0;
+    case ISEL_ZERO: return is_const && c == 0;
+    case ISEL_BYTE_MASK: return is_const && c == 255;
+    case ISEL_LOAD8: return inst->op == IR_OP_LOAD && inst->width == 1 && isel->interior[value];
+  }
+  return 0;
+}
+
+typedef struct {
+  MirReg base;
+  int32_t offset;
+  uint32_t frame;
+} IselAddress;
+
+static IselAddress isel_address(Isel *isel, IrValueId addr, int32_t offset) {
+  const IrFunction *fn = isel->fn;
+  for (;;) {
+    const IrInst *inst = &fn->insts[addr];
+    if (inst->op != IR_OP_ADD || inst->type != IR_TYPE_PTR) {
+      break;
+    }
+    uint32_t ptr = fn->insts[inst->ops[0]].type == IR_TYPE_PTR ? 0 : 1;
+    IrValueId base = inst->ops[ptr];
+    int32_t step;
+    if (!ir_value_const(fn, inst->ops[1 - ptr], &step) ||
+        (!isel->interior[addr] && fn->insts[base].op != IR_OP_ALLOCA)) {
+      break;
+    }
+    if (fn->insts[base].op != IR_OP_ALLOCA && !rv_fits_imm12((int64_t) offset + step)) {
+      break;
+    }
+    offset += step;
+    addr = base;
+  }
+  IselAddress result = {MIR_NONE, offset, MIR_NONE};
+  if (fn->insts[addr].op == IR_OP_ALLOCA) {
+    result.base = RV_SP;
+    result.frame = isel->frame_map[fn->insts[addr].imm];
+    return result;
+  }
+  result.base = isel_reg(isel, addr);
+  if (!rv_fits_imm12(offset)) {
+    MirReg index = isel_temp(isel);
+    MirReg sum = isel_temp(isel);
+    isel_li(isel, index, offset);
+    isel_emit(isel, RV_ADD, sum, result.base, index, 0);
+    result.base = sum;
+    result.offset = 0;
+  }
+  return result;
+}
+
+static void isel_load(Isel *isel, const IrValueId load, const MirReg rd, const RvOpcode op) {
+  const IrInst *inst = &isel->fn->insts[load];
+  IselAddress addr = isel_address(isel, inst->ops[0], inst->imm);
+  MirInst *out = isel_emit(isel, op, rd, addr.base, MIR_NONE, addr.offset);
+  if (addr.frame != MIR_NONE) {
+    isel_frame_operand(out, addr.frame);
+  }
+}
+
+static void isel_store(Isel *isel, const IrValueId store) {
+  const IrInst *inst = &isel->fn->insts[store];
+  MirReg value = isel_reg(isel, inst->ops[1]);
+  IselAddress addr = isel_address(isel, inst->ops[0], inst->imm);
+  MirInst *out = isel_emit(isel, isel_memory_for(inst->width)->store, MIR_NONE, addr.base, value, addr.offset);
+  if (addr.frame != MIR_NONE) {
+    isel_frame_operand(out, addr.frame);
+  }
+}
+
+static void isel_zero_extend(Isel *isel, const MirReg rd, const MirReg rs) {
+  MirReg shifted = isel_temp(isel);
+  isel_emit(isel, RV_SLLI, shifted, rs, MIR_NONE, 32);
+  isel_emit(isel, RV_SRLI, rd, shifted, MIR_NONE, 32);
+}
+
+static void isel_libcall(Isel *isel, const IrOp op, const MirReg rd, const MirReg a, const MirReg b) {
+  RvRuntimeHelper helper = op == IR_OP_MUL ? RV_RUNTIME_MUL : op == IR_OP_DIV ? RV_RUNTIME_DIV : RV_RUNTIME_REM;
+  isel_mv(isel, RV_A0, a);
+  isel_mv(isel, RV_A1, b);
+  isel_emit(isel, RV_CALL, MIR_NONE, MIR_NONE, MIR_NONE, 2)->target = (uint32_t) isel->helpers[helper];
+  isel->out->has_calls = 1;
+  isel_mv(isel, rd, RV_A0);
+}
+
+static int32_t isel_log2(const int32_t value) {
+  int32_t shift = 0;
+  while ((value >> shift) != 1) {
+    shift++;
+  }
+  return shift;
+}
+
+static void isel_apply(Isel *isel, const IselPattern *pattern, const RvOpcode op, const IrValueId left,
+                       const IrValueId right, const MirReg rd) {
+  MirReg t;
+  switch (pattern->action) {
+    case ISEL_ACTION_RR:
+      isel_emit(isel, op, rd, isel_reg(isel, left), isel_reg(isel, right), 0);
+      break;
+    case ISEL_ACTION_RI:
+      isel_emit(isel, op, rd, isel_reg(isel, left), MIR_NONE, isel_const(isel, right));
+      break;
+    case ISEL_ACTION_RI_NEG:
+      isel_emit(isel, op, rd, isel_reg(isel, left), MIR_NONE, -isel_const(isel, right));
+      break;
+    case ISEL_ACTION_RI_INC:
+      isel_emit(isel, op, rd, isel_reg(isel, left), MIR_NONE, isel_const(isel, right) + 1);
+      break;
+    case ISEL_ACTION_RI_LOG2:
+      isel_emit(isel, op, rd, isel_reg(isel, left), MIR_NONE, isel_log2(isel_const(isel, right)));
+      break;
+    case ISEL_ACTION_RR_SWAP: {
+      MirReg a = isel_reg(isel, left);
+      isel_emit(isel, op, rd, isel_reg(isel, right), a, 0);
+      break;
+    }
+    case ISEL_ACTION_RR_NOT:
+      t = isel_temp(isel);
+      isel_emit(isel, op, t, isel_reg(isel, left), isel_reg(isel, right), 0);
+      isel_emit(isel, RV_XORI, rd, t, MIR_NONE, 1);
+      break;
+    case ISEL_ACTION_RR_SWAP_NOT: {
+      MirReg a = isel_reg(isel, left);
+      t = isel_temp(isel);
+      isel_emit(isel, op, t, isel_reg(isel, right), a, 0);
+      isel_emit(isel, RV_XORI, rd, t, MIR_NONE, 1);
+      break;
+    }
+    case ISEL_ACTION_RI_NOT:
+    case ISEL_ACTION_RI_INC_NOT:
+      t = isel_temp(isel);
+      isel_emit(isel, op, t, isel_reg(isel, left), MIR_NONE,
+                isel_const(isel, right) + (pattern->action == ISEL_ACTION_RI_INC_NOT));
+      isel_emit(isel, RV_XORI, rd, t, MIR_NONE, 1);
+      break;
+    case ISEL_ACTION_SEQZ:
+      isel_emit(isel, op, rd, isel_reg(isel, left), MIR_NONE, 1);
+      break;
+    case ISEL_ACTION_SNEZ:
+      isel_emit(isel, op, rd, RV_ZERO, isel_reg(isel, left), 0);
+      break;
+    case ISEL_ACTION_RI_SEQZ:
+    case ISEL_ACTION_RR_SEQZ:
+    case ISEL_ACTION_RI_SNEZ:
+    case ISEL_ACTION_RR_SNEZ: {
+      t = isel_temp(isel);
+      if (pattern->action == ISEL_ACTION_RI_SEQZ || pattern->action == ISEL_ACTION_RI_SNEZ) {
+        isel_emit(isel, op, t, isel_reg(isel, left), MIR_NONE, isel_const(isel, right));
+      } else {
+        isel_emit(isel, op, t, isel_reg(isel, left), isel_reg(isel, right), 0);
+      }
+      if (pattern->action == ISEL_ACTION_RI_SEQZ || pattern->action == ISEL_ACTION_RR_SEQZ) {
+        isel_emit(isel, RV_SLTIU, rd, t, MIR_NONE, 1);
+      } else {
+        isel_emit(isel, RV_SLTU, rd, RV_ZERO, t, 0);
+      }
+      break;
+    }
+    case ISEL_ACTION_NEG:
+      isel_emit(isel, op, rd, RV_ZERO, isel_reg(isel, left), 0);
+      break;
+    case ISEL_ACTION_NOT:
+      isel_emit(isel, op, rd, isel_reg(isel, left), MIR_NONE, -1);
+      break;
+    case ISEL_ACTION_SEXT8: {
+      int32_t shift = isel->target->xlen - 8;
+      t = isel_temp(isel);
+      isel_emit(isel, op, t, isel_reg(isel, left), MIR_NONE, shift);
+      isel_emit(isel, RV_SRAI, rd, t, MIR_NONE, shift);
+      break;
+    }
+    case ISEL_ACTION_LOAD:
+      isel_load(isel, left, rd, op);
+      break;
+    case ISEL_ACTION_COPY:
+      isel_emit(isel, op, rd, isel_reg(isel, left), MIR_NONE, 0);
+      break;
+    case ISEL_ACTION_MULH:
+    case ISEL_ACTION_MULHU: {
+      MirReg a = isel_reg(isel, left);
+      MirReg b = isel_reg(isel, right);
+      if (isel->target->xlen == 32) {
+        isel_emit(isel, op, rd, a, b, 0);
+        break;
+      }
+      if (pattern->action == ISEL_ACTION_MULHU) {
+        MirReg za = isel_temp(isel);
+        MirReg zb = isel_temp(isel);
+        isel_zero_extend(isel, za, a);
+        isel_zero_extend(isel, zb, b);
+        a = za;
+        b = zb;
+      }
+      t = isel_temp(isel);
+      isel_emit(isel, op, t, a, b, 0);
+      isel_emit(isel, RV_SRAI, rd, t, MIR_NONE, 32);
+      break;
+    }
+    case ISEL_ACTION_LIBCALL: {
+      MirReg a = isel_reg(isel, left);
+      MirReg b = isel_reg(isel, right);
+      isel_libcall(isel, pattern->op, rd, a, b);
+      break;
+    }
+  }
+}
+
+static void isel_select(Isel *isel, const IrValueId value, const MirReg rd) {
+  const IrInst *inst = &isel->fn->insts[value];
+  if (inst->op == IR_OP_LOAD) {
+    isel_load(isel, value, rd, isel_memory_for(inst->width)->load);
+    return;
+  }
+  if (inst->op == IR_OP_DATA) {
+    isel_data_address(isel, inst->imm, rd);
+    return;
+  }
+  uint32_t flags = ir_op_flags((IrOp) inst->op);
+  uint32_t orders = (flags & IR_OPF_COMMUTATIVE) ? 2 : 1;
+  for (size_t p = 0; p < sizeof(isel_patterns) / sizeof(isel_patterns[0]); p++) {
+    const IselPattern *pattern = &isel_patterns[p];
+    if (pattern->op != inst->op) {
+      continue;
+    }
+    RvOpcode op = isel->target->xlen == 64 ? pattern->rv64 : pattern->rv32;
+    if ((rv_inst_info(op)->flags & RV_IF_MULDIV) && !isel->target->ext_m) {
+      continue;
+    }
+    for (uint32_t order = 0; order < orders; order++) {
+      IrValueId left = inst->ops[order];
+      IrValueId right = (flags & IR_OPF_BINARY) ? inst->ops[1 - order] : IR_NONE;
+      if (isel_matches(isel, pattern->left, left) && isel_matches(isel, pattern->right, right)) {
+        isel_apply(isel, pattern, op, left, right, rd);
+        return;
+      }
+    }
+  }
+  LOG(FATAL, "no instruction pattern for %s", ir_op_name((IrOp) inst->op));
+}
+
+static void isel_phi_copies(Isel *isel, const IrBlockId from, const IrBlockId to) {
+  const IrFunction *fn = isel->fn;
+  const IrIdVector *insts = &fn->blocks[to].insts;
+  int32_t overlap = 0;
+  for (uint32_t i = 0; i < insts->count; i++) {
+    const IrInst *phi = &fn->insts[insts->items[i]];
+    if (phi->op != IR_OP_PHI) {
+      continue;
+    }
+    IrValueId source = ir_phi_incoming_for(fn, insts->items[i], from);
+    if (fn->insts[source].op == IR_OP_PHI && fn->insts[source].block == to) {
+      overlap = 1;
+    }
+  }
+  MirReg *temps = isel_alloc(insts->count, sizeof(MirReg));
+  for (uint32_t i = 0; i < insts->count; i++) {
+    IrValueId phi = insts->items[i];
+    if (fn->insts[phi].op != IR_OP_PHI || isel_use_count(isel, phi) == 0) {
+      continue;
+    }
+    IrValueId source = ir_phi_incoming_for(fn, phi, from);
+    temps[i] = overlap ? isel_temp(isel) : isel_value_reg(isel, phi);
+    if (fn->insts[source].op == IR_OP_CONST) {
+      isel_li(isel, temps[i], fn->insts[source].imm);
+    } else {
+      isel_mv(isel, temps[i], isel_reg(isel, source));
+    }
+  }
+  for (uint32_t i = 0; overlap && i < insts->count; i++) {
+    IrValueId phi = insts->items[i];
+    if (fn->insts[phi].op == IR_OP_PHI && isel_use_count(isel, phi) > 0) {
+      isel_mv(isel, isel_value_reg(isel, phi), temps[i]);
+    }
+  }
+  free(temps);
+}
+
+static void isel_jump(Isel *isel, const IrBlockId target) {
+  isel_emit(isel, RV_JAL, RV_ZERO, MIR_NONE, MIR_NONE, 0)->target = isel->block_map[target];
+}
+
+static void isel_branch(Isel *isel, const IrValueId branch) {
+  const IrFunction *fn = isel->fn;
+  const IrInst *inst = &fn->insts[branch];
+  IrValueId cond = inst->ops[0];
+  uint32_t taken = isel->block_map[inst->ops[1]];
+  const IrInst *compare = &fn->insts[cond];
+  if (compare->op == IR_OP_CONST || inst->ops[1] == inst->ops[2]) {
+    IrBlockId target = compare->op != IR_OP_CONST || compare->imm ? inst->ops[1] : inst->ops[2];
+    isel_phi_copies(isel, inst->block, target);
+    isel_jump(isel, target);
+    return;
+  }
+  int32_t fused = 0;
+  if (isel->interior[cond] && (ir_op_flags((IrOp) compare->op) & IR_OPF_COMPARE)) {
+    for (size_t p = 0; p < sizeof(isel_branches) / sizeof(isel_branches[0]) && !fused; p++) {
+      const IselBranch *pattern = &isel_branches[p];
+      if (pattern->op != compare->op || !isel_matches(isel, pattern->left, compare->ops[0]) ||
+          !isel_matches(isel, pattern->right, compare->ops[1])) {
+        continue;
+      }
+      MirReg a = isel_reg(isel, compare->ops[0]);
+      MirReg b = isel_reg(isel, compare->ops[1]);
+      if (pattern->action == ISEL_ACTION_RR_SWAP) {
+        isel_emit(isel, pattern->rv, MIR_NONE, b, a, 0)->target = taken;
+      } else {
+        isel_emit(isel, pattern->rv, MIR_NONE, a, b, 0)->target = taken;
+      }
+      fused = 1;
+    }
+  }
+  if (!fused) {
+    isel_emit(isel, RV_BNE, MIR_NONE, isel_reg(isel, cond), RV_ZERO, 0)->target = taken;
+  }
+  isel_jump(isel, inst->ops[2]);
+}
+
+static void isel_vsetvli(Isel *isel, const MirReg rd, const MirReg avl, const int32_t sew, const int32_t lmul) {
+  isel_emit(isel, RV_VSETVLI, rd, avl, MIR_NONE, RV_VTYPE(sew, lmul));
+}
+
+static MirReg isel_vector_reg(const VecLoop *loop, const IrValueId value) {
+  return loop->values[value].reg;
+}
+
+static MirReg isel_vector_address(Isel *isel, const VecLoop *loop, const IrValueId access) {
+  const VecValue *info = &loop->values[access];
+  MirReg base = isel_value_reg(isel, info->base);
+  if (info->offset == 0) {
+    return base;
+  }
+  MirReg addr = isel_temp(isel);
+  if (rv_fits_imm12(info->offset)) {
+    isel_emit(isel, RV_ADDI, addr, base, MIR_NONE, info->offset);
+    return addr;
+  }
+  isel_li(isel, addr, info->offset);
+  isel_emit(isel, RV_ADD, addr, base, addr, 0);
+  return addr;
+}
+
+static void isel_vector_load(Isel *isel, const VecLoop *loop, const IrValueId load) {
+  MirReg addr = isel_vector_address(isel, loop, load);
+  MirReg vd = isel_vector_reg(loop, load);
+  if (isel->fn->insts[load].width == 4) {
+    isel_emit(isel, RV_VLE32_V, vd, addr, MIR_NONE, 0);
+    return;
+  }
+  isel_vsetvli(isel, RV_ZERO, RV_ZERO, RV_VSEW_8, RV_VLMUL_F4);
+  isel_emit(isel, RV_VLE8_V, VEC_TEMP0, addr, MIR_NONE, 0);
+  isel_vsetvli(isel, RV_ZERO, RV_ZERO, RV_VSEW_32, RV_VLMUL_1);
+  isel_emit(isel, RV_VSEXT_VF4, vd, MIR_NONE, VEC_TEMP0, 0);
+}
+
+static MirReg isel_vector_source(Isel *isel, const VecLoop *loop, const MirReg *scalar, const IrValueId value) {
+  if (scalar[value] == MIR_NONE) {
+    return isel_vector_reg(loop, value);
+  }
+  isel_emit(isel, RV_VMV_V_X, VEC_TEMP1, scalar[value], MIR_NONE, 0);
+  return VEC_TEMP1;
+}
+
+static void isel_vector_store(Isel *isel, const VecLoop *loop, const MirReg *scalar, const IrValueId store) {
+  const IrInst *inst = &isel->fn->insts[store];
+  MirReg src = isel_vector_source(isel, loop, scalar, inst->ops[1]);
+  MirReg addr = isel_vector_address(isel, loop, store);
+  if (inst->width == 4) {
+    isel_emit(isel, RV_VSE32_V, src, addr, MIR_NONE, 0);
+    return;
+  }
+  isel_vsetvli(isel, RV_ZERO, RV_ZERO, RV_VSEW_16, RV_VLMUL_F2);
+  isel_emit(isel, RV_VNSRL_WI, VEC_TEMP0, MIR_NONE, src, 0);
+  isel_vsetvli(isel, RV_ZERO, RV_ZERO, RV_VSEW_8, RV_VLMUL_F4);
+  isel_emit(isel, RV_VNSRL_WI, VEC_TEMP2, MIR_NONE, VEC_TEMP0, 0);
+  isel_emit(isel, RV_VSE8_V, VEC_TEMP2, addr, MIR_NONE, 0);
+  isel_vsetvli(isel, RV_ZERO, RV_ZERO, RV_VSEW_32, RV_VLMUL_1);
+}
+
+static void isel_vector_accumulate(Isel *isel, const VecLoop *loop, const IrValueId update) {
+  const IrInst *inst = &isel->fn->insts[update];
+  const VecValue *info = &loop->values[update];
+  MirReg acc = isel_value_reg(isel, info->base);
+  MirReg src = isel_vector_reg(loop, inst->ops[1 - info->offset]);
+  isel_emit(isel, RV_VMV_V_X, VEC_TEMP0, acc, MIR_NONE, 0);
+  isel_emit(isel, vec_reduction(info->pattern), VEC_TEMP2, VEC_TEMP0, src, 0);
+  isel_emit(isel, RV_VMV_X_S, acc, MIR_NONE, VEC_TEMP2, 0);
+}
+
+static void isel_vector_apply(Isel *isel, const VecLoop *loop, const MirReg *scalar, const IrValueId value) {
+  const IrInst *inst = &isel->fn->insts[value];
+  const VecValue *info = &loop->values[value];
+  const VecPattern *pattern = vec_pattern(info->pattern);
+  uint32_t flags = ir_op_flags((IrOp) inst->op);
+  IrValueId left = inst->ops[info->swapped];
+  IrValueId right = (flags & IR_OPF_BINARY) ? inst->ops[1 - info->swapped] : IR_NONE;
+  MirReg vd = info->reg;
+  MirReg dst = (flags & IR_OPF_COMPARE) ? VEC_MASK_REG : vd;
+  switch (pattern->action) {
+    case VEC_ACTION_VV:
+      isel_emit(isel, pattern->rv, dst, isel_vector_reg(loop, right), isel_vector_reg(loop, left), 0);
+      break;
+    case VEC_ACTION_VV_SWAP:
+      isel_emit(isel, pattern->rv, dst, isel_vector_reg(loop, left), isel_vector_reg(loop, right), 0);
+      break;
+    case VEC_ACTION_VX:
+    case VEC_ACTION_VX_NOT:
+      isel_emit(isel, pattern->rv, dst, scalar[right], isel_vector_reg(loop, left), 0);
+      break;
+    case VEC_ACTION_XV:
+      isel_emit(isel, pattern->rv, dst, scalar[left], isel_vector_reg(loop, right), 0);
+      break;
+    case VEC_ACTION_SPLAT:
+      isel_emit(isel, RV_VMV_V_X, VEC_TEMP1, scalar[left], MIR_NONE, 0);
+      isel_emit(isel, pattern->rv, dst, isel_vector_reg(loop, right), VEC_TEMP1, 0);
+      break;
+    case VEC_ACTION_NEG:
+      isel_emit(isel, pattern->rv, vd, RV_ZERO, isel_vector_reg(loop, left), 0);
+      break;
+    case VEC_ACTION_NOT:
+      isel_emit(isel, pattern->rv, vd, MIR_NONE, isel_vector_reg(loop, left), -1);
+      break;
+    case VEC_ACTION_SEXT8:
+      isel_emit(isel, pattern->rv, vd, MIR_NONE, isel_vector_reg(loop, left), 24);
+      isel_emit(isel, RV_VSRA_VI, vd, MIR_NONE, vd, 24);
+      break;
+    case VEC_ACTION_COPY:
+      isel_emit(isel, pattern->rv, vd, MIR_NONE, isel_vector_reg(loop, left), 0);
+      break;
+  }
+  if (flags & IR_OPF_COMPARE) {
+    isel_emit(isel, RV_VMV_V_X, vd, RV_ZERO, MIR_NONE, 0);
+    isel_emit(isel, RV_VMERGE_VIM, vd, MIR_NONE, vd, 1);
+    if (pattern->action == VEC_ACTION_VX_NOT) {
+      isel_emit(isel, RV_VXOR_VI, vd, MIR_NONE, vd, 1);
+    }
+  }
+}
+
+static void isel_vector_scalar(Isel *isel, const VecLoop *loop, MirReg *scalar, const IrValueId value) {
+  if (value != IR_NONE && scalar[value] == MIR_NONE && loop->values[value].kind == VEC_UNIFORM) {
+    scalar[value] = isel_reg(isel, value);
+  }
+}
+
+static void isel_vector_setup(Isel *isel, const VecLoop *loop, MirReg *scalar, const MirReg n) {
+  const IrFunction *fn = isel->fn;
+  const IrIdVector *insts = &fn->blocks[loop->body].insts;
+  for (uint32_t i = 0; i < insts->count; i++) {
+    IrValueId id = insts->items[i];
+    uint8_t op = fn->insts[id].op;
+    if (loop->values[id].kind == VEC_UNIFORM && op != IR_OP_CONST && op != IR_OP_NOP && op != IR_OP_JUMP &&
+        !isel->interior[id] && isel_use_count(isel, id) > 0) {
+      isel_select(isel, id, isel_value_reg(isel, id));
+    }
+  }
+  for (uint32_t i = 0; i < insts->count; i++) {
+    IrValueId id = insts->items[i];
+    const IrInst *inst = &fn->insts[id];
+    const VecValue *info = &loop->values[id];
+    if (info->kind == VEC_STORE) {
+      isel_vector_scalar(isel, loop, scalar, inst->ops[1]);
+    } else if (info->kind == VEC_VECTOR && info->live && inst->op != IR_OP_LOAD) {
+      isel_vector_scalar(isel, loop, scalar, inst->ops[0]);
+      if (ir_op_flags((IrOp) inst->op) & IR_OPF_BINARY) {
+        isel_vector_scalar(isel, loop, scalar, inst->ops[1]);
+      }
+    }
+  }
+  int32_t is_ptr = fn->insts[loop->control].type == IR_TYPE_PTR;
+  int32_t shift = isel_log2(loop->values[loop->control].offset);
+  MirReg iv = isel_value_reg(isel, loop->control);
+  MirReg bound = isel_reg(isel, loop->bound);
+  MirInst *skip;
+  if (loop->compare == IR_OP_LT) {
+    skip = isel_emit(isel, is_ptr ? RV_BGEU : RV_BGE, MIR_NONE, iv, bound, 0);
+  } else if (loop->compare == IR_OP_LE) {
+    skip = isel_emit(isel, is_ptr ? RV_BLTU : RV_BLT, MIR_NONE, bound, iv, 0);
+  } else {
+    skip = isel_emit(isel, RV_BEQ, MIR_NONE, iv, bound, 0);
+  }
+  skip->target = isel->block_map[loop->exit];
+  isel_emit(isel, RV_SUB, n, bound, iv, 0);
+  if (loop->compare == IR_OP_LT && shift > 0) {
+    isel_emit(isel, RV_ADDI, n, n, MIR_NONE, (1 << shift) - 1);
+  }
+  if (shift > 0) {
+    isel_emit(isel, RV_SRLI, n, n, MIR_NONE, shift);
+  }
+  if (loop->compare == IR_OP_LE) {
+    isel_emit(isel, RV_ADDI, n, n, MIR_NONE, 1);
+  }
+  isel_jump(isel, loop->body);
+}
+
+static void isel_vector_loop(Isel *isel, const VecLoop *loop) {
+  const IrFunction *fn = isel->fn;
+  MirReg *scalar = isel_alloc(fn->inst_count, sizeof(MirReg));
+  memset(scalar, 0xff, fn->inst_count * sizeof(MirReg));
+  MirReg n = isel_temp(isel);
+  isel_vector_setup(isel, loop, scalar, n);
+  isel->block = isel->block_map[loop->body];
+  MirReg vl = isel_temp(isel);
+  isel_vsetvli(isel, vl, n, RV_VSEW_32, RV_VLMUL_1);
+  const IrIdVector *phis = &fn->blocks[loop->header].insts;
+  for (uint32_t i = 0; i < phis->count; i++) {
+    IrValueId phi = phis->items[i];
+    const VecValue *info = &loop->values[phi];
+    if (info->kind == VEC_INDUCTION && info->live) {
+      isel_emit(isel, RV_VID_V, info->reg, MIR_NONE, MIR_NONE, 0);
+      isel_emit(isel, RV_VADD_VX, info->reg, isel_value_reg(isel, phi), info->reg, 0);
+    }
+  }
+  const IrIdVector *insts = &fn->blocks[loop->body].insts;
+  for (uint32_t i = 0; i < insts->count; i++) {
+    IrValueId id = insts->items[i];
+    const VecValue *info = &loop->values[id];
+    if (info->kind == VEC_STORE) {
+      isel_vector_store(isel, loop, scalar, id);
+    } else if (info->kind == VEC_ACCUMULATE) {
+      isel_vector_accumulate(isel, loop, id);
+    } else if (info->kind == VEC_VECTOR && info->live && fn->insts[id].op == IR_OP_LOAD) {
+      isel_vector_load(isel, loop, id);
+    } else if (info->kind == VEC_VECTOR && info->live) {
+      isel_vector_apply(isel, loop, scalar, id);
+    }
+  }
+  MirReg steps[32];
+  memset(steps, 0xff, sizeof(steps));
+  steps[0] = vl;
+  for (uint32_t i = 0; i < phis->count; i++) {
+    IrValueId phi = phis->items[i];
+    const VecValue *info = &loop->values[phi];
+    if (info->kind != VEC_INDUCTION || isel_use_count(isel, phi) == 0) {
+      continue;
+    }
+    int32_t shift = isel_log2(info->offset);
+    if (steps[shift] == MIR_NONE) {
+      steps[shift] = isel_temp(isel);
+      isel_emit(isel, RV_SLLI, steps[shift], vl, MIR_NONE, shift);
+    }
+    MirReg step = steps[shift];
+    RvOpcode add = fn->insts[phi].type == IR_TYPE_I32 && isel->target->xlen == 64 ? RV_ADDW : RV_ADD;
+    MirReg reg = isel_value_reg(isel, phi);
+    isel_emit(isel, add, reg, reg, step, 0);
+  }
+  isel_emit(isel, RV_SUB, n, n, vl, 0);
+  isel_emit(isel, RV_BNE, MIR_NONE, n, RV_ZERO, 0)->target = isel->block_map[loop->body];
+  isel_jump(isel, loop->exit);
+  free(scalar);
+}
+
+static int32_t isel_call(Isel *isel, const IrValueId call) {
+  const IrFunction *fn = isel->fn;
+  const IrInst *inst = &fn->insts[call];
+  int32_t xlen_bytes = isel->target->xlen / 8;
+  MirReg *args = isel_alloc(inst->list_count, sizeof(MirReg));
+  for (uint32_t a = 0; a < inst->list_count; a++) {
+    args[a] = isel_reg(isel, fn->operands[inst->list + a]);
+  }
+  for (uint32_t a = 0; a < inst->list_count; a++) {
+    if (a < RV_ARG_REGS) {
+      isel_mv(isel, RV_A0 + a, args[a]);
+      continue;
+    }
+    int32_t offset = (int32_t) (a - RV_ARG_REGS) * xlen_bytes;
+    isel_emit(isel, isel_memory_for((uint32_t) xlen_bytes)->store, MIR_NONE, RV_SP, args[a], offset);
+    if (offset + xlen_bytes > isel->out->outgoing_size) {
+      isel->out->outgoing_size = offset + xlen_bytes;
+    }
+  }
+  free(args);
+  int32_t reg_args = inst->list_count < RV_ARG_REGS ? (int32_t) inst->list_count : RV_ARG_REGS;
+  if ((inst->flags & IR_INST_TAIL) && inst->list_count <= RV_ARG_REGS) {
+    isel_emit(isel, RV_TAIL, MIR_NONE, MIR_NONE, MIR_NONE, reg_args)->target = (uint32_t) inst->imm;
+    return 1;
+  }
+  isel_emit(isel, RV_CALL, MIR_NONE, MIR_NONE, MIR_NONE, reg_args)->target = (uint32_t) inst->imm;
+  isel->out->has_calls = 1;
+  if (inst->type != IR_TYPE_VOID && isel_use_count(isel, call) > 0) {
+    isel_mv(isel, isel_value_reg(isel, call), RV_A0);
+  }
+  return 0;
+}
+
+static void isel_ret(Isel *isel, const IrValueId ret) {
+  const IrInst *inst = &isel->fn->insts[ret];
+  if (inst->ops[0] == IR_NONE) {
+    isel_emit(isel, RV_RET, MIR_NONE, MIR_NONE, MIR_NONE, 0);
+    return;
+  }
+  const IrInst *value = &isel->fn->insts[inst->ops[0]];
+  if (value->op == IR_OP_CONST) {
+    isel_li(isel, RV_A0, value->imm);
+  } else {
+    isel_mv(isel, RV_A0, isel_reg(isel, inst->ops[0]));
+  }
+  isel_emit(isel, RV_RET, MIR_NONE, MIR_NONE, MIR_NONE, 1);
+}
+
+static void isel_params(Isel *isel) {
+  const IrFunction *fn = isel->fn;
+  int32_t xlen_bytes = isel->target->xlen / 8;
+  for (uint32_t i = 0; i < fn->inst_count; i++) {
+    const IrInst *inst = &fn->insts[i];
+    if (inst->op != IR_OP_PARAM || inst->block == IR_NONE || isel_use_count(isel, i) == 0) {
+      continue;
+    }
+    if (inst->imm < RV_ARG_REGS) {
+      isel_mv(isel, isel_value_reg(isel, i), RV_A0 + (MirReg) inst->imm);
+      continue;
+    }
+    uint32_t object = mir_frame_object_create(isel->out, xlen_bytes, xlen_bytes, MIR_FRAME_INCOMING);
+    isel->out->frame[object].offset = (inst->imm - RV_ARG_REGS) * xlen_bytes;
+    MirInst *load = isel_emit(isel, isel_memory_for((uint32_t) xlen_bytes)->load, isel_value_reg(isel, i), RV_SP,
+                              MIR_NONE, 0);
+    isel_frame_operand(load, object);
+  }
+}
+
+static void isel_mark_interior(Isel *isel) {
+  const IrFunction *fn = isel->fn;
+  uint32_t *emit_at = isel_alloc(fn->inst_count, sizeof(uint32_t));
+  for (uint32_t b = 0; b < fn->block_count; b++) {
+    const IrIdVector *insts = &fn->blocks[b].insts;
+    if (fn->blocks[b].flags & IR_BLOCK_DEAD) {
+      continue;
+    }
+    for (uint32_t i = insts->count; i-- > 0;) {
+      IrValueId value = insts->items[i];
+      const IrInst *inst = &fn->insts[value];
+      emit_at[value] = i;
+      if (isel_use_count(isel, value) != 1 || inst->op == IR_OP_CONST || inst->op == IR_OP_ALLOCA ||
+          inst->op == IR_OP_PARAM || inst->op == IR_OP_PHI) {
+        continue;
+      }
+      IrValueId user = isel->uses.users[isel->uses.start[value]];
+      const IrInst *user_inst = &fn->insts[user];
+      if (user_inst->block != b || user_inst->op == IR_OP_PHI) {
+        continue;
+      }
+      if (inst->op == IR_OP_LOAD) {
+        int32_t clobbered = 0;
+        for (uint32_t k = i + 1; k < emit_at[user] && !clobbered; k++) {
+          uint8_t op = fn->insts[insts->items[k]].op;
+          clobbered = op == IR_OP_STORE || op == IR_OP_CALL;
+        }
+        if (clobbered) {
+          continue;
+        }
+      } else if (!(ir_op_flags((IrOp) inst->op) & IR_OPF_PURE)) {
+        continue;
+      }
+      isel->interior[value] = 1;
+      emit_at[value] = emit_at[user];
+    }
+  }
+  free(emit_at);
+}
+
+static int32_t isel_has_phis(const IrFunction *fn, const IrBlockId block) {
+  const IrIdVector *insts = &fn->blocks[block].insts;
+  for (uint32_t i = 0; i < insts->count; i++) {
+    if (fn->insts[insts->items[i]].op == IR_OP_PHI) {
+      return 1;
+    }
+  }
+  return 0;
+}
+
+static void isel_split_critical_edges(IrFunction *fn) {
+  uint32_t block_count = fn->block_count;
+  for (uint32_t b = 0; b < block_count; b++) {
+    if ((fn->blocks[b].flags & IR_BLOCK_DEAD) || !isel_has_phis(fn, b)) {
+      continue;
+    }
+    int32_t changed = 1;
+    while (changed) {
+      changed = 0;
+      for (uint32_t p = 0; p < fn->blocks[b].preds.count && !changed; p++) {
+        IrBlockId pred = fn->blocks[b].preds.items[p];
+        IrBlockId succs[2];
+        if (ir_block_succs(fn, pred, succs) == 2) {
+          ir_split_edge(fn, pred, b);
+          changed = 1;
+        }
+      }
+    }
+  }
+}
+
+static void isel_plan_vectors(Isel *isel, const IrLoopInfo *loops) {
+  const IrFunction *fn = isel->fn;
+  isel->plan_count = isel->vectorize ? loops->loop_count : 0;
+  isel->plans = isel_alloc(isel->plan_count, sizeof(VecLoop));
+  isel->block_plan = isel_alloc(fn->block_count, sizeof(uint32_t));
+  memset(isel->block_plan, 0xff, fn->block_count * sizeof(uint32_t));
+  for (uint32_t l = 0; l < isel->plan_count; l++) {
+    VecLoop *plan = &isel->plans[l];
+    VecStatus status = vec_analyze_loop(plan, fn, &isel->uses, loops, l);
+    stats_add(vec_status_name(status), 1);
+    if (status != VEC_OK) {
+      vec_loop_destroy(plan);
+      continue;
+    }
+    isel->block_plan[plan->header] = l;
+    isel->block_plan[plan->body] = l;
+  }
+}
+
+static void isel_block_probs(Isel *isel, const IrDomTree *dom, const IrLoopInfo *loops) {
+  const IrFunction *fn = isel->fn;
+  const IrProfile *profile = isel->profile;
+  const IrFunctionProfile *counts =
+      profile && (uint32_t) fn->index < profile->function_count ? &profile->functions[fn->index] : NULL;
+  IrBlockProbs probs;
+  ir_probs_compute(&probs, fn, dom, loops, counts);
+  for (uint32_t b = 0; b < fn->block_count; b++) {
+    if (isel->block_map[b] != MIR_NONE) {
+      MirBlock *block = &isel->out->blocks[isel->block_map[b]];
+      block->frequency = probs.frequency[b];
+      block->taken = probs.taken[b];
+    }
+  }
+  for (uint32_t l = 0; l < isel->plan_count; l++) {
+    const VecLoop *plan = &isel->plans[l];
+    if (isel->block_plan[plan->header] == l) {
+      isel->out->blocks[isel->block_map[plan->body]].taken = ir_probs_edge(&probs, fn, plan->header, plan->body);
+    }
+  }
+  ir_probs_destroy(&probs);
+}
+
+static void isel_function(Isel *isel, IrFunction *fn, MirFunction *out) {
+  isel->fn = fn;
+  isel->out = out;
+  isel_split_critical_edges(fn);
+  ir_uses_compute(&isel->uses, fn);
+  isel->vreg = isel_alloc(fn->inst_count, sizeof(MirReg));
+  memset(isel->vreg, 0xff, fn->inst_count * sizeof(MirReg));
+  isel->interior = isel_alloc(fn->inst_count, 1);
+  isel->block_map = isel_alloc(fn->block_count, sizeof(uint32_t));
+  isel->frame_map = isel_alloc(fn->frame_count, sizeof(uint32_t));
+  for (uint32_t f = 0; f < fn->frame_count; f++) {
+    const IrFrameObject *object = &fn->frame[f];
+    isel->frame_map[f] = (object->flags & IR_FRAME_DEAD) ? MIR_NONE
+                         : mir_frame_object_create(out, object->size, object->align, MIR_FRAME_LOCAL);
+  }
+  IrDomTree dom;
+  IrLoopInfo loops;
+  ir_dom_compute(&dom, fn);
+  ir_loops_compute(&loops, fn, &dom);
+  for (uint32_t b = 0; b < fn->block_count; b++) {
+    isel->block_map[b] = (fn->blocks[b].flags & IR_BLOCK_DEAD) ? MIR_NONE : mir_block_create(out);
+    if (isel->block_map[b] != MIR_NONE) {
+      out->blocks[isel->block_map[b]].loop_depth = loops.block_depth[b];
+    }
+  }
+  isel_plan_vectors(isel, &loops);
+  isel_block_probs(isel, &dom, &loops);
+  ir_loops_destroy(&loops);
+  ir_dom_destroy(&dom);
+  isel_mark_interior(isel);
+  isel->block = 0;
+  isel_params(isel);
+  for (uint32_t b = 0; b < fn->block_count; b++) {
+    if (isel->block_map[b] == MIR_NONE) {
+      continue;
+    }
+    isel->block = isel->block_map[b];
+    if (isel->block_plan[b] != IR_NONE) {
+      const VecLoop *plan = &isel->plans[isel->block_plan[b]];
+      if (plan->header == b) {
+        isel_vector_loop(isel, plan);
+      }
+      continue;
+    }
+    const IrIdVector *insts = &fn->blocks[b].insts;
+    for (uint32_t i = 0; i < insts->count; i++) {
+      IrValueId id = insts->items[i];
+      const IrInst *inst = &fn->insts[id];
+      if (isel->interior[id]) {
+        continue;
+      }
+      switch (inst->op) {
+        case IR_OP_NOP:
+        case IR_OP_PHI:
+        case IR_OP_PARAM:
+        case IR_OP_CONST:
+        case IR_OP_ALLOCA:
+          break;
+        case IR_OP_STORE:
+          isel_store(isel, id);
+          break;
+        case IR_OP_CALL:
+          if (isel_call(isel, id)) {
+            i = insts->count;
+          }
+          break;
+        case IR_OP_JUMP:
+          isel_phi_copies(isel, b, inst->ops[0]);
+          isel_jump(isel, inst->ops[0]);
+          break;
+        case IR_OP_BRANCH:
+          isel_branch(isel, id);
+          break;
+        case IR_OP_RET:
+          isel_ret(isel, id);
+          break;
+        default:
+          if (isel_use_count(isel, id) > 0) {
+            isel_select(isel, id, isel_value_reg(isel, id));
+          }
+          break;
+      }
+    }
+  }
+  stats_add("isel.mir_insts", mir_inst_count(out));
+  ir_uses_destroy(&isel->uses);
+  free(isel->vreg);
+  free(isel->interior);
+  free(isel->block_map);
+  free(isel->frame_map);
+  for (uint32_t l = 0; l < isel->plan_count; l++) {
+    vec_loop_destroy(&isel->plans[l]);
+  }
+  free(isel->plans);
+  free(isel->block_plan);
+}
+
+void isel_select_module(MirModule *out, IrModule *module, const int32_t vectorize, const IrProfile *profile) {
+  int32_t helpers[RV_RUNTIME_COUNT];
+  rv_runtime_add_helpers(module, &out->target, helpers);
+  Isel isel;
+  memset(&isel, 0, sizeof(isel));
+  isel.mir = out;
+  isel.target = &out->target;
+  isel.helpers = helpers;
+  isel.vectorize = vectorize;
+  isel.profile = profile;
+  isel.data_map = isel_alloc(module->data_count, sizeof(uint32_t));
+  for (uint32_t d = 0; d < module->data_count; d++) {
+    isel.data_map[d] = MIR_NONE;
+  }
+  for (uint32_t f = 0; f < module->function_count; f++) {
+    IrFunction *fn = module->functions[f];
+    int32_t global = 1;
+    for (uint32_t h = 0; h < RV_RUNTIME_COUNT; h++) {
+      global &= helpers[h] != fn->index;
+    }
+    MirFunction *mir = mir_function_create(out, arena_strndup(&out->arena, fn->name, fn->length), global);
+    if (fn->block_count > 0) {
+      isel_function(&isel, fn, mir);
+    }
+  }
+  free(isel.data_map);
+}
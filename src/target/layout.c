@@ -0,0 +1,504 @@
+#include "target/layout.h"
+#include "utils/diagnostic.h"
+#include "utils/stats.h"
+#include <stdlib.h>
+#include <string.h>
+
+#define LAYOUT_MAX_SUCCS 3
+
+typedef struct {
+  uint32_t from;
+  uint32_t to;
+  float weight;
+} LayoutEdge;
+
+typedef struct {
+  MirFunction *fn;
+  uint32_t count;
+  uint32_t *rpo;
+  uint32_t rpo_count;
+  uint32_t *rpo_index;
+  uint32_t *idom;
+  uint32_t *pred_start;
+  uint32_t *preds;
+  uint8_t *header;
+  uint32_t *succ_count;
+  LayoutEdge *succs;
+  LayoutEdge *edges;
+  uint32_t edge_count;
+  uint32_t *head;
+  uint32_t *next;
+  uint32_t *prev;
+} Layout;
+
+static void *layout_alloc(const size_t count, const size_t size) {
+  void *ptr = calloc(count ? count : 1, size);
+  if (!ptr) {
+    LOG(FATAL, "out of memory");
+  }
+  return ptr;
+}
+
+static int32_t layout_is_control(const MirInst *inst) {
+  return (rv_inst_info((RvOpcode) inst->op)->flags & RV_IF_BRANCH) || inst->op == RV_JAL;
+}
+
+static void layout_explicit_jumps(MirFunction *fn) {
+  for (uint32_t b = 0; b + 1 < fn->block_count; b++) {
+    uint32_t flags = 0;
+    for (uint32_t i = mir_block_terminator_start(fn, b); i < fn->blocks[b].count; i++) {
+      flags |= rv_inst_info((RvOpcode) fn->blocks[b].insts[i].op)->flags;
+    }
+    if (!(flags & (RV_IF_JUMP | RV_IF_RETURN))) {
+      mir_emit(fn, b, RV_JAL, RV_ZERO, MIR_NONE, MIR_NONE, 0)->target = b + 1;
+    }
+  }
+}
+
+static uint32_t layout_jump_target(const MirFunction *fn, const uint32_t block) {
+  const MirBlock *data = &fn->blocks[block];
+  if (data->count != 1 || data->insts[0].op != RV_JAL || data->insts[0].rd != RV_ZERO) {
+    return MIR_NONE;
+  }
+  return data->insts[0].target;
+}
+
+static void layout_thread_jumps(MirFunction *fn) {
+  for (uint32_t b = 0; b < fn->block_count; b++) {
+    for (uint32_t i = 0; i < fn->blocks[b].count; i++) {
+      MirInst *inst = &fn->blocks[b].insts[i];
+      if (!layout_is_control(inst)) {
+        continue;
+      }
+      uint32_t target = inst->target;
+      for (uint32_t hops = 0; hops < fn->block_count; hops++) {
+        uint32_t next = layout_jump_target(fn, target);
+        if (next == MIR_NONE || next == target) {
+          break;
+        }
+        target = next;
+      }
+      if (target != inst->target) {
+        inst->target = target;
+        stats_add("layout.jumps_threaded", 1);
+      }
+    }
+  }
+}
+
+static void layout_add_succ(Layout *layout, const uint32_t from, const uint32_t to, const float weight) {
+  LayoutEdge *succs = &layout->succs[from * LAYOUT_MAX_SUCCS];
+  for (uint32_t s = 0; s < layout->succ_count[from]; s++) {
+    if (succs[s].to == to) {
+      succs[s].weight += weight;
+      return;
+    }
+  }
+  succs[layout->succ_count[from]++] = (LayoutEdge) {from, to, weight};
+}
+
+static void layout_collect_succs(Layout *layout) {
+  const MirFunction *fn = layout->fn;
+  for (uint32_t b = 0; b < layout->count; b++) {
+    const MirBlock *block = &fn->blocks[b];
+    float rest = 1.0f;
+    uint32_t start = mir_block_terminator_start(fn, b);
+    for (uint32_t i = 0; i < block->count; i++) {
+      const MirInst *inst = &block->insts[i];
+      if (i < start) {
+        if (layout_is_control(inst)) {
+          layout_add_succ(layout, b, inst->target, 0.0f);
+        }
+      } else if (rv_inst_info((RvOpcode) inst->op)->flags & RV_IF_BRANCH) {
+        layout_add_succ(layout, b, inst->target, block->frequency * block->taken);
+        rest = 1.0f - block->taken;
+      } else if (inst->op == RV_JAL) {
+        layout_add_succ(layout, b, inst->target, block->frequency * rest);
+      }
+    }
+  }
+}
+
+static void layout_order_rpo(Layout *layout) {
+  uint32_t n = layout->count;
+  uint32_t *stack = layout_alloc(n, sizeof(uint32_t));
+  uint32_t *cursor = layout_alloc(n, sizeof(uint32_t));
+  uint32_t *post = layout_alloc(n, sizeof(uint32_t));
+  uint8_t *seen = layout_alloc(n, 1);
+  uint32_t sp = 0;
+  uint32_t post_count = 0;
+  stack[sp++] = 0;
+  seen[0] = 1;
+  while (sp > 0) {
+    uint32_t block = stack[sp - 1];
+    if (cursor[block] < layout->succ_count[block]) {
+      uint32_t succ = layout->succs[block * LAYOUT_MAX_SUCCS + cursor[block]++].to;
+      if (!seen[succ]) {
+        seen[succ] = 1;
+        stack[sp++] = succ;
+      }
+      continue;
+    }
+    post[post_count++] = block;
+    sp--;
+  }
+  layout->rpo_count = post_count;
+  for (uint32_t b = 0; b < n; b++) {
+    layout->rpo_index[b] = MIR_NONE;
+  }
+  for (uint32_t i = 0; i < post_count; i++) {
+    layout->rpo[i] = post[post_count - 1 - i];
+    layout->rpo_index[layout->rpo[i]] = i;
+  }
+  free(stack);
+  free(cursor);
+  free(post);
+  free(seen);
+}
+
+static uint32_t layout_intersect(const Layout *layout, uint32_t a, uint32_t b) {
+  while (a != b) {
+    while (layout->rpo_index[a] > layout->rpo_index[b]) {
+      a = layout->idom[a];
+    }
+    while (layout->rpo_index[b] > layout->rpo_index[a]) {
+      b = layout->idom[b];
+    }
+  }
+  return a;
+}
+
+static void layout_dominators(Layout *layout) {
+  uint32_t n = layout->count;
+  for (uint32_t b = 0; b < n; b++) {
+    for (uint32_t s = 0; s < layout->succ_count[b]; s++) {
+      layout->pred_start[layout->succs[b * LAYOUT_MAX_SUCCS + s].to + 1]++;
+    }
+  }
+  for (uint32_t b = 0; b < n; b++) {
+    layout->pred_start[b + 1] += layout->pred_start[b];
+  }
+  uint32_t *fill = layout_alloc(n, sizeof(uint32_t));
+  memcpy(fill, layout->pred_start, n * sizeof(uint32_t));
+  for (uint32_t b = 0; b < n; b++) {
+    for (uint32_t s = 0; s < layout->succ_count[b]; s++) {
+      uint32_t succ = layout->succs[b * LAYOUT_MAX_SUCCS + s].to;
+      layout->preds[fill[succ]++] = b;
+    }
+  }
+  free(fill);
+  for (uint32_t b = 0; b < n; b++) {
+    layout->idom[b] = MIR_NONE;
+  }
+  layout->idom[0] = 0;
+  int32_t changed = 1;
+  while (changed) {
+    changed = 0;
+    for (uint32_t r = 1; r < layout->rpo_count; r++) {
+      uint32_t block = layout->rpo[r];
+      uint32_t idom = MIR_NONE;
+      for (uint32_t p = layout->pred_start[block]; p < layout->pred_start[block + 1]; p++) {
+        uint32_t pred = layout->preds[p];
+        if (layout->idom[pred] != MIR_NONE) {
+          idom = idom == MIR_NONE ? pred : layout_intersect(layout, pred, idom);
+        }
+      }
+      if (layout->idom[block] != idom) {
+        layout->idom[block] = idom;
+        changed = 1;
+      }
+    }
+  }
+}
+
+static int32_t layout_dominates(const Layout *layout, const uint32_t a, uint32_t b) {
+  if (layout->rpo_index[a] == MIR_NONE || layout->rpo_index[b] == MIR_NONE) {
+    return 0;
+  }
+  while (b != a && b != 0) {
+    b = layout->idom[b];
+  }
+  return b == a;
+}
+
+static void layout_find_headers(Layout *layout) {
+  for (uint32_t b = 0; b < layout->count; b++) {
+    for (uint32_t p = layout->pred_start[b]; p < layout->pred_start[b + 1]; p++) {
+      if (layout_dominates(layout, b, layout->preds[p])) {
+        layout->header[b] = 1;
+      }
+    }
+  }
+}
+
+static int layout_edge_compare(const void *a, const void *b) {
+  const LayoutEdge *left = a;
+  const LayoutEdge *right = b;
+  if (left->weight != right->weight) {
+    return left->weight > right->weight ? -1 : 1;
+  }
+  if (left->from != right->from) {
+    return left->from < right->from ? -1 : 1;
+  }
+  return left->to < right->to ? -1 : left->to > right->to;
+}
+
+static void layout_sort_edges(Layout *layout) {
+  layout->edges = layout_alloc(layout->count * LAYOUT_MAX_SUCCS, sizeof(LayoutEdge));
+  for (uint32_t b = 0; b < layout->count; b++) {
+    for (uint32_t s = 0; s < layout->succ_count[b] && layout->rpo_index[b] != MIR_NONE; s++) {
+      layout->edges[layout->edge_count++] = layout->succs[b * LAYOUT_MAX_SUCCS + s];
+    }
+  }
+  qsort(layout->edges, layout->edge_count, sizeof(LayoutEdge), layout_edge_compare);
+}
+
+static void layout_merge(Layout *layout, const int32_t enter_loops) {
+  for (uint32_t e = 0; e < layout->edge_count; e++) {
+    uint32_t from = layout->edges[e].from;
+    uint32_t to = layout->edges[e].to;
+    if (to == 0 || layout->next[from] != MIR_NONE || layout->prev[to] != MIR_NONE ||
+        layout->head[from] == layout->head[to]) {
+      continue;
+    }
+    if (!enter_loops && layout->header[to] && !layout_dominates(layout, to, from)) {
+      continue;
+    }
+    layout->next[from] = to;
+    layout->prev[to] = from;
+    for (uint32_t block = to; block != MIR_NONE; block = layout->next[block]) {
+      layout->head[block] = layout->head[from];
+    }
+  }
+}
+
+static float layout_weight(const Layout *layout, const uint32_t from, const uint32_t to) {
+  for (uint32_t s = 0; s < layout->succ_count[from]; s++) {
+    if (layout->succs[from * LAYOUT_MAX_SUCCS + s].to == to) {
+      return layout->succs[from * LAYOUT_MAX_SUCCS + s].weight;
+    }
+  }
+  return -1.0f;
+}
+
+static float layout_exit_weight(const Layout *layout, const uint32_t block) {
+  float best = 0.0f;
+  for (uint32_t s = 0; s < layout->succ_count[block]; s++) {
+    const LayoutEdge *edge = &layout->succs[block * LAYOUT_MAX_SUCCS + s];
+    if (layout->head[edge->to] != layout->head[block] && edge->weight > best) {
+      best = edge->weight;
+    }
+  }
+  return best;
+}
+
+static void layout_rotate(Layout *layout, uint32_t *chain) {
+  for (uint32_t h = 0; h < layout->count; h++) {
+    if (!layout->header[h] || layout->prev[h] != MIR_NONE) {
+      continue;
+    }
+    uint32_t n = 0;
+    for (uint32_t block = h; block != MIR_NONE; block = layout->next[block]) {
+      chain[n++] = block;
+    }
+    uint32_t tail = chain[n - 1];
+    if (n < 2 || !layout_dominates(layout, h, tail) || layout_weight(layout, tail, h) < 0.0f) {
+      continue;
+    }
+    uint32_t best = n - 1;
+    float best_score = layout_exit_weight(layout, tail) - layout_weight(layout, tail, h);
+    for (uint32_t k = 0; k + 1 < n; k++) {
+      float score = layout_exit_weight(layout, chain[k]) - layout_weight(layout, chain[k], chain[k + 1]);
+      if (score > best_score) {
+        best = k;
+        best_score = score;
+      }
+    }
+    if (best == n - 1) {
+      continue;
+    }
+    uint32_t top = chain[best + 1];
+    layout->next[tail] = h;
+    layout->prev[h] = tail;
+    layout->next[chain[best]] = MIR_NONE;
+    layout->prev[top] = MIR_NONE;
+    for (uint32_t i = 0; i < n; i++) {
+      layout->head[chain[i]] = top;
+    }
+    stats_add("layout.loops_rotated", 1);
+  }
+}
+
+static uint32_t layout_next_chain(const Layout *layout, const uint32_t tail, const uint8_t *placed,
+                                  const float *hottest) {
+  uint32_t best = MIR_NONE;
+  float best_weight = -1.0f;
+  for (uint32_t s = 0; s < layout->succ_count[tail]; s++) {
+    const LayoutEdge *edge = &layout->succs[tail * LAYOUT_MAX_SUCCS + s];
+    if (!placed[layout->head[edge->to]] && edge->weight > best_weight) {
+      best = layout->head[edge->to];
+      best_weight = edge->weight;
+    }
+  }
+  if (best != MIR_NONE) {
+    return best;
+  }
+  for (uint32_t b = 0; b < layout->count; b++) {
+    if (layout->prev[b] == MIR_NONE && !placed[b] && layout->rpo_index[b] != MIR_NONE &&
+        (best == MIR_NONE || hottest[b] > hottest[best])) {
+      best = b;
+    }
+  }
+  return best;
+}
+
+static uint32_t layout_place(Layout *layout, uint32_t *order) {
+  uint32_t n = layout->count;
+  uint8_t *placed = layout_alloc(n, 1);
+  float *hottest = layout_alloc(n, sizeof(float));
+  for (uint32_t b = 0; b < n; b++) {
+    if (layout->fn->blocks[b].frequency > hottest[layout->head[b]]) {
+      hottest[layout->head[b]] = layout->fn->blocks[b].frequency;
+    }
+  }
+  uint32_t count = 0;
+  uint32_t chain = 0;
+  while (chain != MIR_NONE) {
+    placed[chain] = 1;
+    for (uint32_t block = chain; block != MIR_NONE; block = layout->next[block]) {
+      order[count++] = block;
+    }
+    chain = layout_next_chain(layout, order[count - 1], placed, hottest);
+  }
+  free(placed);
+  free(hottest);
+  return count;
+}
+
+static void layout_align_loops(Layout *layout, const uint32_t *position, const uint32_t align) {
+  MirFunction *fn = layout->fn;
+  uint32_t *mark = layout_alloc(layout->count, sizeof(uint32_t));
+  uint32_t *stack = layout_alloc(layout->count, sizeof(uint32_t));
+  for (uint32_t b = 0; b < layout->count; b++) {
+    mark[b] = MIR_NONE;
+  }
+  for (uint32_t h = 0; h < layout->count; h++) {
+    if (!layout->header[h] || fn->blocks[h].frequency < LAYOUT_ALIGN_FREQUENCY * fn->blocks[0].frequency) {
+      continue;
+    }
+    uint32_t top = h;
+    uint32_t sp = 0;
+    mark[h] = h;
+    for (uint32_t p = layout->pred_start[h]; p < layout->pred_start[h + 1]; p++) {
+      uint32_t latch = layout->preds[p];
+      if (mark[latch] != h && layout_dominates(layout, h, latch)) {
+        mark[latch] = h;
+        stack[sp++] = latch;
+      }
+    }
+    while (sp > 0) {
+      uint32_t block = stack[--sp];
+      if (position[block] < position[top]) {
+        top = block;
+      }
+      for (uint32_t p = layout->pred_start[block]; p < layout->pred_start[block + 1]; p++) {
+        uint32_t pred = layout->preds[p];
+        if (mark[pred] != h && layout->rpo_index[pred] != MIR_NONE) {
+          mark[pred] = h;
+          stack[sp++] = pred;
+        }
+      }
+    }
+    fn->blocks[top].align = align;
+    stats_add("layout.loops_aligned", 1);
+  }
+  free(mark);
+  free(stack);
+}
+
+static void layout_apply(MirFunction *fn, const uint32_t *order, const uint32_t count, const uint32_t *position) {
+  MirBlock *blocks = layout_alloc(count, sizeof(MirBlock));
+  for (uint32_t i = 0; i < count; i++) {
+    blocks[i] = fn->blocks[order[i]];
+    if (order[i] != i) {
+      stats_add("layout.blocks_moved", 1);
+    }
+  }
+  stats_add("layout.blocks_removed", fn->block_count - count);
+  memcpy(fn->blocks, blocks, count * sizeof(MirBlock));
+  fn->block_count = count;
+  free(blocks);
+  for (uint32_t b = 0; b < fn->block_count; b++) {
+    for (uint32_t i = 0; i < fn->blocks[b].count; i++) {
+      MirInst *inst = &fn->blocks[b].insts[i];
+      if (layout_is_control(inst)) {
+        inst->target = position[inst->target];
+      }
+    }
+  }
+}
+
+void layout_function(MirFunction *fn, const MachineModel *model) {
+  if (fn->block_count < 2) {
+    return;
+  }
+  layout_explicit_jumps(fn);
+  layout_thread_jumps(fn);
+  Layout layout;
+  memset(&layout, 0, sizeof(layout));
+  uint32_t n = fn->block_count;
+  layout.fn = fn;
+  layout.count = n;
+  layout.rpo = layout_alloc(n, sizeof(uint32_t));
+  layout.rpo_index = layout_alloc(n, sizeof(uint32_t));
+  layout.idom = layout_alloc(n, sizeof(uint32_t));
+  layout.pred_start = layout_alloc(n + 1, sizeof(uint32_t));
+  layout.preds = layout_alloc(n * LAYOUT_MAX_SUCCS, sizeof(uint32_t));
+  layout.header = layout_alloc(n, 1);
+  layout.succ_count = layout_alloc(n, sizeof(uint32_t));
+  layout.succs = layout_alloc(n * LAYOUT_MAX_SUCCS, sizeof(LayoutEdge));
+  layout.head = layout_alloc(n, sizeof(uint32_t));
+  layout.next = layout_alloc(n, sizeof(uint32_t));
+  layout.prev = layout_alloc(n, sizeof(uint32_t));
+  for (uint32_t b = 0; b < n; b++) {
+    layout.head[b] = b;
+    layout.next[b] = MIR_NONE;
+    layout.prev[b] = MIR_NONE;
+  }
+  layout_collect_succs(&layout);
+  layout_order_rpo(&layout);
+  layout_dominators(&layout);
+  layout_find_headers(&layout);
+  layout_sort_edges(&layout);
+  uint32_t *order = layout_alloc(n, sizeof(uint32_t));
+  uint32_t *position = layout_alloc(n, sizeof(uint32_t));
+  layout_merge(&layout, 0);
+  layout_rotate(&layout, order);
+  layout_merge(&layout, 1);
+  uint32_t count = layout_place(&layout, order);
+  for (uint32_t b = 0; b < n; b++) {
+    position[b] = MIR_NONE;
+  }
+  for (uint32_t i = 0; i < count; i++) {
+    position[order[i]] = i;
+  }
+  uint32_t min_size = fn->module->target.ext_c ? 2 : 4;
+  if (model && model->loop_align > min_size) {
+    layout_align_loops(&layout, position, model->loop_align);
+  }
+  layout_apply(fn, order, count, position);
+  free(order);
+  free(position);
+  free(layout.rpo);
+  free(layout.rpo_index);
+  free(layout.idom);
+  free(layout.pred_start);
+  free(layout.preds);
+  free(layout.header);
+  free(layout.succ_count);
+  free(layout.succs);
+  free(layout.edges);
+  free(layout.head);
+  free(layout.next);
+  free(layout.prev);
+}
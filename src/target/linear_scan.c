@@ -0,0 +1,290 @@
+#include "target/regalloc.h"
+#include "utils/diagnostic.h"
+#include <stdlib.h>
+#include <string.h>
+
+typedef struct {
+  uint32_t start;
+  uint32_t end;
+} ScanRange;
+
+typedef struct {
+  ScanRange *items;
+  uint32_t count;
+  uint32_t capacity;
+  uint32_t cursor;
+} ScanFixed;
+
+typedef struct {
+  RegallocState *state;
+  uint32_t *start;
+  uint32_t *end;
+  uint32_t *active_end;
+  MirReg owner[RV_REG_COUNT];
+  ScanFixed fixed[RV_REG_COUNT];
+  MirReg order[RV_REG_COUNT];
+  uint32_t order_count;
+} LinearScan;
+
+static void *scan_alloc(const size_t count, const size_t size) {
+  void *ptr = calloc(count ? count : 1, size);
+  if (!ptr) {
+    LOG(FATAL, "out of memory");
+  }
+  return ptr;
+}
+
+static void scan_fixed_add(ScanFixed *fixed, const uint32_t start, const uint32_t end) {
+  if (fixed->count == fixed->capacity) {
+    fixed->capacity = fixed->capacity ? fixed->capacity * 2 : 8;
+    fixed->items = realloc(fixed->items, fixed->capacity * sizeof(ScanRange));
+    if (!fixed->items) {
+      LOG(FATAL, "out of memory");
+    }
+  }
+  fixed->items[fixed->count].start = start;
+  fixed->items[fixed->count].end = end;
+  fixed->count++;
+}
+
+static void scan_extend(LinearScan *scan, const MirReg reg, const uint32_t position) {
+  if (scan->start[reg] == MIR_NONE || position < scan->start[reg]) {
+    scan->start[reg] = position;
+  }
+  if (scan->end[reg] == MIR_NONE || position > scan->end[reg]) {
+    scan->end[reg] = position;
+  }
+}
+
+static void scan_build_fixed_block(LinearScan *scan, const uint32_t b) {
+  RegallocState *state = scan->state;
+  const MirBlock *block = &state->fn->blocks[b];
+  const MirRegSet *live_out = mir_live_out(&state->live, b);
+  uint32_t open[RV_REG_COUNT];
+  for (MirReg reg = 0; reg < RV_REG_COUNT; reg++) {
+    open[reg] = MIR_NONE;
+  }
+  for (uint32_t i = 0; i < live_out->count && live_out->items[i] < RV_REG_COUNT; i++) {
+    open[live_out->items[i]] = state->block_end[b];
+  }
+  uint32_t position = state->block_start[b] + 2 * block->count;
+  for (uint32_t i = block->count; i-- > 0;) {
+    const MirInst *inst = &block->insts[i];
+    position -= 2;
+    uint32_t defs = mir_inst_clobbers(inst);
+    MirReg def = mir_inst_def(inst);
+    if (def != MIR_NONE && def < RV_REG_COUNT) {
+      defs |= 1u << def;
+    }
+    for (MirReg reg = 0; defs && reg < RV_REG_COUNT; reg++) {
+      if (!(defs & (1u << reg))) {
+        continue;
+      }
+      scan_fixed_add(&scan->fixed[reg], position + 1, open[reg] != MIR_NONE ? open[reg] : position + 1);
+      open[reg] = MIR_NONE;
+    }
+    MirReg uses[MIR_MAX_USES];
+    uint32_t count = mir_inst_uses(inst, uses);
+    for (uint32_t u = 0; u < count; u++) {
+      if (uses[u] < RV_REG_COUNT && open[uses[u]] == MIR_NONE) {
+        open[uses[u]] = position;
+      }
+    }
+  }
+  for (MirReg reg = 0; reg < RV_REG_COUNT; reg++) {
+    if (open[reg] != MIR_NONE) {
+      scan_fixed_add(&scan->fixed[reg], state->block_start[b], open[reg]);
+    }
+  }
+}
+
+static int scan_range_compare(const void *a, const void *b) {
+  const ScanRange *left = a;
+  const ScanRange *right = b;
+  return left->start < right->start ? -1 : left->start > right->start;
+}
+
+static void scan_extend_live(LinearScan *scan, const MirRegSet *live, const uint32_t position) {
+  for (uint32_t i = 0; i < live->count; i++) {
+    if (mir_is_vreg(live->items[i])) {
+      scan_extend(scan, live->items[i], position);
+    }
+  }
+}
+
+static void scan_build_intervals(LinearScan *scan) {
+  RegallocState *state = scan->state;
+  const MirFunction *fn = state->fn;
+  for (uint32_t b = 0; b < fn->block_count; b++) {
+    scan_extend_live(scan, mir_live_in(&state->live, b), state->block_start[b]);
+    scan_extend_live(scan, mir_live_out(&state->live, b), state->block_end[b]);
+    uint32_t position = state->block_start[b];
+    for (uint32_t i = 0; i < fn->blocks[b].count; i++, position += 2) {
+      const MirInst *inst = &fn->blocks[b].insts[i];
+      MirReg uses[MIR_MAX_USES];
+      uint32_t count = mir_inst_uses(inst, uses);
+      for (uint32_t u = 0; u < count; u++) {
+        if (mir_is_vreg(uses[u])) {
+          scan_extend(scan, uses[u], position);
+        }
+      }
+      MirReg def = mir_inst_def(inst);
+      if (mir_is_vreg(def)) {
+        scan_extend(scan, def, position + 1);
+      }
+    }
+    scan_build_fixed_block(scan, b);
+  }
+  for (MirReg reg = 0; reg < RV_REG_COUNT; reg++) {
+    ScanFixed *fixed = &scan->fixed[reg];
+    if (fixed->count > 1) {
+      qsort(fixed->items, fixed->count, sizeof(ScanRange), scan_range_compare);
+    }
+  }
+}
+
+static uint32_t scan_fixed_free_until(LinearScan *scan, const MirReg reg, const uint32_t position) {
+  ScanFixed *fixed = &scan->fixed[reg];
+  while (fixed->cursor < fixed->count && fixed->items[fixed->cursor].end < position) {
+    fixed->cursor++;
+  }
+  for (uint32_t i = fixed->cursor; i < fixed->count; i++) {
+    const ScanRange *range = &fixed->items[i];
+    if (range->end >= position) {
+      return range->start <= position ? 0 : range->start;
+    }
+  }
+  return MIR_NONE;
+}
+
+static float scan_priority(const LinearScan *scan, const MirReg reg) {
+  const RegallocState *state = scan->state;
+  if (state->temp[reg]) {
+    return REGALLOC_INFINITE_WEIGHT;
+  }
+  return state->weight[reg] / (float) (scan->end[reg] - scan->start[reg] + 2);
+}
+
+static uint32_t scan_split_position(const uint32_t position) {
+  return position & ~1u;
+}
+
+static void scan_spill(LinearScan *scan, const MirReg reg, const uint32_t position) {
+  RegallocState *state = scan->state;
+  uint32_t split = scan_split_position(position);
+  state->split[reg] = split <= scan->start[reg] ? 0 : split;
+}
+
+static int32_t scan_allocate(LinearScan *scan, const MirReg current) {
+  RegallocState *state = scan->state;
+  uint32_t start = scan->start[current];
+  uint32_t end = scan->end[current];
+  uint32_t free_until[RV_REG_COUNT];
+  uint32_t fixed_until[RV_REG_COUNT];
+  for (uint32_t i = 0; i < scan->order_count; i++) {
+    MirReg reg = scan->order[i];
+    if (scan->owner[reg] != MIR_NONE && scan->active_end[scan->owner[reg]] < start) {
+      scan->owner[reg] = MIR_NONE;
+    }
+    fixed_until[reg] = scan_fixed_free_until(scan, reg, start);
+    free_until[reg] = scan->owner[reg] != MIR_NONE ? 0 : fixed_until[reg];
+  }
+  for (int32_t hinted = 1; hinted >= 0; hinted--) {
+    for (uint32_t i = 0; i < scan->order_count; i++) {
+      MirReg reg = scan->order[i];
+      if (free_until[reg] > end && (!hinted || regalloc_prefers(state, current, reg))) {
+        state->assign[current] = reg;
+        scan->owner[reg] = current;
+        scan->active_end[current] = end;
+        return 0;
+      }
+    }
+  }
+  MirReg best = MIR_NONE;
+  for (uint32_t i = 0; i < scan->order_count; i++) {
+    MirReg reg = scan->order[i];
+    if (best == MIR_NONE || free_until[reg] > free_until[best]) {
+      best = reg;
+    }
+  }
+  MirReg victim_reg = MIR_NONE;
+  for (uint32_t i = 0; i < scan->order_count; i++) {
+    MirReg reg = scan->order[i];
+    MirReg owner = scan->owner[reg];
+    if (owner == MIR_NONE || fixed_until[reg] <= end || state->temp[owner]) {
+      continue;
+    }
+    if (victim_reg == MIR_NONE || scan_priority(scan, owner) < scan_priority(scan, scan->owner[victim_reg])) {
+      victim_reg = reg;
+    }
+  }
+  if (victim_reg != MIR_NONE && scan_priority(scan, scan->owner[victim_reg]) < scan_priority(scan, current)) {
+    scan_spill(scan, scan->owner[victim_reg], start);
+    state->assign[current] = victim_reg;
+    scan->owner[victim_reg] = current;
+    scan->active_end[current] = end;
+    return 1;
+  }
+  if (state->temp[current]) {
+    LOG(FATAL, "out of registers for a spill temporary in %s", state->fn->name);
+  }
+  uint32_t split = scan_split_position(free_until[best]);
+  if (free_until[best] != MIR_NONE && split > start + 1) {
+    state->assign[current] = best;
+    state->split[current] = split;
+    scan->owner[best] = current;
+    scan->active_end[current] = split - 1;
+    return 1;
+  }
+  state->split[current] = 0;
+  return 1;
+}
+
+int32_t regalloc_linear_scan(RegallocState *state) {
+  LinearScan scan;
+  memset(&scan, 0, sizeof(scan));
+  scan.state = state;
+  uint32_t reg_count = state->live.reg_count;
+  scan.start = scan_alloc(reg_count, sizeof(uint32_t));
+  scan.end = scan_alloc(reg_count, sizeof(uint32_t));
+  scan.active_end = scan_alloc(reg_count, sizeof(uint32_t));
+  memset(scan.start, 0xff, reg_count * sizeof(uint32_t));
+  memset(scan.end, 0xff, reg_count * sizeof(uint32_t));
+  for (MirReg reg = 0; reg < RV_REG_COUNT; reg++) {
+    scan.owner[reg] = MIR_NONE;
+  }
+  scan.order_count = regalloc_order(state->leaf, scan.order);
+  scan_build_intervals(&scan);
+
+  uint32_t last = state->block_end[state->fn->block_count - 1] + 2;
+  uint32_t *bucket = scan_alloc(last + 1, sizeof(uint32_t));
+  MirReg *sorted = scan_alloc(reg_count, sizeof(MirReg));
+  uint32_t interval_count = 0;
+  for (MirReg reg = MIR_VREG_BASE; reg < reg_count; reg++) {
+    if (scan.start[reg] != MIR_NONE) {
+      bucket[scan.start[reg] + 1]++;
+      interval_count++;
+    }
+  }
+  for (uint32_t p = 1; p <= last; p++) {
+    bucket[p] += bucket[p - 1];
+  }
+  for (MirReg reg = MIR_VREG_BASE; reg < reg_count; reg++) {
+    if (scan.start[reg] != MIR_NONE) {
+      sorted[bucket[scan.start[reg]]++] = reg;
+    }
+  }
+  int32_t spilled = 0;
+  for (uint32_t i = 0; i < interval_count; i++) {
+    spilled += scan_allocate(&scan, sorted[i]);
+  }
+  for (MirReg reg = 0; reg < RV_REG_COUNT; reg++) {
+    free(scan.fixed[reg].items);
+  }
+  free(bucket);
+  free(sorted);
+  free(scan.start);
+  free(scan.end);
+  free(scan.active_end);
+  return spilled;
+}
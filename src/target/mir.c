@@ -0,0 +1,291 @@
+#include "target/mir.h"
+#include "utils/diagnostic.h"
+#include <string.h>
+
+#define MIR_GROW(fn, ptr, count, capacity, initial)                                                       \
+  do {                                                                                                     \
+    if ((count) == (capacity)) {                                                                           \
+      uint32_t new_cap_ = (capacity) ? (capacity) * 2 : (initial);                                         \
+      (ptr) = arena_grow(&(fn)->module->arena, (ptr), (size_t) (capacity) * sizeof(*(ptr)),                 \
+                         (size_t) new_cap_ * sizeof(*(ptr)));                                              \
+      (capacity) = new_cap_;                                                                               \
+    }                                                                                                      \
+  } while (0)
+
+static const RvInstInfo rv_inst_table[] = {
+#define RV_INST(name, text, format, opcode, funct3, funct7, flags) {text, RV_FMT_##format, opcode, funct3, funct7, 0, flags},
+#include "target/riscv.def"
+#define RVV_INST(name, text, format, opcode, funct3, funct6, vs1, flags) \
+  {text, RV_FMT_##format, opcode, funct3, funct6, vs1, (flags) | RV_IF_VECTOR},
+#include "target/rvv.def"
+};
+
+static const char *const rv_reg_names[RV_REG_COUNT] = {
+  "zero", "ra", "sp", "gp", "tp", "t0", "t1", "t2", "s0", "s1", "a0", "a1", "a2", "a3", "a4", "a5",
+  "a6", "a7", "s2", "s3", "s4", "s5", "s6", "s7", "s8", "s9", "s10", "s11", "t3", "t4", "t5", "t6"
+};
+
+const RvInstInfo *rv_inst_info(const RvOpcode op) {
+  return &rv_inst_table[op];
+}
+
+const char *rv_reg_name(const MirReg reg) {
+  return reg < RV_REG_COUNT ? rv_reg_names[reg] : "?";
+}
+
+uint32_t rv_caller_saved_mask(void) {
+  return (1u << RV_RA) | (7u << RV_T0) | (0xffu << RV_A0) | (0xfu << RV_T3);
+}
+
+uint32_t rv_callee_saved_mask(void) {
+  return (3u << RV_S0) | (0x3ffu << RV_S2);
+}
+
+void mir_module_init(MirModule *module, const TargetInfo *target) {
+  arena_init(&module->arena);
+  module->target = *target;
+  module->functions = NULL;
+  module->function_count = 0;
+  module->function_capacity = 0;
+  module->data = NULL;
+  module->data_count = 0;
+  module->data_capacity = 0;
+}
+
+void mir_module_destroy(MirModule *module) {
+  arena_destroy(&module->arena);
+  module->functions = NULL;
+  module->function_count = 0;
+  module->function_capacity = 0;
+  module->data = NULL;
+  module->data_count = 0;
+  module->data_capacity = 0;
+}
+
+uint32_t mir_data_create(MirModule *module, const int32_t *words, const uint32_t word_count) {
+  if (module->data_count == module->data_capacity) {
+    uint32_t new_cap = module->data_capacity ? module->data_capacity * 2 : 8;
+    module->data = arena_grow(&module->arena, module->data, module->data_capacity * sizeof(MirData),
+                              new_cap * sizeof(MirData));
+    module->data_capacity = new_cap;
+  }
+  int32_t *copy = arena_alloc(&module->arena, word_count * sizeof(int32_t));
+  memcpy(copy, words, word_count * sizeof(int32_t));
+  module->data[module->data_count] = (MirData) {copy, word_count};
+  return module->data_count++;
+}
+
+MirFunction *mir_function_create(MirModule *module, const char *name, const int32_t global) {
+  MirFunction *fn = arena_alloc(&module->arena, sizeof(MirFunction));
+  fn->module = module;
+  fn->name = name;
+  fn->index = (int32_t) module->function_count;
+  fn->global = global;
+  fn->vreg_count = MIR_VREG_BASE;
+  if (module->function_count == module->function_capacity) {
+    uint32_t new_cap = module->function_capacity ? module->function_capacity * 2 : 8;
+    module->functions = arena_grow(&module->arena, module->functions,
+                                   module->function_capacity * sizeof(MirFunction *), new_cap * sizeof(MirFunction *));
+    module->function_capacity = new_cap;
+  }
+  module->functions[module->function_count++] = fn;
+  return fn;
+}
+
+uint32_t mir_block_create(MirFunction *fn) {
+  MIR_GROW(fn, fn->blocks, fn->block_count, fn->block_capacity, 8);
+  MirBlock *block = &fn->blocks[fn->block_count];
+  memset(block, 0, sizeof(*block));
+  return fn->block_count++;
+}
+
+MirReg mir_vreg_create(MirFunction *fn) {
+  return fn->vreg_count++;
+}
+
+uint32_t mir_frame_object_create(MirFunction *fn, const int32_t size, const int32_t align, const MirFrameKind kind) {
+  MIR_GROW(fn, fn->frame, fn->frame_count, fn->frame_capacity, 8);
+  MirFrameObject *object = &fn->frame[fn->frame_count];
+  object->size = size;
+  object->align = align;
+  object->offset = 0;
+  object->kind = kind;
+  return fn->frame_count++;
+}
+
+MirInst mir_make(const RvOpcode op, const MirReg rd, const MirReg rs1, const MirReg rs2, const int32_t imm) {
+  MirInst inst;
+  inst.op = (uint16_t) op;
+  inst.flags = 0;
+  inst.rd = rd;
+  inst.rs1 = rs1;
+  inst.rs2 = rs2;
+  inst.imm = imm;
+  inst.target = MIR_NONE;
+  return inst;
+}
+
+MirInst *mir_emit(MirFunction *fn, const uint32_t block, const RvOpcode op, const MirReg rd, const MirReg rs1,
+                  const MirReg rs2, const int32_t imm) {
+  MirInst inst = mir_make(op, rd, rs1, rs2, imm);
+  MirBlock *data = &fn->blocks[block];
+  return mir_insert(fn, block, data->count, &inst);
+}
+
+MirInst *mir_insert(MirFunction *fn, const uint32_t block, const uint32_t position, const MirInst *inst) {
+  MirBlock *data = &fn->blocks[block];
+  MIR_GROW(fn, data->insts, data->count, data->capacity, 16);
+  memmove(&data->insts[position + 1], &data->insts[position], (data->count - position) * sizeof(MirInst));
+  data->insts[position] = *inst;
+  data->count++;
+  return &data->insts[position];
+}
+
+void mir_remove(MirFunction *fn, const uint32_t block, const uint32_t position) {
+  MirBlock *data = &fn->blocks[block];
+  memmove(&data->insts[position], &data->insts[position + 1], (data->count - position - 1) * sizeof(MirInst));
+  data->count--;
+}
+
+MirReg mir_inst_def(const MirInst *inst) {
+  switch (rv_inst_info((RvOpcode) inst->op)->format) {
+    case RV_FMT_R:
+    case RV_FMT_I:
+    case RV_FMT_U:
+    case RV_FMT_J:
+    case RV_FMT_SHIFT:
+    case RV_FMT_VSETVLI:
+    case RV_FMT_VTOX:
+      return inst->rd == RV_ZERO ? MIR_NONE : inst->rd;
+    default:
+      return MIR_NONE;
+  }
+}
+
+MirReg *mir_inst_use_slot(MirInst *inst, const uint32_t index) {
+  switch (rv_inst_info((RvOpcode) inst->op)->format) {
+    case RV_FMT_R:
+    case RV_FMT_S:
+    case RV_FMT_B:
+      return index == 0 ? &inst->rs1 : index == 1 ? &inst->rs2 : NULL;
+    case RV_FMT_I:
+    case RV_FMT_SHIFT:
+    case RV_FMT_VSETVLI:
+    case RV_FMT_VLOAD:
+    case RV_FMT_VSTORE:
+    case RV_FMT_VX:
+    case RV_FMT_VSPLAT:
+      return index == 0 ? &inst->rs1 : NULL;
+    default:
+      return NULL;
+  }
+}
+
+uint32_t mir_inst_uses(const MirInst *inst, MirReg uses[MIR_MAX_USES]) {
+  uint32_t count = 0;
+  MirInst copy = *inst;
+  MirReg *slot;
+  while ((slot = mir_inst_use_slot(&copy, count)) != NULL) {
+    uses[count++] = *slot;
+  }
+  if (inst->op == RV_CALL || inst->op == RV_TAIL) {
+    for (int32_t a = 0; a < inst->imm && a < RV_ARG_REGS; a++) {
+      uses[count++] = RV_A0 + (MirReg) a;
+    }
+  } else if (inst->op == RV_RET && inst->imm) {
+    uses[count++] = RV_A0;
+  }
+  return count;
+}
+
+uint32_t mir_inst_clobbers(const MirInst *inst) {
+  return inst->op == RV_CALL ? rv_caller_saved_mask() : 0;
+}
+
+int32_t mir_inst_is_move(const MirInst *inst) {
+  return inst->op == RV_ADDI && inst->imm == 0 && inst->rs1 != RV_ZERO && inst->rd != RV_ZERO &&
+         !(inst->flags & (MIR_INST_FRAME | MIR_INST_DATA));
+}
+
+uint32_t mir_block_terminator_start(const MirFunction *fn, const uint32_t block) {
+  const MirBlock *data = &fn->blocks[block];
+  uint32_t start = data->count;
+  while (start > 0) {
+    uint32_t flags = rv_inst_info((RvOpcode) data->insts[start - 1].op)->flags;
+    if (!(flags & (RV_IF_BRANCH | RV_IF_JUMP | RV_IF_RETURN))) {
+      break;
+    }
+    start--;
+  }
+  return start;
+}
+
+uint32_t mir_block_succs(const MirFunction *fn, const uint32_t block, uint32_t out[2]) {
+  const MirBlock *data = &fn->blocks[block];
+  uint32_t count = 0;
+  int32_t falls = 1;
+  for (uint32_t i = mir_block_terminator_start(fn, block); i < data->count; i++) {
+    const MirInst *inst = &data->insts[i];
+    uint32_t flags = rv_inst_info((RvOpcode) inst->op)->flags;
+    if (flags & RV_IF_RETURN) {
+      falls = 0;
+    } else if (flags & (RV_IF_BRANCH | RV_IF_JUMP)) {
+      if (count < 2 && (count == 0 || out[0] != inst->target)) {
+        out[count++] = inst->target;
+      }
+      if (flags & RV_IF_JUMP) {
+        falls = 0;
+      }
+    }
+  }
+  if (falls && block + 1 < fn->block_count && count < 2 && (count == 0 || out[0] != block + 1)) {
+    out[count++] = block + 1;
+  }
+  return count;
+}
+
+RvOpcode rv_invert_branch(const RvOpcode op) {
+  switch (op) {
+    case RV_BEQ: return RV_BNE;
+    case RV_BNE: return RV_BEQ;
+    case RV_BLT: return RV_BGE;
+    case RV_BGE: return RV_BLT;
+    case RV_BLTU: return RV_BGEU;
+    case RV_BGEU: return RV_BLTU;
+    default:
+      LOG(FATAL, "not a conditional branch: %s", rv_inst_info(op)->name);
+      return op;
+  }
+}
+
+void mir_remove_fallthrough_jumps(MirFunction *fn) {
+  for (uint32_t b = 0; b + 1 < fn->block_count; b++) {
+    MirBlock *block = &fn->blocks[b];
+    if (block->count == 0 || block->insts[block->count - 1].op != RV_JAL ||
+        block->insts[block->count - 1].rd != RV_ZERO) {
+      continue;
+    }
+    MirInst *jump = &block->insts[block->count - 1];
+    if (jump->target == b + 1) {
+      block->count--;
+      continue;
+    }
+    if (block->count < 2) {
+      continue;
+    }
+    MirInst *branch = &block->insts[block->count - 2];
+    if ((rv_inst_info((RvOpcode) branch->op)->flags & RV_IF_BRANCH) && branch->target == b + 1) {
+      branch->op = (uint16_t) rv_invert_branch((RvOpcode) branch->op);
+      branch->target = jump->target;
+      block->count--;
+    }
+  }
+}
+
+uint32_t mir_inst_count(const MirFunction *fn) {
+  uint32_t count = 0;
+  for (uint32_t b = 0; b < fn->block_count; b++) {
+    count += fn->blocks[b].count;
+  }
+  return count;
+}
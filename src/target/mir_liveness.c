@@ -0,0 +1,228 @@
+#include "target/mir_liveness.h"
+#include "utils/diagnostic.h"
+#include <stdlib.h>
+#include <string.h>
+
+typedef struct {
+  MirReg reg;
+  uint32_t block;
+} LivenessRef;
+
+typedef struct {
+  LivenessRef *items;
+  uint32_t count;
+  uint32_t capacity;
+} LivenessRefs;
+
+typedef struct {
+  uint32_t *start;
+  uint32_t *blocks;
+} LivenessIndex;
+
+static void *liveness_alloc(const size_t count, const size_t size) {
+  void *ptr = calloc(count ? count : 1, size);
+  if (!ptr) {
+    LOG(FATAL, "out of memory");
+  }
+  return ptr;
+}
+
+static uint32_t *liveness_stamps(const uint32_t count) {
+  uint32_t *stamps = liveness_alloc(count, sizeof(uint32_t));
+  memset(stamps, 0xff, (count ? count : 1) * sizeof(uint32_t));
+  return stamps;
+}
+
+static void liveness_ref_push(LivenessRefs *refs, const MirReg reg, const uint32_t block) {
+  if (refs->count == refs->capacity) {
+    refs->capacity = refs->capacity ? refs->capacity * 2 : 64;
+    refs->items = realloc(refs->items, refs->capacity * sizeof(LivenessRef));
+    if (!refs->items) {
+      LOG(FATAL, "out of memory");
+    }
+  }
+  refs->items[refs->count].reg = reg;
+  refs->items[refs->count].block = block;
+  refs->count++;
+}
+
+static void liveness_set_push(MirRegSet *set, const MirReg reg) {
+  if (set->count == set->capacity) {
+    set->capacity = set->capacity ? set->capacity * 2 : 8;
+    set->items = realloc(set->items, set->capacity * sizeof(MirReg));
+    if (!set->items) {
+      LOG(FATAL, "out of memory");
+    }
+  }
+  set->items[set->count++] = reg;
+}
+
+static void liveness_index_build(LivenessIndex *index, const LivenessRefs *refs, const uint32_t reg_count) {
+  index->start = liveness_alloc(reg_count + 1, sizeof(uint32_t));
+  index->blocks = liveness_alloc(refs->count, sizeof(uint32_t));
+  for (uint32_t i = 0; i < refs->count; i++) {
+    index->start[refs->items[i].reg + 1]++;
+  }
+  for (uint32_t r = 0; r < reg_count; r++) {
+    index->start[r + 1] += index->start[r];
+  }
+  uint32_t *fill = liveness_alloc(reg_count, sizeof(uint32_t));
+  memcpy(fill, index->start, reg_count * sizeof(uint32_t));
+  for (uint32_t i = 0; i < refs->count; i++) {
+    index->blocks[fill[refs->items[i].reg]++] = refs->items[i].block;
+  }
+  free(fill);
+}
+
+static void liveness_kill(const MirReg reg, const uint32_t block, uint32_t *def_stamp, LivenessRefs *killed) {
+  if (def_stamp[reg] != block) {
+    def_stamp[reg] = block;
+    liveness_ref_push(killed, reg, block);
+  }
+}
+
+static void liveness_scan_block(const MirFunction *fn, const uint32_t b, uint32_t *def_stamp, uint32_t *use_stamp,
+                                LivenessRefs *exposed, LivenessRefs *killed) {
+  const MirBlock *data = &fn->blocks[b];
+  for (uint32_t i = 0; i < data->count; i++) {
+    const MirInst *inst = &data->insts[i];
+    MirReg uses[MIR_MAX_USES];
+    uint32_t count = mir_inst_uses(inst, uses);
+    for (uint32_t u = 0; u < count; u++) {
+      MirReg reg = uses[u];
+      if (reg != MIR_NONE && reg != RV_ZERO && def_stamp[reg] != b && use_stamp[reg] != b) {
+        use_stamp[reg] = b;
+        liveness_ref_push(exposed, reg, b);
+      }
+    }
+    uint32_t clobbers = mir_inst_clobbers(inst);
+    for (MirReg reg = 0; clobbers && reg < RV_REG_COUNT; reg++) {
+      if (clobbers & (1u << reg)) {
+        liveness_kill(reg, b, def_stamp, killed);
+      }
+    }
+    MirReg def = mir_inst_def(inst);
+    if (def != MIR_NONE) {
+      liveness_kill(def, b, def_stamp, killed);
+    }
+  }
+}
+
+void mir_liveness_compute(MirLiveness *live, const MirFunction *fn) {
+  uint32_t reg_count = fn->vreg_count;
+  uint32_t block_count = fn->block_count;
+  live->reg_count = reg_count;
+  live->block_count = block_count;
+  live->live_in = liveness_alloc(block_count, sizeof(MirRegSet));
+  live->live_out = liveness_alloc(block_count, sizeof(MirRegSet));
+
+  uint32_t *def_stamp = liveness_stamps(reg_count);
+  uint32_t *use_stamp = liveness_stamps(reg_count);
+  LivenessRefs exposed = {NULL, 0, 0};
+  LivenessRefs killed = {NULL, 0, 0};
+  for (uint32_t b = 0; b < block_count; b++) {
+    liveness_scan_block(fn, b, def_stamp, use_stamp, &exposed, &killed);
+  }
+  free(def_stamp);
+  free(use_stamp);
+  LivenessIndex uses;
+  LivenessIndex kills;
+  liveness_index_build(&uses, &exposed, reg_count);
+  liveness_index_build(&kills, &killed, reg_count);
+  free(exposed.items);
+  free(killed.items);
+
+  uint32_t *pred_start = liveness_alloc(block_count + 1, sizeof(uint32_t));
+  for (uint32_t b = 0; b < block_count; b++) {
+    uint32_t succs[2];
+    uint32_t count = mir_block_succs(fn, b, succs);
+    for (uint32_t s = 0; s < count; s++) {
+      pred_start[succs[s] + 1]++;
+    }
+  }
+  for (uint32_t b = 0; b < block_count; b++) {
+    pred_start[b + 1] += pred_start[b];
+  }
+  uint32_t *preds = liveness_alloc(pred_start[block_count], sizeof(uint32_t));
+  uint32_t *fill = liveness_alloc(block_count, sizeof(uint32_t));
+  memcpy(fill, pred_start, block_count * sizeof(uint32_t));
+  for (uint32_t b = 0; b < block_count; b++) {
+    uint32_t succs[2];
+    uint32_t count = mir_block_succs(fn, b, succs);
+    for (uint32_t s = 0; s < count; s++) {
+      preds[fill[succs[s]]++] = b;
+    }
+  }
+  free(fill);
+
+  uint32_t *in_stamp = liveness_stamps(block_count);
+  uint32_t *out_stamp = liveness_stamps(block_count);
+  uint32_t *kill_stamp = liveness_stamps(block_count);
+  uint32_t *work = liveness_alloc(block_count, sizeof(uint32_t));
+  for (MirReg reg = 0; reg < reg_count; reg++) {
+    if (uses.start[reg] == uses.start[reg + 1]) {
+      continue;
+    }
+    for (uint32_t k = kills.start[reg]; k < kills.start[reg + 1]; k++) {
+      kill_stamp[kills.blocks[k]] = reg;
+    }
+    uint32_t top = 0;
+    for (uint32_t u = uses.start[reg]; u < uses.start[reg + 1]; u++) {
+      uint32_t b = uses.blocks[u];
+      in_stamp[b] = reg;
+      liveness_set_push(&live->live_in[b], reg);
+      work[top++] = b;
+    }
+    while (top > 0) {
+      uint32_t b = work[--top];
+      for (uint32_t p = pred_start[b]; p < pred_start[b + 1]; p++) {
+        uint32_t pred = preds[p];
+        if (out_stamp[pred] == reg) {
+          continue;
+        }
+        out_stamp[pred] = reg;
+        liveness_set_push(&live->live_out[pred], reg);
+        if (kill_stamp[pred] != reg && in_stamp[pred] != reg) {
+          in_stamp[pred] = reg;
+          liveness_set_push(&live->live_in[pred], reg);
+          work[top++] = pred;
+        }
+      }
+    }
+  }
+  free(in_stamp);
+  free(out_stamp);
+  free(kill_stamp);
+  free(work);
+  free(pred_start);
+  free(preds);
+  free(uses.start);
+  free(uses.blocks);
+  free(kills.start);
+  free(kills.blocks);
+}
+
+int32_t mir_reg_set_contains(const MirRegSet *set, const MirReg reg) {
+  uint32_t low = 0;
+  uint32_t high = set->count;
+  while (low < high) {
+    uint32_t middle = low + (high - low) / 2;
+    if (set->items[middle] < reg) {
+      low = middle + 1;
+    } else {
+      high = middle;
+    }
+  }
+  return low < set->count && set->items[low] == reg;
+}
+
+void mir_liveness_destroy(MirLiveness *live) {
+  for (uint32_t b = 0; b < live->block_count; b++) {
+    free(live->live_in[b].items);
+    free(live->live_out[b].items);
+  }
+  free(live->live_in);
+  free(live->live_out);
+  live->live_in = NULL;
+  live->live_out = NULL;
+}
@@ -0,0 +1,419 @@
+#include "target/obj_emitter.h"
+#include "target/elf_writer.h"
+#include "target/rvc.h"
+#include "utils/diagnostic.h"
+#include "utils/stats.h"
+#include <stdlib.h>
+#include <string.h>
+
+typedef struct {
+  const MirModule *module;
+  ElfObject object;
+  uint32_t *function_symbol;
+  uint32_t *data_symbol;
+} ObjEmitter;
+
+typedef struct {
+  const MirFunction *fn;
+  uint32_t base;
+  uint32_t *block_offset;
+  uint32_t *inst_offset;
+  uint8_t *form;
+  uint32_t *label_symbol;
+  int32_t xlen;
+  int32_t compress;
+} ObjFunction;
+
+typedef enum {
+  OBJ_FORM_COMPRESSED,
+  OBJ_FORM_NORMAL,
+  OBJ_FORM_EXPANDED
+} ObjForm;
+
+static void *obj_alloc(const size_t count, const size_t size) {
+  void *ptr = calloc(count ? count : 1, size);
+  if (!ptr) {
+    LOG(FATAL, "out of memory");
+  }
+  return ptr;
+}
+
+static uint32_t obj_encode_r(const RvInstInfo *info, const MirReg rd, const MirReg rs1, const MirReg rs2) {
+  return ((uint32_t) info->funct7 << 25) | (rs2 << 20) | (rs1 << 15) | ((uint32_t) info->funct3 << 12) | (rd << 7) |
+         info->opcode;
+}
+
+static uint32_t obj_encode_i(const RvInstInfo *info, const MirReg rd, const MirReg rs1, const int32_t imm) {
+  return (((uint32_t) imm & 0xfffu) << 20) | (rs1 << 15) | ((uint32_t) info->funct3 << 12) | (rd << 7) |
+         info->opcode;
+}
+
+static uint32_t obj_encode_s(const RvInstInfo *info, const MirReg rs1, const MirReg rs2, const int32_t imm) {
+  uint32_t value = (uint32_t) imm;
+  return (((value >> 5) & 0x7fu) << 25) | (rs2 << 20) | (rs1 << 15) | ((uint32_t) info->funct3 << 12) |
+         ((value & 0x1fu) << 7) | info->opcode;
+}
+
+static uint32_t obj_encode_b(const RvInstInfo *info, const MirReg rs1, const MirReg rs2, const int32_t imm) {
+  uint32_t value = (uint32_t) imm;
+  return (((value >> 12) & 1u) << 31) | (((value >> 5) & 0x3fu) << 25) | (rs2 << 20) | (rs1 << 15) |
+         ((uint32_t) info->funct3 << 12) | (((value >> 1) & 0xfu) << 8) | (((value >> 11) & 1u) << 7) | info->opcode;
+}
+
+static uint32_t obj_encode_u(const RvInstInfo *info, const MirReg rd, const int32_t imm) {
+  return (((uint32_t) imm & 0xfffffu) << 12) | (rd << 7) | info->opcode;
+}
+
+static uint32_t obj_encode_j(const RvInstInfo *info, const MirReg rd, const int32_t imm) {
+  uint32_t value = (uint32_t) imm;
+  return (((value >> 20) & 1u) << 31) | (((value >> 1) & 0x3ffu) << 21) | (((value >> 11) & 1u) << 20) |
+         (((value >> 12) & 0xffu) << 12) | (rd << 7) | info->opcode;
+}
+
+static uint32_t obj_encode_v(const RvInstInfo *info, const MirReg vd, const uint32_t field1, const MirReg vs2) {
+  uint32_t vm = (info->flags & RV_IF_VMASK) ? 0 : 1;
+  return ((uint32_t) info->funct7 << 26) | (vm << 25) | (vs2 << 20) | (field1 << 15) |
+         ((uint32_t) info->funct3 << 12) | (vd << 7) | info->opcode;
+}
+
+static int32_t obj_fits_branch(const int64_t displacement) {
+  return displacement >= -4096 && displacement <= 4094;
+}
+
+static int32_t obj_fits_jump(const int64_t displacement) {
+  return displacement >= -(1 << 20) && displacement <= (1 << 20) - 2;
+}
+
+static int32_t obj_is_control(const MirInst *inst) {
+  return (rv_inst_info((RvOpcode) inst->op)->flags & RV_IF_BRANCH) || inst->op == RV_JAL;
+}
+
+static uint32_t obj_inst_size(const ObjFunction *of, const MirInst *inst, const uint32_t flat) {
+  if (inst->op == RV_CALL || inst->op == RV_TAIL) {
+    return 8;
+  }
+  if (obj_is_control(inst)) {
+    return of->form[flat] == OBJ_FORM_COMPRESSED ? 2 : of->form[flat] == OBJ_FORM_EXPANDED ? 8 : 4;
+  }
+  RvcInst compressed;
+  return of->compress && rvc_select(inst, of->xlen, &compressed) ? 2 : 4;
+}
+
+static uint32_t obj_padding(const ObjFunction *of, const uint32_t block) {
+  uint32_t align = of->fn->blocks[block].align;
+  uint32_t min_size = of->compress ? 2 : 4;
+  return align > min_size ? align - min_size : 0;
+}
+
+static int64_t obj_displacement(const ObjFunction *of, const MirInst *inst, const uint32_t flat) {
+  return (int64_t) of->block_offset[inst->target] - of->inst_offset[flat];
+}
+
+static void obj_layout(ObjFunction *of) {
+  const MirFunction *fn = of->fn;
+  uint32_t flat = 0;
+  for (uint32_t b = 0; b < fn->block_count; b++) {
+    for (uint32_t i = 0; i < fn->blocks[b].count; i++, flat++) {
+      RvcInst compressed;
+      const MirInst *inst = &fn->blocks[b].insts[i];
+      of->form[flat] = of->compress && rvc_select_branch(inst, of->xlen, 0, &compressed) ? OBJ_FORM_COMPRESSED
+                                                                                        : OBJ_FORM_NORMAL;
+    }
+  }
+  int32_t changed = 1;
+  while (changed) {
+    changed = 0;
+    uint32_t offset = 0;
+    flat = 0;
+    for (uint32_t b = 0; b < fn->block_count; b++) {
+      offset += obj_padding(of, b);
+      of->block_offset[b] = offset;
+      for (uint32_t i = 0; i < fn->blocks[b].count; i++, flat++) {
+        of->inst_offset[flat] = offset;
+        offset += obj_inst_size(of, &fn->blocks[b].insts[i], flat);
+      }
+    }
+    of->block_offset[fn->block_count] = offset;
+    flat = 0;
+    for (uint32_t b = 0; b < fn->block_count; b++) {
+      for (uint32_t i = 0; i < fn->blocks[b].count; i++, flat++) {
+        const MirInst *inst = &fn->blocks[b].insts[i];
+        if (!obj_is_control(inst) || of->form[flat] == OBJ_FORM_EXPANDED) {
+          continue;
+        }
+        RvcInst compressed;
+        int64_t displacement = obj_displacement(of, inst, flat);
+        if (of->form[flat] == OBJ_FORM_COMPRESSED && !rvc_select_branch(inst, of->xlen, displacement, &compressed)) {
+          of->form[flat] = OBJ_FORM_NORMAL;
+          changed = 1;
+        } else if (of->form[flat] == OBJ_FORM_NORMAL && inst->op != RV_JAL && !obj_fits_branch(displacement)) {
+          of->form[flat] = OBJ_FORM_EXPANDED;
+          changed = 1;
+        }
+      }
+    }
+  }
+}
+
+static uint32_t obj_label(ObjEmitter *emitter, ObjFunction *of, const uint32_t block) {
+  if (of->label_symbol[block] == MIR_NONE) {
+    char name[48];
+    snprintf(name, sizeof(name), ".LBB%d_%u", of->fn->index, block);
+    of->label_symbol[block] = elf_add_symbol(&emitter->object, name, ELF_SECTION_TEXT,
+                                             of->base + of->block_offset[block], 0, ELF_SYM_NOTYPE, ELF_BIND_LOCAL);
+  }
+  return of->label_symbol[block];
+}
+
+static uint32_t obj_callee(const ObjEmitter *emitter, const MirFunction *fn, const uint32_t callee) {
+  uint32_t symbol = emitter->function_symbol[callee];
+  if (symbol == MIR_NONE) {
+    LOG(FATAL, "call from %s to a function without a body", fn->name);
+  }
+  return symbol;
+}
+
+static void obj_data_reloc(ObjEmitter *emitter, const MirInst *inst, const uint32_t offset, const ElfRelocType type) {
+  elf_add_reloc(&emitter->object, ELF_SECTION_TEXT, offset, emitter->data_symbol[inst->target], type, 0);
+  elf_add_reloc(&emitter->object, ELF_SECTION_TEXT, offset, ELF_NO_SYMBOL, R_RISCV_RELAX, 0);
+}
+
+static void obj_emit_inst(ObjEmitter *emitter, ObjFunction *of, const MirInst *inst, const uint32_t flat) {
+  ElfBuffer *text = &emitter->object.sections[ELF_SECTION_TEXT].data;
+  const RvInstInfo *info = rv_inst_info((RvOpcode) inst->op);
+  uint32_t offset = of->base + of->inst_offset[flat];
+  int64_t displacement = 0;
+  if (info->flags & (RV_IF_BRANCH | RV_IF_JUMP)) {
+    displacement = obj_displacement(of, inst, flat);
+  }
+  RvcInst compressed;
+  if (obj_is_control(inst) ? of->form[flat] == OBJ_FORM_COMPRESSED &&
+                                 rvc_select_branch(inst, of->xlen, displacement, &compressed)
+                           : of->compress && rvc_select(inst, of->xlen, &compressed)) {
+    if (obj_is_control(inst)) {
+      elf_add_reloc(&emitter->object, ELF_SECTION_TEXT, offset, obj_label(emitter, of, inst->target),
+                    inst->op == RV_JAL ? R_RISCV_RVC_JUMP : R_RISCV_RVC_BRANCH, 0);
+    }
+    elf_buffer_append_u16(text, rvc_encode(&compressed));
+    stats_add("obj.compressed_insts", 1);
+    return;
+  }
+  switch (info->format) {
+    case RV_FMT_R:
+      elf_buffer_append_u32(text, obj_encode_r(info, inst->rd, inst->rs1, inst->rs2));
+      break;
+    case RV_FMT_I:
+      if (inst->flags & MIR_INST_DATA) {
+        obj_data_reloc(emitter, inst, offset, R_RISCV_LO12_I);
+        elf_buffer_append_u32(text, obj_encode_i(info, inst->rd, inst->rs1, 0));
+        break;
+      }
+      elf_buffer_append_u32(text, obj_encode_i(info, inst->rd, inst->rs1, inst->imm));
+      break;
+    case RV_FMT_SHIFT:
+      elf_buffer_append_u32(text, obj_encode_r(info, inst->rd, inst->rs1, (MirReg) (inst->imm & 0x3f)));
+      break;
+    case RV_FMT_S:
+      elf_buffer_append_u32(text, obj_encode_s(info, inst->rs1, inst->rs2, inst->imm));
+      break;
+    case RV_FMT_U:
+      if (inst->flags & MIR_INST_DATA) {
+        obj_data_reloc(emitter, inst, offset, R_RISCV_HI20);
+        elf_buffer_append_u32(text, obj_encode_u(info, inst->rd, 0));
+        break;
+      }
+      elf_buffer_append_u32(text, obj_encode_u(info, inst->rd, inst->imm));
+      break;
+    case RV_FMT_B: {
+      MirReg rs1 = inst->rs1;
+      MirReg rs2 = inst->rs2;
+      if (rs1 == RV_ZERO && (inst->op == RV_BEQ || inst->op == RV_BNE)) {
+        rs1 = rs2;
+        rs2 = RV_ZERO;
+      }
+      if (of->form[flat] == OBJ_FORM_EXPANDED) {
+        const RvInstInfo *inverted = rv_inst_info(rv_invert_branch((RvOpcode) inst->op));
+        elf_buffer_append_u32(text, obj_encode_b(inverted, rs1, rs2, 8));
+        displacement -= 4;
+        if (!obj_fits_jump(displacement)) {
+          LOG(FATAL, "branch target out of range in %s", of->fn->name);
+        }
+        elf_add_reloc(&emitter->object, ELF_SECTION_TEXT, offset + 4, obj_label(emitter, of, inst->target),
+                      R_RISCV_JAL, 0);
+        elf_buffer_append_u32(text, obj_encode_j(rv_inst_info(RV_JAL), RV_ZERO, (int32_t) displacement));
+        stats_add("obj.relaxed_branches", 1);
+        break;
+      }
+      elf_add_reloc(&emitter->object, ELF_SECTION_TEXT, offset, obj_label(emitter, of, inst->target), R_RISCV_BRANCH,
+                    0);
+      elf_buffer_append_u32(text, obj_encode_b(info, rs1, rs2, (int32_t) displacement));
+      break;
+    }
+    case RV_FMT_J:
+      if (!obj_fits_jump(displacement)) {
+        LOG(FATAL, "jump target out of range in %s", of->fn->name);
+      }
+      elf_add_reloc(&emitter->object, ELF_SECTION_TEXT, offset, obj_label(emitter, of, inst->target), R_RISCV_JAL, 0);
+      elf_buffer_append_u32(text, obj_encode_j(info, inst->rd, (int32_t) displacement));
+      break;
+    case RV_FMT_PSEUDO:
+      if (inst->op == RV_RET) {
+        elf_buffer_append_u32(text, obj_encode_i(rv_inst_info(RV_JALR), RV_ZERO, RV_RA, 0));
+        break;
+      }
+      MirReg link = inst->op == RV_CALL ? RV_RA : RV_T1;
+      elf_add_reloc(&emitter->object, ELF_SECTION_TEXT, offset, obj_callee(emitter, of->fn, inst->target),
+                    R_RISCV_CALL, 0);
+      elf_add_reloc(&emitter->object, ELF_SECTION_TEXT, offset, ELF_NO_SYMBOL, R_RISCV_RELAX, 0);
+      elf_buffer_append_u32(text, obj_encode_u(rv_inst_info(RV_AUIPC), link, 0));
+      elf_buffer_append_u32(text,
+                            obj_encode_i(rv_inst_info(RV_JALR), inst->op == RV_CALL ? RV_RA : RV_ZERO, link, 0));
+      break;
+    case RV_FMT_VSETVLI:
+      elf_buffer_append_u32(text, obj_encode_i(info, inst->rd, inst->rs1, inst->imm & 0x7ff));
+      break;
+    case RV_FMT_VLOAD:
+    case RV_FMT_VSTORE:
+      elf_buffer_append_u32(text, obj_encode_v(info, inst->rd, inst->rs1, 0));
+      break;
+    case RV_FMT_VV:
+    case RV_FMT_VX:
+      elf_buffer_append_u32(text, obj_encode_v(info, inst->rd, inst->rs1, inst->rs2));
+      break;
+    case RV_FMT_VI:
+      elf_buffer_append_u32(text, obj_encode_v(info, inst->rd, (uint32_t) inst->imm & 0x1fu, inst->rs2));
+      break;
+    case RV_FMT_VSPLAT:
+      elf_buffer_append_u32(text, obj_encode_v(info, inst->rd, inst->rs1, 0));
+      break;
+    case RV_FMT_VUNARY:
+    case RV_FMT_VTOX:
+      elf_buffer_append_u32(text, obj_encode_v(info, inst->rd, info->vs1, inst->rs2));
+      break;
+    case RV_FMT_VINDEX:
+      elf_buffer_append_u32(text, obj_encode_v(info, inst->rd, info->vs1, 0));
+      break;
+  }
+}
+
+static void obj_emit_padding(ObjEmitter *emitter, const ObjFunction *of, const uint32_t block) {
+  ElfBuffer *text = &emitter->object.sections[ELF_SECTION_TEXT].data;
+  uint32_t padding = obj_padding(of, block);
+  if (padding == 0) {
+    return;
+  }
+  elf_add_reloc(&emitter->object, ELF_SECTION_TEXT, (uint32_t) text->size, ELF_NO_SYMBOL, R_RISCV_ALIGN,
+                (int64_t) padding);
+  for (; padding >= 4; padding -= 4) {
+    elf_buffer_append_u32(text, obj_encode_i(rv_inst_info(RV_ADDI), RV_ZERO, RV_ZERO, 0));
+  }
+  if (padding == 2) {
+    elf_buffer_append_u16(text, 0x0001);
+  }
+}
+
+static void obj_function_init(ObjFunction *of, const MirFunction *fn, const uint32_t base) {
+  uint32_t inst_count = mir_inst_count(fn);
+  of->fn = fn;
+  of->base = base;
+  of->xlen = fn->module->target.xlen;
+  of->compress = fn->module->target.ext_c;
+  of->block_offset = obj_alloc(fn->block_count + 1, sizeof(uint32_t));
+  of->inst_offset = obj_alloc(inst_count, sizeof(uint32_t));
+  of->form = obj_alloc(inst_count, 1);
+  of->label_symbol = obj_alloc(fn->block_count, sizeof(uint32_t));
+  memset(of->label_symbol, 0xff, fn->block_count * sizeof(uint32_t));
+  obj_layout(of);
+}
+
+static void obj_function_destroy(ObjFunction *of) {
+  free(of->block_offset);
+  free(of->inst_offset);
+  free(of->form);
+  free(of->label_symbol);
+}
+
+static void obj_emit_function(ObjEmitter *emitter, const uint32_t index) {
+  const MirFunction *fn = emitter->module->functions[index];
+  ElfBuffer *text = &emitter->object.sections[ELF_SECTION_TEXT].data;
+  elf_buffer_align(text, fn->module->target.ext_c ? 2 : 4);
+  ObjFunction of;
+  obj_function_init(&of, fn, (uint32_t) text->size);
+  uint32_t flat = 0;
+  for (uint32_t b = 0; b < fn->block_count; b++) {
+    obj_emit_padding(emitter, &of, b);
+    for (uint32_t i = 0; i < fn->blocks[b].count; i++, flat++) {
+      obj_emit_inst(emitter, &of, &fn->blocks[b].insts[i], flat);
+    }
+  }
+  ElfSymbol *symbol = &emitter->object.symbols[emitter->function_symbol[index]];
+  symbol->value = of.base;
+  symbol->size = of.block_offset[fn->block_count];
+  obj_function_destroy(&of);
+}
+
+static void obj_emit_data(ObjEmitter *emitter) {
+  const MirModule *module = emitter->module;
+  ElfSection *rodata = &emitter->object.sections[ELF_SECTION_RODATA];
+  emitter->data_symbol = obj_alloc(module->data_count, sizeof(uint32_t));
+  if (module->data_count > 0) {
+    rodata->align = 4;
+  }
+  for (uint32_t d = 0; d < module->data_count; d++) {
+    char name[32];
+    snprintf(name, sizeof(name), ".LC%u", d);
+    elf_buffer_align(&rodata->data, 4);
+    emitter->data_symbol[d] = elf_add_symbol(&emitter->object, name, ELF_SECTION_RODATA, rodata->data.size, 0,
+                                             ELF_SYM_NOTYPE, ELF_BIND_LOCAL);
+    for (uint32_t w = 0; w < module->data[d].word_count; w++) {
+      elf_buffer_append_u32(&rodata->data, (uint32_t) module->data[d].words[w]);
+    }
+  }
+  stats_add("obj.rodata_bytes", rodata->data.size);
+}
+
+void obj_measure_function(const MirFunction *fn, RvcReport *report) {
+  memset(report, 0, sizeof(*report));
+  report->function = fn->name;
+  if (fn->block_count == 0) {
+    return;
+  }
+  ObjFunction of;
+  obj_function_init(&of, fn, 0);
+  uint32_t flat = 0;
+  for (uint32_t b = 0; b < fn->block_count; b++) {
+    for (uint32_t i = 0; i < fn->blocks[b].count; i++, flat++) {
+      report->insts++;
+      report->compressed += obj_inst_size(&of, &fn->blocks[b].insts[i], flat) == 2;
+    }
+  }
+  report->bytes = of.block_offset[fn->block_count];
+  obj_function_destroy(&of);
+}
+
+int32_t obj_emit_module(const MirModule *module, FILE *out) {
+  ObjEmitter emitter;
+  emitter.module = module;
+  elf_object_init(&emitter.object, module->target.xlen, module->target.ext_c ? ELF_EF_RISCV_RVC : 0);
+  emitter.function_symbol = obj_alloc(module->function_count, sizeof(uint32_t));
+  for (uint32_t f = 0; f < module->function_count; f++) {
+    const MirFunction *fn = module->functions[f];
+    emitter.function_symbol[f] =
+        fn->block_count == 0 ? MIR_NONE
+                             : elf_add_symbol(&emitter.object, fn->name, ELF_SECTION_TEXT, 0, 0, ELF_SYM_FUNC,
+                                              fn->global ? ELF_BIND_GLOBAL : ELF_BIND_LOCAL);
+  }
+  obj_emit_data(&emitter);
+  for (uint32_t f = 0; f < module->function_count; f++) {
+    if (module->functions[f]->block_count > 0) {
+      obj_emit_function(&emitter, f);
+    }
+  }
+  stats_add("obj.text_bytes", emitter.object.sections[ELF_SECTION_TEXT].data.size);
+  stats_add("obj.relocations", emitter.object.sections[ELF_SECTION_TEXT].reloc_count);
+  int32_t status = elf_object_write(&emitter.object, out);
+  free(emitter.function_symbol);
+  free(emitter.data_symbol);
+  elf_object_destroy(&emitter.object);
+  return status;
+}
@@ -0,0 +1,245 @@
+#include "target/peephole.h"
+#include "utils/stats.h"
+
+typedef enum {
+#define RV_INST(name, text, format, opcode, funct3, funct7, flags) PEEPHOLE_OP_##name = RV_##name,
+#include "target/riscv.def"
+  PEEPHOLE_OP_ANY = RV_OPCODE_COUNT,
+  PEEPHOLE_OP_NONE,
+  PEEPHOLE_OP_PURE,
+  PEEPHOLE_OP_WORD,
+  PEEPHOLE_OP_BRANCH
+} PeepholeOp;
+
+typedef enum {
+  PEEPHOLE_GUARD_IDENTITY,
+  PEEPHOLE_GUARD_MOVE_USED,
+  PEEPHOLE_GUARD_OVERWRITTEN,
+  PEEPHOLE_GUARD_SAME_ADDRESS,
+  PEEPHOLE_GUARD_SEXT_OF_FIRST,
+  PEEPHOLE_GUARD_JUMP_OVER
+} PeepholeGuard;
+
+typedef enum {
+  PEEPHOLE_ACTION_DELETE_FIRST,
+  PEEPHOLE_ACTION_FORWARD_SOURCE,
+  PEEPHOLE_ACTION_FORWARD_WORD,
+  PEEPHOLE_ACTION_FORWARD_MOVE,
+  PEEPHOLE_ACTION_FORWARD_BYTE,
+  PEEPHOLE_ACTION_MOVE_SECOND,
+  PEEPHOLE_ACTION_INVERT_BRANCH
+} PeepholeAction;
+
+typedef struct {
+  const char *stat;
+  PeepholeOp first;
+  PeepholeOp second;
+  PeepholeGuard guard;
+  PeepholeAction action;
+} PeepholeRule;
+
+static const PeepholeRule peephole_rules[] = {
+#define PEEPHOLE_RULE(name, first, second, guard, action) \
+  {"peephole." #name, PEEPHOLE_OP_##first, PEEPHOLE_OP_##second, PEEPHOLE_GUARD_##guard, PEEPHOLE_ACTION_##action},
+#include "target/peephole.def"
+};
+
+typedef struct {
+  MirFunction *fn;
+  uint32_t block;
+  int32_t rv64;
+} Peephole;
+
+static uint32_t peephole_flags(const MirInst *inst) {
+  return rv_inst_info((RvOpcode) inst->op)->flags;
+}
+
+static int32_t peephole_is_pure(const MirInst *inst) {
+  uint32_t side_effects =
+      RV_IF_LOAD | RV_IF_STORE | RV_IF_BRANCH | RV_IF_JUMP | RV_IF_CALL | RV_IF_RETURN | RV_IF_VECTOR;
+  return !(peephole_flags(inst) & side_effects) && mir_inst_def(inst) != MIR_NONE;
+}
+
+static int32_t peephole_is_sign_extended(const MirInst *inst) {
+  switch ((RvOpcode) inst->op) {
+    case RV_LUI:
+    case RV_LB:
+    case RV_LH:
+    case RV_LW:
+    case RV_LBU:
+    case RV_LHU:
+    case RV_SLTI:
+    case RV_SLTIU:
+    case RV_SLT:
+    case RV_SLTU:
+      return 1;
+    default:
+      return (peephole_flags(inst) & RV_IF_RV64) && rv_inst_info((RvOpcode) inst->op)->opcode != 0x03;
+  }
+}
+
+static int32_t peephole_op_matches(const PeepholeOp pattern, const MirInst *inst) {
+  switch (pattern) {
+    case PEEPHOLE_OP_ANY:
+      return 1;
+    case PEEPHOLE_OP_NONE:
+      return 0;
+    case PEEPHOLE_OP_PURE:
+      return peephole_is_pure(inst);
+    case PEEPHOLE_OP_WORD:
+      return peephole_is_sign_extended(inst) && mir_inst_def(inst) != MIR_NONE;
+    case PEEPHOLE_OP_BRANCH:
+      return (peephole_flags(inst) & RV_IF_BRANCH) != 0;
+    default:
+      return inst->op == (uint16_t) pattern;
+  }
+}
+
+static int32_t peephole_reads(const MirInst *inst, const MirReg reg) {
+  MirReg uses[MIR_MAX_USES];
+  uint32_t count = mir_inst_uses(inst, uses);
+  for (uint32_t u = 0; u < count; u++) {
+    if (uses[u] == reg) {
+      return 1;
+    }
+  }
+  return 0;
+}
+
+static int32_t peephole_transparent(const MirInst *between, const MirInst *first) {
+  uint32_t blocking = RV_IF_STORE | RV_IF_BRANCH | RV_IF_JUMP | RV_IF_CALL | RV_IF_RETURN | RV_IF_VECTOR;
+  if (peephole_flags(between) & blocking) {
+    return 0;
+  }
+  MirReg def = mir_inst_def(between);
+  MirReg first_def = mir_inst_def(first);
+  if (first_def != MIR_NONE && (def == first_def || peephole_reads(between, first_def))) {
+    return 0;
+  }
+  return def == MIR_NONE || !peephole_reads(first, def);
+}
+
+static int32_t peephole_guard(const Peephole *ph, const PeepholeRule *rule, const uint32_t i, const uint32_t j) {
+  const MirBlock *block = &ph->fn->blocks[ph->block];
+  const MirInst *first = &block->insts[i];
+  const MirInst *second = j != MIR_NONE ? &block->insts[j] : NULL;
+  switch (rule->guard) {
+    case PEEPHOLE_GUARD_IDENTITY:
+      return mir_inst_is_move(first) && first->rd == first->rs1;
+    case PEEPHOLE_GUARD_MOVE_USED: {
+      if (!mir_inst_is_move(first) || first->rd == first->rs1) {
+        return 0;
+      }
+      MirInst copy = *second;
+      MirReg *slot;
+      for (uint32_t u = 0; (slot = mir_inst_use_slot(&copy, u)) != NULL; u++) {
+        if (*slot == first->rd) {
+          return 1;
+        }
+      }
+      return 0;
+    }
+    case PEEPHOLE_GUARD_OVERWRITTEN:
+      return mir_inst_def(second) == first->rd && !peephole_reads(second, first->rd) &&
+             !(peephole_flags(second) & RV_IF_CALL);
+    case PEEPHOLE_GUARD_SAME_ADDRESS:
+      return first->rs1 == second->rs1 && first->imm == second->imm &&
+             !((first->flags | second->flags) & MIR_INST_FRAME);
+    case PEEPHOLE_GUARD_SEXT_OF_FIRST:
+      return ph->rv64 && second->imm == 0 && second->rs1 == first->rd;
+    case PEEPHOLE_GUARD_JUMP_OVER:
+      return j == i + 1 && j + 1 == block->count && second->rd == RV_ZERO && first->target == ph->block + 1;
+  }
+  return 0;
+}
+
+static void peephole_apply(Peephole *ph, const PeepholeRule *rule, const uint32_t i, const uint32_t j) {
+  MirBlock *block = &ph->fn->blocks[ph->block];
+  MirInst *first = &block->insts[i];
+  MirInst *second = j != MIR_NONE ? &block->insts[j] : NULL;
+  switch (rule->action) {
+    case PEEPHOLE_ACTION_DELETE_FIRST:
+      mir_remove(ph->fn, ph->block, i);
+      break;
+    case PEEPHOLE_ACTION_FORWARD_SOURCE: {
+      MirReg *slot;
+      for (uint32_t u = 0; (slot = mir_inst_use_slot(second, u)) != NULL; u++) {
+        if (*slot == first->rd) {
+          *slot = first->rs1;
+        }
+      }
+      break;
+    }
+    case PEEPHOLE_ACTION_FORWARD_WORD:
+      *second = mir_make(ph->rv64 ? RV_ADDIW : RV_ADDI, second->rd, first->rs2, MIR_NONE, 0);
+      break;
+    case PEEPHOLE_ACTION_FORWARD_MOVE:
+      *second = mir_make(RV_ADDI, second->rd, first->rs2, MIR_NONE, 0);
+      break;
+    case PEEPHOLE_ACTION_FORWARD_BYTE:
+      *second = mir_make(RV_ANDI, second->rd, first->rs2, MIR_NONE, 0xff);
+      break;
+    case PEEPHOLE_ACTION_MOVE_SECOND:
+      *second = mir_make(RV_ADDI, second->rd, second->rs1, MIR_NONE, 0);
+      break;
+    case PEEPHOLE_ACTION_INVERT_BRANCH:
+      first->op = (uint16_t) rv_invert_branch((RvOpcode) first->op);
+      first->target = second->target;
+      mir_remove(ph->fn, ph->block, j);
+      break;
+  }
+  stats_add(rule->stat, 1);
+}
+
+static int32_t peephole_try(Peephole *ph, const PeepholeRule *rule, const uint32_t i) {
+  const MirBlock *block = &ph->fn->blocks[ph->block];
+  if (!peephole_op_matches(rule->first, &block->insts[i])) {
+    return 0;
+  }
+  if (rule->second == PEEPHOLE_OP_NONE) {
+    if (!peephole_guard(ph, rule, i, MIR_NONE)) {
+      return 0;
+    }
+    peephole_apply(ph, rule, i, MIR_NONE);
+    return 1;
+  }
+  for (uint32_t j = i + 1; j < block->count && j < i + PEEPHOLE_WINDOW; j++) {
+    const MirInst *second = &block->insts[j];
+    if (peephole_op_matches(rule->second, second) && peephole_guard(ph, rule, i, j)) {
+      peephole_apply(ph, rule, i, j);
+      return 1;
+    }
+    if (!peephole_transparent(second, &block->insts[i])) {
+      return 0;
+    }
+  }
+  return 0;
+}
+
+static int32_t peephole_block(Peephole *ph) {
+  int32_t changed = 0;
+  uint32_t i = 0;
+  while (i < ph->fn->blocks[ph->block].count) {
+    int32_t applied = 0;
+    for (uint32_t r = 0; r < sizeof(peephole_rules) / sizeof(peephole_rules[0]) && !applied; r++) {
+      applied = peephole_try(ph, &peephole_rules[r], i);
+    }
+    if (!applied) {
+      i++;
+      continue;
+    }
+    changed = 1;
+    i = i >= PEEPHOLE_WINDOW - 1 ? i - (PEEPHOLE_WINDOW - 1) : 0;
+  }
+  return changed;
+}
+
+void peephole_function(MirFunction *fn) {
+  Peephole ph;
+  ph.fn = fn;
+  ph.rv64 = fn->module->target.xlen == 64;
+  for (ph.block = 0; ph.block < fn->block_count; ph.block++) {
+    while (peephole_block(&ph)) {
+    }
+  }
+}
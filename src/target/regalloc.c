@@ -0,0 +1,466 @@
+#include "target/regalloc.h"
+#include "target/rvc.h"
+#include "utils/diagnostic.h"
+#include "utils/stats.h"
+#include <stdlib.h>
+#include <string.h>
+
+static const MirReg regalloc_leaf_order[] = {
+  RV_A0, RV_A0 + 1, RV_A0 + 2, RV_A0 + 3, RV_A0 + 4, RV_A0 + 5, RV_A0 + 6, RV_A7,
+  RV_T0, RV_T1, RV_T2, RV_T3, RV_T3 + 1, RV_T3 + 2,
+  RV_S0, RV_S1, RV_S2, RV_S2 + 1, RV_S2 + 2, RV_S2 + 3, RV_S2 + 4, RV_S2 + 5, RV_S2 + 6, RV_S2 + 7, RV_S2 + 8, RV_S11
+};
+
+static const MirReg regalloc_call_order[] = {
+  RV_T0, RV_T1, RV_T2, RV_T3, RV_T3 + 1, RV_T3 + 2,
+  RV_S0, RV_S1, RV_S2, RV_S2 + 1, RV_S2 + 2, RV_S2 + 3, RV_S2 + 4, RV_S2 + 5, RV_S2 + 6, RV_S2 + 7, RV_S2 + 8, RV_S11,
+  RV_A0, RV_A0 + 1, RV_A0 + 2, RV_A0 + 3, RV_A0 + 4, RV_A0 + 5, RV_A0 + 6, RV_A7
+};
+
+typedef struct {
+  uint32_t pred;
+  uint32_t succ;
+  MirInst *insts;
+  uint32_t count;
+  uint32_t capacity;
+} RegallocEdgeFix;
+
+static void *regalloc_alloc(const size_t count, const size_t size) {
+  void *ptr = calloc(count ? count : 1, size);
+  if (!ptr) {
+    LOG(FATAL, "out of memory");
+  }
+  return ptr;
+}
+
+uint32_t regalloc_order(const int32_t leaf, MirReg order[RV_REG_COUNT]) {
+  const MirReg *source = leaf ? regalloc_leaf_order : regalloc_call_order;
+  uint32_t count = (uint32_t) (sizeof(regalloc_leaf_order) / sizeof(regalloc_leaf_order[0]));
+  memcpy(order, source, count * sizeof(MirReg));
+  return count;
+}
+
+static int32_t regalloc_callee_saved(const MirReg reg) {
+  return reg == RV_S0 || reg == RV_S1 || (reg >= RV_S2 && reg <= RV_S11);
+}
+
+int32_t regalloc_prefers(const RegallocState *state, const MirReg vreg, const MirReg reg) {
+  if (!state->compress || state->temp[vreg] || state->weight[vreg] < REGALLOC_HOT_WEIGHT) {
+    return 1;
+  }
+  return rvc_is_compact_reg(reg) && !regalloc_callee_saved(reg);
+}
+
+const char *regalloc_kind_name(const RegallocKind kind) {
+  return kind == REGALLOC_LINEAR_SCAN ? "linear-scan" : "graph-coloring";
+}
+
+static float regalloc_depth_weight(const uint32_t depth) {
+  float weight = 1.0f;
+  for (uint32_t d = 0; d < depth && d < 6; d++) {
+    weight *= 10.0f;
+  }
+  return weight;
+}
+
+static void regalloc_state_init(RegallocState *state, MirFunction *fn, const uint8_t *temp, RegallocReport *report) {
+  memset(state, 0, sizeof(*state));
+  state->fn = fn;
+  state->temp = temp;
+  state->report = report;
+  state->leaf = !fn->has_calls;
+  state->compress = fn->module->target.ext_c;
+  mir_liveness_compute(&state->live, fn);
+  state->block_start = regalloc_alloc(fn->block_count, sizeof(uint32_t));
+  state->block_end = regalloc_alloc(fn->block_count, sizeof(uint32_t));
+  state->weight = regalloc_alloc(fn->vreg_count, sizeof(float));
+  state->assign = regalloc_alloc(fn->vreg_count, sizeof(MirReg));
+  state->split = regalloc_alloc(fn->vreg_count, sizeof(uint32_t));
+  for (MirReg reg = 0; reg < fn->vreg_count; reg++) {
+    state->assign[reg] = reg < RV_REG_COUNT ? reg : MIR_NONE;
+    state->split[reg] = MIR_NONE;
+  }
+  uint32_t position = 0;
+  for (uint32_t b = 0; b < fn->block_count; b++) {
+    const MirBlock *block = &fn->blocks[b];
+    float weight = regalloc_depth_weight(block->loop_depth);
+    state->block_start[b] = position;
+    for (uint32_t i = 0; i < block->count; i++) {
+      const MirInst *inst = &block->insts[i];
+      MirReg uses[MIR_MAX_USES];
+      uint32_t count = mir_inst_uses(inst, uses);
+      for (uint32_t u = 0; u < count; u++) {
+        if (mir_is_vreg(uses[u])) {
+          state->weight[uses[u]] += weight;
+        }
+      }
+      MirReg def = mir_inst_def(inst);
+      if (mir_is_vreg(def)) {
+        state->weight[def] += weight;
+      }
+      position += 2;
+    }
+    state->block_end[b] = position - 1;
+  }
+  for (MirReg reg = MIR_VREG_BASE; reg < fn->vreg_count; reg++) {
+    if (temp[reg]) {
+      state->weight[reg] = REGALLOC_INFINITE_WEIGHT;
+    }
+  }
+}
+
+static void regalloc_state_destroy(RegallocState *state) {
+  mir_liveness_destroy(&state->live);
+  free(state->block_start);
+  free(state->block_end);
+  free(state->weight);
+  free(state->assign);
+  free(state->split);
+}
+
+static MirInst regalloc_slot_access(const MirFunction *fn, const int32_t store, const MirReg reg,
+                                    const uint32_t slot) {
+  int32_t rv64 = fn->module->target.xlen == 64;
+  MirInst inst = store ? mir_make(rv64 ? RV_SD : RV_SW, MIR_NONE, RV_SP, reg, 0)
+                       : mir_make(rv64 ? RV_LD : RV_LW, reg, RV_SP, MIR_NONE, 0);
+  inst.flags = MIR_INST_FRAME;
+  inst.target = slot;
+  return inst;
+}
+
+typedef struct {
+  MirFunction *fn;
+  uint32_t *slots;
+  uint8_t *temp;
+  uint8_t *split_once;
+  uint32_t capacity;
+} RegallocSpillSpace;
+
+static uint32_t regalloc_slot(RegallocSpillSpace *space, const MirReg reg) {
+  if (space->slots[reg] == MIR_NONE) {
+    int32_t xlen_bytes = space->fn->module->target.xlen / 8;
+    space->slots[reg] = mir_frame_object_create(space->fn, xlen_bytes, xlen_bytes, MIR_FRAME_SPILL);
+  }
+  return space->slots[reg];
+}
+
+static MirReg regalloc_new_temp(RegallocSpillSpace *space) {
+  MirReg reg = mir_vreg_create(space->fn);
+  if (reg >= space->capacity) {
+    uint32_t capacity = space->capacity * 2;
+    space->temp = realloc(space->temp, capacity);
+    space->split_once = realloc(space->split_once, capacity);
+    space->slots = realloc(space->slots, capacity * sizeof(uint32_t));
+    if (!space->temp || !space->split_once || !space->slots) {
+      LOG(FATAL, "out of memory");
+    }
+    memset(space->temp + space->capacity, 0, capacity - space->capacity);
+    memset(space->split_once + space->capacity, 0, capacity - space->capacity);
+    memset(space->slots + space->capacity, 0xff, (capacity - space->capacity) * sizeof(uint32_t));
+    space->capacity = capacity;
+  }
+  space->temp[reg] = 1;
+  return reg;
+}
+
+static int32_t regalloc_in_memory(const RegallocState *state, const MirReg reg, const uint32_t position) {
+  return mir_is_vreg(reg) && reg < state->live.reg_count && state->split[reg] != MIR_NONE &&
+         position >= state->split[reg];
+}
+
+static void regalloc_rewrite_block(const RegallocState *state, RegallocSpillSpace *space, const uint32_t b,
+                                   const MirReg *pending, const uint32_t pending_count, uint32_t *cursor) {
+  MirFunction *fn = state->fn;
+  uint32_t position = state->block_start[b];
+  uint32_t original = fn->blocks[b].count;
+  uint32_t i = 0;
+  for (uint32_t k = 0; k < original; k++, position += 2) {
+    while (*cursor < pending_count && state->split[pending[*cursor]] <= position) {
+      MirReg reg = pending[(*cursor)++];
+      if (k > 0 && state->split[reg] == position) {
+        MirInst store = regalloc_slot_access(fn, 1, reg, regalloc_slot(space, reg));
+        mir_insert(fn, b, i++, &store);
+        state->report->spills++;
+      }
+    }
+    MirInst *inst = &fn->blocks[b].insts[i];
+    MirReg loaded[2] = {MIR_NONE, MIR_NONE};
+    MirReg temps[2] = {MIR_NONE, MIR_NONE};
+    MirReg *slot;
+    for (uint32_t u = 0; (slot = mir_inst_use_slot(inst, u)) != NULL; u++) {
+      if (!regalloc_in_memory(state, *slot, position)) {
+        continue;
+      }
+      MirReg reg = *slot;
+      if (loaded[0] == reg) {
+        *slot = temps[0];
+        continue;
+      }
+      loaded[u] = reg;
+      temps[u] = regalloc_new_temp(space);
+      *slot = temps[u];
+      MirInst reload = regalloc_slot_access(fn, 0, temps[u], regalloc_slot(space, reg));
+      mir_insert(fn, b, i++, &reload);
+      inst = &fn->blocks[b].insts[i];
+      state->report->reloads++;
+    }
+    MirReg def = mir_inst_def(inst);
+    if (regalloc_in_memory(state, def, position + 1)) {
+      MirReg temp = regalloc_new_temp(space);
+      inst->rd = temp;
+      MirInst store = regalloc_slot_access(fn, 1, temp, regalloc_slot(space, def));
+      mir_insert(fn, b, ++i, &store);
+      state->report->spills++;
+    }
+    i++;
+  }
+}
+
+static void regalloc_edge_push(RegallocEdgeFix *fix, const MirInst *inst) {
+  if (fix->count == fix->capacity) {
+    fix->capacity = fix->capacity ? fix->capacity * 2 : 4;
+    fix->insts = realloc(fix->insts, fix->capacity * sizeof(MirInst));
+    if (!fix->insts) {
+      LOG(FATAL, "out of memory");
+    }
+  }
+  fix->insts[fix->count++] = *inst;
+}
+
+static void regalloc_retarget(MirFunction *fn, const uint32_t block, const uint32_t from, const uint32_t to) {
+  MirBlock *data = &fn->blocks[block];
+  for (uint32_t i = mir_block_terminator_start(fn, block); i < data->count; i++) {
+    uint32_t flags = rv_inst_info((RvOpcode) data->insts[i].op)->flags;
+    if ((flags & (RV_IF_BRANCH | RV_IF_JUMP)) && data->insts[i].target == from) {
+      data->insts[i].target = to;
+    }
+  }
+}
+
+static void regalloc_place_edge(MirFunction *fn, const RegallocEdgeFix *fix, const uint32_t *pred_count) {
+  if (pred_count[fix->succ] == 1) {
+    for (uint32_t i = 0; i < fix->count; i++) {
+      mir_insert(fn, fix->succ, i, &fix->insts[i]);
+    }
+    return;
+  }
+  uint32_t succs[2];
+  if (mir_block_succs(fn, fix->pred, succs) == 1) {
+    uint32_t at = mir_block_terminator_start(fn, fix->pred);
+    for (uint32_t i = 0; i < fix->count; i++) {
+      mir_insert(fn, fix->pred, at + i, &fix->insts[i]);
+    }
+    return;
+  }
+  uint32_t middle = mir_block_create(fn);
+  fn->blocks[middle].loop_depth = fn->blocks[fix->succ].loop_depth;
+  fn->blocks[middle].frequency = fn->blocks[fix->pred].frequency < fn->blocks[fix->succ].frequency
+                                     ? fn->blocks[fix->pred].frequency
+                                     : fn->blocks[fix->succ].frequency;
+  for (uint32_t i = 0; i < fix->count; i++) {
+    mir_insert(fn, middle, i, &fix->insts[i]);
+  }
+  mir_emit(fn, middle, RV_JAL, RV_ZERO, MIR_NONE, MIR_NONE, 0)->target = fix->succ;
+  regalloc_retarget(fn, fix->pred, fix->succ, middle);
+}
+
+static uint32_t regalloc_first_split_after(const RegallocState *state, const MirReg *pending,
+                                           const uint32_t pending_count, const uint32_t position) {
+  uint32_t low = 0;
+  uint32_t high = pending_count;
+  while (low < high) {
+    uint32_t middle = low + (high - low) / 2;
+    if (state->split[pending[middle]] <= position) {
+      low = middle + 1;
+    } else {
+      high = middle;
+    }
+  }
+  return low;
+}
+
+static void regalloc_resolve_edges(const RegallocState *state, RegallocSpillSpace *space, const MirReg *pending,
+                                   const uint32_t pending_count) {
+  MirFunction *fn = state->fn;
+  uint32_t block_count = fn->block_count;
+  uint32_t *pred_count = regalloc_alloc(block_count, sizeof(uint32_t));
+  for (uint32_t b = 0; b < block_count; b++) {
+    uint32_t succs[2];
+    uint32_t count = mir_block_succs(fn, b, succs);
+    for (uint32_t s = 0; s < count; s++) {
+      pred_count[succs[s]]++;
+    }
+  }
+  RegallocEdgeFix *fixes = NULL;
+  uint32_t fix_count = 0;
+  uint32_t fix_capacity = 0;
+  for (uint32_t b = 0; b < block_count; b++) {
+    uint32_t succs[2];
+    uint32_t count = mir_block_succs(fn, b, succs);
+    uint32_t pred_last = state->block_end[b] - 1;
+    for (uint32_t s = 0; s < count; s++) {
+      RegallocEdgeFix fix = {b, succs[s], NULL, 0, 0};
+      const MirRegSet *live = mir_live_in(&state->live, succs[s]);
+      uint32_t succ_first = state->block_start[succs[s]];
+      int32_t from_memory = pred_last > succ_first;
+      uint32_t low = from_memory ? succ_first : pred_last;
+      uint32_t high = from_memory ? pred_last : succ_first;
+      for (uint32_t p = regalloc_first_split_after(state, pending, pending_count, low);
+           p < pending_count && state->split[pending[p]] <= high; p++) {
+        MirReg reg = pending[p];
+        if (!mir_reg_set_contains(live, reg)) {
+          continue;
+        }
+        MirInst access = regalloc_slot_access(fn, !from_memory, reg, regalloc_slot(space, reg));
+        regalloc_edge_push(&fix, &access);
+        if (from_memory) {
+          state->report->reloads++;
+        } else {
+          state->report->spills++;
+        }
+      }
+      if (fix.count > 0) {
+        if (fix_count == fix_capacity) {
+          fix_capacity = fix_capacity ? fix_capacity * 2 : 16;
+          fixes = realloc(fixes, fix_capacity * sizeof(RegallocEdgeFix));
+          if (!fixes) {
+            LOG(FATAL, "out of memory");
+          }
+        }
+        fixes[fix_count++] = fix;
+      }
+    }
+  }
+  for (uint32_t f = 0; f < fix_count; f++) {
+    regalloc_place_edge(fn, &fixes[f], pred_count);
+    free(fixes[f].insts);
+  }
+  free(fixes);
+  free(pred_count);
+}
+
+static void regalloc_rewrite(const RegallocState *state, RegallocSpillSpace *space) {
+  uint32_t reg_count = state->live.reg_count;
+  MirReg *pending = regalloc_alloc(reg_count, sizeof(MirReg));
+  uint32_t pending_count = 0;
+  uint32_t last_position = state->block_end[state->live.block_count - 1] + 1;
+  uint32_t *bucket = regalloc_alloc(last_position + 2, sizeof(uint32_t));
+  for (MirReg reg = MIR_VREG_BASE; reg < reg_count; reg++) {
+    if (state->split[reg] == MIR_NONE) {
+      continue;
+    }
+    if (space->split_once[reg]) {
+      state->split[reg] = 0;
+    }
+    space->split_once[reg] = 1;
+    if (state->split[reg] == 0) {
+      stats_add("regalloc.spilled_vregs", 1);
+    } else {
+      state->report->splits++;
+    }
+    if (state->split[reg] <= last_position) {
+      bucket[state->split[reg] + 1]++;
+    }
+  }
+  for (uint32_t p = 1; p < last_position + 2; p++) {
+    bucket[p] += bucket[p - 1];
+  }
+  for (MirReg reg = MIR_VREG_BASE; reg < reg_count; reg++) {
+    if (state->split[reg] != MIR_NONE && state->split[reg] <= last_position) {
+      pending[bucket[state->split[reg]]++] = reg;
+      pending_count++;
+    }
+  }
+  uint32_t cursor = 0;
+  for (uint32_t b = 0; b < state->live.block_count; b++) {
+    regalloc_rewrite_block(state, space, b, pending, pending_count, &cursor);
+  }
+  regalloc_resolve_edges(state, space, pending, pending_count);
+  free(bucket);
+  free(pending);
+}
+
+static MirReg regalloc_assigned(const RegallocState *state, const MirReg reg) {
+  if (state->assign[reg] == MIR_NONE) {
+    LOG(FATAL, "unallocated register in %s", state->fn->name);
+  }
+  return state->assign[reg];
+}
+
+static void regalloc_apply(const RegallocState *state) {
+  MirFunction *fn = state->fn;
+  for (uint32_t b = 0; b < fn->block_count; b++) {
+    MirBlock *block = &fn->blocks[b];
+    uint32_t out = 0;
+    for (uint32_t i = 0; i < block->count; i++) {
+      MirInst *inst = &block->insts[i];
+      MirReg *slot;
+      for (uint32_t u = 0; (slot = mir_inst_use_slot(inst, u)) != NULL; u++) {
+        if (mir_is_vreg(*slot)) {
+          *slot = regalloc_assigned(state, *slot);
+        }
+      }
+      if (mir_is_vreg(mir_inst_def(inst))) {
+        inst->rd = regalloc_assigned(state, inst->rd);
+      }
+      if (mir_inst_is_move(inst) && inst->rd == inst->rs1) {
+        state->report->coalesced++;
+        continue;
+      }
+      block->insts[out++] = *inst;
+    }
+    block->count = out;
+  }
+}
+
+void regalloc_function(MirFunction *fn, const RegallocKind kind, RegallocReport *report) {
+  memset(report, 0, sizeof(*report));
+  report->function = fn->name;
+  report->kind = kind;
+  if (fn->block_count == 0) {
+    return;
+  }
+  RegallocSpillSpace space;
+  space.fn = fn;
+  space.capacity = fn->vreg_count * 2 + 64;
+  space.temp = regalloc_alloc(space.capacity, 1);
+  space.split_once = regalloc_alloc(space.capacity, 1);
+  space.slots = regalloc_alloc(space.capacity, sizeof(uint32_t));
+  memset(space.slots, 0xff, space.capacity * sizeof(uint32_t));
+  for (;;) {
+    if (++report->rounds > REGALLOC_MAX_ROUNDS) {
+      LOG(FATAL, "register allocation did not converge in %s", fn->name);
+    }
+    RegallocState state;
+    regalloc_state_init(&state, fn, space.temp, report);
+    int32_t spilled = kind == REGALLOC_LINEAR_SCAN ? regalloc_linear_scan(&state) : regalloc_graph_color(&state);
+    if (!spilled) {
+      regalloc_apply(&state);
+      regalloc_state_destroy(&state);
+      break;
+    }
+    regalloc_rewrite(&state, &space);
+    regalloc_state_destroy(&state);
+  }
+  free(space.temp);
+  free(space.split_once);
+  free(space.slots);
+  stats_add("regalloc.spills", report->spills);
+  stats_add("regalloc.reloads", report->reloads);
+  stats_add("regalloc.splits", report->splits);
+  stats_add("regalloc.coalesced", report->coalesced);
+}
+
+void regalloc_print_reports(const RegallocReport *reports, const uint32_t count, FILE *out) {
+  fprintf(out, "register allocation report:\n");
+  fprintf(out, "  %-24s %-15s %6s %7s %7s %7s %9s\n", "function", "allocator", "rounds", "spills", "reloads",
+          "splits", "coalesced");
+  for (uint32_t i = 0; i < count; i++) {
+    const RegallocReport *report = &reports[i];
+    if (report->rounds == 0) {
+      continue;
+    }
+    fprintf(out, "  %-24s %-15s %6u %7u %7u %7u %9u\n", report->function, regalloc_kind_name(report->kind),
+            report->rounds, report->spills, report->reloads, report->splits, report->coalesced);
+  }
+}
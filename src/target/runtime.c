@@ -0,0 +1,160 @@
+#include "target/runtime.h"
+#include <string.h>
+
+static const char *const rv_runtime_names[RV_RUNTIME_COUNT] = {"__crv_mulsi3", "__crv_divsi3", "__crv_modsi3"};
+
+static IrValueId runtime_param(IrFunction *fn, const IrBlockId block, const int32_t index) {
+  IrValueId param = ir_emit(fn, block, IR_OP_PARAM, IR_TYPE_I32, IR_NONE, IR_NONE);
+  fn->insts[param].imm = index;
+  return param;
+}
+
+static IrValueId runtime_phi(IrFunction *fn, const IrBlockId block) {
+  IrValueId phi = ir_inst_create(fn, IR_OP_PHI, IR_TYPE_I32);
+  ir_block_append(fn, block, phi);
+  return phi;
+}
+
+static IrValueId runtime_op(IrFunction *fn, const IrBlockId block, const IrOp op, const IrValueId a,
+                            const IrValueId b) {
+  return ir_emit(fn, block, op, IR_TYPE_I32, a, b);
+}
+
+static void runtime_jump(IrFunction *fn, const IrBlockId block, const IrBlockId target) {
+  ir_emit(fn, block, IR_OP_JUMP, IR_TYPE_VOID, target, IR_NONE);
+}
+
+static void runtime_branch(IrFunction *fn, const IrBlockId block, const IrValueId cond, const IrBlockId taken,
+                           const IrBlockId other) {
+  IrValueId branch = ir_emit(fn, block, IR_OP_BRANCH, IR_TYPE_VOID, cond, taken);
+  fn->insts[branch].ops[2] = other;
+}
+
+static void runtime_build_mul(IrFunction *fn) {
+  IrBlockId entry = ir_block_create(fn);
+  IrBlockId loop = ir_block_create(fn);
+  IrBlockId body = ir_block_create(fn);
+  IrBlockId exit = ir_block_create(fn);
+  IrValueId a = runtime_param(fn, entry, 0);
+  IrValueId b = runtime_param(fn, entry, 1);
+  IrValueId zero = ir_emit_const(fn, entry, 0);
+  runtime_jump(fn, entry, loop);
+
+  IrValueId acc = runtime_phi(fn, loop);
+  IrValueId x = runtime_phi(fn, loop);
+  IrValueId y = runtime_phi(fn, loop);
+  runtime_branch(fn, loop, runtime_op(fn, loop, IR_OP_NE, y, zero), body, exit);
+
+  IrValueId one = ir_emit_const(fn, body, 1);
+  IrValueId mask = runtime_op(fn, body, IR_OP_SUB, zero, runtime_op(fn, body, IR_OP_AND, y, one));
+  IrValueId next_acc = runtime_op(fn, body, IR_OP_ADD, acc, runtime_op(fn, body, IR_OP_AND, x, mask));
+  IrValueId next_x = runtime_op(fn, body, IR_OP_SHL, x, one);
+  IrValueId next_y = runtime_op(fn, body, IR_OP_SHRU, y, one);
+  runtime_jump(fn, body, loop);
+  ir_emit(fn, exit, IR_OP_RET, IR_TYPE_VOID, acc, IR_NONE);
+
+  ir_phi_add_incoming(fn, acc, entry, zero);
+  ir_phi_add_incoming(fn, acc, body, next_acc);
+  ir_phi_add_incoming(fn, x, entry, a);
+  ir_phi_add_incoming(fn, x, body, next_x);
+  ir_phi_add_incoming(fn, y, entry, b);
+  ir_phi_add_incoming(fn, y, body, next_y);
+}
+
+static void runtime_build_divmod(IrFunction *fn, const int32_t want_rem) {
+  IrBlockId entry = ir_block_create(fn);
+  IrBlockId by_zero = ir_block_create(fn);
+  IrBlockId setup = ir_block_create(fn);
+  IrBlockId loop = ir_block_create(fn);
+  IrBlockId exit = ir_block_create(fn);
+  IrValueId a = runtime_param(fn, entry, 0);
+  IrValueId b = runtime_param(fn, entry, 1);
+  IrValueId zero = ir_emit_const(fn, entry, 0);
+  runtime_branch(fn, entry, runtime_op(fn, entry, IR_OP_EQ, b, zero), by_zero, setup);
+
+  IrValueId fallback = want_rem ? a : ir_emit_const(fn, by_zero, -1);
+  ir_emit(fn, by_zero, IR_OP_RET, IR_TYPE_VOID, fallback, IR_NONE);
+
+  IrValueId sign_shift = ir_emit_const(fn, setup, 31);
+  IrValueId one = ir_emit_const(fn, setup, 1);
+  IrValueId min = ir_emit_const(fn, setup, INT32_MIN);
+  IrValueId sign_a = runtime_op(fn, setup, IR_OP_SHR, a, sign_shift);
+  IrValueId sign_b = runtime_op(fn, setup, IR_OP_SHR, b, sign_shift);
+  IrValueId abs_a = runtime_op(fn, setup, IR_OP_SUB, runtime_op(fn, setup, IR_OP_XOR, a, sign_a), sign_a);
+  IrValueId abs_b = runtime_op(fn, setup, IR_OP_SUB, runtime_op(fn, setup, IR_OP_XOR, b, sign_b), sign_b);
+  IrValueId biased_b = runtime_op(fn, setup, IR_OP_XOR, abs_b, min);
+  runtime_jump(fn, setup, loop);
+
+  IrValueId bit = runtime_phi(fn, loop);
+  IrValueId quot = runtime_phi(fn, loop);
+  IrValueId rem = runtime_phi(fn, loop);
+  IrValueId next_bit = runtime_op(fn, loop, IR_OP_AND, runtime_op(fn, loop, IR_OP_SHRU, abs_a, bit), one);
+  IrValueId shifted = runtime_op(fn, loop, IR_OP_OR, runtime_op(fn, loop, IR_OP_SHL, rem, one), next_bit);
+  IrValueId fits = runtime_op(fn, loop, IR_OP_GE, runtime_op(fn, loop, IR_OP_XOR, shifted, min), biased_b);
+  IrValueId mask = runtime_op(fn, loop, IR_OP_SUB, zero, fits);
+  IrValueId next_rem = runtime_op(fn, loop, IR_OP_SUB, shifted, runtime_op(fn, loop, IR_OP_AND, abs_b, mask));
+  IrValueId next_quot = runtime_op(fn, loop, IR_OP_OR, quot, runtime_op(fn, loop, IR_OP_SHL, fits, bit));
+  IrValueId next_index = runtime_op(fn, loop, IR_OP_SUB, bit, one);
+  runtime_branch(fn, loop, runtime_op(fn, loop, IR_OP_GE, next_index, zero), loop, exit);
+
+  ir_phi_add_incoming(fn, bit, setup, sign_shift);
+  ir_phi_add_incoming(fn, bit, loop, next_index);
+  ir_phi_add_incoming(fn, quot, setup, zero);
+  ir_phi_add_incoming(fn, quot, loop, next_quot);
+  ir_phi_add_incoming(fn, rem, setup, zero);
+  ir_phi_add_incoming(fn, rem, loop, next_rem);
+
+  IrValueId sign = want_rem ? sign_a : runtime_op(fn, exit, IR_OP_XOR, sign_a, sign_b);
+  IrValueId magnitude = want_rem ? next_rem : next_quot;
+  IrValueId result = runtime_op(fn, exit, IR_OP_SUB, runtime_op(fn, exit, IR_OP_XOR, magnitude, sign), sign);
+  ir_emit(fn, exit, IR_OP_RET, IR_TYPE_VOID, result, IR_NONE);
+}
+
+static int32_t runtime_needs_call(const IrFunction *fn, const IrInst *inst) {
+  if (inst->op == IR_OP_DIV || inst->op == IR_OP_REM) {
+    return 1;
+  }
+  if (inst->op != IR_OP_MUL) {
+    return 0;
+  }
+  for (uint32_t k = 0; k < 2; k++) {
+    int32_t value;
+    if (ir_value_const(fn, inst->ops[k], &value) && value > 0 && (value & (value - 1)) == 0) {
+      return 0;
+    }
+  }
+  return 1;
+}
+
+void rv_runtime_add_helpers(IrModule *module, const TargetInfo *target, int32_t helpers[RV_RUNTIME_COUNT]) {
+  int32_t needed[RV_RUNTIME_COUNT];
+  memset(needed, 0, sizeof(needed));
+  for (uint32_t h = 0; h < RV_RUNTIME_COUNT; h++) {
+    helpers[h] = -1;
+  }
+  if (target->ext_m) {
+    return;
+  }
+  for (uint32_t f = 0; f < module->function_count; f++) {
+    const IrFunction *fn = module->functions[f];
+    for (uint32_t i = 0; i < fn->inst_count; i++) {
+      const IrInst *inst = &fn->insts[i];
+      if (inst->block != IR_NONE && runtime_needs_call(fn, inst)) {
+        needed[inst->op == IR_OP_MUL ? RV_RUNTIME_MUL : inst->op == IR_OP_DIV ? RV_RUNTIME_DIV : RV_RUNTIME_REM] = 1;
+      }
+    }
+  }
+  for (uint32_t h = 0; h < RV_RUNTIME_COUNT; h++) {
+    if (!needed[h]) {
+      continue;
+    }
+    IrFunction *fn = ir_function_create(module, rv_runtime_names[h], strlen(rv_runtime_names[h]), 2);
+    if (h == RV_RUNTIME_MUL) {
+      runtime_build_mul(fn);
+    } else {
+      runtime_build_divmod(fn, h == RV_RUNTIME_REM);
+    }
+    ir_compute_preds(fn);
+    helpers[h] = fn->index;
+  }
+}
@@ -0,0 +1,322 @@
+#include "target/rvc.h"
+
+typedef struct {
+  const char *name;
+  RvcFormat format;
+  uint16_t match;
+} RvcInstInfo;
+
+static const RvcInstInfo rvc_infos[] = {
+#define RVC_INST(name, text, format, match) {text, RVC_FMT_##format, match},
+#include "target/rvc.def"
+};
+
+int32_t rvc_is_compact_reg(const MirReg reg) {
+  return reg >= RV_S0 && reg <= RV_A0 + 5;
+}
+
+static int32_t rvc_fits_signed(const int64_t value, const uint32_t bits) {
+  int64_t limit = (int64_t) 1 << (bits - 1);
+  return value >= -limit && value < limit;
+}
+
+static int32_t rvc_fits_scaled(const int32_t value, const int32_t scale, const int32_t limit) {
+  return value >= 0 && value < limit && value % scale == 0;
+}
+
+static int32_t rvc_make(RvcInst *out, const RvcOpcode op, const MirReg high, const MirReg low, const int32_t imm) {
+  out->op = op;
+  out->high = high;
+  out->low = low;
+  out->imm = imm;
+  return 1;
+}
+
+static int32_t rvc_select_addi(const MirInst *inst, RvcInst *out) {
+  if (inst->rd == RV_ZERO) {
+    return 0;
+  }
+  if (inst->rs1 == RV_ZERO && rvc_fits_signed(inst->imm, 6)) {
+    return rvc_make(out, RVC_LI, inst->rd, MIR_NONE, inst->imm);
+  }
+  if (inst->imm == 0 && inst->rs1 != RV_ZERO) {
+    return rvc_make(out, RVC_MV, inst->rd, inst->rs1, 0);
+  }
+  if (inst->rd == inst->rs1 && inst->imm != 0 && rvc_fits_signed(inst->imm, 6)) {
+    return rvc_make(out, RVC_ADDI, inst->rd, MIR_NONE, inst->imm);
+  }
+  if (inst->rd == RV_SP && inst->rs1 == RV_SP && inst->imm != 0 && inst->imm % 16 == 0 &&
+      rvc_fits_signed(inst->imm, 10)) {
+    return rvc_make(out, RVC_ADDI16SP, RV_SP, MIR_NONE, inst->imm);
+  }
+  if (inst->rs1 == RV_SP && rvc_is_compact_reg(inst->rd) && inst->imm != 0 && rvc_fits_scaled(inst->imm, 4, 1024)) {
+    return rvc_make(out, RVC_ADDI4SPN, MIR_NONE, inst->rd, inst->imm);
+  }
+  return 0;
+}
+
+static int32_t rvc_select_lui(const MirInst *inst, RvcInst *out) {
+  int32_t value = inst->imm & 0xfffff;
+  if (value & 0x80000) {
+    value -= 0x100000;
+  }
+  if (inst->rd == RV_ZERO || inst->rd == RV_SP || value == 0 || !rvc_fits_signed(value, 6)) {
+    return 0;
+  }
+  return rvc_make(out, RVC_LUI, inst->rd, MIR_NONE, value);
+}
+
+static int32_t rvc_select_shift(const MirInst *inst, const int32_t xlen, RvcInst *out) {
+  if (inst->rd != inst->rs1 || inst->imm <= 0 || inst->imm >= xlen) {
+    return 0;
+  }
+  if (inst->op == RV_SLLI) {
+    return inst->rd != RV_ZERO && rvc_make(out, RVC_SLLI, inst->rd, MIR_NONE, inst->imm);
+  }
+  if (!rvc_is_compact_reg(inst->rd)) {
+    return 0;
+  }
+  return rvc_make(out, inst->op == RV_SRLI ? RVC_SRLI : RVC_SRAI, inst->rd, MIR_NONE, inst->imm);
+}
+
+static int32_t rvc_select_arith(const MirInst *inst, const RvcOpcode op, const int32_t commutative, RvcInst *out) {
+  if (!rvc_is_compact_reg(inst->rd)) {
+    return 0;
+  }
+  if (inst->rd == inst->rs1 && rvc_is_compact_reg(inst->rs2)) {
+    return rvc_make(out, op, inst->rd, inst->rs2, 0);
+  }
+  if (commutative && inst->rd == inst->rs2 && rvc_is_compact_reg(inst->rs1)) {
+    return rvc_make(out, op, inst->rd, inst->rs1, 0);
+  }
+  return 0;
+}
+
+static int32_t rvc_select_add(const MirInst *inst, RvcInst *out) {
+  if (inst->rd == RV_ZERO) {
+    return 0;
+  }
+  if (inst->rs1 == RV_ZERO && inst->rs2 != RV_ZERO) {
+    return rvc_make(out, RVC_MV, inst->rd, inst->rs2, 0);
+  }
+  if (inst->rd == inst->rs1 && inst->rs2 != RV_ZERO) {
+    return rvc_make(out, RVC_ADD, inst->rd, inst->rs2, 0);
+  }
+  if (inst->rd == inst->rs2 && inst->rs1 != RV_ZERO) {
+    return rvc_make(out, RVC_ADD, inst->rd, inst->rs1, 0);
+  }
+  return 0;
+}
+
+static int32_t rvc_select_memory(const MirInst *inst, const int32_t doubleword, RvcInst *out) {
+  int32_t store = (rv_inst_info((RvOpcode) inst->op)->flags & RV_IF_STORE) != 0;
+  int32_t scale = doubleword ? 8 : 4;
+  MirReg value = store ? inst->rs2 : inst->rd;
+  if (inst->rs1 == RV_SP && rvc_fits_scaled(inst->imm, scale, scale * 64) && (store || value != RV_ZERO)) {
+    RvcOpcode op = store ? (doubleword ? RVC_SDSP : RVC_SWSP) : (doubleword ? RVC_LDSP : RVC_LWSP);
+    return rvc_make(out, op, store ? MIR_NONE : value, store ? value : MIR_NONE, inst->imm);
+  }
+  if (rvc_is_compact_reg(inst->rs1) && rvc_is_compact_reg(value) && rvc_fits_scaled(inst->imm, scale, scale * 32)) {
+    RvcOpcode op = store ? (doubleword ? RVC_SD : RVC_SW) : (doubleword ? RVC_LD : RVC_LW);
+    return rvc_make(out, op, inst->rs1, value, inst->imm);
+  }
+  return 0;
+}
+
+int32_t rvc_select(const MirInst *inst, const int32_t xlen, RvcInst *out) {
+  int32_t rv64 = xlen == 64;
+  if (inst->flags & MIR_INST_DATA) {
+    return 0;
+  }
+  switch ((RvOpcode) inst->op) {
+    case RV_ADDI:
+      return rvc_select_addi(inst, out);
+    case RV_ADDIW:
+      return rv64 && inst->rd != RV_ZERO && inst->rd == inst->rs1 && rvc_fits_signed(inst->imm, 6) &&
+             rvc_make(out, RVC_ADDIW, inst->rd, MIR_NONE, inst->imm);
+    case RV_LUI:
+      return rvc_select_lui(inst, out);
+    case RV_SLLI:
+    case RV_SRLI:
+    case RV_SRAI:
+      return rvc_select_shift(inst, xlen, out);
+    case RV_ANDI:
+      return inst->rd == inst->rs1 && rvc_is_compact_reg(inst->rd) && rvc_fits_signed(inst->imm, 6) &&
+             rvc_make(out, RVC_ANDI, inst->rd, MIR_NONE, inst->imm);
+    case RV_ADD:
+      return rvc_select_add(inst, out);
+    case RV_SUB:
+      return rvc_select_arith(inst, RVC_SUB, 0, out);
+    case RV_XOR:
+      return rvc_select_arith(inst, RVC_XOR, 1, out);
+    case RV_OR:
+      return rvc_select_arith(inst, RVC_OR, 1, out);
+    case RV_AND:
+      return rvc_select_arith(inst, RVC_AND, 1, out);
+    case RV_SUBW:
+      return rv64 && rvc_select_arith(inst, RVC_SUBW, 0, out);
+    case RV_ADDW:
+      return rv64 && rvc_select_arith(inst, RVC_ADDW, 1, out);
+    case RV_LW:
+    case RV_SW:
+      return rvc_select_memory(inst, 0, out);
+    case RV_LD:
+    case RV_SD:
+      return rv64 && rvc_select_memory(inst, 1, out);
+    case RV_JALR:
+      if (inst->imm != 0 || inst->rs1 == RV_ZERO || (inst->rd != RV_ZERO && inst->rd != RV_RA)) {
+        return 0;
+      }
+      return rvc_make(out, inst->rd == RV_ZERO ? RVC_JR : RVC_JALR, inst->rs1, RV_ZERO, 0);
+    case RV_RET:
+      return rvc_make(out, RVC_JR, RV_RA, RV_ZERO, 0);
+    default:
+      return 0;
+  }
+}
+
+int32_t rvc_select_branch(const MirInst *inst, const int32_t xlen, const int64_t displacement, RvcInst *out) {
+  if (inst->op == RV_JAL) {
+    if (displacement < -RVC_JUMP_RANGE || displacement >= RVC_JUMP_RANGE) {
+      return 0;
+    }
+    if (inst->rd == RV_ZERO) {
+      return rvc_make(out, RVC_J, MIR_NONE, MIR_NONE, (int32_t) displacement);
+    }
+    return xlen == 32 && inst->rd == RV_RA && rvc_make(out, RVC_JAL, MIR_NONE, MIR_NONE, (int32_t) displacement);
+  }
+  if (inst->op != RV_BEQ && inst->op != RV_BNE) {
+    return 0;
+  }
+  if (displacement < -RVC_BRANCH_RANGE || displacement >= RVC_BRANCH_RANGE) {
+    return 0;
+  }
+  MirReg tested = inst->rs2 == RV_ZERO ? inst->rs1 : inst->rs1 == RV_ZERO ? inst->rs2 : MIR_NONE;
+  if (tested == MIR_NONE || !rvc_is_compact_reg(tested)) {
+    return 0;
+  }
+  return rvc_make(out, inst->op == RV_BEQ ? RVC_BEQZ : RVC_BNEZ, tested, MIR_NONE, (int32_t) displacement);
+}
+
+static uint32_t rvc_bits(const int32_t value, const uint32_t high, const uint32_t low, const uint32_t at) {
+  return (((uint32_t) value >> low) & ((1u << (high - low + 1)) - 1)) << at;
+}
+
+static uint32_t rvc_compact(const MirReg reg) {
+  return (reg - RV_S0) & 0x7u;
+}
+
+uint16_t rvc_encode(const RvcInst *inst) {
+  const RvcInstInfo *info = &rvc_infos[inst->op];
+  uint32_t bits = info->match;
+  int32_t imm = inst->imm;
+  switch (info->format) {
+    case RVC_FMT_CR:
+      bits |= (inst->high << 7) | (inst->low << 2);
+      break;
+    case RVC_FMT_CI:
+      bits |= rvc_bits(imm, 5, 5, 12) | (inst->high << 7) | rvc_bits(imm, 4, 0, 2);
+      break;
+    case RVC_FMT_CI_ADDI16SP:
+      bits |= rvc_bits(imm, 9, 9, 12) | rvc_bits(imm, 4, 4, 6) | rvc_bits(imm, 6, 6, 5) | rvc_bits(imm, 8, 7, 3) |
+              rvc_bits(imm, 5, 5, 2);
+      break;
+    case RVC_FMT_CI_LWSP:
+      bits |= rvc_bits(imm, 5, 5, 12) | (inst->high << 7) | rvc_bits(imm, 4, 2, 4) | rvc_bits(imm, 7, 6, 2);
+      break;
+    case RVC_FMT_CI_LDSP:
+      bits |= rvc_bits(imm, 5, 5, 12) | (inst->high << 7) | rvc_bits(imm, 4, 3, 5) | rvc_bits(imm, 8, 6, 2);
+      break;
+    case RVC_FMT_CSS_SWSP:
+      bits |= rvc_bits(imm, 5, 2, 9) | rvc_bits(imm, 7, 6, 7) | (inst->low << 2);
+      break;
+    case RVC_FMT_CSS_SDSP:
+      bits |= rvc_bits(imm, 5, 3, 10) | rvc_bits(imm, 8, 6, 7) | (inst->low << 2);
+      break;
+    case RVC_FMT_CIW:
+      bits |= rvc_bits(imm, 5, 4, 11) | rvc_bits(imm, 9, 6, 7) | rvc_bits(imm, 2, 2, 6) | rvc_bits(imm, 3, 3, 5) |
+              (rvc_compact(inst->low) << 2);
+      break;
+    case RVC_FMT_CL_W:
+      bits |= rvc_bits(imm, 5, 3, 10) | (rvc_compact(inst->high) << 7) | rvc_bits(imm, 2, 2, 6) |
+              rvc_bits(imm, 6, 6, 5) | (rvc_compact(inst->low) << 2);
+      break;
+    case RVC_FMT_CL_D:
+      bits |= rvc_bits(imm, 5, 3, 10) | (rvc_compact(inst->high) << 7) | rvc_bits(imm, 7, 6, 5) |
+              (rvc_compact(inst->low) << 2);
+      break;
+    case RVC_FMT_CA:
+      bits |= (rvc_compact(inst->high) << 7) | (rvc_compact(inst->low) << 2);
+      break;
+    case RVC_FMT_CB_ALU:
+      bits |= rvc_bits(imm, 5, 5, 12) | (rvc_compact(inst->high) << 7) | rvc_bits(imm, 4, 0, 2);
+      break;
+    case RVC_FMT_CB_BRANCH:
+      bits |= rvc_bits(imm, 8, 8, 12) | rvc_bits(imm, 4, 3, 10) | (rvc_compact(inst->high) << 7) |
+              rvc_bits(imm, 7, 6, 5) | rvc_bits(imm, 2, 1, 3) | rvc_bits(imm, 5, 5, 2);
+      break;
+    case RVC_FMT_CJ:
+      bits |= rvc_bits(imm, 11, 11, 12) | rvc_bits(imm, 4, 4, 11) | rvc_bits(imm, 9, 8, 9) | rvc_bits(imm, 10, 10, 8) |
+              rvc_bits(imm, 6, 6, 7) | rvc_bits(imm, 7, 7, 6) | rvc_bits(imm, 3, 1, 3) | rvc_bits(imm, 5, 5, 2);
+      break;
+  }
+  return (uint16_t) bits;
+}
+
+void rvc_print(const RvcInst *inst, FILE *out) {
+  const RvcInstInfo *info = &rvc_infos[inst->op];
+  fprintf(out, "%s ", info->name);
+  switch (info->format) {
+    case RVC_FMT_CR:
+      if (inst->low == RV_ZERO) {
+        fprintf(out, "%s", rv_reg_name(inst->high));
+      } else {
+        fprintf(out, "%s, %s", rv_reg_name(inst->high), rv_reg_name(inst->low));
+      }
+      break;
+    case RVC_FMT_CI:
+    case RVC_FMT_CB_ALU:
+      fprintf(out, "%s, %d", rv_reg_name(inst->high), inst->op == RVC_LUI ? inst->imm & 0xfffff : inst->imm);
+      break;
+    case RVC_FMT_CI_ADDI16SP:
+      fprintf(out, "sp, %d", inst->imm);
+      break;
+    case RVC_FMT_CI_LWSP:
+    case RVC_FMT_CI_LDSP:
+      fprintf(out, "%s, %d(sp)", rv_reg_name(inst->high), inst->imm);
+      break;
+    case RVC_FMT_CSS_SWSP:
+    case RVC_FMT_CSS_SDSP:
+      fprintf(out, "%s, %d(sp)", rv_reg_name(inst->low), inst->imm);
+      break;
+    case RVC_FMT_CIW:
+      fprintf(out, "%s, sp, %d", rv_reg_name(inst->low), inst->imm);
+      break;
+    case RVC_FMT_CL_W:
+    case RVC_FMT_CL_D:
+      fprintf(out, "%s, %d(%s)", rv_reg_name(inst->low), inst->imm, rv_reg_name(inst->high));
+      break;
+    case RVC_FMT_CA:
+      fprintf(out, "%s, %s", rv_reg_name(inst->high), rv_reg_name(inst->low));
+      break;
+    case RVC_FMT_CB_BRANCH:
+      fprintf(out, "%s, %d", rv_reg_name(inst->high), inst->imm);
+      break;
+    case RVC_FMT_CJ:
+      fprintf(out, "%d", inst->imm);
+      break;
+  }
+}
+
+void rvc_print_reports(const RvcReport *reports, const uint32_t count, FILE *out) {
+  fprintf(out, "compression report:\n");
+  fprintf(out, "  %-24s %7s %10s %7s %7s\n", "function", "insts", "compressed", "ratio", "bytes");
+  for (uint32_t i = 0; i < count; i++) {
+    const RvcReport *report = &reports[i];
+    if (report->insts == 0) {
+      continue;
+    }
+    fprintf(out, "  %-24s %7u %10u %6.1f%% %7u\n", report->function, report->insts, report->compressed,
+            100.0 * report->compressed / report->insts, report->bytes);
+  }
+}
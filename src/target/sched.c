@@ -0,0 +1,449 @@
+#include "target/sched.h"
+#include "utils/diagnostic.h"
+#include "utils/stats.h"
+#include <stdlib.h>
+#include <string.h>
+
+static const MachineModel sched_models[] = {
+#define MACHINE_MODEL(id, name, issue_width, alu_units, mul_units, mem_units, alu_latency, mul_latency, div_latency, \
+                      load_latency, loop_align)                                                                      \
+  {name, issue_width, {alu_units, mul_units, mem_units}, alu_latency, mul_latency, div_latency, load_latency,        \
+   loop_align},
+#include "target/machines.def"
+};
+
+typedef struct {
+  uint32_t from;
+  uint32_t to;
+  uint32_t latency;
+} SchedEdge;
+
+typedef struct {
+  uint32_t node;
+  uint32_t next;
+} SchedUse;
+
+typedef struct {
+  const MachineModel *model;
+  const MirFunction *fn;
+  MirInst *insts;
+  uint32_t count;
+  uint32_t capacity;
+  SchedEdge *edges;
+  uint32_t edge_count;
+  uint32_t edge_capacity;
+  uint32_t *succ_start;
+  SchedEdge *succs;
+  uint32_t succ_capacity;
+  uint32_t *pred_count;
+  uint32_t *height;
+  uint32_t *earliest;
+  uint32_t *base_def;
+  uint32_t *order;
+  uint32_t *ready;
+  MirInst *scratch;
+  uint32_t reg_count;
+  uint32_t *last_def;
+  uint32_t *use_head;
+  SchedUse *uses;
+  uint32_t use_count;
+  uint32_t use_capacity;
+  MirReg *touched;
+  uint32_t touched_count;
+} Sched;
+
+typedef struct {
+  const Sched *sched;
+  uint32_t cycle;
+  uint32_t issued;
+  uint32_t used[SCHED_UNIT_COUNT];
+  uint32_t div_busy;
+} SchedIssue;
+
+const MachineModel *machine_model_default(void) {
+  return &sched_models[0];
+}
+
+const MachineModel *machine_model_find(const char *name) {
+  for (uint32_t i = 0; i < sizeof(sched_models) / sizeof(sched_models[0]); i++) {
+    if (strcmp(sched_models[i].name, name) == 0) {
+      return &sched_models[i];
+    }
+  }
+  return NULL;
+}
+
+static void *sched_alloc(const size_t count, const size_t size) {
+  void *ptr = calloc(count ? count : 1, size);
+  if (!ptr) {
+    LOG(FATAL, "out of memory");
+  }
+  return ptr;
+}
+
+static void sched_grow(void **items, uint32_t *capacity, const uint32_t needed, const size_t size) {
+  if (needed <= *capacity) {
+    return;
+  }
+  uint32_t grown = *capacity ? *capacity : 16;
+  while (grown < needed) {
+    grown *= 2;
+  }
+  *items = realloc(*items, grown * size);
+  if (!*items) {
+    LOG(FATAL, "out of memory");
+  }
+  *capacity = grown;
+}
+
+static uint32_t sched_inst_flags(const MirInst *inst) {
+  return rv_inst_info((RvOpcode) inst->op)->flags;
+}
+
+static int32_t sched_is_div(const MirInst *inst) {
+  const RvInstInfo *info = rv_inst_info((RvOpcode) inst->op);
+  return (info->flags & RV_IF_MULDIV) && info->funct3 >= 4;
+}
+
+static SchedUnit sched_unit(const MirInst *inst) {
+  uint32_t flags = sched_inst_flags(inst);
+  if (flags & (RV_IF_LOAD | RV_IF_STORE)) {
+    return SCHED_UNIT_MEM;
+  }
+  return (flags & RV_IF_MULDIV) ? SCHED_UNIT_MUL : SCHED_UNIT_ALU;
+}
+
+static uint32_t sched_latency(const MachineModel *model, const MirInst *inst) {
+  uint32_t flags = sched_inst_flags(inst);
+  if (flags & RV_IF_LOAD) {
+    return model->load_latency;
+  }
+  if (flags & RV_IF_MULDIV) {
+    return sched_is_div(inst) ? model->div_latency : model->mul_latency;
+  }
+  return model->alu_latency;
+}
+
+static int32_t sched_access_width(const MirInst *inst) {
+  switch ((RvOpcode) inst->op) {
+    case RV_LB:
+    case RV_LBU:
+    case RV_SB:
+      return 1;
+    case RV_LH:
+    case RV_LHU:
+    case RV_SH:
+      return 2;
+    case RV_LD:
+    case RV_SD:
+      return 8;
+    default:
+      return 4;
+  }
+}
+
+static int32_t sched_frame_private(const Sched *sched, const MirInst *inst) {
+  return sched->fn->frame[inst->target].kind == MIR_FRAME_SPILL;
+}
+
+static int32_t sched_may_alias(const Sched *sched, const uint32_t a, const uint32_t b) {
+  const MirInst *left = &sched->insts[a];
+  const MirInst *right = &sched->insts[b];
+  int32_t left_frame = (left->flags & MIR_INST_FRAME) != 0;
+  int32_t right_frame = (right->flags & MIR_INST_FRAME) != 0;
+  if (left_frame && right_frame) {
+    return left->target == right->target;
+  }
+  if (left_frame || right_frame) {
+    return !sched_frame_private(sched, left_frame ? left : right);
+  }
+  if (left->rs1 == right->rs1 && sched->base_def[a] == sched->base_def[b]) {
+    return left->imm < right->imm + sched_access_width(right) && right->imm < left->imm + sched_access_width(left);
+  }
+  return 1;
+}
+
+static void sched_add_edge(Sched *sched, const uint32_t from, const uint32_t to, const uint32_t latency) {
+  sched_grow((void **) &sched->edges, &sched->edge_capacity, sched->edge_count + 1, sizeof(SchedEdge));
+  SchedEdge *edge = &sched->edges[sched->edge_count++];
+  edge->from = from;
+  edge->to = to;
+  edge->latency = latency;
+}
+
+static int32_t sched_tracked(const Sched *sched, const MirReg reg) {
+  return reg != MIR_NONE && reg != RV_ZERO && reg < sched->reg_count;
+}
+
+static void sched_touch(Sched *sched, const MirReg reg) {
+  if (sched->last_def[reg] == MIR_NONE && sched->use_head[reg] == MIR_NONE) {
+    sched->touched[sched->touched_count++] = reg;
+  }
+}
+
+static void sched_build(Sched *sched) {
+  uint32_t *memory = sched_alloc(sched->count, sizeof(uint32_t));
+  uint32_t memory_count = 0;
+  sched->edge_count = 0;
+  sched->use_count = 0;
+  sched->touched_count = 0;
+  for (uint32_t i = 0; i < sched->count; i++) {
+    const MirInst *inst = &sched->insts[i];
+    uint32_t flags = sched_inst_flags(inst);
+    MirReg uses[MIR_MAX_USES];
+    uint32_t use_count = mir_inst_uses(inst, uses);
+    sched->base_def[i] = sched_tracked(sched, inst->rs1) ? sched->last_def[inst->rs1] : MIR_NONE;
+    for (uint32_t u = 0; u < use_count; u++) {
+      MirReg reg = uses[u];
+      if (!sched_tracked(sched, reg)) {
+        continue;
+      }
+      sched_touch(sched, reg);
+      uint32_t def = sched->last_def[reg];
+      if (def != MIR_NONE) {
+        sched_add_edge(sched, def, i, sched_latency(sched->model, &sched->insts[def]));
+      }
+      sched_grow((void **) &sched->uses, &sched->use_capacity, sched->use_count + 1, sizeof(SchedUse));
+      sched->uses[sched->use_count].node = i;
+      sched->uses[sched->use_count].next = sched->use_head[reg];
+      sched->use_head[reg] = sched->use_count++;
+    }
+    MirReg def = mir_inst_def(inst);
+    if (sched_tracked(sched, def)) {
+      sched_touch(sched, def);
+      if (sched->last_def[def] != MIR_NONE) {
+        sched_add_edge(sched, sched->last_def[def], i, 1);
+      }
+      for (uint32_t use = sched->use_head[def]; use != MIR_NONE; use = sched->uses[use].next) {
+        if (sched->uses[use].node != i) {
+          sched_add_edge(sched, sched->uses[use].node, i, 0);
+        }
+      }
+      sched->use_head[def] = MIR_NONE;
+      sched->last_def[def] = i;
+    }
+    if (flags & (RV_IF_LOAD | RV_IF_STORE)) {
+      for (uint32_t m = 0; m < memory_count; m++) {
+        uint32_t other = memory[m];
+        int32_t other_store = (sched_inst_flags(&sched->insts[other]) & RV_IF_STORE) != 0;
+        if ((other_store || (flags & RV_IF_STORE)) && sched_may_alias(sched, other, i)) {
+          sched_add_edge(sched, other, i, other_store ? 1 : 0);
+        }
+      }
+      memory[memory_count++] = i;
+    }
+  }
+  for (uint32_t t = 0; t < sched->touched_count; t++) {
+    sched->last_def[sched->touched[t]] = MIR_NONE;
+    sched->use_head[sched->touched[t]] = MIR_NONE;
+  }
+  free(memory);
+
+  sched_grow((void **) &sched->succs, &sched->succ_capacity, sched->edge_count, sizeof(SchedEdge));
+  memset(sched->succ_start, 0, (sched->count + 1) * sizeof(uint32_t));
+  memset(sched->pred_count, 0, sched->count * sizeof(uint32_t));
+  for (uint32_t e = 0; e < sched->edge_count; e++) {
+    sched->succ_start[sched->edges[e].from + 1]++;
+    sched->pred_count[sched->edges[e].to]++;
+  }
+  for (uint32_t i = 0; i < sched->count; i++) {
+    sched->succ_start[i + 1] += sched->succ_start[i];
+  }
+  for (uint32_t e = 0; e < sched->edge_count; e++) {
+    sched->succs[sched->succ_start[sched->edges[e].from]++] = sched->edges[e];
+  }
+  for (uint32_t i = sched->count; i > 0; i--) {
+    sched->succ_start[i] = sched->succ_start[i - 1];
+  }
+  sched->succ_start[0] = 0;
+  for (uint32_t i = sched->count; i-- > 0;) {
+    uint32_t height = sched_latency(sched->model, &sched->insts[i]);
+    for (uint32_t e = sched->succ_start[i]; e < sched->succ_start[i + 1]; e++) {
+      uint32_t through = sched->succs[e].latency + sched->height[sched->succs[e].to];
+      if (through > height) {
+        height = through;
+      }
+    }
+    sched->height[i] = height;
+  }
+}
+
+static void sched_issue_init(SchedIssue *issue, const Sched *sched) {
+  memset(issue, 0, sizeof(*issue));
+  issue->sched = sched;
+}
+
+static void sched_issue_advance(SchedIssue *issue) {
+  issue->cycle++;
+  issue->issued = 0;
+  memset(issue->used, 0, sizeof(issue->used));
+}
+
+static int32_t sched_issue_fits(const SchedIssue *issue, const uint32_t node) {
+  const Sched *sched = issue->sched;
+  const MirInst *inst = &sched->insts[node];
+  SchedUnit unit = sched_unit(inst);
+  if (issue->issued >= sched->model->issue_width || issue->used[unit] >= sched->model->units[unit]) {
+    return 0;
+  }
+  return unit != SCHED_UNIT_MUL || issue->div_busy <= issue->cycle;
+}
+
+static uint32_t sched_issue(SchedIssue *issue, const uint32_t node) {
+  Sched *sched = (Sched *) issue->sched;
+  const MirInst *inst = &sched->insts[node];
+  issue->issued++;
+  issue->used[sched_unit(inst)]++;
+  uint32_t latency = sched_latency(sched->model, inst);
+  if (sched_is_div(inst)) {
+    issue->div_busy = issue->cycle + latency;
+  }
+  for (uint32_t e = sched->succ_start[node]; e < sched->succ_start[node + 1]; e++) {
+    uint32_t ready = issue->cycle + sched->succs[e].latency;
+    if (ready > sched->earliest[sched->succs[e].to]) {
+      sched->earliest[sched->succs[e].to] = ready;
+    }
+  }
+  return issue->cycle + latency;
+}
+
+static uint32_t sched_simulate(Sched *sched, const uint32_t *order) {
+  SchedIssue issue;
+  sched_issue_init(&issue, sched);
+  memset(sched->earliest, 0, sched->count * sizeof(uint32_t));
+  uint32_t finish = 0;
+  for (uint32_t k = 0; k < sched->count; k++) {
+    uint32_t node = order ? order[k] : k;
+    while (issue.cycle < sched->earliest[node] || !sched_issue_fits(&issue, node)) {
+      sched_issue_advance(&issue);
+    }
+    uint32_t done = sched_issue(&issue, node);
+    if (done > finish) {
+      finish = done;
+    }
+  }
+  return finish;
+}
+
+static int32_t sched_better(const Sched *sched, const uint32_t a, const uint32_t b) {
+  if (sched->height[a] != sched->height[b]) {
+    return sched->height[a] > sched->height[b];
+  }
+  return a < b;
+}
+
+static void sched_list(Sched *sched) {
+  SchedIssue issue;
+  sched_issue_init(&issue, sched);
+  memset(sched->earliest, 0, sched->count * sizeof(uint32_t));
+  uint32_t ready_count = 0;
+  for (uint32_t i = 0; i < sched->count; i++) {
+    if (sched->pred_count[i] == 0) {
+      sched->ready[ready_count++] = i;
+    }
+  }
+  uint32_t scheduled = 0;
+  while (scheduled < sched->count) {
+    uint32_t pick = MIR_NONE;
+    for (uint32_t r = 0; r < ready_count; r++) {
+      uint32_t node = sched->ready[r];
+      if (sched->earliest[node] <= issue.cycle && sched_issue_fits(&issue, node) &&
+          (pick == MIR_NONE || sched_better(sched, node, sched->ready[pick]))) {
+        pick = r;
+      }
+    }
+    if (pick == MIR_NONE) {
+      sched_issue_advance(&issue);
+      continue;
+    }
+    uint32_t node = sched->ready[pick];
+    sched->ready[pick] = sched->ready[--ready_count];
+    sched->order[scheduled++] = node;
+    sched_issue(&issue, node);
+    for (uint32_t e = sched->succ_start[node]; e < sched->succ_start[node + 1]; e++) {
+      if (--sched->pred_count[sched->succs[e].to] == 0) {
+        sched->ready[ready_count++] = sched->succs[e].to;
+      }
+    }
+  }
+}
+
+static void sched_region(Sched *sched, MirInst *insts, const uint32_t count) {
+  sched->insts = insts;
+  sched->count = count;
+  if (count > sched->capacity) {
+    sched->capacity = count;
+    free(sched->succ_start);
+    free(sched->pred_count);
+    free(sched->height);
+    free(sched->earliest);
+    free(sched->base_def);
+    free(sched->order);
+    free(sched->ready);
+    free(sched->scratch);
+    sched->succ_start = sched_alloc(count + 1, sizeof(uint32_t));
+    sched->pred_count = sched_alloc(count, sizeof(uint32_t));
+    sched->height = sched_alloc(count, sizeof(uint32_t));
+    sched->earliest = sched_alloc(count, sizeof(uint32_t));
+    sched->base_def = sched_alloc(count, sizeof(uint32_t));
+    sched->order = sched_alloc(count, sizeof(uint32_t));
+    sched->ready = sched_alloc(count, sizeof(uint32_t));
+    sched->scratch = sched_alloc(count, sizeof(MirInst));
+  }
+  sched_build(sched);
+  stats_add("sched.regions", 1);
+  uint32_t before = sched_simulate(sched, NULL);
+  sched_list(sched);
+  uint32_t after = sched_simulate(sched, sched->order);
+  if (after >= before) {
+    return;
+  }
+  for (uint32_t k = 0; k < count; k++) {
+    sched->scratch[k] = insts[sched->order[k]];
+  }
+  memcpy(insts, sched->scratch, count * sizeof(MirInst));
+  stats_add("sched.reordered_regions", 1);
+  stats_add("sched.cycles_saved", (int64_t) (before - after));
+}
+
+void sched_function(MirFunction *fn, const MachineModel *model, const int32_t post_ra) {
+  Sched sched;
+  memset(&sched, 0, sizeof(sched));
+  sched.model = model;
+  sched.fn = fn;
+  sched.reg_count = post_ra ? RV_REG_COUNT : fn->vreg_count;
+  sched.last_def = sched_alloc(sched.reg_count, sizeof(uint32_t));
+  sched.use_head = sched_alloc(sched.reg_count, sizeof(uint32_t));
+  sched.touched = sched_alloc(sched.reg_count, sizeof(MirReg));
+  memset(sched.last_def, 0xff, sched.reg_count * sizeof(uint32_t));
+  memset(sched.use_head, 0xff, sched.reg_count * sizeof(uint32_t));
+  for (uint32_t b = 0; b < fn->block_count; b++) {
+    MirBlock *block = &fn->blocks[b];
+    uint32_t end = mir_block_terminator_start(fn, b);
+    uint32_t start = 0;
+    while (start < end) {
+      uint32_t stop = start;
+      while (stop < end && !(sched_inst_flags(&block->insts[stop]) & (RV_IF_CALL | RV_IF_VECTOR))) {
+        stop++;
+      }
+      if (stop - start > 1) {
+        sched_region(&sched, block->insts + start, stop - start);
+      }
+      start = stop + 1;
+    }
+  }
+  free(sched.last_def);
+  free(sched.use_head);
+  free(sched.touched);
+  free(sched.edges);
+  free(sched.succs);
+  free(sched.uses);
+  free(sched.succ_start);
+  free(sched.pred_count);
+  free(sched.height);
+  free(sched.earliest);
+  free(sched.base_def);
+  free(sched.order);
+  free(sched.ready);
+  free(sched.scratch);
+}
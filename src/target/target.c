@@ -0,0 +1,40 @@
+#include "target/target.h"
+#include <string.h>
+
+void target_init(TargetInfo *target) {
+  target->xlen = 32;
+  target->ext_m = 1;
+  target->ext_c = 0;
+  target->ext_v = 0;
+}
+
+int32_t target_parse_march(TargetInfo *target, const char *march) {
+  TargetInfo parsed;
+  if (strncmp(march, "rv32", 4) == 0) {
+    parsed.xlen = 32;
+  } else if (strncmp(march, "rv64", 4) == 0) {
+    parsed.xlen = 64;
+  } else {
+    return 0;
+  }
+  const char *ext = march + 4;
+  if (*ext != 'i') {
+    return 0;
+  }
+  parsed.ext_m = 0;
+  parsed.ext_c = 0;
+  parsed.ext_v = 0;
+  for (ext++; *ext; ext++) {
+    if (*ext == 'm' && !parsed.ext_m && !parsed.ext_c && !parsed.ext_v) {
+      parsed.ext_m = 1;
+    } else if (*ext == 'c' && !parsed.ext_c && !parsed.ext_v) {
+      parsed.ext_c = 1;
+    } else if (*ext == 'v' && !parsed.ext_v) {
+      parsed.ext_v = 1;
+    } else {
+      return 0;
+    }
+  }
+  *target = parsed;
+  return 1;
+}
@@ -0,0 +1,582 @@
+#include "target/vectorize.h"
+#include "utils/diagnostic.h"
+#include <stdlib.h>
+#include <string.h>
+
+typedef struct {
+  IrOp op;
+  RvOpcode reduce;
+} VecReduction;
+
+static const VecPattern vec_patterns[] = {
+#define ISEL_VECTOR(op, left, right, rv, action) \
+  {IR_OP_##op, VEC_LANE_##left, VEC_LANE_##right, RV_##rv, VEC_ACTION_##action},
+#include "target/isel.def"
+};
+
+static const VecReduction vec_reductions[] = {
+#define ISEL_REDUCTION(op, reduce) {IR_OP_##op, RV_##reduce},
+#include "target/isel.def"
+};
+
+static const char *const vec_status_names[] = {
+  "vectorize.loops",           "vectorize.rejected_shape",      "vectorize.rejected_induction",
+  "vectorize.rejected_stride", "vectorize.rejected_operation",  "vectorize.rejected_dependence",
+  "vectorize.rejected_registers"};
+
+typedef struct {
+  const IrFunction *fn;
+  const IrUses *uses;
+  VecLoop *loop;
+} VecAnalysis;
+
+typedef struct {
+  uint32_t position;
+  uint32_t width;
+  int32_t store;
+  int32_t resolved;
+  IrValueId object;
+  int32_t start;
+} VecAccess;
+
+const VecPattern *vec_pattern(const uint32_t index) {
+  return &vec_patterns[index];
+}
+
+RvOpcode vec_reduction(const uint32_t index) {
+  return vec_reductions[index].reduce;
+}
+
+const char *vec_status_name(const VecStatus status) {
+  return vec_status_names[status];
+}
+
+static int32_t vec_in_loop(const VecAnalysis *a, const IrValueId value) {
+  IrBlockId block = a->fn->insts[value].block;
+  return block == a->loop->header || block == a->loop->body;
+}
+
+static int32_t vec_is_phi(const VecAnalysis *a, const IrValueId value) {
+  return a->fn->insts[value].op == IR_OP_PHI && a->fn->insts[value].block == a->loop->header;
+}
+
+static int32_t vec_pow2(const int32_t value) {
+  return value > 0 && (value & (value - 1)) == 0;
+}
+
+static IrOp vec_invert(const IrOp op) {
+  switch (op) {
+    case IR_OP_EQ: return IR_OP_NE;
+    case IR_OP_NE: return IR_OP_EQ;
+    case IR_OP_LT: return IR_OP_GE;
+    case IR_OP_GE: return IR_OP_LT;
+    case IR_OP_LE: return IR_OP_GT;
+    case IR_OP_GT: return IR_OP_LE;
+    default: return op;
+  }
+}
+
+static IrOp vec_swap(const IrOp op) {
+  switch (op) {
+    case IR_OP_LT: return IR_OP_GT;
+    case IR_OP_GT: return IR_OP_LT;
+    case IR_OP_LE: return IR_OP_GE;
+    case IR_OP_GE: return IR_OP_LE;
+    default: return op;
+  }
+}
+
+static VecStatus vec_shape(VecAnalysis *a, const IrLoopInfo *loops, const uint32_t index) {
+  const IrFunction *fn = a->fn;
+  VecLoop *loop = a->loop;
+  const IrLoop *info = &loops->loops[index];
+  if (info->block_count != 2) {
+    return VEC_REJECTED_SHAPE;
+  }
+  loop->header = info->header;
+  loop->body = loops->blocks[info->block_start + 1];
+  const IrIdVector *preds = &fn->blocks[loop->header].preds;
+  if (preds->count != 2 || fn->blocks[loop->body].preds.count != 1) {
+    return VEC_REJECTED_SHAPE;
+  }
+  loop->preheader = preds->items[0] == loop->body ? preds->items[1] : preds->items[0];
+  const IrInst *jump = &fn->insts[ir_block_terminator(fn, loop->body)];
+  const IrInst *branch = &fn->insts[ir_block_terminator(fn, loop->header)];
+  if (jump->op != IR_OP_JUMP || jump->ops[0] != loop->header || branch->op != IR_OP_BRANCH) {
+    return VEC_REJECTED_SHAPE;
+  }
+  IrValueId cond = branch->ops[0];
+  const IrInst *compare = &fn->insts[cond];
+  if (!(ir_op_flags((IrOp) compare->op) & IR_OPF_COMPARE) || compare->block != loop->header ||
+      a->uses->start[cond + 1] - a->uses->start[cond] != 1) {
+    return VEC_REJECTED_SHAPE;
+  }
+  const IrIdVector *insts = &fn->blocks[loop->header].insts;
+  for (uint32_t i = 0; i < insts->count; i++) {
+    uint8_t op = fn->insts[insts->items[i]].op;
+    if (op != IR_OP_PHI && op != IR_OP_NOP && op != IR_OP_CONST && insts->items[i] != cond &&
+        op != IR_OP_BRANCH) {
+      return VEC_REJECTED_SHAPE;
+    }
+  }
+  IrOp op = (IrOp) compare->op;
+  if (branch->ops[1] == loop->body && branch->ops[2] != loop->body) {
+    loop->exit = branch->ops[2];
+  } else if (branch->ops[2] == loop->body && branch->ops[1] != loop->body) {
+    loop->exit = branch->ops[1];
+    op = vec_invert(op);
+  } else {
+    return VEC_REJECTED_SHAPE;
+  }
+  if (vec_is_phi(a, compare->ops[0])) {
+    loop->control = compare->ops[0];
+    loop->bound = compare->ops[1];
+  } else if (vec_is_phi(a, compare->ops[1])) {
+    loop->control = compare->ops[1];
+    loop->bound = compare->ops[0];
+    op = vec_swap(op);
+  } else {
+    return VEC_REJECTED_SHAPE;
+  }
+  if ((op != IR_OP_LT && op != IR_OP_LE && op != IR_OP_NE) || vec_in_loop(a, loop->bound)) {
+    return VEC_REJECTED_SHAPE;
+  }
+  loop->compare = op;
+  return VEC_OK;
+}
+
+static int32_t vec_find_reduction(const IrOp op) {
+  for (size_t r = 0; r < sizeof(vec_reductions) / sizeof(vec_reductions[0]); r++) {
+    if (vec_reductions[r].op == op) {
+      return (int32_t) r;
+    }
+  }
+  return -1;
+}
+
+static IrValueId vec_single_user(const VecAnalysis *a, const IrValueId value) {
+  IrValueId found = IR_NONE;
+  for (uint32_t u = a->uses->start[value]; u < a->uses->start[value + 1]; u++) {
+    IrValueId user = a->uses->users[u];
+    if (!vec_in_loop(a, user)) {
+      continue;
+    }
+    if (found != IR_NONE) {
+      return IR_NONE;
+    }
+    found = user;
+  }
+  return found;
+}
+
+static VecStatus vec_chain(VecAnalysis *a, const IrValueId phi, const IrValueId update, const int32_t reduction) {
+  const IrFunction *fn = a->fn;
+  IrValueId prev = phi;
+  IrValueId cur = vec_single_user(a, phi);
+  while (cur != IR_NONE) {
+    const IrInst *inst = &fn->insts[cur];
+    if (inst->op != vec_reductions[reduction].op || inst->type != IR_TYPE_I32 || inst->block != a->loop->body ||
+        inst->ops[0] == inst->ops[1]) {
+      return VEC_REJECTED_INDUCTION;
+    }
+    VecValue *info = &a->loop->values[cur];
+    info->kind = VEC_ACCUMULATE;
+    info->base = phi;
+    info->offset = inst->ops[0] == prev ? 0 : 1;
+    info->pattern = (uint16_t) reduction;
+    if (cur == update) {
+      return VEC_OK;
+    }
+    prev = cur;
+    cur = vec_single_user(a, cur);
+  }
+  return VEC_REJECTED_INDUCTION;
+}
+
+static VecStatus vec_phis(VecAnalysis *a) {
+  const IrFunction *fn = a->fn;
+  VecLoop *loop = a->loop;
+  const IrIdVector *insts = &fn->blocks[loop->header].insts;
+  for (uint32_t i = 0; i < insts->count; i++) {
+    IrValueId phi = insts->items[i];
+    if (fn->insts[phi].op != IR_OP_PHI) {
+      continue;
+    }
+    IrValueId update = ir_phi_incoming_for(fn, phi, loop->body);
+    const IrInst *inst = &fn->insts[update];
+    if (inst->block != loop->body || a->uses->start[update + 1] - a->uses->start[update] != 1) {
+      return VEC_REJECTED_INDUCTION;
+    }
+    uint32_t self = inst->ops[0] == phi ? 0 : 1;
+    int32_t step;
+    int32_t reduction = vec_find_reduction((IrOp) inst->op);
+    if (inst->op == IR_OP_ADD && inst->ops[self] == phi && ir_value_const(fn, inst->ops[1 - self], &step) &&
+        vec_pow2(step)) {
+      loop->values[phi].kind = VEC_INDUCTION;
+      loop->values[phi].base = update;
+      loop->values[phi].offset = step;
+      loop->values[update].kind = VEC_INDUCTION;
+      loop->values[update].base = phi;
+      continue;
+    }
+    if (reduction < 0 || vec_chain(a, phi, update, reduction) != VEC_OK) {
+      return VEC_REJECTED_INDUCTION;
+    }
+    loop->values[phi].kind = VEC_REDUCTION;
+    loop->values[phi].base = update;
+  }
+  const VecValue *control = &loop->values[loop->control];
+  if (control->kind != VEC_INDUCTION) {
+    return VEC_REJECTED_INDUCTION;
+  }
+  if (loop->compare == IR_OP_NE && fn->insts[loop->control].type != IR_TYPE_PTR && control->offset != 1) {
+    return VEC_REJECTED_INDUCTION;
+  }
+  return VEC_OK;
+}
+
+static VecStatus vec_lane(const VecAnalysis *a, const IrValueId value, VecLane *lane) {
+  const IrInst *inst = &a->fn->insts[value];
+  const VecValue *info = &a->loop->values[value];
+  if (inst->type == IR_TYPE_PTR) {
+    return VEC_REJECTED_OPERATION;
+  }
+  if (!vec_in_loop(a, value) || info->kind == VEC_UNIFORM) {
+    *lane = VEC_LANE_UNI;
+    return VEC_OK;
+  }
+  if (info->kind == VEC_VECTOR) {
+    *lane = VEC_LANE_VEC;
+    return VEC_OK;
+  }
+  if (info->kind == VEC_INDUCTION && vec_is_phi(a, value)) {
+    *lane = VEC_LANE_VEC;
+    return info->offset == 1 ? VEC_OK : VEC_REJECTED_STRIDE;
+  }
+  return VEC_REJECTED_OPERATION;
+}
+
+static VecStatus vec_address(const VecAnalysis *a, const IrValueId value, IrValueId *base, int32_t *offset) {
+  const VecValue *info = &a->loop->values[value];
+  if (a->fn->insts[value].type != IR_TYPE_PTR || !vec_in_loop(a, value)) {
+    return VEC_REJECTED_OPERATION;
+  }
+  if (info->kind == VEC_INDUCTION && vec_is_phi(a, value)) {
+    *base = value;
+    *offset = 0;
+    return VEC_OK;
+  }
+  if (info->kind == VEC_ADDRESS) {
+    *base = info->base;
+    *offset = info->offset;
+    return VEC_OK;
+  }
+  return VEC_REJECTED_OPERATION;
+}
+
+static VecStatus vec_access(VecAnalysis *a, const IrValueId value) {
+  const IrInst *inst = &a->fn->insts[value];
+  VecValue *info = &a->loop->values[value];
+  if (inst->width != 1 && inst->width != 4) {
+    return VEC_REJECTED_OPERATION;
+  }
+  VecStatus status = vec_address(a, inst->ops[0], &info->base, &info->offset);
+  if (status != VEC_OK) {
+    return status;
+  }
+  if (a->loop->values[info->base].offset != inst->width) {
+    return VEC_REJECTED_STRIDE;
+  }
+  info->offset += inst->imm;
+  return VEC_OK;
+}
+
+static VecStatus vec_operation(VecAnalysis *a, const IrValueId value) {
+  const IrInst *inst = &a->fn->insts[value];
+  VecValue *info = &a->loop->values[value];
+  uint32_t flags = ir_op_flags((IrOp) inst->op);
+  if (inst->type != IR_TYPE_I32 || !(flags & IR_OPF_PURE) || !(flags & (IR_OPF_BINARY | IR_OPF_UNARY))) {
+    return VEC_REJECTED_OPERATION;
+  }
+  VecLane lanes[2] = {VEC_LANE_NONE, VEC_LANE_NONE};
+  for (uint32_t o = 0; o < ((flags & IR_OPF_BINARY) ? 2u : 1u); o++) {
+    VecStatus status = vec_lane(a, inst->ops[o], &lanes[o]);
+    if (status != VEC_OK) {
+      return status;
+    }
+  }
+  int32_t uniform = lanes[0] == VEC_LANE_UNI && (lanes[1] == VEC_LANE_UNI || lanes[1] == VEC_LANE_NONE);
+  uint32_t orders = (flags & IR_OPF_COMMUTATIVE) ? 2 : 1;
+  for (size_t p = 0; p < sizeof(vec_patterns) / sizeof(vec_patterns[0]); p++) {
+    const VecPattern *pattern = &vec_patterns[p];
+    if (pattern->op != inst->op) {
+      continue;
+    }
+    if (uniform) {
+      info->kind = VEC_UNIFORM;
+      return VEC_OK;
+    }
+    for (uint32_t order = 0; order < orders; order++) {
+      if (pattern->left == lanes[order] && pattern->right == lanes[1 - order]) {
+        info->kind = VEC_VECTOR;
+        info->pattern = (uint16_t) p;
+        info->swapped = (uint8_t) order;
+        return VEC_OK;
+      }
+    }
+  }
+  return VEC_REJECTED_OPERATION;
+}
+
+static VecStatus vec_body(VecAnalysis *a) {
+  const IrFunction *fn = a->fn;
+  VecLoop *loop = a->loop;
+  const IrIdVector *insts = &fn->blocks[loop->body].insts;
+  for (uint32_t i = 0; i < insts->count; i++) {
+    IrValueId id = insts->items[i];
+    const IrInst *inst = &fn->insts[id];
+    VecValue *info = &loop->values[id];
+    VecStatus status = VEC_OK;
+    for (uint32_t u = a->uses->start[id]; u < a->uses->start[id + 1]; u++) {
+      if (!vec_in_loop(a, a->uses->users[u])) {
+        return VEC_REJECTED_SHAPE;
+      }
+    }
+    if (info->kind == VEC_INDUCTION) {
+      continue;
+    }
+    if (info->kind == VEC_ACCUMULATE) {
+      VecLane lane;
+      status = vec_lane(a, inst->ops[1 - info->offset], &lane);
+      if (status == VEC_OK && lane != VEC_LANE_VEC) {
+        status = VEC_REJECTED_OPERATION;
+      }
+    } else if (inst->op == IR_OP_NOP || inst->op == IR_OP_JUMP || inst->op == IR_OP_CONST) {
+      info->kind = VEC_UNIFORM;
+    } else if (inst->op == IR_OP_ADD && inst->type == IR_TYPE_PTR) {
+      uint32_t ptr = fn->insts[inst->ops[0]].type == IR_TYPE_PTR ? 0 : 1;
+      int32_t step = 0;
+      status = vec_address(a, inst->ops[ptr], &info->base, &info->offset);
+      if (status == VEC_OK && !ir_value_const(fn, inst->ops[1 - ptr], &step)) {
+        status = VEC_REJECTED_OPERATION;
+      }
+      info->kind = VEC_ADDRESS;
+      info->offset += step;
+    } else if (inst->op == IR_OP_LOAD) {
+      info->kind = VEC_VECTOR;
+      status = vec_access(a, id);
+    } else if (inst->op == IR_OP_STORE) {
+      VecLane lane;
+      info->kind = VEC_STORE;
+      status = vec_lane(a, inst->ops[1], &lane);
+      if (status == VEC_OK) {
+        status = vec_access(a, id);
+      }
+    } else {
+      status = vec_operation(a, id);
+    }
+    if (status != VEC_OK) {
+      return status;
+    }
+  }
+  return VEC_OK;
+}
+
+static void vec_mark(VecAnalysis *a, const IrValueId value) {
+  if (vec_in_loop(a, value)) {
+    a->loop->values[value].live = 1;
+  }
+}
+
+static void vec_liveness(VecAnalysis *a) {
+  const IrFunction *fn = a->fn;
+  VecLoop *loop = a->loop;
+  const IrIdVector *insts = &fn->blocks[loop->body].insts;
+  for (uint32_t i = insts->count; i-- > 0;) {
+    IrValueId id = insts->items[i];
+    const IrInst *inst = &fn->insts[id];
+    VecValue *info = &loop->values[id];
+    if (info->kind == VEC_STORE) {
+      info->live = 1;
+      vec_mark(a, inst->ops[1]);
+    } else if (info->kind == VEC_ACCUMULATE) {
+      info->live = 1;
+      vec_mark(a, inst->ops[1 - info->offset]);
+    } else if (info->kind == VEC_VECTOR && info->live && inst->op != IR_OP_LOAD) {
+      uint32_t count = (ir_op_flags((IrOp) inst->op) & IR_OPF_BINARY) ? 2 : 1;
+      for (uint32_t o = 0; o < count; o++) {
+        vec_mark(a, inst->ops[o]);
+      }
+    }
+  }
+}
+
+static void vec_resolve(const VecAnalysis *a, const IrValueId access, VecAccess *out) {
+  const IrFunction *fn = a->fn;
+  const VecValue *info = &a->loop->values[access];
+  IrValueId init = ir_phi_incoming_for(fn, info->base, a->loop->preheader);
+  int32_t start;
+  out->width = fn->insts[access].width;
+  out->store = fn->insts[access].op == IR_OP_STORE;
+  out->object = ir_address_base(fn, init);
+  out->resolved = out->object != IR_NONE && ir_address_constant_offset(fn, init, &start);
+  if (!out->resolved) {
+    out->object = init;
+    start = 0;
+  }
+  out->start = start + info->offset;
+}
+
+static VecStatus vec_dependence(VecAnalysis *a) {
+  const IrFunction *fn = a->fn;
+  const IrIdVector *insts = &fn->blocks[a->loop->body].insts;
+  VecAccess *accesses = calloc(insts->count ? insts->count : 1, sizeof(VecAccess));
+  if (!accesses) {
+    LOG(FATAL, "out of memory");
+  }
+  uint32_t count = 0;
+  for (uint32_t i = 0; i < insts->count; i++) {
+    IrValueId id = insts->items[i];
+    uint8_t op = fn->insts[id].op;
+    if ((op == IR_OP_LOAD && a->loop->values[id].live) || op == IR_OP_STORE) {
+      vec_resolve(a, id, &accesses[count]);
+      accesses[count++].position = i;
+    }
+  }
+  VecStatus status = VEC_OK;
+  for (uint32_t i = 0; i < count && status == VEC_OK; i++) {
+    for (uint32_t j = i + 1; j < count && status == VEC_OK; j++) {
+      const VecAccess *first = &accesses[i];
+      const VecAccess *second = &accesses[j];
+      if (!first->store && !second->store) {
+        continue;
+      }
+      if (first->object != second->object) {
+        if (!first->resolved || !second->resolved) {
+          status = VEC_REJECTED_DEPENDENCE;
+        }
+        continue;
+      }
+      if (first->width != second->width || first->resolved != second->resolved) {
+        status = VEC_REJECTED_DEPENDENCE;
+      } else if (first->start != second->start &&
+                 (first->store || !second->store || first->start < second->start)) {
+        status = VEC_REJECTED_DEPENDENCE;
+      }
+    }
+  }
+  free(accesses);
+  return status;
+}
+
+static int32_t vec_has_reg(const VecAnalysis *a, const IrValueId value) {
+  const VecValue *info = &a->loop->values[value];
+  return vec_in_loop(a, value) && info->live && (info->kind == VEC_VECTOR || info->kind == VEC_INDUCTION);
+}
+
+static uint32_t vec_operands(const VecAnalysis *a, const IrValueId value, IrValueId out[2]) {
+  const IrInst *inst = &a->fn->insts[value];
+  const VecValue *info = &a->loop->values[value];
+  uint32_t count = 0;
+  if (info->kind == VEC_STORE) {
+    out[count++] = inst->ops[1];
+  } else if (info->kind == VEC_ACCUMULATE) {
+    out[count++] = inst->ops[1 - info->offset];
+  } else if (info->kind == VEC_VECTOR && info->live && inst->op != IR_OP_LOAD) {
+    out[count++] = inst->ops[0];
+    if (ir_op_flags((IrOp) inst->op) & IR_OPF_BINARY) {
+      out[count++] = inst->ops[1];
+    }
+  }
+  return count;
+}
+
+static VecStatus vec_take_reg(VecLoop *loop, const IrValueId value, uint32_t *free_regs, uint32_t *live) {
+  for (int32_t reg = VEC_FIRST_REG; reg <= VEC_LAST_REG; reg++) {
+    if (*free_regs & (1u << reg)) {
+      *free_regs &= ~(1u << reg);
+      loop->values[value].reg = (uint8_t) reg;
+      if (++*live > loop->registers) {
+        loop->registers = *live;
+      }
+      return VEC_OK;
+    }
+  }
+  return VEC_REJECTED_REGISTERS;
+}
+
+static VecStatus vec_registers(VecAnalysis *a) {
+  const IrFunction *fn = a->fn;
+  VecLoop *loop = a->loop;
+  const IrIdVector *header = &fn->blocks[loop->header].insts;
+  const IrIdVector *insts = &fn->blocks[loop->body].insts;
+  uint32_t *last = calloc(fn->inst_count, sizeof(uint32_t));
+  if (!last) {
+    LOG(FATAL, "out of memory");
+  }
+  for (uint32_t i = 0; i < insts->count; i++) {
+    IrValueId operands[2];
+    uint32_t count = vec_operands(a, insts->items[i], operands);
+    for (uint32_t o = 0; o < count; o++) {
+      last[operands[o]] = i + 1;
+    }
+  }
+  uint32_t free_regs = 0;
+  for (int32_t reg = VEC_FIRST_REG; reg <= VEC_LAST_REG; reg++) {
+    free_regs |= 1u << reg;
+  }
+  VecStatus status = VEC_OK;
+  uint32_t live = 0;
+  for (uint32_t i = 0; i < header->count && status == VEC_OK; i++) {
+    if (vec_has_reg(a, header->items[i])) {
+      status = vec_take_reg(loop, header->items[i], &free_regs, &live);
+    }
+  }
+  for (uint32_t i = 0; i < insts->count && status == VEC_OK; i++) {
+    IrValueId id = insts->items[i];
+    IrValueId operands[2];
+    uint32_t count = vec_operands(a, id, operands);
+    for (uint32_t o = 0; o < count; o++) {
+      if (vec_has_reg(a, operands[o]) && last[operands[o]] == i + 1) {
+        free_regs |= 1u << loop->values[operands[o]].reg;
+        last[operands[o]] = 0;
+        live--;
+      }
+    }
+    if (vec_has_reg(a, id)) {
+      status = vec_take_reg(loop, id, &free_regs, &live);
+    }
+  }
+  free(last);
+  return status;
+}
+
+VecStatus vec_analyze_loop(VecLoop *out, const IrFunction *fn, const IrUses *uses, const IrLoopInfo *loops,
+                           const uint32_t loop) {
+  memset(out, 0, sizeof(*out));
+  out->values = calloc(fn->inst_count ? fn->inst_count : 1, sizeof(VecValue));
+  if (!out->values) {
+    LOG(FATAL, "out of memory");
+  }
+  VecAnalysis analysis = {fn, uses, out};
+  VecStatus status = vec_shape(&analysis, loops, loop);
+  if (status == VEC_OK) {
+    status = vec_phis(&analysis);
+  }
+  if (status == VEC_OK) {
+    status = vec_body(&analysis);
+  }
+  if (status == VEC_OK) {
+    vec_liveness(&analysis);
+    status = vec_dependence(&analysis);
+  }
+  if (status == VEC_OK) {
+    status = vec_registers(&analysis);
+  }
+  return status;
+}
+
+void vec_loop_destroy(VecLoop *loop) {
+  free(loop->values);
+  loop->values = NULL;
+}
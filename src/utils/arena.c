@@ -0,0 +1,78 @@
+#include "utils/arena.h"
+#include "utils/diagnostic.h"
+#include <stdlib.h>
+#include <string.h>
+
+#define ARENA_CHUNK_SIZE (64 * 1024)
+#define ARENA_ALIGN 16
+
+struct ArenaChunk {
+  ArenaChunk *next;
+  size_t used;
+  size_t capacity;
+  _Alignas(ARENA_ALIGN) unsigned char data[];
+};
+
+static ArenaChunk *arena_new_chunk(const size_t min_size) {
+  size_t capacity = min_size > ARENA_CHUNK_SIZE ? min_size : ARENA_CHUNK_SIZE;
+  ArenaChunk *chunk = malloc(sizeof(ArenaChunk) + capacity);
+  if (!chunk) {
+    LOG(FATAL, "out of memory");
+  }
+  chunk->next = NULL;
+  chunk->used = 0;
+  chunk->capacity = capacity;
+  return chunk;
+}
+
+void arena_init(Arena *arena) {
+  arena->head = NULL;
+  arena->total_allocated = 0;
+}
+
+void *arena_alloc(Arena *arena, const size_t size) {
+  size_t aligned = (size + ARENA_ALIGN - 1) & ~(size_t) (ARENA_ALIGN - 1);
+  if (aligned == 0) {
+    aligned = ARENA_ALIGN;
+  }
+  ArenaChunk *chunk = arena->head;
+  if (!chunk || chunk->capacity - chunk->used < aligned) {
+    chunk = arena_new_chunk(aligned);
+    chunk->next = arena->head;
+    arena->head = chunk;
+    arena->total_allocated += chunk->capacity;
+  }
+  void *ptr = chunk->data + chunk->used;
+  chunk->used += aligned;
+  memset(ptr, 0, aligned);
+  return ptr;
+}
+
+void *arena_grow(Arena *arena, void *ptr, const size_t old_size, const size_t new_size) {
+  if (new_size <= old_size) {
+    return ptr;
+  }
+  void *result = arena_alloc(arena, new_size);
+  if (ptr && old_size) {
+    memcpy(result, ptr, old_size);
+  }
+  return result;
+}
+
+char *arena_strndup(Arena *arena, const char *str, const size_t length) {
+  char *copy = arena_alloc(arena, length + 1);
+  memcpy(copy, str, length);
+  copy[length] = '\0';
+  return copy;
+}
+
+void arena_destroy(Arena *arena) {
+  ArenaChunk *chunk = arena->head;
+  while (chunk) {
+    ArenaChunk *next = chunk->next;
+    free(chunk);
+    chunk = next;
+  }
+  arena->head = NULL;
+  arena->total_allocated = 0;
+}
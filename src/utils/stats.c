@@ -0,0 +1,55 @@
+#include "utils/stats.h"
+#include "utils/diagnostic.h"
+#include <string.h>
+
+#define STATS_MAX_COUNTERS 128
+
+typedef struct {
+  const char *name;
+  uint64_t value;
+} StatCounter;
+
+struct {
+  StatCounter counters[STATS_MAX_COUNTERS];
+  uint32_t count;
+} stats_state = {{{NULL, 0}}, 0};
+
+static StatCounter *stats_find(const char *name) {
+  for (uint32_t i = 0; i < stats_state.count; i++) {
+    if (strcmp(stats_state.counters[i].name, name) == 0) {
+      return &stats_state.counters[i];
+    }
+  }
+  return NULL;
+}
+
+void stats_add(const char *name, const uint64_t amount) {
+  StatCounter *counter = stats_find(name);
+  if (!counter) {
+    if (stats_state.count == STATS_MAX_COUNTERS) {
+      LOG(FATAL, "too many statistics counters");
+      return;
+    }
+    counter = &stats_state.counters[stats_state.count++];
+    counter->name = name;
+    counter->value = 0;
+  }
+  counter->value += amount;
+}
+
+uint64_t stats_get(const char *name) {
+  const StatCounter *counter = stats_find(name);
+  return counter ? counter->value : 0;
+}
+
+void stats_reset(void) {
+  stats_state.count = 0;
+}
+
+void stats_print(FILE *out) {
+  fprintf(out, "statistics:\n");
+  for (uint32_t i = 0; i < stats_state.count; i++) {
+    fprintf(out, "  %-36s %llu\n", stats_state.counters[i].name,
+            (unsigned long long) stats_state.counters[i].value);
+  }
+}
@@ -0,0 +1,72 @@
+#include "utils/timing.h"
+#include "utils/diagnostic.h"
+#include <string.h>
+#include <time.h>
+
+#define TIMING_MAX_ENTRIES 128
+
+typedef struct {
+  const char *name;
+  double seconds;
+  uint32_t runs;
+} TimingEntry;
+
+struct {
+  TimingEntry entries[TIMING_MAX_ENTRIES];
+  uint32_t count;
+} timing_state = {{{NULL, 0.0, 0}}, 0};
+
+static TimingEntry *timing_find(const char *name) {
+  for (uint32_t i = 0; i < timing_state.count; i++) {
+    if (strcmp(timing_state.entries[i].name, name) == 0) {
+      return &timing_state.entries[i];
+    }
+  }
+  return NULL;
+}
+
+double timing_now(void) {
+  struct timespec ts;
+  timespec_get(&ts, TIME_UTC);
+  return (double) ts.tv_sec + (double) ts.tv_nsec * 1e-9;
+}
+
+void timing_add(const char *name, const double seconds) {
+  TimingEntry *entry = timing_find(name);
+  if (!entry) {
+    if (timing_state.count == TIMING_MAX_ENTRIES) {
+      LOG(FATAL, "too many timing entries");
+      return;
+    }
+    entry = &timing_state.entries[timing_state.count++];
+    entry->name = name;
+    entry->seconds = 0.0;
+    entry->runs = 0;
+  }
+  entry->seconds += seconds;
+  entry->runs++;
+}
+
+double timing_get(const char *name) {
+  const TimingEntry *entry = timing_find(name);
+  return entry ? entry->seconds : 0.0;
+}
+
+void timing_reset(void) {
+  timing_state.count = 0;
+}
+
+void timing_print(FILE *out) {
+  double total = 0.0;
+  for (uint32_t i = 0; i < timing_state.count; i++) {
+    total += timing_state.entries[i].seconds;
+  }
+  fprintf(out, "time report:\n");
+  fprintf(out, "  %-28s %6s %12s %7s\n", "name", "runs", "seconds", "share");
+  for (uint32_t i = 0; i < timing_state.count; i++) {
+    const TimingEntry *entry = &timing_state.entries[i];
+    fprintf(out, "  %-28s %6u %12.6f %6.1f%%\n", entry->name, entry->runs, entry->seconds,
+            total > 0.0 ? 100.0 * entry->seconds / total : 0.0);
+  }
+  fprintf(out, "  %-28s %6s %12.6f %6.1f%%\n", "total", "", total, 100.0);
+}
@@ -0,0 +1,13 @@
+char wrap(char c) {
+    return c + 1;
+}
+
+int main() {
+    char c = 300;
+    char buf[3] = {'a'};
+    buf[1] = 257;
+    if (buf[2] != 0) {
+        return 1;
+    }
+    return wrap(c - 1) + buf[1] - 1;
+}
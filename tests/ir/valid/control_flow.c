@@ -0,0 +1,20 @@
+int main() {
+    int i = 0;
+    int acc = 0;
+    while (1) {
+        if (i >= 10) {
+            break;
+        }
+        if (i % 2 == 0) {
+            acc = acc + i;
+        } else {
+            int j = i;
+            while (j > 0) {
+                acc = acc + 1;
+                j = j - 2;
+            }
+        }
+        i = i + 1;
+    }
+    return acc + i + (7 / 2) + (-7 % 3);
+}
@@ -0,0 +1,65 @@
+int sum(int n) {
+    int arr[8] = {1, 2, 3, 4, 5, 6, 7, 8};
+    int i = 0;
+    int total = 0;
+    while (i < n) {
+        total = total + arr[i];
+        i = i + 1;
+    }
+    return total;
+}
+
+int neighbours(int n) {
+    int arr[6] = {1, 4, 9, 16, 25, 36};
+    int out[6];
+    int i = 0;
+    while (i < n - 1) {
+        out[i] = arr[i + 1] - arr[i];
+        i = i + 1;
+    }
+    int j = n - 2;
+    int acc = 0;
+    while (j >= 0) {
+        acc = acc * 3 + out[j];
+        j = j - 1;
+    }
+    return acc;
+}
+
+int bytes(int n) {
+    char text[5] = {'a', 'b', 'c', 'd', 'e'};
+    int i = 0;
+    int acc = 0;
+    while (i <= n) {
+        acc = acc + text[i] - 'a';
+        i = i + 2;
+    }
+    return acc;
+}
+
+int first_zero(int n) {
+    int arr[5] = {3, 1, 0, 2, 0};
+    int i = 0;
+    while (i < n) {
+        if (arr[i] == 0) {
+            break;
+        }
+        i = i + 1;
+    }
+    return i;
+}
+
+int counter_used_after(int n) {
+    int arr[4] = {5, 6, 7, 8};
+    int i = 0;
+    int acc = 0;
+    while (i < n) {
+        acc = acc + arr[i];
+        i = i + 1;
+    }
+    return acc + i;
+}
+
+int main() {
+    return sum(8) + neighbours(6) + bytes(4) + first_zero(5) + counter_used_after(3);
+}
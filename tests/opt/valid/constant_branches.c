@@ -0,0 +1,37 @@
+int divide(int a, int b) {
+    return a / b;
+}
+
+int main() {
+    int limit = 4;
+    int mask = (limit * 8) & 63;
+    int acc = 0;
+    int i = 0;
+    while (i < limit) {
+        if (mask == 32) {
+            acc = acc + 2;
+        } else {
+            acc = acc - 100;
+        }
+        i = i + 1;
+    }
+    int same = 5;
+    if (acc > 0) {
+        same = 5;
+    }
+    int min = -2147483647 - 1;
+    if (min / -1 != min) {
+        return 1;
+    }
+    if (min % -1 != 0) {
+        return 2;
+    }
+    int zero = 0;
+    if (7 / zero != -1) {
+        return 3;
+    }
+    if (divide(7, zero) != -1) {
+        return 4;
+    }
+    return acc + same + (6 | 3) % 4;
+}
@@ -0,0 +1,34 @@
+int unused_work(int n) {
+    int t;
+    int wasted = n * 7;
+    int buf[4];
+    buf[0] = 1;
+    buf[0] = n;
+    buf[1] = wasted;
+    return n + 1;
+    wasted = wasted + 1;
+    return wasted;
+}
+
+int first_even(int n) {
+    int i = 1;
+    while (i < n) {
+        if (i % 2 == 0) {
+            break;
+            i = i + 100;
+        }
+        i = i + 1;
+    }
+    return i;
+}
+
+int main() {
+    int scratch[3];
+    scratch[2] = 5;
+    scratch[2] = 9;
+    int flag = 0;
+    if (flag) {
+        return 100;
+    }
+    return unused_work(3) + first_even(7) + scratch[2];
+}
@@ -0,0 +1,23 @@
+int bucket(int h) {
+    return (h & 1023) % 7;
+}
+
+int ring_next(int pos) {
+    return (pos + 1) % 16;
+}
+
+int mixed(int x) {
+    return x / 3 + x % 5 + x / -8 + x % -4 + x / 10;
+}
+
+int main() {
+    int i = -40;
+    int acc = 0;
+    int pos = 0;
+    while (i < 40) {
+        acc = acc + mixed(i * 37) + bucket(i * 131);
+        pos = ring_next(pos + i);
+        i = i + 1;
+    }
+    return acc + pos;
+}
@@ -0,0 +1,53 @@
+int add(int x, int y) {
+    return x + y;
+}
+
+int clamp(int v, int lo, int hi) {
+    if (v < lo) {
+        return lo;
+    }
+    if (v > hi) {
+        return hi;
+    }
+    return v;
+}
+
+char low_byte(int v) {
+    return v;
+}
+
+int lookup(int i) {
+    int table[4] = {7, 11, 13, 17};
+    return table[clamp(i, 0, 3)];
+}
+
+int fact(int n) {
+    if (n <= 1) {
+        return 1;
+    }
+    return n * fact(n - 1);
+}
+
+int pong(int n) {
+    if (n <= 0) {
+        return 0;
+    }
+    return 1 + ping(n - 1);
+}
+
+int ping(int n) {
+    if (n <= 0) {
+        return 0;
+    }
+    return 2 + pong(n - 1);
+}
+
+int main() {
+    int i = 0;
+    int acc = 0;
+    while (i < 6) {
+        acc = add(acc, lookup(i - 1));
+        i = i + 1;
+    }
+    return acc + low_byte(300) + fact(5) + ping(5) + clamp(add(2, 3), 0, 4);
+}
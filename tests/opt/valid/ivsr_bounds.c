@@ -0,0 +1,25 @@
+int wrapped(int n) {
+    int a[4] = {1, 2, 3, 4};
+    int s = 0;
+    int i = 1;
+    while (i < n) {
+        s = s + a[i];
+        i = i + 1;
+    }
+    return s;
+}
+
+int fixed(int seed) {
+    int a[8] = {3, 1, 4, 1, 5, 9, 2, 6};
+    int s = seed;
+    int i = 0;
+    while (i < 8) {
+        s = s * 3 + a[i];
+        i = i + 1;
+    }
+    return s;
+}
+
+int main() {
+    return wrapped(-1073741822) + wrapped(3) * 100 + fixed(2) % 1000;
+}
@@ -0,0 +1,15 @@
+int scan(int n, int s) {
+    int x0[8] = {1, 2, 3, 4, 5, 6, 7, 8};
+    int x1[8] = {8, 7, 6, 5, 4, 3, 2, 1};
+    int acc = 1;
+    int i = 0;
+    while (i < n) {
+        acc = acc & ((s > -48) & (x1[i] >= x0[i]));
+        i = i + 1;
+    }
+    return n + s;
+}
+
+int main() {
+    return scan(8, 5) + scan(3, -50) * 10;
+}
@@ -0,0 +1,43 @@
+int scale(int n, int k) {
+    int table[4] = {3, 5, 7, 9};
+    int i = 0;
+    int acc = 0;
+    while (i < n) {
+        int j = 0;
+        while (j < n) {
+            acc = acc + table[2] * k + (n * 4 - 1) + j;
+            j = j + 1;
+        }
+        i = i + 1;
+    }
+    return acc;
+}
+
+int refresh(int n) {
+    int cell[2] = {1, 2};
+    int i = 0;
+    int acc = 0;
+    while (i < n) {
+        acc = acc + cell[0];
+        cell[0] = cell[0] + 1;
+        acc = acc + cell[1];
+        i = i + 1;
+    }
+    return acc;
+}
+
+int guarded(int n, int d) {
+    int i = 0;
+    int acc = 0;
+    while (i < n) {
+        if (d != 0) {
+            acc = acc + 100 / d;
+        }
+        i = i + 1;
+    }
+    return acc;
+}
+
+int main() {
+    return scale(3, 2) + refresh(4) + guarded(3, 0) + guarded(2, 5);
+}
@@ -0,0 +1,58 @@
+int fib(int n) {
+    if (n < 2) {
+        return n;
+    }
+    return fib(n - 1) + fib(n - 2);
+}
+
+int is_even(int n) {
+    if (n == 0) {
+        return 1;
+    }
+    return is_odd(n - 1);
+}
+
+int is_odd(int n) {
+    if (n == 0) {
+        return 0;
+    }
+    return is_even(n - 1);
+}
+
+int checksum(int seed) {
+    int digits[6] = {4, 8, 15, 16, 23, 42};
+    int i = 0;
+    int acc = seed;
+    while (i < 6) {
+        acc = acc * 31 + digits[i];
+        i = i + 1;
+    }
+    return acc;
+}
+
+int long_sum(int n) {
+    int i = 0;
+    int acc = 0;
+    while (i < n) {
+        acc = acc + i % 7;
+        i = i + 1;
+    }
+    return acc;
+}
+
+int unused_helper(int x) {
+    return fib(x) * 3;
+}
+
+int unused_caller() {
+    return unused_helper(4) + checksum(1);
+}
+
+int main() {
+    int a = fib(15);
+    int b = is_even(10) * 100 + is_odd(7) * 10;
+    int c = checksum(3) % 1000;
+    int d = long_sum(60000);
+    int e = fib(a % 10);
+    return a + b + c + d % 1000 + e;
+}
@@ -0,0 +1,41 @@
+int sum_pairs(int n) {
+    int a[8] = {1, 2, 3, 4, 5, 6, 7, 8};
+    int b[8];
+    int i = 0;
+    int acc = 0;
+    while (i < n) {
+        b[i] = a[i] + a[i];
+        a[i] = 0;
+        acc = acc + b[i] + a[i] + (i + 1) * (1 + i);
+        i = i + 1;
+    }
+    return acc;
+}
+
+int overlap() {
+    int v[4] = {10, 20, 30, 40};
+    int x = v[1];
+    v[1] = x + 1;
+    int y = v[1];
+    v[2] = 7;
+    return x + y + v[1] + v[2];
+}
+
+int may_alias(int i, int j) {
+    int v[4] = {1, 2, 3, 4};
+    int x = v[j];
+    v[i] = 5;
+    return x + v[j];
+}
+
+int main() {
+    int x = 6;
+    int y = 7;
+    int p = x * y + (y * x & 15) + ((x | y) - (y | x));
+    if (x < y) {
+        if (y > x) {
+            p = p + 1;
+        }
+    }
+    return sum_pairs(8) + overlap() + may_alias(2, 2) + p;
+}
@@ -0,0 +1,40 @@
+int pair_sum(int x) {
+    int arr[2] = {0, 1};
+    arr[0] = x + arr[1];
+    arr[1] = arr[0] * 3;
+    return arr[0] + arr[1];
+}
+
+int rotate(int a, int b, int c) {
+    int v[3];
+    int t = 0;
+    v[0] = a;
+    v[1] = b;
+    v[2] = c;
+    while (t < 4) {
+        int first = v[0];
+        v[0] = v[1];
+        v[1] = v[2];
+        v[2] = first;
+        t = t + 1;
+    }
+    return v[0] * 100 + v[1] * 10 + v[2];
+}
+
+int bytes(int x) {
+    char b[4];
+    b[0] = x;
+    b[1] = x + 1;
+    b[3] = b[0] + b[1];
+    return b[3];
+}
+
+int indexed(int i) {
+    int w[4] = {5, 6, 7, 8};
+    w[2] = w[2] + i;
+    return w[i];
+}
+
+int main() {
+    return pair_sum(4) + rotate(1, 2, 3) + bytes(100) + indexed(2) + indexed(3);
+}
@@ -0,0 +1,43 @@
+int gcd(int a, int b) {
+    if (b == 0) {
+        return a;
+    }
+    return gcd(b, a % b);
+}
+
+int sum_to(int n, int acc) {
+    if (n == 0) {
+        return acc;
+    }
+    return sum_to(n - 1, acc + n);
+}
+
+int digits(int n, int count) {
+    int buf[2];
+    buf[0] = n % 10;
+    buf[1] = count;
+    if (n < 10) {
+        return buf[1] + 1;
+    }
+    return digits(n / 10, buf[1] + 1);
+}
+
+int is_odd(int n) {
+    if (n == 0) {
+        return 0;
+    }
+    return is_even(n - 1);
+}
+
+int is_even(int n) {
+    if (n == 0) {
+        return 1;
+    }
+    return is_odd(n - 1);
+}
+
+int main() {
+    int total = gcd(1071, 462) + sum_to(3000, 0) % 997;
+    total = total + is_even(1001) * 10 + is_odd(777) * 100;
+    return total + digits(123456, 0) * 1000;
+}
@@ -0,0 +1,6 @@
+int main() {
+    int arr[2] = {1, 2, 3};
+    int s = {1};
+    arr = 4;
+    return arr;
+}
@@ -0,0 +1,9 @@
+int add(int x, int y) {
+    return x + y;
+}
+
+int main() {
+    int v = 3;
+    break;
+    return add(1) + v(2) + add;
+}
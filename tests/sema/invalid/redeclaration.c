@@ -0,0 +1,9 @@
+int helper(int a, int a) {
+    return a;
+}
+
+int main() {
+    int x = 1;
+    int x = 2;
+    return x;
+}
@@ -0,0 +1,8 @@
+int main() {
+    int x = 1;
+    {
+        int y = 2;
+    }
+    x = y + missing();
+    return x;
+}
@@ -0,0 +1,23 @@
+int sum(int n) {
+    int total = 0;
+    while (n > 0) {
+        int n2 = n;
+        total = total + n2;
+        n = n - 1;
+    }
+    return total;
+}
+
+int main() {
+    int x = 1;
+    char buf[4] = {'a', 'b'};
+    {
+        int x = 2;
+        buf[x] = 'c';
+    }
+    if (x == 1) {
+        int y = sum(3);
+        return y + buf[0];
+    }
+    return x;
+}
@@ -0,0 +1,76 @@
+int crc_step(int crc, int byte) {
+    int table[16] = {0, 7, 14, 9, 28, 27, 18, 21, 56, 63, 54, 49, 36, 35, 42, 45};
+    int mixed = (crc + byte) & 15;
+    return (crc / 16 + table[mixed] * 3) % 251;
+}
+
+int digits(int seed) {
+    char text[70] = {'c', 'r', '-', 'v', ' ', 'r', 'o', 'd', 'a', 't', 'a', ' ', 't', 'e', 'm', 'p', 'l', 'a', 't',
+                     'e', seed, seed + 1};
+    int sum = 0;
+    int i = 0;
+    while (i < 70) {
+        sum = sum * 3 + text[i];
+        sum = sum % 100003;
+        i = i + 1;
+    }
+    return sum;
+}
+
+int sparse(int seed) {
+    int zero[40] = {0};
+    int head[33] = {seed, 2, 3};
+    int mixed[24] = {1, 2, 3, 4, seed, 6, 7, 8, 9, 10, seed * 2, 12};
+    int i = 0;
+    int sum = 0;
+    while (i < 40) {
+        sum = sum + zero[i] * 5;
+        i = i + 1;
+    }
+    i = 0;
+    while (i < 33) {
+        sum = sum + head[i] * (i + 1);
+        i = i + 1;
+    }
+    i = 0;
+    while (i < 24) {
+        sum = sum + mixed[i] * (i + 3);
+        i = i + 1;
+    }
+    return sum;
+}
+
+int shuffle(int seed) {
+    int perm[48] = {17, 3, 29, 41, 8, 36, 12, 45, 0, 22, 31, 6, 39, 14, 27, 2, 44, 19, 10, 33, 25, 47, 5, 38,
+                    16, 28, 1, 43, 21, 9, 35, 13, 40, 24, 7, 30, 46, 18, 11, 34, 4, 26, 42, 15, 37, 20, 32, 23};
+    int hist[64] = {0};
+    int i = 0;
+    while (i < 48) {
+        int j = (perm[i] + seed) % 48;
+        int t = perm[i];
+        perm[i] = perm[j];
+        perm[j] = t;
+        hist[perm[i] + 16] = hist[perm[i] + 16] + i;
+        i = i + 1;
+    }
+    int sum = 0;
+    i = 0;
+    while (i < 64) {
+        sum = sum * 7 + hist[i] + perm[i % 48];
+        sum = sum % 65521;
+        i = i + 1;
+    }
+    return sum;
+}
+
+int main() {
+    int crc = 0;
+    int total = 0;
+    int round = 0;
+    while (round < 50) {
+        crc = crc_step(crc, round * 13);
+        total = total + digits(round) % 1000 + sparse(round - 7) + crc + shuffle(round) % 977;
+        round = round + 1;
+    }
+    return total;
+}
@@ -0,0 +1,54 @@
+int classify(int v) {
+    if (v < 0) {
+        return -1;
+    }
+    if (v == 0) {
+        return 0;
+    }
+    int steps = 0;
+    while (v != 1) {
+        if (v % 2 != 0) {
+            v = v * 3 + 1;
+        } else {
+            v = v / 2;
+        }
+        steps = steps + 1;
+        if (steps > 500) {
+            return -2;
+        }
+    }
+    return steps;
+}
+
+int scan(int seed) {
+    int data[64];
+    int i = 0;
+    while (i < 64) {
+        data[i] = (seed * (i + 7)) % 97 - 20;
+        i = i + 1;
+    }
+    int total = 0;
+    int row = 0;
+    while (row < 8) {
+        int col = 0;
+        while (col < 8) {
+            int x = data[row * 8 + col];
+            if (x != 0) {
+                total = total + classify(x);
+            }
+            col = col + 1;
+        }
+        row = row + 1;
+    }
+    return total;
+}
+
+int main() {
+    int sum = 0;
+    int round = 1;
+    while (round <= 40) {
+        sum = sum + scan(round);
+        round = round + 1;
+    }
+    return sum;
+}
@@ -0,0 +1,45 @@
+int many(int a, int b, int c, int d, int e, int f, int g, int h, int i, int j) {
+    return a - b + c * d - e + f * g - h + i * 3 - j;
+}
+
+int mix(int seed) {
+    int big[700];
+    int i = 0;
+    int x = seed;
+    while (i < 700) {
+        x = x * 1103515245 + 12345;
+        big[i] = (x / 65536) & 32767;
+        i = i + 1;
+    }
+    int acc = 0;
+    i = 0;
+    while (i < 700) {
+        int v = big[i];
+        if (v % 7 == 3) {
+            acc = acc + v / 13;
+        } else {
+            acc = acc - v % 11 + v * 4 - v / 8;
+        }
+        i = i + 1;
+    }
+    return acc;
+}
+
+char shout(char c) {
+    return c - 32;
+}
+
+int divide(int a, int b) {
+    return a / b + a % b;
+}
+
+int main() {
+    int total = many(1, 2, 3, 4, 5, 6, 7, 8, 9, 10);
+    int round = 0;
+    while (round < 200) {
+        total = total + mix(round) % 1000;
+        round = round + 1;
+    }
+    total = total + shout('a') + divide(-100000, 7) + divide(123456789, -321);
+    return total;
+}
@@ -0,0 +1,25 @@
+int signed_table(int k) {
+    int a[16] = {-1, -1, 0, 0, 0, 0, 0, 100, 0, 131, 65, -21, 1, -20, 3, 256};
+    return a[k & 15];
+}
+
+int sparse_tail(int seed) {
+    int a[16] = {seed, -3, 0, 0, 0, 0, 0, 100, 0, seed * 2, 0, -21, 0, 0, 0, 256};
+    int sum = 0;
+    int i = 0;
+    while (i < 16) {
+        sum = sum * 3 + a[i];
+        i = i + 1;
+    }
+    return sum;
+}
+
+int main() {
+    int total = signed_table(7) + signed_table(11) * 7 + signed_table(15);
+    int seed = 0;
+    while (seed < 20) {
+        total = total + sparse_tail(seed - 9) % 1009;
+        seed = seed + 1;
+    }
+    return total;
+}
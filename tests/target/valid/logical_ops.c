@@ -0,0 +1,61 @@
+int find(int limit, int seed) {
+    int data[24];
+    int i = 0;
+    while (i < 24) {
+        data[i] = (i * 5 + seed) % 9;
+        i = i + 1;
+    }
+    i = 0;
+    while (i < limit && data[i] != 0) {
+        i = i + 1;
+    }
+    return i;
+}
+
+int classify(int a, int b, int c) {
+    int score = 0;
+    if (a > 0 && b > 0 || c == 3) {
+        score = score + 1;
+    }
+    if (!(a < b) || a == c && b != 2) {
+        score = score + 10;
+    }
+    if (a & 4 && b | c) {
+        score = score + 100;
+    }
+    score = score + (a < b && b < c) * 1000;
+    score = score + (a || b) * 2000 + (c && 0) * 7 + (0 || a - b) * 3000;
+    return score;
+}
+
+int effects(int a, int b) {
+    int calls = 0;
+    int hits = 0;
+    if (a > 2 && (calls = calls + 1) > 0) {
+        hits = hits + 1;
+    }
+    if (b > 2 || (calls = calls + 10) > 0) {
+        hits = hits + 2;
+    }
+    int both = a % 3 == 0 && (calls = calls + 100) > 150;
+    return calls * 10 + hits + both * 5000 + find(b, a);
+}
+
+int main() {
+    int total = 0;
+    int a = -3;
+    while (a <= 4) {
+        int b = -2;
+        while (b <= 3) {
+            int c = 0;
+            while (c <= 4) {
+                total = total + classify(a, b, c);
+                c = c + 1;
+            }
+            total = total + effects(a, b);
+            b = b + 1;
+        }
+        a = a + 1;
+    }
+    return total % 1000003;
+}
@@ -0,0 +1,55 @@
+int mix(int seed, int n) {
+    int a = seed + 1;
+    int b = seed * 3;
+    int c = seed - 5;
+    int d = seed - 7;
+    int e = seed * seed;
+    int f = seed + 11;
+    int g = seed * 13;
+    int h = seed - 17;
+    int p = seed - 19;
+    int q = seed + 23;
+    int r = seed * 29;
+    int s = seed - 31;
+    int t = seed - 37;
+    int u = seed + 41;
+    int v = seed * 43;
+    int w = seed - 47;
+    int x = seed - 53;
+    int y = seed + 59;
+    int z = seed * 61;
+    int k = 0;
+    while (k < n) {
+        a = a + b * c;
+        b = b - (d + e);
+        c = c + f - g;
+        d = d * 3 + h;
+        e = e - (p + q);
+        f = f + r * s;
+        g = g - t + u;
+        h = h - (v + w);
+        p = p + x * y;
+        q = q - z + a;
+        r = r - (b + c);
+        s = s + d * e;
+        t = t - f + g;
+        u = u - (h + p);
+        v = v + q * r;
+        w = w - s + t;
+        x = x - (u + v);
+        y = y + w * x;
+        z = z - y + k;
+        k = k + 1;
+    }
+    return a + b + c + d + e + f + g + h + p + q + r + s + t + u + v + w + x + y + z;
+}
+
+int main() {
+    int total = 0;
+    int seed = 0;
+    while (seed < 30) {
+        total = total + mix(seed, seed % 7 + 3);
+        seed = seed + 1;
+    }
+    return total;
+}
@@ -0,0 +1,41 @@
+int slow_path(int x) {
+    int acc = 0;
+    int i = 0;
+    while (i < x % 17) {
+        acc = acc + i * x;
+        i = i + 1;
+    }
+    return acc;
+}
+
+int lookup(int key, int limit) {
+    if (key < 0) {
+        return -1;
+    }
+    if (key < limit) {
+        return key * 3;
+    }
+    int a = slow_path(key);
+    int b = slow_path(key + limit);
+    return a + b + key;
+}
+
+int clamp(int value, int low, int high) {
+    if (value < low) {
+        return low;
+    }
+    if (value > high) {
+        return high;
+    }
+    return value;
+}
+
+int main() {
+    int total = 0;
+    int i = -50;
+    while (i < 400) {
+        total = total + lookup(i, 300) + clamp(i * 7, -20, 900);
+        i = i + 1;
+    }
+    return total % 1000000;
+}
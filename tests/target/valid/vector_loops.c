@@ -0,0 +1,74 @@
+int kernels(int seed) {
+    int a[257];
+    int b[257];
+    char c[300];
+    char d[300];
+    int i = 0;
+    while (i < 257) {
+        a[i] = i * 7 + seed;
+        b[i] = seed - i;
+        i = i + 1;
+    }
+    i = 0;
+    while (i < 300) {
+        c[i] = i + seed;
+        i = i + 1;
+    }
+    i = 0;
+    while (i < 300) {
+        d[i] = c[i] - 1;
+        i = i + 1;
+    }
+    int sum = 0;
+    i = 0;
+    while (i < 257) {
+        sum = sum + a[i] * b[i];
+        i = i + 1;
+    }
+    int mask = -1;
+    int bits = 0;
+    i = 0;
+    while (i <= 256) {
+        mask = mask & (a[i] | 3);
+        bits = bits | (b[i] & 255);
+        i = i + 1;
+    }
+    int chars = 0;
+    i = 0;
+    while (i != 300) {
+        chars = chars + d[i];
+        i = i + 1;
+    }
+    i = 0;
+    while (i < 257) {
+        b[i] = (a[i] > b[i]) + (a[i] <= seed + 3) * 2 + (b[i] == 0) * 4 + (5 >= a[i]) * 8 + -(a[i] / 8) + ~b[i];
+        i = i + 1;
+    }
+    i = 0;
+    while (i < 256) {
+        a[i] = a[i + 1] - a[i];
+        i = i + 1;
+    }
+    i = 0;
+    while (i < 256) {
+        b[i + 1] = b[i] + a[i] % 4;
+        i = i + 1;
+    }
+    int tail = 0;
+    i = 0;
+    while (i < 257) {
+        tail = tail + a[i] + b[i] * 3;
+        i = i + 1;
+    }
+    return sum + mask + bits + chars + tail;
+}
+
+int main() {
+    int total = 0;
+    int round = 0;
+    while (round < 100) {
+        total = total + kernels(round * 37 - 900) % 100000;
+        round = round + 1;
+    }
+    return total;
+}
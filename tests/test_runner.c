@@ -4,7 +4,36 @@
 #include "lexer/lexer.h"
 #include "parser/parser.h"
 #include "parser/ast_printer.h"
+#include "sema/sema.h"
+#include "ir/ir.h"
+#include "ir/ir_builder.h"
+#include "ir/ir_fold.h"
+#include "ir/ir_interp.h"
+#include "ir/ir_verify.h"
+#include "opt/div_const.h"
+#include "opt/optimize.h"
+#include "sim/sim.h"
+#include "target/codegen.h"
+#include "target/mir.h"
+#include "target/peephole.h"
+#include "target/sched.h"
 #include "utils/diagnostic.h"
+#include "utils/stats.h"
+
+#define TEST_SIM_MEMORY (16u << 20)
+#define TEST_SIM_STEP_LIMIT 100000000u
+
+#define TEST_MIR(op, flags, rd, rs1, rs2, imm, target) {RV_##op, flags, rd, rs1, rs2, imm, target}
+#define TEST_MIR_MAX 3
+
+#define TEST_SHUFFLED_PIPELINE \
+  "gvn,licm,ivsr,sccp,sroa,inline,tailrec,licm,gvn,divconst,simplifycfg,sccp,dse,tailrec,dce,simplifycfg,globaldce,tailcall"
+
+#define TEST_IVSR_PIPELINE "licm,ivsr"
+
+static const char *const test_codegen_march[][3] = {{"rv32i", NULL}, {"rv64imc", NULL}, {"rv32imc", "rv32imcv", NULL}};
+static const char *const test_codegen_tune[] = {"generic", "rocket", "sifive-7"};
+static const char *const test_sim_march[][3] = {{"rv32im", NULL}, {"rv64imc", NULL}, {"rv32imc", "rv32imcv", NULL}};
 
 #ifndef TEST_ROOT
 #define TEST_ROOT "tests"
@@ -12,15 +41,30 @@
 
 typedef enum {
   TEST_LEX,
-  TEST_PARSE
+  TEST_PARSE,
+  TEST_SEMA,
+  TEST_RUN
 } TestStage;
 
 typedef struct {
   const char *path;
   int expect_success;
   TestStage stage;
+  int32_t expected_value;
 } TestCase;
 
+typedef int (*ShapePredicate)(IrModule *module, const char *assembly);
+
+typedef struct {
+  const char *name;
+  const char *path;
+  const char *march;
+  int32_t opt_level;
+  const char *pipeline;
+  const char *stat;
+  ShapePredicate predicate;
+} ShapeCheck;
+
 static char *read_file(const char *path) {
   FILE *f = fopen(path, "rb");
   if (!f) return NULL;
@@ -56,6 +100,728 @@ static char *make_path(const char *rel) {
   return full;
 }
 
+static int32_t find_main(const IrModule *module) {
+  for (uint32_t i = 0; i < module->function_count; i++) {
+    if (strcmp(module->functions[i]->name, "main") == 0) {
+      return (int32_t) i;
+    }
+  }
+  return -1;
+}
+
+static int simulate_module(IrModule *module, const int32_t opt_level, const char *march, SimResult *result,
+                           SimStats *stats) {
+  TargetInfo target;
+  target_init(&target);
+  target_parse_march(&target, march);
+  CodegenOptions options;
+  codegen_options_init(&options, &target, opt_level);
+  options.tune = machine_model_find(test_codegen_tune[opt_level]);
+  options.emit_object = 1;
+  FILE *out = tmpfile();
+  if (!out) {
+    printf("[ERROR] cannot create a temporary file\n");
+    return 0;
+  }
+  stats_reset();
+  int ok = codegen_module(module, &options, out) == 0;
+  if (ok && target.ext_c && stats_get("obj.compressed_insts") == 0) {
+    printf("[ERROR] no 16-bit encodings were emitted for %s at -O%d\n", march, opt_level);
+    ok = 0;
+  }
+  long size = ftell(out);
+  uint8_t *image = malloc(size > 0 ? (size_t) size : 1);
+  rewind(out);
+  ok = ok && image && size > 0 && fread(image, 1, (size_t) size, out) == (size_t) size;
+  fclose(out);
+  SimMachine sim;
+  sim_init(&sim, TEST_SIM_MEMORY, options.tune);
+  if (ok && sim_load_elf(&sim, image, (size_t) size)) {
+    *result = sim_run(&sim, TEST_SIM_STEP_LIMIT);
+    *stats = sim.stats;
+    if (result->status != SIM_OK) {
+      printf("[ERROR] simulator: %s at 0x%llx for %s at -O%d\n", sim_status_name(result->status),
+             (unsigned long long) result->pc, march, opt_level);
+      ok = 0;
+    }
+  } else {
+    printf("[ERROR] simulator could not load the object for %s at -O%d\n", march, opt_level);
+    ok = 0;
+  }
+  sim_destroy(&sim);
+  free(image);
+  return ok;
+}
+
+static int run_simulator(IrModule *module, const int32_t opt_level, const char *march, const int32_t expected) {
+  SimResult result;
+  SimStats stats;
+  if (!simulate_module(module, opt_level, march, &result, &stats)) {
+    return 0;
+  }
+  if ((int32_t) result.value != expected) {
+    printf("[ERROR] simulated main returned %d for %s at -O%d, expected %d\n", (int32_t) result.value, march,
+           opt_level, expected);
+    return 0;
+  }
+  return 1;
+}
+
+static int run_codegen(IrModule *module, const int32_t opt_level, const char *march) {
+  TargetInfo target;
+  target_init(&target);
+  target_parse_march(&target, march);
+  static const RegallocKind kinds[] = {REGALLOC_LINEAR_SCAN, REGALLOC_GRAPH_COLORING};
+  for (uint32_t k = 0; k < sizeof(kinds) / sizeof(kinds[0]); k++) {
+    for (int32_t object = 0; object <= 1; object++) {
+      CodegenOptions options;
+      codegen_options_init(&options, &target, opt_level);
+      options.regalloc = kinds[k];
+      options.tune = machine_model_find(test_codegen_tune[opt_level]);
+      options.emit_object = object;
+      FILE *out = tmpfile();
+      if (!out) {
+        printf("[ERROR] cannot create a temporary file\n");
+        return 0;
+      }
+      int ok = codegen_module(module, &options, out) == 0 && ftell(out) > 0;
+      if (ok && object) {
+        unsigned char magic[4] = {0};
+        rewind(out);
+        ok = fread(magic, 1, sizeof(magic), out) == sizeof(magic) && memcmp(magic, "\x7f" "ELF", 4) == 0;
+      }
+      fclose(out);
+      if (!ok) {
+        printf("[ERROR] %s generation failed for %s with %s\n", object ? "object" : "assembly", march,
+               regalloc_kind_name(kinds[k]));
+        return 0;
+      }
+    }
+  }
+  return 1;
+}
+
+static int run_module(const AstModule *ast, const Sema *sema, const int32_t opt_level, const char *pipeline,
+                      const int32_t expected) {
+  IrModule module;
+  ir_module_init(&module);
+  ir_build_module(&module, ast, sema);
+  int ok = ir_verify_module(&module) == 0;
+  if (ok) {
+    OptOptions options;
+    opt_options_init(&options, opt_level);
+    options.pipeline = pipeline;
+    options.whole_program = 1;
+    opt_optimize_module(&module, &options);
+    ok = ir_verify_module(&module) == 0;
+  }
+  int32_t main_index = find_main(&module);
+  if (ok && main_index >= 0) {
+    IrInterpResult result = ir_interp_run(&module, main_index, NULL, 0, 100000000);
+    if (result.status != IR_INTERP_OK) {
+      printf("[ERROR] interpreter: %s\n", ir_interp_status_name(result.status));
+      ok = 0;
+    } else if (result.value != expected) {
+      printf("[ERROR] main returned %d at -O%d%s%s, expected %d\n", result.value, opt_level,
+             pipeline ? " with -fpasses=" : "", pipeline ? pipeline : "", expected);
+      ok = 0;
+    }
+  } else {
+    ok = 0;
+  }
+  for (uint32_t m = 0; ok && test_codegen_march[opt_level][m]; m++) {
+    ok = run_codegen(&module, opt_level, test_codegen_march[opt_level][m]);
+  }
+  for (uint32_t m = 0; ok && test_sim_march[opt_level][m]; m++) {
+    ok = run_simulator(&module, opt_level, test_sim_march[opt_level][m], expected);
+  }
+  ir_module_destroy(&module);
+  return ok;
+}
+
+static uint32_t div_check_random(uint32_t *state) {
+  *state = *state * 1664525u + 1013904223u;
+  return *state ^ (*state >> 16);
+}
+
+static int32_t div_check_eval(const IrFunction *fn, const int32_t arg, int32_t *lowered) {
+  int32_t *values = calloc(fn->inst_count, sizeof(int32_t));
+  int32_t result = 0;
+  *lowered = 1;
+  const IrIdVector *insts = &fn->blocks[0].insts;
+  for (uint32_t i = 0; i < insts->count; i++) {
+    IrValueId id = insts->items[i];
+    const IrInst *inst = &fn->insts[id];
+    if (inst->op == IR_OP_PARAM) {
+      values[id] = arg;
+    } else if (inst->op == IR_OP_CONST) {
+      values[id] = inst->imm;
+    } else if (inst->op == IR_OP_RET) {
+      result = values[inst->ops[0]];
+    } else if (ir_op_flags((IrOp) inst->op) & IR_OPF_BINARY) {
+      *lowered &= inst->op != IR_OP_DIV && inst->op != IR_OP_REM;
+      ir_fold_binary((IrOp) inst->op, values[inst->ops[0]], values[inst->ops[1]], &values[id]);
+    } else {
+      ir_fold_unary((IrOp) inst->op, values[inst->ops[0]], &values[id]);
+    }
+  }
+  free(values);
+  return result;
+}
+
+static int div_check_one(const int32_t d, const IrOp op, const int32_t nonneg, const int32_t has_mul,
+                         const int32_t *dividends, const uint32_t count) {
+  IrModule module;
+  ir_module_init(&module);
+  IrFunction *fn = ir_function_create(&module, "div", 3, 1);
+  IrBlockId entry = ir_block_create(fn);
+  IrValueId n = ir_emit(fn, entry, IR_OP_PARAM, IR_TYPE_I32, IR_NONE, IR_NONE);
+  fn->insts[n].imm = 0;
+  if (nonneg) {
+    n = ir_emit(fn, entry, IR_OP_AND, IR_TYPE_I32, n, ir_emit_const(fn, entry, INT32_MAX));
+  }
+  IrValueId q = ir_emit(fn, entry, op, IR_TYPE_I32, n, ir_emit_const(fn, entry, d));
+  ir_emit(fn, entry, IR_OP_RET, IR_TYPE_VOID, q, IR_NONE);
+  ir_compute_preds(fn);
+  opt_div_const(fn, has_mul);
+  int ok = ir_verify_function(fn) == 0;
+  uint32_t ad = d < 0 ? 0u - (uint32_t) d : (uint32_t) d;
+  for (uint32_t i = 0; ok && i < count; i++) {
+    int32_t x = nonneg ? dividends[i] & INT32_MAX : dividends[i];
+    int32_t expected = 0;
+    int32_t lowered;
+    ir_fold_binary(op, x, d, &expected);
+    int32_t actual = div_check_eval(fn, dividends[i], &lowered);
+    if (actual != expected || (!lowered && (has_mul || (ad & (ad - 1)) == 0))) {
+      printf("[ERROR] %d %s %d: got %d, expected %d (nonneg=%d, mul=%d, lowered=%d)\n", x,
+             op == IR_OP_DIV ? "/" : "%", d, actual, expected, nonneg, has_mul, lowered);
+      ok = 0;
+    }
+  }
+  ir_module_destroy(&module);
+  return ok;
+}
+
+static int run_div_const_check(void) {
+  static const int32_t fixed[] = {1, -1, 2, -2, 3, -3, 5, 6, 7, -7, 10, 12, 25, 100, 125, 641, 1000, -1000, 4096,
+                                  65535, 65536, 6700417, 1 << 30, -(1 << 30), INT32_MAX, INT32_MIN, INT32_MIN + 1};
+  const uint32_t fixed_count = (uint32_t) (sizeof(fixed) / sizeof(fixed[0]));
+  const uint32_t divisor_count = fixed_count + 1500;
+  int32_t dividends[256];
+  uint32_t state = 12345;
+  int ok = 1;
+  for (uint32_t k = 0; ok && k < divisor_count; k++) {
+    int32_t d;
+    if (k < fixed_count) {
+      d = fixed[k];
+    } else {
+      uint32_t bits = div_check_random(&state);
+      d = (int32_t) (bits >> (div_check_random(&state) % 31));
+      if ((div_check_random(&state) & 1) && d != INT32_MIN) {
+        d = -d;
+      }
+      if (d == 0) {
+        continue;
+      }
+    }
+    uint32_t count = 0;
+    const int32_t edges[] = {0, 1, -1, 2, -2, INT32_MAX, INT32_MIN, INT32_MIN + 1, INT32_MAX - 1};
+    for (uint32_t e = 0; e < sizeof(edges) / sizeof(edges[0]); e++) {
+      dividends[count++] = edges[e];
+    }
+    for (int32_t m = -3; m <= 3; m++) {
+      int32_t base = (int32_t) ((uint32_t) d * (uint32_t) m);
+      dividends[count++] = base;
+      dividends[count++] = (int32_t) ((uint32_t) base + 1);
+      dividends[count++] = (int32_t) ((uint32_t) base - 1);
+    }
+    while (count < sizeof(dividends) / sizeof(dividends[0])) {
+      uint32_t bits = div_check_random(&state);
+      dividends[count++] = (int32_t) (bits >> (div_check_random(&state) % 32));
+    }
+    for (int32_t variant = 0; ok && variant < 8; variant++) {
+      ok = div_check_one(d, (variant & 1) ? IR_OP_REM : IR_OP_DIV, (variant >> 1) & 1, !(variant & 4), dividends,
+                         count);
+    }
+  }
+  printf("[%s] division by constants (%u divisors)\n", ok ? "PASS" : "FAIL", divisor_count);
+  return ok;
+}
+
+typedef struct {
+  const char *model;
+  uint32_t order[5];
+} SchedCheck;
+
+static void sched_check_block(MirFunction *fn, const uint32_t block) {
+  MirReg loaded = mir_vreg_create(fn);
+  MirReg bumped = mir_vreg_create(fn);
+  MirReg squared = mir_vreg_create(fn);
+  MirReg sum = mir_vreg_create(fn);
+  MirReg offset = mir_vreg_create(fn);
+  mir_emit(fn, block, RV_LW, loaded, RV_A0, MIR_NONE, 0);
+  mir_emit(fn, block, RV_ADDI, bumped, loaded, MIR_NONE, 1);
+  mir_emit(fn, block, RV_MUL, squared, RV_A1, RV_A1, 0);
+  mir_emit(fn, block, RV_ADD, sum, squared, bumped, 0);
+  mir_emit(fn, block, RV_ADDI, offset, RV_A1, MIR_NONE, 5);
+  mir_emit(fn, block, RV_RET, MIR_NONE, MIR_NONE, MIR_NONE, 0);
+}
+
+static int run_sched_check(const SchedCheck *check) {
+  TargetInfo target;
+  target_init(&target);
+  target_parse_march(&target, "rv32im");
+  MirModule module;
+  mir_module_init(&module, &target);
+  MirFunction *fn = mir_function_create(&module, "sched", 1);
+  uint32_t block = mir_block_create(fn);
+  sched_check_block(fn, block);
+  MirInst original[5];
+  memcpy(original, fn->blocks[block].insts, sizeof(original));
+  const MachineModel *model = machine_model_find(check->model);
+  int ok = model != NULL;
+  if (ok) {
+    stats_reset();
+    sched_function(fn, model, 0);
+    for (uint32_t i = 0; ok && i < 5; i++) {
+      const MirInst *inst = &fn->blocks[block].insts[i];
+      const MirInst *expected = &original[check->order[i]];
+      ok = inst->op == expected->op && inst->rd == expected->rd;
+    }
+    if (!ok) {
+      printf("[ERROR] unexpected instruction order\n");
+    } else if (stats_get("sched.reordered_regions") != 1 || stats_get("sched.cycles_saved") == 0) {
+      printf("[ERROR] sched.reordered_regions or sched.cycles_saved did not rise\n");
+      ok = 0;
+    }
+  }
+  printf("[%s] scheduler reorders a block for %s\n", ok ? "PASS" : "FAIL", check->model);
+  mir_module_destroy(&module);
+  return ok;
+}
+
+typedef struct {
+  const char *name;
+  const char *rule;
+  const char *march;
+  uint32_t count;
+  MirInst input[TEST_MIR_MAX];
+  uint32_t expected_count;
+  MirInst expected[TEST_MIR_MAX];
+  int32_t fires;
+} PeepholeCheck;
+
+static int peephole_same_inst(const MirInst *a, const MirInst *b) {
+  return a->op == b->op && a->flags == b->flags && a->rd == b->rd && a->rs1 == b->rs1 && a->rs2 == b->rs2 &&
+         a->imm == b->imm && a->target == b->target;
+}
+
+static int run_peephole_check(const PeepholeCheck *check) {
+  TargetInfo target;
+  target_init(&target);
+  target_parse_march(&target, check->march);
+  MirModule module;
+  mir_module_init(&module, &target);
+  MirFunction *fn = mir_function_create(&module, "peephole", 1);
+  mir_frame_object_create(fn, 4, 4, MIR_FRAME_LOCAL);
+  for (uint32_t b = 0; b < 4; b++) {
+    mir_block_create(fn);
+  }
+  for (uint32_t i = 0; i < check->count; i++) {
+    mir_insert(fn, 0, i, &check->input[i]);
+  }
+  for (uint32_t b = 1; b < 4; b++) {
+    mir_emit(fn, b, RV_RET, MIR_NONE, MIR_NONE, MIR_NONE, 0);
+  }
+  char stat[64];
+  snprintf(stat, sizeof(stat), "peephole.%s", check->rule);
+  stats_reset();
+  peephole_function(fn);
+  const MirBlock *block = &fn->blocks[0];
+  int ok = block->count == check->expected_count;
+  for (uint32_t i = 0; ok && i < check->expected_count; i++) {
+    ok = peephole_same_inst(&block->insts[i], &check->expected[i]);
+  }
+  if (!ok) {
+    printf("[ERROR] unexpected rewrite for %s\n", check->rule);
+  } else if ((stats_get(stat) > 0) != check->fires) {
+    printf("[ERROR] %s %s\n", stat, check->fires ? "stayed at zero" : "rose");
+    ok = 0;
+  }
+  printf("[%s] peephole %s\n", ok ? "PASS" : "FAIL", check->name);
+  mir_module_destroy(&module);
+  return ok;
+}
+
+static int shape_no_self_calls(IrModule *module, const char *assembly) {
+  (void) assembly;
+  for (uint32_t f = 0; f < module->function_count; f++) {
+    const IrFunction *fn = module->functions[f];
+    for (uint32_t b = 0; b < fn->block_count; b++) {
+      const IrIdVector *insts = &fn->blocks[b].insts;
+      for (uint32_t i = 0; i < insts->count; i++) {
+        const IrInst *inst = &fn->insts[insts->items[i]];
+        if (inst->op == IR_OP_CALL && inst->imm == fn->index) {
+          return 0;
+        }
+      }
+    }
+  }
+  return 1;
+}
+
+static int shape_leaves_inlined(IrModule *module, const char *assembly) {
+  static const char *const leaves[] = {"add", "clamp", "low_byte"};
+  for (uint32_t f = 0; f < module->function_count; f++) {
+    const IrFunction *fn = module->functions[f];
+    for (uint32_t b = 0; b < fn->block_count; b++) {
+      const IrIdVector *insts = &fn->blocks[b].insts;
+      for (uint32_t i = 0; i < insts->count; i++) {
+        const IrInst *inst = &fn->insts[insts->items[i]];
+        for (uint32_t l = 0; inst->op == IR_OP_CALL && l < sizeof(leaves) / sizeof(leaves[0]); l++) {
+          if (strcmp(module->functions[inst->imm]->name, leaves[l]) == 0) {
+            return 0;
+          }
+        }
+      }
+    }
+  }
+  return strstr(assembly, "  call add\n") == NULL && strstr(assembly, "  call clamp\n") == NULL &&
+         strstr(assembly, "  call low_byte\n") == NULL && strstr(assembly, "  call fact\n") != NULL;
+}
+
+static uint32_t shape_count_op(const IrModule *module, const char *name, const IrOp op) {
+  uint32_t count = 0;
+  for (uint32_t f = 0; f < module->function_count; f++) {
+    const IrFunction *fn = module->functions[f];
+    if (strcmp(fn->name, name) != 0) {
+      continue;
+    }
+    for (uint32_t b = 0; b < fn->block_count; b++) {
+      const IrIdVector *insts = &fn->blocks[b].insts;
+      for (uint32_t i = 0; i < insts->count; i++) {
+        count += fn->insts[insts->items[i]].op == op;
+      }
+    }
+  }
+  return count;
+}
+
+static int shape_arrays_promoted(IrModule *module, const char *assembly) {
+  (void) assembly;
+  return shape_count_op(module, "pair_sum", IR_OP_ALLOCA) == 0 && shape_count_op(module, "rotate", IR_OP_ALLOCA) == 0 &&
+         shape_count_op(module, "bytes", IR_OP_ALLOCA) == 0 && shape_count_op(module, "indexed", IR_OP_ALLOCA) == 1;
+}
+
+static int shape_divisions_lowered(IrModule *module, const char *assembly) {
+  (void) assembly;
+  static const char *const names[] = {"bucket", "ring_next", "mixed"};
+  for (uint32_t i = 0; i < sizeof(names) / sizeof(names[0]); i++) {
+    if (shape_count_op(module, names[i], IR_OP_DIV) != 0 || shape_count_op(module, names[i], IR_OP_REM) != 0) {
+      return 0;
+    }
+  }
+  return 1;
+}
+
+static int shape_dom_cached(IrModule *module, const char *assembly) {
+  (void) assembly;
+  return stats_get("analysis.dom_computed") == module->function_count;
+}
+
+static const char *shape_function(const char *assembly, const char *name, size_t *length) {
+  char header[64];
+  snprintf(header, sizeof(header), "\n%s:\n", name);
+  const char *start = strstr(assembly, header);
+  const char *end = start ? strstr(start, "\n  .size ") : NULL;
+  *length = end ? (size_t) (end - start) : 0;
+  return end ? start : NULL;
+}
+
+static int shape_mentions(const char *text, const size_t length, const char *needle) {
+  size_t needle_length = strlen(needle);
+  for (size_t i = 0; i + needle_length <= length; i++) {
+    if (memcmp(text + i, needle, needle_length) == 0) {
+      return 1;
+    }
+  }
+  return 0;
+}
+
+static int shape_blocks_placed(IrModule *module, const char *assembly) {
+  (void) module;
+  for (const char *line = strstr(assembly, "\n  j "); line; line = strstr(line + 1, "\n  j ")) {
+    const char *label = line + 5;
+    const char *next = strchr(label, '\n');
+    size_t length = next ? (size_t) (next - label) : 0;
+    if (next && strncmp(next + 1, label, length) == 0 && next[1 + length] == ':') {
+      return 0;
+    }
+  }
+  size_t length;
+  const char *classify = shape_function(assembly, "classify", &length);
+  if (!classify) {
+    return 0;
+  }
+  const char *last = NULL;
+  for (const char *label = strstr(classify, "\n.L"); label && label < classify + length;
+       label = strstr(label + 1, "\n.L")) {
+    last = label;
+  }
+  return last && shape_mentions(last, (size_t) (classify + length - last), "li a0, -1\n");
+}
+
+static int shape_leaf_frames_elided(IrModule *module, const char *assembly) {
+  (void) module;
+  static const char *const leaves[] = {"slow_path", "clamp"};
+  for (uint32_t l = 0; l < sizeof(leaves) / sizeof(leaves[0]); l++) {
+    size_t length;
+    const char *text = shape_function(assembly, leaves[l], &length);
+    if (!text || shape_mentions(text, length, "sp")) {
+      return 0;
+    }
+  }
+  return 1;
+}
+
+static int shape_saves_shrink_wrapped(IrModule *module, const char *assembly) {
+  (void) module;
+  size_t length;
+  const char *text = shape_function(assembly, "lookup", &length);
+  if (!text) {
+    return 0;
+  }
+  const char *ret = strstr(text, "\n  ret\n");
+  const char *prologue = strstr(text, "\n  addi sp, sp, -");
+  return ret && prologue && ret < prologue && prologue < text + length;
+}
+
+static uint32_t shape_count_branches(const char *assembly, const char *name) {
+  size_t length;
+  const char *text = shape_function(assembly, name, &length);
+  uint32_t count = 0;
+  for (size_t i = 0; text && i + 4 <= length; i++) {
+    count += memcmp(text + i, "\n  b", 4) == 0;
+  }
+  return count;
+}
+
+static int shape_guarded_increments(const IrModule *module, const char *name) {
+  for (uint32_t f = 0; f < module->function_count; f++) {
+    const IrFunction *fn = module->functions[f];
+    if (strcmp(fn->name, name) != 0) {
+      continue;
+    }
+    uint32_t guarded = 0;
+    for (uint32_t b = 0; b < fn->block_count; b++) {
+      const IrIdVector *insts = &fn->blocks[b].insts;
+      for (uint32_t i = 0; i < insts->count; i++) {
+        const IrInst *inst = &fn->insts[insts->items[i]];
+        int32_t step;
+        if (inst->op != IR_OP_ADD || !ir_value_const(fn, inst->ops[1], &step) ||
+            (step != 1 && step != 10 && step != 100)) {
+          continue;
+        }
+        const IrIdVector *preds = &fn->blocks[b].preds;
+        IrValueId term = preds->count == 1 ? ir_block_terminator(fn, preds->items[0]) : IR_NONE;
+        if (term == IR_NONE || fn->insts[term].op != IR_OP_BRANCH) {
+          return 0;
+        }
+        guarded++;
+      }
+    }
+    return guarded >= 3;
+  }
+  return 0;
+}
+
+static int shape_logical_branches(IrModule *module, const char *assembly) {
+  size_t length;
+  const char *text = shape_function(assembly, "classify", &length);
+  return text && shape_mentions(text, length, "snez") && shape_count_branches(assembly, "classify") == 8 &&
+         shape_count_branches(assembly, "effects") == 6 && shape_guarded_increments(module, "effects");
+}
+
+static uint64_t shape_codegen_stat(IrModule *module, const CodegenOptions *options, const char *stat) {
+  FILE *out = tmpfile();
+  if (!out) {
+    return 0;
+  }
+  uint64_t before = stats_get(stat);
+  int ok = codegen_module(module, options, out) == 0;
+  fclose(out);
+  return ok ? stats_get(stat) - before : 0;
+}
+
+static int shape_graph_spills_less(IrModule *module, const char *assembly) {
+  (void) assembly;
+  TargetInfo target;
+  target_init(&target);
+  target_parse_march(&target, "rv32im");
+  CodegenOptions options;
+  codegen_options_init(&options, &target, 2);
+  options.regalloc = REGALLOC_LINEAR_SCAN;
+  uint64_t linear = shape_codegen_stat(module, &options, "regalloc.spills");
+  options.regalloc = REGALLOC_GRAPH_COLORING;
+  uint64_t graph = shape_codegen_stat(module, &options, "regalloc.spills");
+  if (linear == 0 || graph > linear) {
+    printf("[ERROR] linear scan spilled %llu times, graph coloring %llu times\n", (unsigned long long) linear,
+           (unsigned long long) graph);
+    return 0;
+  }
+  return 1;
+}
+
+static int shape_object_relocations(IrModule *module, const char *assembly) {
+  uint64_t expected = 0;
+  for (const char *line = strchr(assembly, '\n'); line; line = strchr(line + 1, '\n')) {
+    if (strncmp(line, "\n  call ", 8) == 0) {
+      expected += 2;
+    } else if (strncmp(line, "\n  b", 4) == 0 || strncmp(line, "\n  j ", 5) == 0) {
+      expected++;
+    }
+  }
+  TargetInfo target;
+  target_init(&target);
+  target_parse_march(&target, "rv32im");
+  CodegenOptions options;
+  codegen_options_init(&options, &target, 1);
+  options.emit_object = 1;
+  uint64_t relocations = shape_codegen_stat(module, &options, "obj.relocations");
+  if (expected == 0 || relocations < expected) {
+    printf("[ERROR] %llu relocations for %llu calls and branches\n", (unsigned long long) relocations,
+           (unsigned long long) expected);
+    return 0;
+  }
+  return 1;
+}
+
+static int shape_rodata_templates(IrModule *module, const char *assembly) {
+  return strstr(assembly, ".section .rodata") != NULL && shape_count_op(module, "crc_step", IR_OP_DATA) > 0 &&
+         shape_count_op(module, "crc_step", IR_OP_STORE) == 0 && shape_count_op(module, "shuffle", IR_OP_DATA) > 0 &&
+         shape_count_op(module, "shuffle", IR_OP_STORE) < 48;
+}
+
+static int shape_signed_templates(IrModule *module, const char *assembly) {
+  (void) assembly;
+  return shape_count_op(module, "signed_table", IR_OP_DATA) > 0 &&
+         shape_count_op(module, "signed_table", IR_OP_NEG) == 0 &&
+         shape_count_op(module, "signed_table", IR_OP_STORE) == 0;
+}
+
+static int shape_exports_kept(IrModule *module, const char *assembly) {
+  (void) assembly;
+  uint32_t count = module->function_count;
+  OptOptions options;
+  opt_options_init(&options, 2);
+  opt_optimize_module(module, &options);
+  return module->function_count == count && stats_get("ipo.calls_folded") == 0 &&
+         stats_get("ipo.functions_removed") == 0 && ir_verify_module(module) == 0;
+}
+
+static int shape_vector_matches_scalar(IrModule *module, const char *assembly) {
+  (void) assembly;
+  static const char *const pairs[][2] = {{"rv32imcv", "rv32imc"}, {"rv64imcv", "rv64imc"}};
+  for (uint32_t p = 0; p < sizeof(pairs) / sizeof(pairs[0]); p++) {
+    SimResult vector;
+    SimResult scalar;
+    SimStats vector_stats;
+    SimStats scalar_stats;
+    if (!simulate_module(module, 2, pairs[p][0], &vector, &vector_stats) ||
+        !simulate_module(module, 2, pairs[p][1], &scalar, &scalar_stats)) {
+      return 0;
+    }
+    if (vector.value != scalar.value || vector_stats.vector_insts == 0 || scalar_stats.vector_insts != 0) {
+      printf("[ERROR] %s returned %lld after %llu vector instructions, %s returned %lld\n", pairs[p][0],
+             (long long) vector.value, (unsigned long long) vector_stats.vector_insts, pairs[p][1],
+             (long long) scalar.value);
+      return 0;
+    }
+  }
+  return 1;
+}
+
+static char *shape_assembly(IrModule *module, const char *march, const int32_t opt_level) {
+  TargetInfo target;
+  target_init(&target);
+  target_parse_march(&target, march);
+  CodegenOptions options;
+  codegen_options_init(&options, &target, opt_level);
+  FILE *out = tmpfile();
+  if (!out) {
+    return NULL;
+  }
+  char *assembly = NULL;
+  if (codegen_module(module, &options, out) == 0) {
+    long size = ftell(out);
+    assembly = malloc((size_t) (size > 0 ? size : 0) + 1);
+    rewind(out);
+    size_t read = assembly && size > 0 ? fread(assembly, 1, (size_t) size, out) : 0;
+    if (assembly) {
+      assembly[read] = '\0';
+    }
+  }
+  fclose(out);
+  return assembly;
+}
+
+static int shape_check_module(const ShapeCheck *check, const AstModule *ast, const Sema *sema) {
+  IrModule module;
+  ir_module_init(&module);
+  ir_build_module(&module, ast, sema);
+  stats_reset();
+  OptOptions options;
+  opt_options_init(&options, check->opt_level);
+  options.pipeline = check->pipeline;
+  options.whole_program = 1;
+  opt_optimize_module(&module, &options);
+  char *assembly = shape_assembly(&module, check->march, check->opt_level);
+  int ok = assembly != NULL;
+  if (!ok) {
+    printf("[ERROR] assembly generation failed for %s\n", check->march);
+  } else if (check->stat && stats_get(check->stat) == 0) {
+    printf("[ERROR] %s stayed at zero\n", check->stat);
+    ok = 0;
+  } else if (check->predicate && !check->predicate(&module, assembly)) {
+    printf("[ERROR] unexpected IR or assembly shape\n");
+    ok = 0;
+  }
+  free(assembly);
+  ir_module_destroy(&module);
+  return ok;
+}
+
+static int run_shape_check(const ShapeCheck *check) {
+  char *path = make_path(check->path);
+  char *source = read_file(path);
+  int ok = source != NULL;
+  if (ok) {
+    diagnostic_reset();
+    Lexer lexer;
+    lexer_init(&lexer, source, path);
+    lexer_tokenize(&lexer);
+    ok = !lexer_had_error(&lexer);
+    if (ok) {
+      Parser parser;
+      parser_init(&parser, lexer_get_tokens(&lexer), source, path);
+      ParseResult pr = parser_parse(&parser);
+      ok = !pr.had_error;
+      if (ok) {
+        Sema sema;
+        sema_init(&sema, pr.module, source, path);
+        ok = !sema_analyze(&sema).had_error && shape_check_module(check, pr.module, &sema);
+        sema_destroy(&sema);
+      }
+      parser_destroy(&parser);
+    }
+    lexer_destroy(&lexer);
+  }
+  printf("[%s] %s: %s\n", ok ? "PASS" : "FAIL", check->name, path);
+  free(source);
+  free(path);
+  return ok;
+}
+
 static int run_one(const TestCase *tc) {
   char *path = make_path(tc->path);
   char *source = read_file(path);
@@ -76,18 +842,38 @@ static int run_one(const TestCase *tc) {
     ok = 0;
   }
 
-  if (ok && tc->stage == TEST_PARSE) {
+  if (ok && tc->stage >= TEST_PARSE) {
     Parser parser;
     parser_init(&parser, lexer_get_tokens(&lexer), source, path);
     ParseResult pr = parser_parse(&parser);
     if (pr.had_error) {
       ok = 0;
     }
-    if (ok && pr.module) {
+    if (ok && pr.module && tc->stage == TEST_PARSE) {
       printf("{ AST for %s:\n", path);
       ast_print_module(pr.module);
       printf("end AST }");
     }
+    if (ok && tc->stage >= TEST_SEMA) {
+      Sema sema;
+      sema_init(&sema, pr.module, source, path);
+      SemaResult sr = sema_analyze(&sema);
+      if (sr.had_error) {
+        ok = 0;
+      }
+      if (ok && tc->stage >= TEST_RUN) {
+        for (int32_t level = 0; ok && level <= 2; level++) {
+          ok = run_module(pr.module, &sema, level, NULL, tc->expected_value);
+        }
+        if (ok) {
+          ok = run_module(pr.module, &sema, 2, TEST_SHUFFLED_PIPELINE, tc->expected_value);
+        }
+        if (ok) {
+          ok = run_module(pr.module, &sema, 2, TEST_IVSR_PIPELINE, tc->expected_value);
+        }
+      }
+      sema_destroy(&sema);
+    }
     parser_destroy(&parser);
   }
 
@@ -103,12 +889,179 @@ static int run_one(const TestCase *tc) {
 
 int main(void) {
   const TestCase tests[] = {
-    {"lexer/invalid/lexer_error.c", 0, TEST_LEX},
+    {"lexer/invalid/lexer_error.c", 0, TEST_LEX, 0},
+
+    {"parser/valid/simple_main.c", 1, TEST_PARSE, 0},
+    {"parser/valid/arrays_and_while.c", 1, TEST_PARSE, 0},
+    {"parser/valid/calls_and_subscripts.c", 1, TEST_PARSE, 0},
+    {"parser/valid/func_params.c", 1, TEST_PARSE, 0},
+
+    {"parser/valid/arrays_and_while.c", 1, TEST_SEMA, 0},
+    {"parser/valid/calls_and_subscripts.c", 1, TEST_SEMA, 0},
+    {"parser/valid/func_params.c", 1, TEST_SEMA, 0},
+    {"sema/valid/shadowing.c", 1, TEST_SEMA, 0},
+    {"sema/invalid/undeclared.c", 0, TEST_SEMA, 0},
+    {"sema/invalid/redeclaration.c", 0, TEST_SEMA, 0},
+    {"sema/invalid/array_init.c", 0, TEST_SEMA, 0},
+    {"sema/invalid/bad_call.c", 0, TEST_SEMA, 0},
+
+    {"parser/valid/simple_main.c", 1, TEST_RUN, 3},
+    {"parser/valid/arrays_and_while.c", 1, TEST_RUN, 6},
+    {"parser/valid/calls_and_subscripts.c", 1, TEST_RUN, 6},
+    {"parser/valid/func_params.c", 1, TEST_RUN, 22},
+    {"sema/valid/shadowing.c", 1, TEST_RUN, 103},
+    {"ir/valid/control_flow.c", 1, TEST_RUN, 47},
+    {"ir/valid/recursion.c", 1, TEST_RUN, 55},
+    {"ir/valid/char_arith.c", 1, TEST_RUN, 44},
+    {"opt/valid/constant_branches.c", 1, TEST_RUN, 16},
+    {"opt/valid/dead_code.c", 1, TEST_RUN, 15},
+    {"opt/valid/redundant_exprs.c", 1, TEST_RUN, 406},
+    {"opt/valid/loop_invariants.c", 1, TEST_RUN, 292},
+    {"opt/valid/array_loops.c", 1, TEST_RUN, 1280},
+    {"opt/valid/inlining.c", 1, TEST_RUN, 248},
+    {"opt/valid/tail_calls.c", 1, TEST_RUN, 6166},
+    {"opt/valid/scalar_arrays.c", 1, TEST_RUN, 213},
+    {"opt/valid/div_by_constants.c", 1, TEST_RUN, -208},
+    {"opt/valid/pure_calls.c", 1, TEST_RUN, 1229},
+    {"opt/valid/ivsr_dead_access.c", 1, TEST_RUN, -457},
+    {"opt/valid/ivsr_bounds.c", 1, TEST_RUN, 1193},
+    {"target/valid/codegen_mix.c", 1, TEST_RUN, -302340},
+    {"target/valid/vector_loops.c", 1, TEST_RUN, 1420700},
+    {"target/valid/branch_layout.c", 1, TEST_RUN, 54991},
+    {"target/valid/shrink_wrap.c", 1, TEST_RUN, 504780},
+    {"target/valid/array_init.c", 1, TEST_RUN, 118320},
+    {"target/valid/logical_ops.c", 1, TEST_RUN, 190349},
+    {"target/valid/init_tail.c", 1, TEST_RUN, 790},
+    {"target/valid/reg_pressure.c", 1, TEST_RUN, -2125771421},
+  };
+
+  const ShapeCheck shapes[] = {
+    {"sccp folds branches", "opt/valid/constant_branches.c", "rv32im", 0, "sccp", "sccp.branches_folded", NULL},
+    {"gvn removes expressions", "opt/valid/redundant_exprs.c", "rv32im", 0, "gvn", "gvn.insts_removed", NULL},
+    {"gvn removes loads", "opt/valid/redundant_exprs.c", "rv32im", 0, "gvn", "gvn.loads_removed", NULL},
+    {"licm hoists invariants", "opt/valid/loop_invariants.c", "rv32im", 0, "licm", "licm.insts_hoisted", NULL},
+    {"ivsr rewrites subscripts", "opt/valid/array_loops.c", "rv32im", 0, "ivsr", "ivsr.accesses_rewritten", NULL},
+    {"ivsr removes bounded counters", "opt/valid/ivsr_bounds.c", "rv32im", 0, TEST_IVSR_PIPELINE,
+     "ivsr.counters_removed", NULL},
+    {"small leaves are inlined", "opt/valid/inlining.c", "rv32im", 0, "inline", "inline.calls_inlined",
+     shape_leaves_inlined},
+    {"tail recursion becomes a loop", "opt/valid/tail_calls.c", "rv32im", 0, "tailrec", "tailcall.recursion_to_loop",
+     shape_no_self_calls},
+    {"sroa promotes arrays", "opt/valid/scalar_arrays.c", "rv32im", 0, "sccp,sroa", "sroa.arrays_split",
+     shape_arrays_promoted},
+    {"divconst lowers divisions", "opt/valid/div_by_constants.c", "rv32im", 0, "sccp,divconst",
+     "divconst.divs_lowered", shape_divisions_lowered},
+    {"divconst lowers remainders", "opt/valid/div_by_constants.c", "rv32im", 0, "sccp,divconst",
+     "divconst.rems_lowered", NULL},
+    {"pass manager reuses dominators", "opt/valid/redundant_exprs.c", "rv32im", 0, "gvn,dce,gvn,dse,gvn",
+     "analysis.dom_computed", shape_dom_cached},
+    {"vector loops match the scalar build", "target/valid/vector_loops.c", "rv32imcv", 2, NULL, "vectorize.loops",
+     shape_vector_matches_scalar},
+    {"blocks are placed for fall-through", "target/valid/branch_layout.c", "rv32im", 1, NULL, "layout.blocks_moved",
+     shape_blocks_placed},
+    {"leaf frames are elided", "target/valid/shrink_wrap.c", "rv32im", 1, NULL, "frame.elided",
+     shape_leaf_frames_elided},
+    {"saves are shrink-wrapped", "target/valid/shrink_wrap.c", "rv32im", 1, NULL, "frame.shrink_wrapped",
+     shape_saves_shrink_wrapped},
+    {"logical operators branch only in conditions", "target/valid/logical_ops.c", "rv32im", 0, NULL, NULL,
+     shape_logical_branches},
+    {"graph coloring spills less than linear scan", "target/valid/reg_pressure.c", "rv32im", 2, "inline",
+     "regalloc.spills", shape_graph_spills_less},
+    {"objects relocate calls and branches", "target/valid/codegen_mix.c", "rv32im", 1, "sccp", NULL,
+     shape_object_relocations},
+    {"initializers use .rodata templates", "target/valid/array_init.c", "rv32im", 0, NULL, NULL,
+     shape_rodata_templates},
+    {"negative initializers use templates", "target/valid/init_tail.c", "rv32im", 0, NULL, NULL,
+     shape_signed_templates},
+    {"pure calls are folded", "opt/valid/pure_calls.c", "rv32im", 0, "purecall", "ipo.calls_folded", NULL},
+    {"dead functions are removed", "opt/valid/pure_calls.c", "rv32im", 0, "purecall,globaldce", "ipo.functions_removed",
+     NULL},
+    {"exported functions are kept", "opt/valid/pure_calls.c", "rv32im", 0, NULL, NULL, shape_exports_kept},
+  };
+
+  const SchedCheck sched_checks[] = {
+    {"generic", {0, 2, 1, 4, 3}},
+    {"rocket", {0, 2, 4, 1, 3}},
+    {"sifive-7", {0, 2, 4, 1, 3}},
+  };
 
-    {"parser/valid/simple_main.c", 1, TEST_PARSE},
-    {"parser/valid/arrays_and_while.c", 1, TEST_PARSE},
-    {"parser/valid/calls_and_subscripts.c", 1, TEST_PARSE},
-    {"parser/valid/func_params.c", 1, TEST_PARSE},
+  const PeepholeCheck peepholes[] = {
+    {"identity_move fires", "identity_move", "rv32im", 2,
+     {TEST_MIR(ADDI, 0, RV_A0, RV_A0, MIR_NONE, 0, MIR_NONE),
+      TEST_MIR(ADD, 0, RV_A1, RV_A0, RV_T1, 0, MIR_NONE)},
+     1,
+     {TEST_MIR(ADD, 0, RV_A1, RV_A0, RV_T1, 0, MIR_NONE)},
+     1},
+    {"move_chain fires", "move_chain", "rv32im", 2,
+     {TEST_MIR(ADDI, 0, RV_T0, RV_A0, MIR_NONE, 0, MIR_NONE),
+      TEST_MIR(ADD, 0, RV_A1, RV_T0, RV_T1, 0, MIR_NONE)},
+     2,
+     {TEST_MIR(ADDI, 0, RV_T0, RV_A0, MIR_NONE, 0, MIR_NONE),
+      TEST_MIR(ADD, 0, RV_A1, RV_A0, RV_T1, 0, MIR_NONE)},
+     1},
+    {"dead_def fires", "dead_def", "rv32im", 2,
+     {TEST_MIR(ADDI, 0, RV_T0, RV_A0, MIR_NONE, 5, MIR_NONE),
+      TEST_MIR(ADDI, 0, RV_T0, RV_A1, MIR_NONE, 7, MIR_NONE)},
+     1,
+     {TEST_MIR(ADDI, 0, RV_T0, RV_A1, MIR_NONE, 7, MIR_NONE)},
+     1},
+    {"store_load_word fires", "store_load_word", "rv32im", 2,
+     {TEST_MIR(SW, 0, MIR_NONE, RV_A0, RV_A1, 4, MIR_NONE),
+      TEST_MIR(LW, 0, RV_T1, RV_A0, MIR_NONE, 4, MIR_NONE)},
+     2,
+     {TEST_MIR(SW, 0, MIR_NONE, RV_A0, RV_A1, 4, MIR_NONE),
+      TEST_MIR(ADDI, 0, RV_T1, RV_A1, MIR_NONE, 0, MIR_NONE)},
+     1},
+    {"store_load_double fires", "store_load_double", "rv64imc", 2,
+     {TEST_MIR(SD, 0, MIR_NONE, RV_A0, RV_A1, 8, MIR_NONE),
+      TEST_MIR(LD, 0, RV_T1, RV_A0, MIR_NONE, 8, MIR_NONE)},
+     2,
+     {TEST_MIR(SD, 0, MIR_NONE, RV_A0, RV_A1, 8, MIR_NONE),
+      TEST_MIR(ADDI, 0, RV_T1, RV_A1, MIR_NONE, 0, MIR_NONE)},
+     1},
+    {"store_load_byte fires", "store_load_byte", "rv32im", 2,
+     {TEST_MIR(SB, 0, MIR_NONE, RV_A0, RV_A1, 0, MIR_NONE),
+      TEST_MIR(LBU, 0, RV_T1, RV_A0, MIR_NONE, 0, MIR_NONE)},
+     2,
+     {TEST_MIR(SB, 0, MIR_NONE, RV_A0, RV_A1, 0, MIR_NONE),
+      TEST_MIR(ANDI, 0, RV_T1, RV_A1, MIR_NONE, 255, MIR_NONE)},
+     1},
+    {"redundant_sext fires", "redundant_sext", "rv64imc", 2,
+     {TEST_MIR(ADDW, 0, RV_T1, RV_A0, RV_A1, 0, MIR_NONE),
+      TEST_MIR(ADDIW, 0, RV_T2, RV_T1, MIR_NONE, 0, MIR_NONE)},
+     2,
+     {TEST_MIR(ADDW, 0, RV_T1, RV_A0, RV_A1, 0, MIR_NONE),
+      TEST_MIR(ADDI, 0, RV_T2, RV_T1, MIR_NONE, 0, MIR_NONE)},
+     1},
+    {"branch_over_jump fires", "branch_over_jump", "rv32im", 2,
+     {TEST_MIR(BEQ, 0, MIR_NONE, RV_A0, RV_A1, 0, 1),
+      TEST_MIR(JAL, 0, RV_ZERO, MIR_NONE, MIR_NONE, 0, 2)},
+     1,
+     {TEST_MIR(BNE, 0, MIR_NONE, RV_A0, RV_A1, 0, 2)},
+     1},
+    {"store_load_word is blocked by a store", "store_load_word", "rv32im", 3,
+     {TEST_MIR(SW, 0, MIR_NONE, RV_A0, RV_A1, 4, MIR_NONE),
+      TEST_MIR(SW, 0, MIR_NONE, RV_T2, RV_T1, 0, MIR_NONE),
+      TEST_MIR(LW, 0, RV_T1, RV_A0, MIR_NONE, 4, MIR_NONE)},
+     3,
+     {TEST_MIR(SW, 0, MIR_NONE, RV_A0, RV_A1, 4, MIR_NONE),
+      TEST_MIR(SW, 0, MIR_NONE, RV_T2, RV_T1, 0, MIR_NONE),
+      TEST_MIR(LW, 0, RV_T1, RV_A0, MIR_NONE, 4, MIR_NONE)},
+     0},
+    {"store_load_word is blocked by a frame access", "store_load_word", "rv32im", 2,
+     {TEST_MIR(SW, MIR_INST_FRAME, MIR_NONE, RV_SP, RV_A1, 0, 0),
+      TEST_MIR(LW, MIR_INST_FRAME, RV_T1, RV_SP, MIR_NONE, 0, 0)},
+     2,
+     {TEST_MIR(SW, MIR_INST_FRAME, MIR_NONE, RV_SP, RV_A1, 0, 0),
+      TEST_MIR(LW, MIR_INST_FRAME, RV_T1, RV_SP, MIR_NONE, 0, 0)},
+     0},
+    {"branch_over_jump needs a fall-through target", "branch_over_jump", "rv32im", 2,
+     {TEST_MIR(BEQ, 0, MIR_NONE, RV_A0, RV_A1, 0, 2),
+      TEST_MIR(JAL, 0, RV_ZERO, MIR_NONE, MIR_NONE, 0, 3)},
+     2,
+     {TEST_MIR(BEQ, 0, MIR_NONE, RV_A0, RV_A1, 0, 2),
+      TEST_MIR(JAL, 0, RV_ZERO, MIR_NONE, MIR_NONE, 0, 3)},
+     0},
   };
 
   int passed = 0;
@@ -116,6 +1069,23 @@ int main(void) {
   for (int i = 0; i < total; i++) {
     passed += run_one(&tests[i]);
   }
+  int shape_count = (int) (sizeof(shapes) / sizeof(shapes[0]));
+  for (int i = 0; i < shape_count; i++) {
+    passed += run_shape_check(&shapes[i]);
+  }
+  total += shape_count;
+  int sched_count = (int) (sizeof(sched_checks) / sizeof(sched_checks[0]));
+  for (int i = 0; i < sched_count; i++) {
+    passed += run_sched_check(&sched_checks[i]);
+  }
+  total += sched_count;
+  int peephole_count = (int) (sizeof(peepholes) / sizeof(peepholes[0]));
+  for (int i = 0; i < peephole_count; i++) {
+    passed += run_peephole_check(&peepholes[i]);
+  }
+  total += peephole_count;
+  passed += run_div_const_check();
+  total++;
 
   printf("\nsummary: %d/%d passed\n", passed, total);
   return (passed == total) ? 0 : 1;